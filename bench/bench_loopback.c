@@ -0,0 +1,164 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "loopback.h"
+#include "log.h"
+
+#define MAX_PAIRS   LOOPBACK_FRAMES /* A whole burst of ConnReq fits the queue */
+#define DATA_ROUNDS 200U
+#define PING_ROUNDS 100000U
+#define RUN_ROUNDS  100U
+
+static StdRet_t Client_Receive(const SafeComSpdu* const pSpdus, const uint32_t count);
+static StdRet_t Server_Receive(const SafeComSpdu* const pSpdus, const uint32_t count);
+static StdRet_t ReceiveMsg(const MsgId_t msgId, const MsgLen_t msgLen, const uint8_t* const pMsgData);
+
+static Loopback wire;
+static SafeCom client;
+static SafeCom server;
+static SmType *client_sms;
+static SmType *server_sms;
+static uint64_t messages = 0;
+
+static double now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static StdRet_t setup(const uint32_t pairs)
+{
+    const SafeComType client_config = {
+        .vtable = { .SendSpdu = Loopback_ClientSendSpdu, .SendSpduBatch = Loopback_ClientSendSpduBatch, .ReceiveMsg = ReceiveMsg },
+        .config = { .instname = "rass", .role = ROLE_CLIENT, .max_connections = pairs, .sms = client_sms },
+    };
+    const SafeComType server_config = {
+        .vtable = { .SendSpdu = Loopback_ServerSendSpdu, .SendSpduBatch = Loopback_ServerSendSpduBatch, .ReceiveMsg = ReceiveMsg },
+        .config = { .instname = "sic", .role = ROLE_SERVER, .max_connections = pairs, .sms = server_sms },
+    };
+    const LoopbackConfig wire_config = { .ToClient = Client_Receive, .ToServer = Server_Receive };
+
+    memset(client_sms, 0, MAX_PAIRS * sizeof(SmType));
+    memset(server_sms, 0, MAX_PAIRS * sizeof(SmType));
+    Loopback_Init(&wire, &wire_config);
+
+    return ((SafeCom_Init(&client, &client_config) == OK) && (SafeCom_Init(&server, &server_config) == OK)) ? OK : NOT_OK;
+}
+
+/* ConnReq, ConnResp and HB for every pair; returns ns per connection brought up */
+static double run_handshake(const uint32_t pairs, uint32_t *up)
+{
+    const double start = now_ns();
+
+    for (uint32_t i = 0; i < pairs; i++) {
+        SafeCom_OpenConnection(&server, i);
+        SafeCom_OpenConnection(&client, i);
+    }
+    Loopback_Run(&wire, RUN_ROUNDS);
+    const double ns = (now_ns() - start) / pairs;
+
+    *up = 0;
+    for (uint32_t i = 0; i < pairs; i++) {
+        *up += ((client_sms[i].state == STATE_UP) && (server_sms[i].state == STATE_UP)) ? 1U : 0U;
+    }
+
+    return ns;
+}
+
+/* A Data PDU on every pair per round, client to server; returns ns per message delivered */
+static double run_data(const uint32_t pairs)
+{
+    const uint8_t payload[32] = { 0 };
+
+    messages = 0;
+    const double start = now_ns();
+    for (uint32_t round = 0; round < DATA_ROUNDS; round++) {
+        for (uint32_t i = 0; i < pairs; i++) {
+            SafeCom_SendData(&client, i, sizeof(payload), payload);
+        }
+        Loopback_Run(&wire, RUN_ROUNDS);
+    }
+
+    return (messages > 0U) ? (now_ns() - start) / (double)messages : 0.0;
+}
+
+/* Data there and back on pair 0; returns ns per round trip */
+static double run_ping(void)
+{
+    const uint8_t payload[32] = { 0 };
+
+    messages = 0;
+    const double start = now_ns();
+    for (uint32_t round = 0; round < PING_ROUNDS; round++) {
+        SafeCom_SendData(&client, 0, sizeof(payload), payload);
+        Loopback_Pump(&wire);
+        SafeCom_SendData(&server, 0, sizeof(payload), payload);
+        Loopback_Pump(&wire);
+    }
+
+    return (messages == (2U * PING_ROUNDS)) ? (now_ns() - start) / PING_ROUNDS : 0.0;
+}
+
+int main(void)
+{
+    static const uint32_t pairs[] = { 1U, 16U, 256U, MAX_PAIRS };
+
+    set_loglevel_filter(LOG_ERROR);
+    if ((posix_memalign((void**)&client_sms, SM_CACHE_LINE, MAX_PAIRS * sizeof(SmType)) != 0) ||
+        (posix_memalign((void**)&server_sms, SM_CACHE_LINE, MAX_PAIRS * sizeof(SmType)) != 0)) {
+        printf("out of memory\n");
+        return 1;
+    }
+
+    printf("Rass client to Sic server over the in-process loopback\n");
+    printf("%8s %8s %16s %16s %16s\n", "pairs", "up", "handshake ns", "data ns/msg", "msgs/s");
+    for (uint32_t k = 0; k < sizeof(pairs) / sizeof(pairs[0]); k++) {
+        uint32_t up = 0;
+
+        if (setup(pairs[k]) != OK) {
+            printf("instances could not be set up\n");
+            return 1;
+        }
+        const double handshake = run_handshake(pairs[k], &up);
+        const double data = run_data(pairs[k]);
+        printf("%8u %8u %16.0f %16.1f %16.0f\n", pairs[k], up, handshake, data, (data > 0.0) ? 1e9 / data : 0.0);
+    }
+
+    setup(1);
+    uint32_t up = 0;
+    run_handshake(1, &up);
+    printf("round trip of a Data PDU on one pair: %.0f ns\n", run_ping());
+    printf("dropped on the wire: %lu\n", (unsigned long)(wire.to_server.dropped + wire.to_client.dropped));
+
+    free(client_sms);
+    free(server_sms);
+
+    return 0;
+}
+
+static StdRet_t Client_Receive(const SafeComSpdu* const pSpdus, const uint32_t count)
+{
+    return SafeCom_ReceiveSpduBatch(&client, pSpdus, count);
+}
+
+static StdRet_t Server_Receive(const SafeComSpdu* const pSpdus, const uint32_t count)
+{
+    return SafeCom_ReceiveSpduBatch(&server, pSpdus, count);
+}
+
+static StdRet_t ReceiveMsg(const MsgId_t msgId, const MsgLen_t msgLen, const uint8_t* const pMsgData)
+{
+    (void)msgId;
+    (void)msgLen;
+    (void)pMsgData;
+
+    messages++;
+    return OK;
+}
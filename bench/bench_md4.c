@@ -0,0 +1,110 @@
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <time.h>
+
+#include "md4.h"
+#include "md4_multi.h"
+#include "sm.h"
+#include "pdu.h"
+
+#define BATCH       64U         /* One full transmit batch */
+#define ROUNDS      20000U
+
+static const char *kernel_names[] = { "scalar", "sse2", "avx2", "avx512" };
+
+static uint8_t frames[BATCH][MAX_BUFF_SIZE];
+static const uint8_t *msgs[BATCH];
+static size_t lens[BATCH];
+static uint8_t digests[BATCH][MD4_DIGEST_LENGTH];
+
+static double now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+/* Per-PDU MD4 as the transmit path did it before batching */
+static double bench_md4(void)
+{
+    const double start = now_ns();
+
+    for (uint32_t r = 0; r < ROUNDS; r++) {
+        for (uint32_t i = 0; i < BATCH; i++) {
+            MD4_CTX ctx;
+            MD4_Init(&ctx);
+            MD4_Update(&ctx, msgs[i], lens[i]);
+            MD4_Final(digests[i], &ctx);
+        }
+    }
+
+    return (now_ns() - start) / ((double)ROUNDS * BATCH);
+}
+
+/* One compression per PDU, for the messages that fit in one block */
+static double bench_md4_oneblock(void)
+{
+    const double start = now_ns();
+
+    for (uint32_t r = 0; r < ROUNDS; r++) {
+        for (uint32_t i = 0; i < BATCH; i++) {
+            md4_oneblock(digests[i], NULL, msgs[i], lens[i]);
+        }
+    }
+
+    return (now_ns() - start) / ((double)ROUNDS * BATCH);
+}
+
+static double bench_md4_multi(void)
+{
+    const double start = now_ns();
+
+    for (uint32_t r = 0; r < ROUNDS; r++) {
+        md4_multi(NULL, msgs, lens, digests, BATCH);
+    }
+
+    return (now_ns() - start) / ((double)ROUNDS * BATCH);
+}
+
+int main(void)
+{
+    /* Safety-code input of a heartbeat, a ConnReq and the longest Data PDU */
+    const size_t sizes[] = {
+        PDU_FIXED_FIELDS_LENGTH - SAFETY_CODE_LENGTH,
+        PDU_FIXED_FIELDS_LENGTH + CONN_REQ_PAYLOAD_LENGTH - SAFETY_CODE_LENGTH,
+        MAX_BUFF_SIZE - SAFETY_CODE_LENGTH,
+    };
+    const Md4MultiKernel initial = md4_multi_kernel();
+
+    for (uint32_t i = 0; i < BATCH; i++) {
+        for (uint32_t j = 0; j < MAX_BUFF_SIZE; j++) {
+            frames[i][j] = (uint8_t)(i + j);
+        }
+        msgs[i] = frames[i];
+    }
+
+    printf("%-8s %-10s %10s\n", "bytes", "kernel", "ns/digest");
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        for (uint32_t i = 0; i < BATCH; i++) {
+            lens[i] = sizes[s];
+        }
+
+        printf("%-8zu %-10s %10.1f\n", sizes[s], "md4", bench_md4());
+        if (sizes[s] <= MD4_ONEBLOCK_MAX_LENGTH) {
+            printf("%-8zu %-10s %10.1f\n", sizes[s], "oneblock", bench_md4_oneblock());
+        }
+        for (Md4MultiKernel kernel = MD4_MULTI_SCALAR; kernel <= MD4_MULTI_AVX512; kernel++) {
+            if (md4_multi_select(kernel)) {
+                printf("%-8zu %-10s %10.1f\n", sizes[s], kernel_names[kernel], bench_md4_multi());
+            }
+        }
+    }
+
+    md4_multi_select(initial);
+
+    return 0;
+}
@@ -0,0 +1,261 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <time.h>
+#include <unistd.h>
+#include <sched.h>
+#include <pthread.h>
+
+#include "shard.h"
+#include "log.h"
+
+#define CONNECTIONS 4096U
+#define FRAMES      32U         /* Data PDUs per connection and run */
+
+/* Where the SPDUs of the peer clients go */
+typedef enum {
+    WIRE_HANDSHAKE = 0U,    /* Into the engine, answers straight back to the clients */
+    WIRE_CAPTURE,           /* Into the recorded frames of the run */
+    WIRE_NONE
+} WireMode;
+
+typedef struct {
+    SpduLen_t len;
+    uint8_t data[MAX_BUFF_SIZE];
+} Frame;
+
+typedef struct {
+    uint32_t producer;
+    uint32_t producers;
+} Producer;
+
+static StdRet_t Server_SendSpdu(const NodeId_t nodeId, const SpduLen_t spduLen, const uint8_t* const pSpduData);
+static StdRet_t Server_ReceiveMsg(const MsgId_t msgId, const MsgLen_t msgLen, const uint8_t* const pMsgData);
+static StdRet_t Client_SendSpdu(const NodeId_t nodeId, const SpduLen_t spduLen, const uint8_t* const pSpduData);
+
+static SafeComVtable client_vtable = { .SendSpdu = Client_SendSpdu, .ReceiveMsg = Server_ReceiveMsg };
+static SmShared client_shared;
+static ShardEngine engine;
+static SmType *servers;
+static SmType *clients;
+static Frame (*frames)[FRAMES];
+static uint32_t captured[CONNECTIONS];
+static WireMode wire = WIRE_NONE;
+
+static double now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static void poll_all(const uint32_t workers)
+{
+    uint32_t handled;
+
+    do {
+        handled = 0;
+        for (uint32_t k = 0; k < workers; k++) {
+            handled += Shard_Poll(&engine, k);
+        }
+    } while (handled > 0U);
+}
+
+/* Bring all connections up and record the Data PDUs of the run, single-threaded */
+static uint32_t prepare(const uint32_t workers, const uint32_t producers)
+{
+    const SafeComType config = {
+        .vtable = { .SendSpdu = Server_SendSpdu, .ReceiveMsg = Server_ReceiveMsg },
+        .config = { .instname = "gateway", .role = ROLE_SERVER, .max_connections = CONNECTIONS, .sms = servers },
+    };
+    PDU_S pdu = { 0 };
+    uint32_t up = 0;
+
+    memset(servers, 0, CONNECTIONS * sizeof(SmType));
+    memset(clients, 0, CONNECTIONS * sizeof(SmType));
+    memset(captured, 0, sizeof(captured));
+    if (Shard_Init(&engine, &config, workers, producers) != OK) {
+        return 0;
+    }
+
+    Sm_SharedInit(&client_shared, &client_vtable);
+    wire = WIRE_HANDSHAKE;
+    for (MsgId_t i = 0; i < CONNECTIONS; i++) {
+        clients[i].role = ROLE_CLIENT;
+        clients[i].shared = &client_shared;
+        clients[i].channel = i;
+        Sm_Init(&clients[i]);
+
+        Shard_OpenConnection(&engine, 0, i);
+        poll_all(workers);
+        Sm_HandleEvent(&clients[i], EVENT_OPEN_CONN, &pdu);
+        poll_all(workers);
+        up += ((servers[i].state == STATE_UP) && (clients[i].state == STATE_UP)) ? 1U : 0U;
+    }
+
+    wire = WIRE_CAPTURE;
+    for (uint32_t k = 0; k < FRAMES; k++) {
+        for (MsgId_t i = 0; i < CONNECTIONS; i++) {
+            const uint8_t payload[MAX_DATA_LENGTH / 2U] = { (uint8_t)k };
+
+            Data(&clients[i], &pdu, sizeof(payload), payload);
+            Sm_HandleEvent(&clients[i], EVENT_SEND_DATA, &pdu);
+        }
+    }
+    wire = WIRE_NONE;
+
+    return up;
+}
+
+/* Each producer posts the frames of every producers-th connection, in order per connection */
+static void* produce(void* arg)
+{
+    const Producer* const self = (const Producer*)arg;
+
+    for (uint32_t k = 0; k < FRAMES; k++) {
+        for (MsgId_t i = self->producer; i < CONNECTIONS; i += self->producers) {
+            while (Shard_ReceiveSpdu(&engine, self->producer, i, frames[i][k].len, frames[i][k].data) != OK) {
+                sched_yield();
+            }
+        }
+    }
+
+    return NULL;
+}
+
+static uint64_t processed(const uint32_t workers)
+{
+    uint64_t sum = 0;
+
+    for (uint32_t k = 0; k < workers; k++) {
+        sum += __atomic_load_n(&engine.shards[k].processed, __ATOMIC_ACQUIRE);
+    }
+
+    return sum;
+}
+
+static double run(const uint32_t workers, uint32_t *full, uint32_t *delivered)
+{
+    const uint32_t producers = (workers < SHARD_MAX_PRODUCERS) ? workers : SHARD_MAX_PRODUCERS;
+    const uint64_t total = (uint64_t)CONNECTIONS * FRAMES;
+    pthread_t threads[SHARD_MAX_PRODUCERS];
+    Producer args[SHARD_MAX_PRODUCERS];
+
+    if (prepare(workers, producers) != CONNECTIONS) {
+        return 0.0;
+    }
+
+    const uint64_t before = processed(workers);
+    const int32_t snr_before = servers[0].snr;
+
+    Shard_Start(&engine);
+    const double start = now_ns();
+
+    for (uint32_t p = 0; p < producers; p++) {
+        args[p].producer = p;
+        args[p].producers = producers;
+        pthread_create(&threads[p], NULL, produce, &args[p]);
+    }
+    for (uint32_t p = 0; p < producers; p++) {
+        pthread_join(threads[p], NULL);
+    }
+    while ((processed(workers) - before) < total) {
+        sched_yield();
+    }
+
+    const double elapsed = now_ns() - start;
+    Shard_Stop(&engine);
+
+    *full = 0;
+    for (uint32_t k = 0; k < workers; k++) {
+        *full += Shard_Overflows(&engine, k);
+    }
+    *delivered = (uint32_t)(servers[0].snr - snr_before);
+
+    return (double)total / (elapsed / 1e9);
+}
+
+int main(void)
+{
+    const long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    const uint32_t max_workers = ((cpus > 0) && ((unsigned long)cpus < SHARD_MAX_WORKERS)) ? (uint32_t)cpus : SHARD_MAX_WORKERS;
+    double single = 0.0;
+
+    set_loglevel_filter(LOG_ERROR);
+
+    /* Connections start on a cache line of their own; prepare() clears them */
+    if ((posix_memalign((void **)&servers, SM_CACHE_LINE, CONNECTIONS * sizeof(SmType)) != 0) ||
+        (posix_memalign((void **)&clients, SM_CACHE_LINE, CONNECTIONS * sizeof(SmType)) != 0)) {
+        return 1;
+    }
+    frames = calloc(CONNECTIONS, sizeof(*frames));
+    if (frames == NULL) {
+        return 1;
+    }
+
+    printf("%u connections, %u Data PDUs each, %ld CPUs online\n", CONNECTIONS, FRAMES, cpus);
+    printf("%8s %14s %9s %10s %12s\n", "workers", "SPDU/s", "speedup", "ring full", "delivered/c");
+
+    /* 1, 2, 4, ... workers and finally all CPUs */
+    for (uint32_t workers = 1; ; workers = ((2U * workers) < max_workers) ? (2U * workers) : max_workers) {
+        uint32_t full = 0;
+        uint32_t delivered = 0;
+        const double rate = run(workers, &full, &delivered);
+
+        if (rate == 0.0) {
+            printf("%8u %14s\n", workers, "setup failed");
+            break;
+        }
+        if (single == 0.0) {
+            single = rate;
+        }
+        printf("%8u %14.0f %8.2fx %10u %12u\n", workers, rate, rate / single, full, delivered);
+        if (workers == max_workers) {
+            break;
+        }
+    }
+
+    free(frames);
+    free(clients);
+    free(servers);
+
+    return 0;
+}
+
+static StdRet_t Server_SendSpdu(const NodeId_t nodeId, const SpduLen_t spduLen, const uint8_t* const pSpduData)
+{
+    PDU_View view;
+
+    if ((wire == WIRE_HANDSHAKE) && pdu_view_init_verified(&view, pSpduData, spduLen, &clients[nodeId].safety_code)) {
+        Sm_HandlePdu(&clients[nodeId], &view);
+    }
+
+    return OK;
+}
+
+static StdRet_t Server_ReceiveMsg(const MsgId_t msgId, const MsgLen_t msgLen, const uint8_t* const pMsgData)
+{
+    (void)msgId;
+    (void)msgLen;
+    (void)pMsgData;
+
+    return OK;
+}
+
+static StdRet_t Client_SendSpdu(const NodeId_t nodeId, const SpduLen_t spduLen, const uint8_t* const pSpduData)
+{
+    if (wire == WIRE_HANDSHAKE) {
+        Shard_ReceiveSpdu(&engine, 0, nodeId, spduLen, pSpduData);
+    }
+    else if ((wire == WIRE_CAPTURE) && (captured[nodeId] < FRAMES)) {
+        Frame* const frame = &frames[nodeId][captured[nodeId]++];
+        frame->len = spduLen;
+        memcpy(frame->data, pSpduData, spduLen);
+    }
+
+    return OK;
+}
@@ -0,0 +1,162 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <sched.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/wait.h>
+
+#include "shm.h"
+#include "udp.h"
+#include "log.h"
+
+#define FRAMES      1000000U
+#define ROUNDS      100000U
+#define SPDU_LEN    (PDU_HEADER_LENGTH + 32U + SAFETY_CODE_LENGTH) /* Data PDU with a small payload */
+#define ROUTES      4U
+
+static ShmTransport client_shm;
+static ShmTransport server_shm;
+static UdpTransport client_udp;
+static UdpTransport server_udp;
+static struct sockaddr_in client_peers[1];
+static struct sockaddr_in server_peers[1];
+static UdpRoute client_routes[ROUTES];
+static UdpRoute server_routes[ROUTES];
+static uint8_t frame[SPDU_LEN];
+static volatile uint64_t sink;
+
+static double now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+/* A spinning peer on the only CPU would just burn the time slice of the other */
+static void idle(const bool shared_cpu)
+{
+    if (shared_cpu) {
+        sched_yield();
+    }
+}
+
+/* One frame handed from one end to the other within a thread: the cost of the ring alone */
+static double run_handoff(void)
+{
+    const double start = now_ns();
+
+    for (uint32_t i = 0; i < FRAMES; i++) {
+        const SafeComSpdu* rx;
+
+        Shm_SendSpdu(&client_shm, 0, SPDU_LEN, frame);
+        if (Shm_Receive(&server_shm, &rx) == 1U) {
+            sink += rx[0].pSpduData[0];
+        }
+    }
+
+    return (now_ns() - start) / FRAMES;
+}
+
+/* The same over loopback UDP sockets, one sendmmsg and one recvmmsg per frame */
+static double run_udp_handoff(void)
+{
+    struct sockaddr_in local = { .sin_family = AF_INET, .sin_port = 0 };
+    local.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    const UdpConfig client_config = { .local = local, .peers = client_peers, .peer_count = 1, .routes = client_routes, .route_count = ROUTES };
+    const UdpConfig server_config = { .local = local, .peers = server_peers, .peer_count = 1, .routes = server_routes, .route_count = ROUTES };
+
+    if ((Udp_Init(&client_udp, &client_config) != OK) || (Udp_Init(&server_udp, &server_config) != OK) ||
+        (Udp_AddPeer(&client_udp, 0, &server_udp.local) != OK) || (Udp_AddPeer(&server_udp, 0, &client_udp.local) != OK)) {
+        return 0.0;
+    }
+
+    const double start = now_ns();
+    for (uint32_t i = 0; i < ROUNDS; i++) {
+        const SafeComSpdu* rx;
+
+        Udp_SendSpdu(&client_udp, 0, SPDU_LEN, frame);
+        Udp_Flush(&client_udp);
+        while (Udp_Receive(&server_udp, &rx) == 0U) {
+        }
+        sink += rx[0].pSpduData[0];
+    }
+    const double ns = (now_ns() - start) / ROUNDS;
+
+    Udp_Close(&client_udp);
+    Udp_Close(&server_udp);
+
+    return ns;
+}
+
+/* Ping-pong with a forked process echoing every frame; half a round trip is one handoff */
+static double run_ping_pong(const bool shared_cpu)
+{
+    const pid_t pid = fork();
+
+    if (pid == 0) {
+        ShmTransport echo;
+        const ShmConfig config = { .first_node = 0, .peer_count = 1 };
+        uint32_t echoed = 0;
+
+        if (Shm_Attach(&echo, &config, dup(client_shm.fd)) != OK) {
+            _exit(1);
+        }
+        while (echoed < ROUNDS) {
+            const SafeComSpdu* rx;
+            const uint32_t count = Shm_Receive(&echo, &rx);
+
+            Shm_SendSpduBatch(&echo, rx, count);
+            echoed += count;
+            if (count == 0U) {
+                idle(shared_cpu);
+            }
+        }
+        _exit(0);
+    }
+
+    const double start = now_ns();
+    for (uint32_t i = 0; (pid > 0) && (i < ROUNDS); i++) {
+        const SafeComSpdu* rx;
+
+        Shm_SendSpdu(&client_shm, 0, SPDU_LEN, frame);
+        while (Shm_Receive(&client_shm, &rx) == 0U) {
+            idle(shared_cpu);
+        }
+    }
+    const double ns = (now_ns() - start) / ROUNDS / 2.0;
+
+    waitpid(pid, NULL, 0);
+
+    return ns;
+}
+
+int main(void)
+{
+    const ShmConfig config = { .first_node = 0, .peer_count = 1 };
+    const bool shared_cpu = (sysconf(_SC_NPROCESSORS_ONLN) < 2);
+
+    set_loglevel_filter(LOG_ERROR);
+    memset(frame, 0x5A, sizeof(frame));
+    if ((Shm_Create(&client_shm, &config) != OK) || (Shm_Attach(&server_shm, &config, dup(client_shm.fd)) != OK)) {
+        printf("shared region could not be set up\n");
+        return 1;
+    }
+
+    printf("frames of %u bytes\n", SPDU_LEN);
+    printf("%24s %12s\n", "mode", "ns/handoff");
+    const double shm = run_handoff();
+    printf("%24s %12.1f\n", "shm, one thread", shm);
+    const double udp = run_udp_handoff();
+    printf("%24s %12.1f\n", "udp loopback, one thread", udp);
+    Shm_Close(&server_shm);
+    const double ping = run_ping_pong(shared_cpu);
+    printf("%24s %12.1f%s\n", "shm, two processes", ping, shared_cpu ? " (one CPU, yielding)" : "");
+    printf("udp/shm %.0fx\n", udp / shm);
+
+    Shm_Close(&client_shm);
+
+    return 0;
+}
@@ -0,0 +1,177 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+
+#include "udp.h"
+#ifdef RASTAS_IO_URING
+#include "uring.h"
+#endif
+#include "log.h"
+
+#define DATAGRAMS   (UDP_BATCH * 20000U)
+#define SPDU_LEN    (PDU_HEADER_LENGTH + 32U + SAFETY_CODE_LENGTH) /* Data PDU with a small payload */
+#define ROUTES      4U
+
+static UdpTransport sender;
+static UdpTransport receiver;
+static struct sockaddr_in sender_peers[1];
+static struct sockaddr_in receiver_peers[1];
+static UdpRoute sender_routes[ROUTES];
+static UdpRoute receiver_routes[ROUTES];
+static uint8_t frames[UDP_BATCH][SPDU_LEN];
+
+static double now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static StdRet_t open_pair(const bool offload)
+{
+    struct sockaddr_in local = { .sin_family = AF_INET, .sin_port = 0 };
+    local.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    const UdpConfig sender_config = { .local = local, .peers = sender_peers, .peer_count = 1, .routes = sender_routes, .route_count = ROUTES, .offload = offload };
+    const UdpConfig receiver_config = { .local = local, .peers = receiver_peers, .peer_count = 1, .routes = receiver_routes, .route_count = ROUTES, .offload = offload };
+
+    memset(sender_peers, 0, sizeof(sender_peers));
+    memset(receiver_peers, 0, sizeof(receiver_peers));
+
+    if ((Udp_Init(&sender, &sender_config) != OK) || (Udp_Init(&receiver, &receiver_config) != OK) ||
+        (Udp_AddPeer(&sender, 0, &receiver.local) != OK) || (Udp_AddPeer(&receiver, 0, &sender.local) != OK)) {
+        return NOT_OK;
+    }
+
+    return OK;
+}
+
+/* One datagram per sendto and recvfrom, what a transport without batching does */
+static double run_single(uint64_t *received)
+{
+    uint8_t buffer[MAX_BUFF_SIZE];
+    const double start = now_ns();
+
+    *received = 0;
+    for (uint32_t i = 0; i < DATAGRAMS; i++) {
+        if (sendto(sender.fd, frames[i % UDP_BATCH], SPDU_LEN, 0, (const struct sockaddr*)&receiver.local, sizeof(receiver.local)) == SPDU_LEN) {
+            *received += (recvfrom(receiver.fd, buffer, sizeof(buffer), MSG_DONTWAIT, NULL, NULL) > 0) ? 1U : 0U;
+        }
+    }
+
+    return (double)*received / ((now_ns() - start) / 1e9);
+}
+
+/* UDP_BATCH datagrams per sendmmsg and recvmmsg, received in place; with offload one GSO burst per batch */
+static double run_batched(uint64_t *received)
+{
+    SafeComSpdu spdus[UDP_BATCH];
+    const double start = now_ns();
+
+    for (uint32_t i = 0; i < UDP_BATCH; i++) {
+        spdus[i] = (SafeComSpdu){ .nodeId = 0, .spduLen = SPDU_LEN, .pSpduData = frames[i] };
+    }
+
+    *received = 0;
+    for (uint32_t i = 0; i < DATAGRAMS; i += UDP_BATCH) {
+        const SafeComSpdu* rx;
+
+        Udp_SendSpduBatch(&sender, spdus, UDP_BATCH);
+        *received += Udp_Receive(&receiver, &rx);
+    }
+
+    return (double)*received / ((now_ns() - start) / 1e9);
+}
+
+#ifdef RASTAS_IO_URING
+static UringTransport uring;
+static struct sockaddr_in uring_peers[1];
+static UdpRoute uring_routes[ROUTES];
+
+/* The same batches, received by multishot recvmsg into the registered buffers */
+static double run_uring(uint64_t *received, uint64_t *syscalls)
+{
+    struct sockaddr_in local = { .sin_family = AF_INET, .sin_port = 0 };
+    local.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    const UdpConfig config = { .local = local, .peers = uring_peers, .peer_count = 1, .routes = uring_routes, .route_count = ROUTES };
+    SafeComSpdu spdus[UDP_BATCH];
+
+    *received = 0;
+    if ((Uring_Init(&uring, &config) != OK) || (Udp_AddPeer(&uring.udp, 0, &sender.local) != OK)) {
+        return 0.0;
+    }
+    sender_peers[0] = uring.udp.local;  /* The sender now sends to the ring */
+    for (uint32_t i = 0; i < UDP_BATCH; i++) {
+        spdus[i] = (SafeComSpdu){ .nodeId = 0, .spduLen = SPDU_LEN, .pSpduData = frames[i] };
+    }
+
+    const uint64_t sent_syscalls = sender.stats.tx_syscalls;
+    const double start = now_ns();
+    for (uint32_t i = 0; i < DATAGRAMS; i += UDP_BATCH) {
+        const SafeComSpdu* rx;
+
+        Udp_SendSpduBatch(&sender, spdus, UDP_BATCH);
+        *received += Uring_Receive(&uring, &rx);
+    }
+    const double rate = (double)*received / ((now_ns() - start) / 1e9);
+
+    *syscalls = sender.stats.tx_syscalls - sent_syscalls + uring.udp.stats.rx_syscalls;
+    Uring_Close(&uring);
+
+    return rate;
+}
+#endif
+
+int main(void)
+{
+    uint64_t received = 0;
+
+    set_loglevel_filter(LOG_ERROR);
+    for (uint32_t i = 0; i < UDP_BATCH; i++) {
+        memset(frames[i], (int)i, SPDU_LEN);
+    }
+    if (open_pair(false) != OK) {
+        printf("loopback sockets could not be opened\n");
+        return 1;
+    }
+
+    printf("%u datagrams of %u bytes over loopback\n", DATAGRAMS, SPDU_LEN);
+    printf("%10s %14s %10s %14s\n", "mode", "SPDU/s", "received", "syscalls/SPDU");
+
+    const double single = run_single(&received);
+    printf("%10s %14.0f %10lu %14.2f\n", "single", single, (unsigned long)received, 2.0);
+
+    const double batched = run_batched(&received);
+    const double syscalls = (double)(sender.stats.tx_syscalls + receiver.stats.rx_syscalls) / (double)received;
+    printf("%10s %14.0f %10lu %14.3f\n", "mmsg", batched, (unsigned long)received, syscalls);
+    printf("speedup %.2fx, dropped %lu\n", batched / single, (unsigned long)sender.stats.tx_dropped);
+
+#ifdef RASTAS_IO_URING
+    uint64_t uring_syscalls = 0;
+    const double ringed = run_uring(&received, &uring_syscalls);
+    if (received > 0U) {
+        printf("%10s %14.0f %10lu %14.3f\n", "io_uring", ringed, (unsigned long)received, (double)uring_syscalls / (double)received);
+        printf("speedup %.2fx over single\n", ringed / single);
+    } else {
+        printf("io_uring not available\n");
+    }
+#endif
+
+    Udp_Close(&sender);
+    Udp_Close(&receiver);
+    if (open_pair(true) == OK) {
+        const double offloaded = run_batched(&received);
+        const double offload_syscalls = (double)(sender.stats.tx_syscalls + receiver.stats.rx_syscalls) / (double)received;
+        printf("%10s %14.0f %10lu %14.3f\n", sender.gso && receiver.gro ? "gso/gro" : "no gso/gro", offloaded, (unsigned long)received, offload_syscalls);
+        printf("speedup %.2fx over single, %lu coalesced on receive\n", offloaded / single, (unsigned long)receiver.stats.rx_coalesced);
+    }
+
+    Udp_Close(&sender);
+    Udp_Close(&receiver);
+
+    return 0;
+}
@@ -0,0 +1,57 @@
+#ifndef DEMUX_H
+#define DEMUX_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "types.h"
+
+#define DEMUX_NONE  0xFFFFFFFFU /* No connection for the key */
+
+/* What identifies the connection a received SPDU belongs to */
+typedef struct {
+    NodeId_t nodeId;        /* Node the transport received the SPDU from */
+    uint32_t sender_id;     /* RaSTA id of the peer, the sender of the SPDU */
+    uint32_t receiver_id;   /* Own RaSTA id, the receiver of the SPDU */
+} DemuxKey;
+
+typedef struct {
+    DemuxKey key;
+    uint32_t connection;    /* Index of the connection, DEMUX_NONE for a free entry */
+} DemuxEntry;
+
+/* Open-addressing hash table from DemuxKey to connection index, filled once at init.
+   The entries are owned by the caller; twice as many as connections keeps the probes short. */
+typedef struct {
+    DemuxEntry *entries;
+    uint32_t mask;          /* Number of entries - 1 */
+    uint32_t unknown;       /* SPDUs rejected because no connection matched */
+} Demux;
+
+/**
+ * @brief Start an empty table.
+ *
+ * @param[out]  demux   Table to initialise.
+ * @param[in]   entries Storage of the table.
+ * @param[in]   count   Number of entries, a power of two.
+ *
+ * @retval - `OK`       The table is empty.
+ * @retval - `NOT_OK`   count is not a power of two.
+ */
+StdRet_t demux_init(Demux *demux, DemuxEntry *entries, const uint32_t count);
+
+/**
+ * @brief Add the key of a connection.
+ *
+ * @retval - `OK`       Added.
+ * @retval - `NOT_OK`   The key is taken by another connection, or the table is full.
+ */
+StdRet_t demux_add(Demux *demux, const DemuxKey *key, const uint32_t connection);
+
+/**
+ * @brief Find the connection of a key.
+ *
+ * @retval Index of the connection, DEMUX_NONE if there is none.
+ */
+uint32_t demux_find(const Demux *demux, const DemuxKey *key);
+
+#endif /* DEMUX_H */
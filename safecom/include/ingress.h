@@ -0,0 +1,68 @@
+#ifndef INGRESS_H
+#define INGRESS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "types.h"
+#include "sm.h"
+
+#define INGRESS_SIZE        1024U   /* Received SPDUs the queue holds, a power of two */
+#define INGRESS_CACHE_LINE  64U
+
+/* One received SPDU; sequence tells producers and the consumer whose turn the cell is */
+typedef struct {
+    uint32_t sequence;
+    NodeId_t nodeId;
+    SpduLen_t spduLen;
+    uint8_t data[MAX_BUFF_SIZE];
+} IngressCell;
+
+/* Bounded lock-free queue of received SPDUs, filled by any number of threads and drained by one */
+typedef struct {
+    uint32_t enqueue_pos;   /* Claimed by producers with a compare-and-swap */
+    uint8_t pad_enqueue[INGRESS_CACHE_LINE - sizeof(uint32_t)];
+    uint32_t dequeue_pos;   /* Only written by the consumer */
+    uint8_t pad_dequeue[INGRESS_CACHE_LINE - sizeof(uint32_t)];
+    uint32_t high_water;    /* Most SPDUs ever waiting at once */
+    uint32_t overflows;     /* SPDUs rejected because the queue was full */
+    uint8_t pad_stats[INGRESS_CACHE_LINE - 2U * sizeof(uint32_t)];
+    IngressCell cells[INGRESS_SIZE];
+} Ingress;
+
+/**
+ * @brief Empty the queue and reset its counters.
+ */
+void ingress_init(Ingress *queue);
+
+/**
+ * @brief Copy a received SPDU into the queue. Safe to call from several threads at once;
+ * never blocks.
+ *
+ * @retval - `true`   If the SPDU is queued.
+ * @retval - `false`  If the SPDU is longer than MAX_BUFF_SIZE or the queue is full, counted as overflow.
+ */
+bool ingress_push(Ingress *queue, const NodeId_t nodeId, const SpduLen_t spduLen, const uint8_t *pSpduData);
+
+/**
+ * @brief Get the SPDUs at the head of the queue without removing them. Consumer only.
+ *
+ * The SPDUs stay in place until ingress_release, so they can be handled without a copy.
+ *
+ * @param[out]  spdus   Descriptors of the queued SPDUs, pointing into the queue.
+ * @param[in]   max     Most SPDUs to return.
+ *
+ * @retval Number of SPDUs returned.
+ */
+uint32_t ingress_peek(Ingress *queue, SafeComSpdu *spdus, const uint32_t max);
+
+/**
+ * @brief Hand the first count SPDUs returned by ingress_peek back to the producers. Consumer only.
+ */
+void ingress_release(Ingress *queue, const uint32_t count);
+
+/**
+ * @brief Get the high-water mark and the overflow counter.
+ */
+void ingress_stats(const Ingress *queue, uint32_t *high_water, uint32_t *overflows);
+
+#endif /* INGRESS_H */
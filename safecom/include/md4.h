@@ -27,6 +27,8 @@
 #define MD4_H
 
 #define	MD4_DIGEST_LENGTH		16
+/* Longest message md4_oneblock takes: one block minus the 0x80 byte and bit count */
+#define	MD4_ONEBLOCK_MAX_LENGTH		55
 
 /* Any 32-bit or wider unsigned integer data type will do */
 typedef unsigned int MD4_u32plus;
@@ -39,7 +41,10 @@ typedef struct {
 } MD4_CTX;
 
 extern void MD4_Init(MD4_CTX *ctx);
+extern void MD4_InitIV(MD4_CTX *ctx, const MD4_u32plus *iv);
 extern void MD4_Update(MD4_CTX *ctx, const void *data, unsigned long size);
 extern void MD4_Final(unsigned char *result, MD4_CTX *ctx);
+extern void md4_oneblock(unsigned char *result, const MD4_u32plus *iv,
+    const void *data, unsigned long size);
 
 #endif
\ No newline at end of file
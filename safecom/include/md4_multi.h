@@ -0,0 +1,52 @@
+#ifndef MD4_MULTI_H
+#define MD4_MULTI_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "md4.h"
+
+#define MD4_MULTI_MAX_LANES     16U /* Widest kernel (AVX-512) */
+
+/* Kernels that hash several independent messages in parallel lanes */
+typedef enum {
+    MD4_MULTI_SCALAR = 0U,  /* Portable fallback, one message after the other */
+    MD4_MULTI_SSE2,         /* 4 lanes */
+    MD4_MULTI_AVX2,         /* 8 lanes */
+    MD4_MULTI_AVX512        /* 16 lanes */
+} Md4MultiKernel;
+
+/**
+ * @brief Calculate the MD4 digests of independent messages together.
+ *
+ * Messages up to MD4_ONEBLOCK_MAX_LENGTH bytes are hashed in the lanes of the selected
+ * kernel, longer ones go through the scalar MD4.
+ *
+ * @param[in]   ivs     Initial values a, b, c, d of each message, NULL for the standard ones for all.
+ * @param[in]   msgs    The messages.
+ * @param[in]   lens    Length of each message.
+ * @param[out]  digests MD4 digest of each message.
+ * @param[in]   count   Number of messages.
+ */
+void md4_multi(const MD4_u32plus *const *ivs, const uint8_t *const *msgs, const size_t *lens,
+               uint8_t (*digests)[MD4_DIGEST_LENGTH], const size_t count);
+
+/**
+ * @brief Select the kernel used by md4_multi.
+ *
+ * The widest kernel the CPU supports is selected on first use; this overrides it,
+ * e.g. to compare kernels.
+ *
+ * @param[in]   kernel  Kernel to use.
+ *
+ * @retval - `true`   If the kernel is supported by this build and CPU and is now selected.
+ * @retval - `false`  If the kernel is not supported; the selection is unchanged.
+ */
+bool md4_multi_select(const Md4MultiKernel kernel);
+
+/**
+ * @brief Get the kernel used by md4_multi.
+ */
+Md4MultiKernel md4_multi_kernel(void);
+
+#endif /* MD4_MULTI_H */
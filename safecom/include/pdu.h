@@ -2,14 +2,17 @@
 #define PDU_H
 
 #include <stdint.h>
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include "md4.h"
+#include "safety_code.h"
 
-#define SAFETY_CODE_LENGTH          8U
+#define SAFETY_CODE_LENGTH          8U  /* Default safety code, the lower half of the MD4 digest */
 #define PDU_FIXED_FIELDS_LENGTH     36U
+#define PDU_HEADER_LENGTH           (PDU_FIXED_FIELDS_LENGTH - SAFETY_CODE_LENGTH)
 #define MAX_PDU_LENGTH              50U
 #define CONN_REQ_PAYLOAD_LENGTH     14U
 #define CONN_RESP_PAYLOAD_LENGTH    14U
@@ -29,6 +32,16 @@
 #define SHIFT_2_BYTES  16U
 #define SHIFT_3_BYTES  24U
 
+/* Byte offsets of the fixed header fields */
+#define PDU_OFFSET_MESSAGE_LENGTH       0U
+#define PDU_OFFSET_MESSAGE_TYPE         2U
+#define PDU_OFFSET_RECEIVER_ID          4U
+#define PDU_OFFSET_SENDER_ID            8U
+#define PDU_OFFSET_SEQUENCE_NUMBER      12U
+#define PDU_OFFSET_CONFIRMED_SEQ_NUMBER 16U
+#define PDU_OFFSET_TIMESTAMP            20U
+#define PDU_OFFSET_CONFIRMED_TIMESTAMP  24U
+
 /* State machine context structure */
 typedef struct SmType SmType;
 
@@ -56,8 +69,27 @@ typedef struct {
     uint32_t confirmed_timestamp;
     const uint8_t *payload;
     uint8_t *safety_code;
+    const uint8_t *frame_template;  /* Pre-encoded header and payload of the connection, NULL to encode every field */
 } PDU_S;
 
+/* Header and payload of the PDUs that only differ in sequence numbers and timestamps,
+   encoded once per connection so that building them only patches those fields */
+typedef struct {
+    uint8_t conn_req[PDU_HEADER_LENGTH + CONN_REQ_PAYLOAD_LENGTH];
+    uint8_t conn_resp[PDU_HEADER_LENGTH + CONN_RESP_PAYLOAD_LENGTH];
+    uint8_t retr_req[PDU_HEADER_LENGTH];
+    uint8_t hb[PDU_HEADER_LENGTH];
+} PduTemplates;
+
+/* Read-only view over a received PDU. Only length and type are decoded up front, every
+   other field is decoded on demand straight from the frame, which must outlive the view. */
+typedef struct {
+    const uint8_t *frame;
+    uint16_t message_length;
+    MessageType message_type;
+    uint8_t code_length;    /* Safety code length of the connection the PDU was received on */
+} PDU_View;
+
 typedef enum {
     USER_REQUEST = 0U,
     UNDEFINED_MSG_TYPE_RECV,
@@ -73,21 +105,186 @@ typedef enum {
 /**
  * @brief Serialize fields in to a buffer with data from PDU structure.
  *
+ * Only for PDUs with the default safety code of SAFETY_CODE_LENGTH bytes.
+ *
  * @param[in]   pdu         Protocol Data Unit (PDU_S) structure.
  * @param[out]  buffer      Buffer that will be serialized with PDU_S structure.
  * @param[in]   buffer_size The size of the buffer (PDU_FIXED_FIELDS_LENGTH + payload length). Payload length depends on message type.
  */
 void serialize_pdu(const PDU_S *pdu, uint8_t *buffer, const size_t buffer_size);
 
+/**
+ * @brief Encode the frame templates of a connection.
+ *
+ * @param[out]  templates   Frame templates of the connection.
+ * @param[in]   code        Safety code of the connection, its length is part of the encoded message length.
+ * @param[in]   receiver_id RaSTA id of the peer, sent as receiver.
+ * @param[in]   sender_id   Own RaSTA id, sent as sender.
+ */
+void pdu_templates_init(PduTemplates *templates, const SafetyCode *code, const uint32_t receiver_id, const uint32_t sender_id);
+
+/**
+ * @brief Encode a PDU straight into a transmit frame and append its safety code.
+ *
+ * The header and payload are written once into the frame and the safety code is
+ * computed over that same memory, so the PDU is neither serialized twice nor copied.
+ *
+ * @param[in]   pdu         Protocol Data Unit (PDU_S) structure. The safety_code field is ignored.
+ * @param[in]   code        Safety code of the connection the PDU is sent on.
+ * @param[out]  frame       Transmit frame that receives the encoded PDU.
+ * @param[in]   frame_size  The size of the frame.
+ *
+ * @retval The number of bytes written (message_length), or 0 if the PDU does not fit in the frame.
+ */
+size_t encode_pdu(const PDU_S *pdu, const SafetyCode *code, uint8_t *frame, const size_t frame_size);
+
+/**
+ * @brief Encode header and safety code of a PDU for a transmission in segments.
+ *
+ * The payload stays where pdu->payload points; the safety code is computed over header and
+ * payload without gathering them into one frame.
+ *
+ * @param[in]   pdu         Protocol Data Unit (PDU_S) structure. The safety_code field is ignored.
+ * @param[in]   code        Safety code of the connection the PDU is sent on.
+ * @param[out]  header      Receives the PDU_HEADER_LENGTH bytes of the header.
+ * @param[out]  safety_code Receives code->length bytes of safety code.
+ *
+ * @retval The message length of the PDU, or 0 if the PDU is malformed.
+ */
+size_t encode_pdu_segments(const PDU_S *pdu, const SafetyCode *code, uint8_t *header, uint8_t *safety_code);
+
+/**
+ * @brief Write header and payload of a PDU into a transmit frame without its safety code.
+ *
+ * Used when the safety codes of several frames are computed together with seal_pdus.
+ *
+ * @param[in]   pdu         Protocol Data Unit (PDU_S) structure. The safety_code field is ignored.
+ * @param[in]   code        Safety code of the connection the PDU is sent on.
+ * @param[out]  frame       Transmit frame that receives the PDU.
+ * @param[in]   frame_size  The size of the frame.
+ *
+ * @retval The number of bytes the PDU takes in the frame, safety code included, or 0 if it does not fit.
+ */
+size_t write_pdu(const PDU_S *pdu, const SafetyCode *code, uint8_t *frame, const size_t frame_size);
+
+/**
+ * @brief Append the safety codes of frames written by write_pdu.
+ *
+ * The frames are independent, so their MD4 digests are computed together in the lanes of md4_multi.
+ *
+ * @param[in]       codes   Safety code of the connection each frame is sent on.
+ * @param[in,out]   frames  The frames.
+ * @param[in]       lengths Length of each frame, safety code included.
+ * @param[in]       count   Number of frames.
+ */
+void seal_pdus(const SafetyCode *const *codes, uint8_t *const *frames, const uint16_t *lengths, const size_t count);
+
 /**
  * @brief Deserialize data in to the PDU structure from a buffer with serialized data.
  *
+ * Only for PDUs with the default safety code of SAFETY_CODE_LENGTH bytes.
+ *
  * @param[in]   buffer      Buffer that will be deserialized in to the PDU_S structure.
  * @param[in]   buffer_size The size of the buffer (PDU_FIXED_FIELDS_LENGTH + payload length). Payload length depends on message type. 
- * @param[out]  pdu         Protocol Data Unit (PDU_S) structure.
+ * @param[out]  pdu         Protocol Data Unit (PDU_S) structure, left untouched if the PDU is malformed.
  */
 void deserialize_pdu(const uint8_t *buffer, const size_t buffer_size, PDU_S *pdu);
 
+/**
+ * @brief Initialize a PDU view over a received buffer.
+ *
+ * The buffer must hold at least the header and safety code, the message type must be known
+ * and message_length must match that type and fit in the buffer. Nothing is copied.
+ *
+ * @param[out]  view        PDU view to initialize.
+ * @param[in]   buffer      Buffer with the received PDU.
+ * @param[in]   buffer_size The size of the buffer.
+ * @param[in]   code_length Safety code length of the connection the PDU was received on.
+ *
+ * @retval - `true`   If the buffer holds a well-formed PDU.
+ * @retval - `false`  If the PDU is malformed; the view must not be used.
+ */
+bool pdu_view_init(PDU_View *view, const uint8_t *buffer, const size_t buffer_size, const uint8_t code_length);
+
+/**
+ * @brief Initialize a PDU view over a received buffer and check its safety code.
+ *
+ * The header is decoded and the safety code calculated over the same frame right away,
+ * while it is still in cache.
+ *
+ * @param[out]  view        PDU view to initialize.
+ * @param[in]   buffer      Buffer with the received PDU.
+ * @param[in]   buffer_size The size of the buffer.
+ * @param[in]   code        Safety code of the connection the PDU was received on.
+ *
+ * @retval - `true`   If the buffer holds a well-formed PDU with a correct safety code.
+ * @retval - `false`  If the PDU is malformed or corrupted; the view must not be used.
+ */
+bool pdu_view_init_verified(PDU_View *view, const uint8_t *buffer, const size_t buffer_size, const SafetyCode *code);
+
+/**
+ * @brief Check the safety codes of received PDUs.
+ *
+ * The PDUs are independent, so their MD4 digests are computed together in the lanes of md4_multi.
+ *
+ * @param[in]   codes   Safety code of the connection each PDU was received on.
+ * @param[in]   views   Views over the PDUs, initialized with the code length of their connection.
+ * @param[out]  valid   Whether the safety code of each PDU is correct.
+ * @param[in]   count   Number of PDUs.
+ */
+void verify_pdus(const SafetyCode *const *codes, const PDU_View *views, bool *valid, const size_t count);
+
+static inline uint32_t pdu_load_uint32(const uint8_t *p)
+{
+    return ((uint32_t)p[0] << SHIFT_3_BYTES) | ((uint32_t)p[1] << SHIFT_2_BYTES) |
+           ((uint32_t)p[2] << SHIFT_1_BYTES) | (uint32_t)p[3];
+}
+
+static inline uint32_t pdu_view_receiver_id(const PDU_View *view)
+{
+    return pdu_load_uint32(&view->frame[PDU_OFFSET_RECEIVER_ID]);
+}
+
+static inline uint32_t pdu_view_sender_id(const PDU_View *view)
+{
+    return pdu_load_uint32(&view->frame[PDU_OFFSET_SENDER_ID]);
+}
+
+static inline uint32_t pdu_view_sequence_number(const PDU_View *view)
+{
+    return pdu_load_uint32(&view->frame[PDU_OFFSET_SEQUENCE_NUMBER]);
+}
+
+static inline uint32_t pdu_view_confirmed_sequence_number(const PDU_View *view)
+{
+    return pdu_load_uint32(&view->frame[PDU_OFFSET_CONFIRMED_SEQ_NUMBER]);
+}
+
+static inline uint32_t pdu_view_timestamp(const PDU_View *view)
+{
+    return pdu_load_uint32(&view->frame[PDU_OFFSET_TIMESTAMP]);
+}
+
+static inline uint32_t pdu_view_confirmed_timestamp(const PDU_View *view)
+{
+    return pdu_load_uint32(&view->frame[PDU_OFFSET_CONFIRMED_TIMESTAMP]);
+}
+
+static inline const uint8_t *pdu_view_payload(const PDU_View *view)
+{
+    return &view->frame[PDU_HEADER_LENGTH];
+}
+
+static inline uint16_t pdu_view_payload_length(const PDU_View *view)
+{
+    return (uint16_t)(view->message_length - PDU_HEADER_LENGTH - view->code_length);
+}
+
+static inline const uint8_t *pdu_view_safety_code(const PDU_View *view)
+{
+    return &view->frame[view->message_length - view->code_length];
+}
+
 /**
  * @brief Create PDU for Connection Request.
  * 
@@ -148,4 +345,16 @@ void HB(SmType *self, PDU_S *pdu);
  */
 void Data(SmType *self, PDU_S *pdu, const uint8_t msgLen, const uint8_t *pMsgData);
 
+/**
+ * @brief Create PDU for Retransmitted Data.
+ *
+ * The payload of an unconfirmed Data PDU, sent again under a new sequence number.
+ *
+ * @param[in]   self        State machine context structure.
+ * @param[in]   pdu         Pointer to the pdu that need to be build.
+ * @param[in]   msgLen      The length of the data that will be retransmitted.
+ * @param[in]   pMsgData    Pointer to the data that will be retransmitted.
+ */
+void RetrData(SmType *self, PDU_S *pdu, const uint8_t msgLen, const uint8_t *pMsgData);
+
 #endif // PDU_H
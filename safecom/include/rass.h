@@ -3,11 +3,18 @@
 
 #include "safecom.h"
 
+/* Front-end of the single default Rass instance; further instances, each with the
+   callouts of the caller, are driven with SafeCom_Init and the other SafeCom_* functions */
+
 StdRet_t Rass_Init_VTable(const SafeComType* const pConfig);
 StdRet_t Rass_Init(SafeComConfig* const pConfig);
 StdRet_t Rass_Main(void);
 StdRet_t Rass_ReceiveSpdu(const NodeId_t nodeId, const SpduLen_t spduLen, const uint8_t* const pSpduData);
+StdRet_t Rass_ReceiveSpduBatch(const SafeComSpdu* const pSpdus, const uint32_t count);
 StdRet_t Rass_SendData(const MsgId_t msgId, const MsgLen_t msgLen, const uint8_t* const pMsgData);
+StdRet_t Rass_SendDataBatch(const SafeComMsg* const pMsgs, const uint32_t count);
+StdRet_t Rass_PostSpdu(const NodeId_t nodeId, const SpduLen_t spduLen, const uint8_t* const pSpduData);
+StdRet_t Rass_ReleaseSpdu(const NodeId_t nodeId, const uint8_t* const pSpduData);
 StdRet_t Rass_OpenConnection(const MsgId_t msgId);
 StdRet_t Rass_CloseConnection(const MsgId_t msgId);
 StdRet_t Rass_ConnectionStateRequest(const MsgId_t msgId);
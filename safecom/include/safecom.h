@@ -8,6 +8,8 @@
 typedef struct {
     SafeComVtable vtable;
     SafeComConfig config;
+    TimerWheel timers; /* Next Th or Ti deadline of every monitored connection, set up by SafeCom_Init on config.Tlocal */
+    SmShared shared; /* Callouts, clock and timeouts of all connections, set up by SafeCom_Init */
 } SafeComType;
 
 #if 0
@@ -18,10 +20,21 @@ typedef struct {
 #endif
 typedef SafeComType SafeCom;
 
+/* Application message descriptor used by the batch interfaces */
+typedef struct {
+    MsgId_t msgId;
+    MsgLen_t msgLen;
+    const uint8_t* pMsgData;
+} SafeComMsg;
+
 StdRet_t SafeCom_Init(SafeCom* const self, const SafeComType* const pConfig);
-StdRet_t SafeCom_Main(const SafeCom* const self);
+StdRet_t SafeCom_Main(SafeCom* const self);
 StdRet_t SafeCom_ReceiveSpdu(const SafeCom* const self, const NodeId_t nodeId, const SpduLen_t spduLen, const uint8_t* const pSpduData);
+StdRet_t SafeCom_ReceiveSpduBatch(const SafeCom* const self, const SafeComSpdu* const pSpdus, const uint32_t count);
 StdRet_t SafeCom_SendData(const SafeCom* const self, const MsgId_t msgId, const MsgLen_t msgLen, const uint8_t* const pMsgData);
+StdRet_t SafeCom_SendDataBatch(const SafeCom* const self, const SafeComMsg* const pMsgs, const uint32_t count);
+StdRet_t SafeCom_PostSpdu(const SafeCom* const self, const NodeId_t nodeId, const SpduLen_t spduLen, const uint8_t* const pSpduData);
+StdRet_t SafeCom_ReleaseSpdu(const SafeCom* const self, const NodeId_t nodeId, const uint8_t* const pSpduData);
 StdRet_t SafeCom_OpenConnection(const SafeCom* const self, const MsgId_t msgId);
 StdRet_t SafeCom_CloseConnection(const SafeCom* const self, const MsgId_t msgId);
 StdRet_t SafeCom_ConnectionStateRequest(const SafeCom* const self, const MsgId_t msgId);
@@ -3,14 +3,31 @@
 
 #include "types.h"
 #include "sm.h"
+#include "ingress.h"
+#include "demux.h"
 
 #define INSTNAME_LENGTH 10U
+#define SAFECOM_MAIN_BUDGET 256U /* Default for the received SPDUs, and the timer events, SafeCom_Main handles per call */
+
+/* Where the SPDUs of a connection come from and the RaSTA ids it uses */
+typedef struct {
+    NodeId_t nodeId;        /* Node the transport receives the connection's SPDUs from */
+    uint32_t sender_id;     /* Own RaSTA id */
+    uint32_t receiver_id;   /* RaSTA id of the peer */
+} SafeComPeer;
 
 typedef struct {
     uint8_t instname[INSTNAME_LENGTH];
     SmRole role;
     MsgId_t max_connections;
-    SmType* sms;
+    NodeId_t first_node; /* Node and message id of the first connection, the others follow; 0 unless the ids are split over several instances */
+    SmType* sms; /* max_connections entries, NULL if there are none */
+    uint32_t main_budget; /* Work per SafeCom_Main call, 0 for SAFECOM_MAIN_BUDGET */
+    Ingress* ingress; /* Optional queue of SPDUs posted by other threads and handled by SafeCom_Main, NULL if unused */
+    const SafeComPeer* peers; /* One per connection, NULL for SENDER_ID and RECEIVER_ID on all */
+    Demux* demux; /* Optional, routes received SPDUs by node and RaSTA ids from peers; NULL to address connections by node id */
+    const SafetyCodeConfig* safety_codes; /* One per connection, NULL for the lower-half MD4 with standard initial values on all */
+    GetTimestamp Tlocal; /* Clock of the connections and the timer wheel, NULL for GetCurrentTimestamp */
 } SafeComConfig;
 
 #endif /* SAFE_COM_CONFIG_H */
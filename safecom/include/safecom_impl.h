@@ -4,9 +4,13 @@
 #include "safecom.h"
 
 StdRet_t SafeCom_Init_Impl(SafeCom* const self, const SafeComType* const pConfig);
-StdRet_t SafeCom_Main_Impl(const SafeCom* const self);
+StdRet_t SafeCom_Main_Impl(SafeCom* const self);
 StdRet_t SafeCom_ReceiveSpdu_Impl(const SafeCom* const self, const NodeId_t nodeId, const SpduLen_t spduLen, const uint8_t* const pSpduData);
+StdRet_t SafeCom_ReceiveSpduBatch_Impl(const SafeCom* const self, const SafeComSpdu* const pSpdus, const uint32_t count);
 StdRet_t SafeCom_SendData_Impl(const SafeCom* const self, const MsgId_t msgId, const MsgLen_t msgLen, const uint8_t* const pMsgData);
+StdRet_t SafeCom_SendDataBatch_Impl(const SafeCom* const self, const SafeComMsg* const pMsgs, const uint32_t count);
+StdRet_t SafeCom_PostSpdu_Impl(const SafeCom* const self, const NodeId_t nodeId, const SpduLen_t spduLen, const uint8_t* const pSpduData);
+StdRet_t SafeCom_ReleaseSpdu_Impl(const SafeCom* const self, const NodeId_t nodeId, const uint8_t* const pSpduData);
 StdRet_t SafeCom_OpenConnection_Impl(const SafeCom* const self, const MsgId_t msgId);
 StdRet_t SafeCom_CloseConnection_Impl(const SafeCom* const self, const MsgId_t msgId);
 StdRet_t SafeCom_ConnectionStateRequest_Impl(const SafeCom* const self, const MsgId_t msgId);
@@ -3,12 +3,35 @@
 
 #include "types.h"
 
+#define SAFECOM_MAX_BATCH 64U /* SPDUs handled in one pass by the batch interfaces */
+
+/* SPDU descriptor used by the batch interfaces */
+typedef struct {
+    NodeId_t nodeId;
+    SpduLen_t spduLen;
+    const uint8_t* pSpduData;
+} SafeComSpdu;
+
+/* One contiguous part of an SPDU handed to SendSpduV */
+typedef struct {
+    const uint8_t* pData;
+    SpduLen_t len;
+} SafeComSegment;
+
+#define SAFECOM_SPDU_SEGMENTS 3U /* Header, payload and safety code */
+
 typedef StdRet_t (*SendSpdu_t)(const NodeId_t nodeId, const SpduLen_t spduLen, const uint8_t* const pSpduData);
 typedef StdRet_t (*ReceiveMsg_t)(const MsgId_t msgId, const MsgLen_t msgLen, const uint8_t* const pMsgData);
+typedef StdRet_t (*SendSpduBatch_t)(const SafeComSpdu* const pSpdus, const uint32_t count);
+/* The segments, and the application payload among them, are only valid during the call */
+typedef StdRet_t (*SendSpduV_t)(const NodeId_t nodeId, const SafeComSegment* const pSegments, const uint32_t count);
 
 typedef struct {
     SendSpdu_t SendSpdu;
     ReceiveMsg_t ReceiveMsg;
+    SendSpduBatch_t SendSpduBatch; /* Optional, batches fall back to SendSpdu per frame when NULL */
+    SendSpduV_t SendSpduV; /* Optional, single SPDUs go out in segments without copying the payload; SendSpdu is used when NULL */
+    SendSpdu_t SendSpduAsync; /* Optional, takes precedence over SendSpdu: on OK the transport keeps the frame until it hands it back with SafeCom_ReleaseSpdu */
 } SafeComVtable;
 
 #endif /* SAFE_COM_VTABLE_H */
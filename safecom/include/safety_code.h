@@ -0,0 +1,95 @@
+#ifndef SAFETY_CODE_H
+#define SAFETY_CODE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "md4.h"
+
+#define SAFETY_CODE_MAX_LENGTH  MD4_DIGEST_LENGTH
+#define SAFETY_CODE_KEY_WORDS   4U
+
+/* Safety code of a connection */
+typedef enum {
+    SAFETY_CODE_LOWER_MD4 = 0U, /* Lower half of the MD4 digest, 8 bytes (default) */
+    SAFETY_CODE_NONE,           /* No safety code */
+    SAFETY_CODE_FULL_MD4        /* Full MD4 digest, 16 bytes */
+} SafetyCodeType;
+
+/* Configured safety code of a connection. The key holds the MD4 initial values a, b, c, d;
+   an all-zero key selects the standard MD4 initial values. */
+typedef struct {
+    SafetyCodeType type;
+    uint32_t key[SAFETY_CODE_KEY_WORDS];
+} SafetyCodeConfig;
+
+/* Safety code of a connection as used per PDU, derived once from its configuration */
+typedef struct {
+    MD4_u32plus iv[SAFETY_CODE_KEY_WORDS];  /* MD4 state every safety code starts from */
+    uint8_t length;                         /* Bytes of the digest appended to each PDU */
+} SafetyCode;
+
+/**
+ * @brief Derive the per-PDU safety code state from a configuration.
+ *
+ * @param[out]  code    Safety code state.
+ * @param[in]   config  Configuration, NULL for the lower-half MD4 with the standard initial values.
+ */
+void safety_code_init(SafetyCode *code, const SafetyCodeConfig *config);
+
+/**
+ * @brief Calculate the safety code over a PDU.
+ *
+ * Inputs up to MD4_ONEBLOCK_MAX_LENGTH bytes take a single MD4 compression from the cached initial values.
+ *
+ * @param[in]   code    Safety code state of the connection.
+ * @param[in]   data    The PDU without its safety code.
+ * @param[in]   length  Length of the PDU without its safety code.
+ * @param[out]  out     Receives code->length bytes.
+ */
+void safety_code_calculate(const SafetyCode *code, const uint8_t *data, const size_t length, uint8_t *out);
+
+/**
+ * @brief Calculate the safety code over a PDU held in two parts, e.g. header and payload.
+ *
+ * Short PDUs are gathered into one block on the stack, longer ones are hashed part by part
+ * so a large payload is never copied.
+ *
+ * @param[in]   code        Safety code state of the connection.
+ * @param[in]   head        First part of the PDU.
+ * @param[in]   head_length Length of the first part.
+ * @param[in]   tail        Second part of the PDU, may be NULL if tail_length is 0.
+ * @param[in]   tail_length Length of the second part.
+ * @param[out]  out         Receives code->length bytes.
+ */
+void safety_code_calculate_split(const SafetyCode *code, const uint8_t *head, const size_t head_length,
+                                 const uint8_t *tail, const size_t tail_length, uint8_t *out);
+
+/**
+ * @brief Compare a received safety code with the calculated one in constant time.
+ *
+ * The time taken does not depend on where the codes differ.
+ *
+ * @param[in]   received    Safety code received with the PDU.
+ * @param[in]   calculated  Safety code calculated over the PDU.
+ * @param[in]   length      Length of the safety code.
+ *
+ * @retval - `true`   If the codes are equal.
+ * @retval - `false`  If the codes differ.
+ */
+bool safety_code_equal(const uint8_t *received, const uint8_t *calculated, const size_t length);
+
+/**
+ * @brief Check the safety code of a received PDU.
+ *
+ * @param[in]   code        Safety code state of the connection.
+ * @param[in]   data        The PDU without its safety code.
+ * @param[in]   length      Length of the PDU without its safety code.
+ * @param[in]   received    Safety code received with the PDU, code->length bytes.
+ *
+ * @retval - `true`   If the received safety code matches the PDU.
+ * @retval - `false`  If it does not; the PDU must be dropped.
+ */
+bool safety_code_verify(const SafetyCode *code, const uint8_t *data, const size_t length, const uint8_t *received);
+
+#endif /* SAFETY_CODE_H */
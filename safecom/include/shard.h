@@ -0,0 +1,113 @@
+#ifndef SHARD_H
+#define SHARD_H
+
+#include <pthread.h>
+#include "safecom.h"
+
+#define SHARD_MAX_WORKERS   16U     /* Worker threads, each owning a SafeCom instance */
+#define SHARD_MAX_PRODUCERS 4U      /* Network or application threads posting to the workers */
+#define SHARD_RING_SIZE     256U    /* Entries per ring, a power of two */
+#define SHARD_CACHE_LINE    64U
+
+/* What a ring entry asks the owning worker to do */
+typedef enum {
+    SHARD_RECEIVE_SPDU = 0U,    /* SafeCom_ReceiveSpdu */
+    SHARD_SEND_DATA,            /* SafeCom_SendData */
+    SHARD_OPEN_CONN,            /* SafeCom_OpenConnection */
+    SHARD_CLOSE_CONN            /* SafeCom_CloseConnection */
+} ShardRequest;
+
+typedef struct {
+    uint32_t request;   /* ShardRequest */
+    NodeId_t nodeId;    /* Node id of an SPDU, message id otherwise */
+    uint32_t len;
+    uint8_t data[MAX_BUFF_SIZE];
+} ShardEntry;
+
+/* Lock-free ring between one producer thread and one worker; head and tail live on their own cache lines */
+typedef struct {
+    uint32_t head;      /* Next entry to write, only written by the producer */
+    uint32_t full;      /* Entries rejected because the ring was full */
+    uint8_t pad_head[SHARD_CACHE_LINE - 2U * sizeof(uint32_t)];
+    uint32_t tail;      /* Next entry to read, only written by the worker */
+    uint8_t pad_tail[SHARD_CACHE_LINE - sizeof(uint32_t)];
+    ShardEntry entries[SHARD_RING_SIZE];
+} ShardRing;
+
+struct ShardEngine;
+
+/* One worker: a SafeCom instance for a contiguous slice of the node ids, fed by one ring per producer */
+typedef struct {
+    SafeCom instance;
+    ShardRing rings[SHARD_MAX_PRODUCERS];
+    uint64_t processed; /* Ring entries handled, read with __atomic_load_n from other threads */
+    pthread_t thread;
+    struct ShardEngine *engine;
+} Shard;
+
+typedef struct ShardEngine {
+    Shard shards[SHARD_MAX_WORKERS];
+    uint32_t workers;
+    uint32_t producers;
+    NodeId_t first_node;
+    MsgId_t connections;
+    MsgId_t per_shard;  /* Node ids per worker, the last one may have fewer */
+    uint32_t running;
+} ShardEngine;
+
+/**
+ * @brief Split the connections of a configuration over worker SafeCom instances.
+ *
+ * Worker k owns the node ids first_node + k * per_shard onwards, with the matching part of
+ * config.sms and config.safety_codes. The callouts are called from the worker threads,
+ * concurrently for different workers. Received SPDUs are posted with Shard_ReceiveSpdu, so
+ * config.ingress must be NULL.
+ *
+ * @param[out]  self        Engine, owned by the caller.
+ * @param[in]   pConfig     Callouts and configuration of all connections.
+ * @param[in]   workers     Number of workers, 1 to SHARD_MAX_WORKERS.
+ * @param[in]   producers   Number of threads posting requests, 1 to SHARD_MAX_PRODUCERS.
+ *
+ * @retval - `OK`       The instances are initialised.
+ * @retval - `NOT_OK`   Invalid number of workers or producers, or an ingress queue configured.
+ */
+StdRet_t Shard_Init(ShardEngine* const self, const SafeComType* const pConfig, const uint32_t workers, const uint32_t producers);
+
+/**
+ * @brief Start one thread per worker, each running Shard_Poll until Shard_Stop.
+ */
+StdRet_t Shard_Start(ShardEngine* const self);
+
+/**
+ * @brief Stop and join the worker threads, after they have handled what was posted.
+ */
+StdRet_t Shard_Stop(ShardEngine* const self);
+
+/**
+ * @brief Handle the posted requests of one worker, in the calling thread.
+ *
+ * Used by the worker threads; without them, a single thread can drive every worker.
+ *
+ * @retval Number of requests handled.
+ */
+uint32_t Shard_Poll(ShardEngine* const self, const uint32_t worker);
+
+/**
+ * @brief Post a received SPDU to the worker owning the node; the SPDU is copied.
+ *
+ * Each producer index must only be used by one thread at a time.
+ *
+ * @retval - `OK`       Posted.
+ * @retval - `NOT_OK`   Unknown node, SPDU too long or ring full.
+ */
+StdRet_t Shard_ReceiveSpdu(ShardEngine* const self, const uint32_t producer, const NodeId_t nodeId, const SpduLen_t spduLen, const uint8_t* const pSpduData);
+StdRet_t Shard_SendData(ShardEngine* const self, const uint32_t producer, const MsgId_t msgId, const MsgLen_t msgLen, const uint8_t* const pMsgData);
+StdRet_t Shard_OpenConnection(ShardEngine* const self, const uint32_t producer, const MsgId_t msgId);
+StdRet_t Shard_CloseConnection(ShardEngine* const self, const uint32_t producer, const MsgId_t msgId);
+
+/**
+ * @brief Number of requests rejected because a ring of the worker was full.
+ */
+uint32_t Shard_Overflows(const ShardEngine* const self, const uint32_t worker);
+
+#endif /* SHARD_H */
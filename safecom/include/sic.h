@@ -3,11 +3,18 @@
 
 #include "safecom.h"
 
+/* Front-end of the single default Sic instance; further instances, each with the
+   callouts of the caller, are driven with SafeCom_Init and the other SafeCom_* functions */
+
 StdRet_t Sic_Init_VTable(SafeComType* const pConfig);
 StdRet_t Sic_Init(SafeComConfig* const pConfig);
 StdRet_t Sic_Main(void);
 StdRet_t Sic_ReceiveSpdu(const NodeId_t nodeId, const SpduLen_t spduLen, const uint8_t* const pSpduData);
+StdRet_t Sic_ReceiveSpduBatch(const SafeComSpdu* const pSpdus, const uint32_t count);
 StdRet_t Sic_SendData(const MsgId_t msgId, const MsgLen_t msgLen, const uint8_t* const pMsgData);
+StdRet_t Sic_SendDataBatch(const SafeComMsg* const pMsgs, const uint32_t count);
+StdRet_t Sic_PostSpdu(const NodeId_t nodeId, const SpduLen_t spduLen, const uint8_t* const pSpduData);
+StdRet_t Sic_ReleaseSpdu(const NodeId_t nodeId, const uint8_t* const pSpduData);
 StdRet_t Sic_OpenConnection(const MsgId_t msgId);
 StdRet_t Sic_CloseConnection(const MsgId_t msgId);
 StdRet_t Sic_ConnectionStateRequest(const MsgId_t msgId);
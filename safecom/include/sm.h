@@ -7,9 +7,14 @@
 #include "types.h"
 #include "safecom_vtable.h"
 #include "time_mon.h"
+#include "timer_wheel.h"
 
 #define TMAX    500U /* TODO: RTR - Define TMP_MAX */
-#define MAX_BUFF_SIZE   100U
+#define MAX_DATA_LENGTH 64U /* Largest application payload of a Data PDU */
+#define MAX_BUFF_SIZE   (PDU_HEADER_LENGTH + MAX_DATA_LENGTH + SAFETY_CODE_MAX_LENGTH)
+#define RETR_BUFFER_SIZE 16U /* Unconfirmed Data PDUs kept for retransmission, at most N_SEND_MAX */
+#define SM_TX_FRAMES    4U  /* Transmit frames per connection, the most a transport can hold at once */
+#define SM_CACHE_LINE   64U /* The hot part of a connection fits one line */
 
 /* Define states of the state machine */
 typedef enum {
@@ -46,28 +51,78 @@ typedef enum {
 /* State machine context structure */
 typedef struct SmType SmType;
 
-/* Type definition for the state handler function pointer */
-typedef void (*EventHandler)(SmType *self, const Event event, PDU_S *pdu);
+/* Configuration shared by the connections of an instance, kept once instead of in every connection */
+typedef struct {
+    SafeComVtable *vtable;
+    GetTimestamp Tlocal;        /* Local time (timestamp at the time of analysis) */
+    TimeoutsConfig timeouts;
+} SmShared;
 
-/* State machine context definition */
+/* Transmit arena collecting the frames of a batch, handed to the transport at once */
+typedef struct {
+    uint8_t arena[SAFECOM_MAX_BATCH * MAX_BUFF_SIZE];
+    size_t used;                            /* Bytes of the arena taken by frames */
+    SafeComSpdu spdus[SAFECOM_MAX_BATCH];   /* One descriptor per frame, pointing into the arena */
+    const SafetyCode *codes[SAFECOM_MAX_BATCH]; /* Safety code each frame is sealed with on flush */
+    uint32_t count;
+} SmTxBatch;
+
+/* Unconfirmed Data PDUs in the order they were sent, oldest first. Entries are trimmed as
+   the peer confirms them and sent again as RetrData when the peer asks for a retransmission. */
+typedef struct {
+    uint8_t frames[RETR_BUFFER_SIZE][MAX_BUFF_SIZE];   /* Header and payload as sent, without safety code */
+    uint16_t lengths[RETR_BUFFER_SIZE];
+    uint32_t head;      /* Index of the oldest entry */
+    uint32_t count;
+    uint32_t released;  /* Highest sequence number no longer kept, confirmed or dropped when full */
+} SmRetrBuffer;
+
+/* Transmit frame of a connection. It is busy from encoding until the transport hands it back,
+   which an asynchronous transport may do from another thread. */
+typedef struct {
+    uint8_t data[MAX_BUFF_SIZE];
+    uint8_t busy;   /* Accessed atomically */
+} SmTxFrame;
+
+/* State machine context definition. The fields every PDU, timer and statistics sweep touches come
+   first and fill one cache line, so walking many connections does not drag in their buffers. */
 struct SmType {
-    MsgId_t channel; /* The channel/connection/msg_id number */
     State state;    /* The state of the state machine */
-    SmRole role;    /* The state machine can act like a client or like a server */
     int32_t snr;    /* Receive sequence number (i.e. the expected sequence number of the next received protocol data unit) */
     int32_t snt;    /* Send sequence number (i.e. the sequence number of the protocol data unit to be sent next) */
     int32_t cst;    /* Sequence number to be confirmed (which is transmitted at the next protocol data unit to be sent) */
     int32_t csr;    /* Last received confirmed sequence number */
     int32_t tsr;    /* Timestamp of the last formally correct message received */
     int32_t ctsr;   /* Confirmed timestamp of the last received message relevant to time monitoring */
-    EventHandler handle_event;
-    SafeComVtable *vtable; 
+    uint32_t tx_time;       /* Tlocal when the last PDU was sent, Th counts from here */
+    uint32_t rx_time;       /* Tlocal when Ti was last updated, Ti counts from here */
     TimeMonitoring time;
-};
+    uint32_t rx_dropped;    /* Received frames dropped as malformed or with a wrong safety code */
+    uint32_t tx_dropped;    /* PDUs not sent because the transport held all transmit frames */
+
+    MsgId_t channel; /* The channel/connection/msg_id number */
+    SmRole role;    /* The state machine can act like a client or like a server */
+    uint32_t sender_id;     /* Own RaSTA id, set before Sm_Init; sent as sender. Received ids are only checked by a demux table */
+    uint32_t receiver_id;   /* RaSTA id of the peer, set before Sm_Init; sent as receiver */
+    const SmShared *shared; /* Callouts, clock and timeouts of the owner, set before Sm_Init */
+    TimerWheel *timers;     /* Wheel the next Th or Ti deadline is armed on, NULL if the owner checks the timers itself */
+    TimerNode timer;        /* Earlier of the Th and Ti deadlines while monitored */
+    SmTxBatch *tx_batch; /* When set, frames are collected here instead of being sent one by one */
+    uint32_t snt_seed;      /* State of the generator of the initial SNT */
+    const SafetyCodeConfig *safety_code_config; /* Set before Sm_Init, NULL for the default safety code */
+    SafetyCode safety_code; /* Derived from safety_code_config by Sm_Init */
+    PduTemplates templates; /* Frame templates, encoded by Sm_Init */
+    uint8_t disc_payload[DISC_REQ_PAYLOAD_LENGTH]; /* Payload of the DiscReq built last, referenced by its PDU */
+    SmRetrBuffer retr;      /* Sent Data PDUs the peer has not confirmed yet */
+    SmTxFrame tx_frames[SM_TX_FRAMES]; /* Frames single PDUs are encoded into for SendSpdu */
+} __attribute__((aligned(SM_CACHE_LINE)));
 
 /**
  * @brief Initializes the RastaS module.
  *
+ * The safety code state, including the keyed MD4 initial values, and the frame templates
+ * of the connection are derived here once.
+ *
  * @param[in]   self Pointer to my RastaS structure handle.
  * 
  * @retval - `OK`      If the initialization was done successfully.
@@ -76,7 +131,52 @@ struct SmType {
 StdRet_t Sm_Init(SmType *self);
 
 /**
- * @brief Initializes the RastaS module.
+ * @brief Sets up the configuration shared by the connections of an instance.
+ *
+ * The clock is GetCurrentTimestamp and the timeouts are the defaults; both may be changed
+ * before the connections are initialised.
+ *
+ * @param[out]  shared  Shared configuration to set up.
+ * @param[in]   vtable  Callouts of the instance.
+ */
+void Sm_SharedInit(SmShared *shared, SafeComVtable *vtable);
+
+/**
+ * @brief Starts an empty transmit batch.
+ *
+ * @param[out]  batch   Transmit batch to reset.
+ */
+void Sm_TxBatchInit(SmTxBatch *batch);
+
+/**
+ * @brief Hands all frames of a transmit batch to the transport and empties the batch.
+ *
+ * The safety codes of all frames are computed together first. Uses the SendSpduBatch callout when available, SendSpdu per frame otherwise.
+ *
+ * @param[in]   batch   Transmit batch to flush.
+ * @param[in]   vtable  Callouts of the SafeCom instance the frames belong to.
+ */
+void Sm_TxBatchFlush(SmTxBatch *batch, const SafeComVtable *vtable);
+
+/**
+ * @brief Hands a transmit frame back to its connection.
+ *
+ * For transports with SendSpduAsync, once they are done with a frame. May be called from
+ * another thread than the one driving the state machine.
+ *
+ * @param[in]   self        Pointer to my RastaS structure handle.
+ * @param[in]   pSpduData   Frame as passed to SendSpduAsync.
+ *
+ * @retval - `OK`      If the frame belonged to the connection and was busy.
+ * @retval - `NOT_OK`  Otherwise.
+ */
+StdRet_t Sm_TxRelease(SmType *self, const uint8_t *pSpduData);
+
+/**
+ * @brief Handles an event of the state machine.
+ *
+ * For receive events the PDU is the received one; it is checked like a frame from the wire
+ * and dropped if malformed. For all events the PDU is reused to build the PDU to send.
  *
  * @param[in]   self        Pointer to my RastaS structure handle.
  * @param[in]   event       Received event to handle.
@@ -84,4 +184,28 @@ StdRet_t Sm_Init(SmType *self);
  */
 void Sm_HandleEvent(SmType *self, const Event event, PDU_S *pdu);
 
+/**
+ * @brief Fires the heartbeat or incoming-message timer of a connection if it is due.
+ *
+ * Only connections from STATE_START on are monitored. Ti elapsed takes precedence over Th.
+ * With a timer wheel, the timer of the connection is armed again for its next deadline.
+ *
+ * @param[in]   self        Pointer to my RastaS structure handle.
+ * @param[in]   now         Current Tlocal.
+ *
+ * @retval Number of timer events handled, 0 or 1.
+ */
+uint32_t Sm_CheckTimers(SmType *self, const uint32_t now);
+
+/**
+ * @brief Handles a received PDU straight from its frame.
+ *
+ * The receive event is derived from the message type and header fields are decoded
+ * on demand, so nothing is copied out of the frame.
+ *
+ * @param[in]   self        Pointer to my RastaS structure handle.
+ * @param[in]   rx          Validated view over the received PDU.
+ */
+void Sm_HandlePdu(SmType *self, const PDU_View *rx);
+
 #endif /* SM_H */
@@ -16,9 +16,6 @@ typedef struct {
 typedef uint32_t (*GetTimestamp)();
 
 typedef struct {
-    TimeoutsConfig timeouts;
-    // uint32_t Tlocal;    /* Local time (timestamp at the time of analysis) */
-    GetTimestamp Tlocal;
     int32_t Ti;        /* Monitoring time for incoming messages (calculated dynamically) */
     uint32_t Trtd;      /* Round trip delay of a message */
     uint32_t Talive;    /* Tlocal - CTSR : is calculated upon receipt of a message relevant to time monitoring 
@@ -0,0 +1,63 @@
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define TIMER_WHEEL_SLOTS 256U /* Ticks of Tlocal one turn of the wheel covers, a power of two */
+
+/* Timer embedded in its owner; linked into the slot of its deadline while armed */
+typedef struct TimerNode {
+    struct TimerNode *prev;
+    struct TimerNode *next;
+    uint32_t deadline;  /* Tlocal at which the timer expires */
+} TimerNode;
+
+/* Hashed timing wheel: a timer lives in slot deadline % TIMER_WHEEL_SLOTS, later turns wait there
+   until their deadline comes, so arming, disarming and expiring a timer do not depend on how many there are */
+typedef struct {
+    TimerNode slots[TIMER_WHEEL_SLOTS]; /* List heads */
+    uint32_t tick;                      /* Earliest tick whose slot may still hold expired timers */
+} TimerWheel;
+
+/**
+ * @brief Start an empty wheel.
+ *
+ * @param[out]  wheel   Wheel to initialise.
+ * @param[in]   now     Current Tlocal.
+ */
+void timer_wheel_init(TimerWheel *wheel, const uint32_t now);
+
+/**
+ * @brief Mark a timer as not armed, before it is used with a wheel.
+ */
+void timer_node_init(TimerNode *node);
+
+/**
+ * @brief Arm a timer, or move it if it is armed already.
+ *
+ * @param[in]   wheel       Wheel of the timer.
+ * @param[in]   node        Timer to arm.
+ * @param[in]   deadline    Tlocal at which the timer expires; deadlines already passed expire on the next expiry check.
+ */
+void timer_wheel_arm(TimerWheel *wheel, TimerNode *node, const uint32_t deadline);
+
+/**
+ * @brief Disarm a timer; nothing happens if it is not armed.
+ */
+void timer_wheel_disarm(TimerNode *node);
+
+/**
+ * @brief Take the next expired timer off the wheel.
+ *
+ * Call until it returns NULL to collect all timers expired at now. Long gaps between the
+ * calls cost at most one pass over the slots.
+ *
+ * @param[in]   wheel   Wheel to check.
+ * @param[in]   now     Current Tlocal.
+ *
+ * @retval The expired timer, no longer armed, or NULL if there is none.
+ */
+TimerNode* timer_wheel_expire(TimerWheel *wheel, const uint32_t now);
+
+#endif /* TIMER_WHEEL_H */
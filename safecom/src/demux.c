@@ -0,0 +1,87 @@
+#include "demux.h"
+#include "assert.h"
+
+/* Mix the three words so that keys differing in any of them spread over the table */
+static uint32_t hash_key(const DemuxKey *key)
+{
+    uint32_t h = key->nodeId * 0x9E3779B1U;
+
+    h ^= key->sender_id + 0x85EBCA77U + (h << 6) + (h >> 2);
+    h ^= key->receiver_id + 0xC2B2AE3DU + (h << 6) + (h >> 2);
+    h ^= h >> 16;
+    h *= 0x7FEB352DU;
+    h ^= h >> 15;
+
+    return h;
+}
+
+static bool same_key(const DemuxKey *a, const DemuxKey *b)
+{
+    return (a->nodeId == b->nodeId) && (a->sender_id == b->sender_id) && (a->receiver_id == b->receiver_id);
+}
+
+StdRet_t demux_init(Demux *demux, DemuxEntry *entries, const uint32_t count)
+{
+    assert(demux != NULL);
+    assert(entries != NULL);
+
+    if ((count == 0U) || ((count & (count - 1U)) != 0U)) {
+        return NOT_OK;
+    }
+
+    demux->entries = entries;
+    demux->mask = count - 1U;
+    demux->unknown = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        entries[i].connection = DEMUX_NONE;
+    }
+
+    return OK;
+}
+
+StdRet_t demux_add(Demux *demux, const DemuxKey *key, const uint32_t connection)
+{
+    assert(demux != NULL);
+    assert(key != NULL);
+
+    uint32_t index = hash_key(key) & demux->mask;
+
+    for (uint32_t probe = 0; probe <= demux->mask; probe++) {
+        DemuxEntry *entry = &demux->entries[index];
+
+        if (entry->connection == DEMUX_NONE) {
+            entry->key = *key;
+            entry->connection = connection;
+            return OK;
+        }
+        if (same_key(&entry->key, key)) {
+            return NOT_OK;
+        }
+        index = (index + 1U) & demux->mask;
+    }
+
+    return NOT_OK;
+}
+
+uint32_t demux_find(const Demux *demux, const DemuxKey *key)
+{
+    assert(demux != NULL);
+    assert(key != NULL);
+
+    uint32_t index = hash_key(key) & demux->mask;
+
+    /* Entries are never removed, so the first free entry ends the probe sequence */
+    for (uint32_t probe = 0; probe <= demux->mask; probe++) {
+        const DemuxEntry *entry = &demux->entries[index];
+
+        if (entry->connection == DEMUX_NONE) {
+            break;
+        }
+        if (same_key(&entry->key, key)) {
+            return entry->connection;
+        }
+        index = (index + 1U) & demux->mask;
+    }
+
+    return DEMUX_NONE;
+}
@@ -0,0 +1,115 @@
+#include <string.h>
+#include "ingress.h"
+#include "assert.h"
+
+/* Bounded multi-producer queue after D. Vyukov: a cell is free for position pos when its
+   sequence is pos, and holds the SPDU of position pos once its sequence is pos + 1. */
+
+void ingress_init(Ingress *queue)
+{
+    assert(queue != NULL);
+
+    memset(queue, 0, sizeof(*queue));
+    for (uint32_t i = 0; i < INGRESS_SIZE; i++) {
+        queue->cells[i].sequence = i;
+    }
+}
+
+static void raise_high_water(Ingress *queue, const uint32_t depth)
+{
+    uint32_t seen = __atomic_load_n(&queue->high_water, __ATOMIC_RELAXED);
+
+    while ((depth > seen) &&
+           !__atomic_compare_exchange_n(&queue->high_water, &seen, depth, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+bool ingress_push(Ingress *queue, const NodeId_t nodeId, const SpduLen_t spduLen, const uint8_t *pSpduData)
+{
+    assert(queue != NULL);
+    assert(pSpduData != NULL);
+
+    if (spduLen > MAX_BUFF_SIZE) {
+        __atomic_fetch_add(&queue->overflows, 1U, __ATOMIC_RELAXED);
+        return false;
+    }
+
+    uint32_t pos = __atomic_load_n(&queue->enqueue_pos, __ATOMIC_RELAXED);
+    IngressCell *cell;
+
+    for (;;) {
+        cell = &queue->cells[pos & (INGRESS_SIZE - 1U)];
+        const int32_t diff = (int32_t)(__atomic_load_n(&cell->sequence, __ATOMIC_ACQUIRE) - pos);
+
+        if (diff == 0) {
+            /* The cell is free, claim its position; on failure pos holds the current one */
+            if (__atomic_compare_exchange_n(&queue->enqueue_pos, &pos, pos + 1U, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                break;
+            }
+        }
+        else if (diff < 0) {
+            /* Still holds the SPDU of the previous round: full */
+            __atomic_fetch_add(&queue->overflows, 1U, __ATOMIC_RELAXED);
+            return false;
+        }
+        else {
+            pos = __atomic_load_n(&queue->enqueue_pos, __ATOMIC_RELAXED);
+        }
+    }
+
+    cell->nodeId = nodeId;
+    cell->spduLen = spduLen;
+    memcpy(cell->data, pSpduData, spduLen);
+    __atomic_store_n(&cell->sequence, pos + 1U, __ATOMIC_RELEASE);
+
+    raise_high_water(queue, pos + 1U - __atomic_load_n(&queue->dequeue_pos, __ATOMIC_RELAXED));
+
+    return true;
+}
+
+uint32_t ingress_peek(Ingress *queue, SafeComSpdu *spdus, const uint32_t max)
+{
+    assert(queue != NULL);
+    assert(spdus != NULL);
+
+    const uint32_t pos = queue->dequeue_pos;
+    uint32_t count = 0;
+
+    /* Stops at the first cell whose producer has not finished yet, so the order is kept */
+    while (count < max) {
+        IngressCell *cell = &queue->cells[(pos + count) & (INGRESS_SIZE - 1U)];
+
+        if (__atomic_load_n(&cell->sequence, __ATOMIC_ACQUIRE) != (pos + count + 1U)) {
+            break;
+        }
+        spdus[count].nodeId = cell->nodeId;
+        spdus[count].spduLen = cell->spduLen;
+        spdus[count].pSpduData = cell->data;
+        count++;
+    }
+
+    return count;
+}
+
+void ingress_release(Ingress *queue, const uint32_t count)
+{
+    assert(queue != NULL);
+
+    const uint32_t pos = queue->dequeue_pos;
+
+    for (uint32_t i = 0; i < count; i++) {
+        IngressCell *cell = &queue->cells[(pos + i) & (INGRESS_SIZE - 1U)];
+        __atomic_store_n(&cell->sequence, pos + i + INGRESS_SIZE, __ATOMIC_RELEASE);
+    }
+    __atomic_store_n(&queue->dequeue_pos, pos + count, __ATOMIC_RELEASE);
+}
+
+void ingress_stats(const Ingress *queue, uint32_t *high_water, uint32_t *overflows)
+{
+    assert(queue != NULL);
+    assert(high_water != NULL);
+    assert(overflows != NULL);
+
+    *high_water = __atomic_load_n(&queue->high_water, __ATOMIC_RELAXED);
+    *overflows = __atomic_load_n(&queue->overflows, __ATOMIC_RELAXED);
+}
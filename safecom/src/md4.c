@@ -37,6 +37,7 @@
 #include <string.h>
 
 #include "md4.h"
+#include "assert.h"
 
 /*
  * The basic MD4 functions.
@@ -191,6 +192,21 @@ void MD4_Init(MD4_CTX *ctx)
 	ctx->hi = 0;
 }
 
+/*
+ * Like MD4_Init, but starts from the given initial values a, b, c and d
+ * instead of the standard ones, e.g. a safety-code key.
+ */
+void MD4_InitIV(MD4_CTX *ctx, const MD4_u32plus *iv)
+{
+	ctx->a = iv[0];
+	ctx->b = iv[1];
+	ctx->c = iv[2];
+	ctx->d = iv[3];
+
+	ctx->lo = 0;
+	ctx->hi = 0;
+}
+
 void MD4_Update(MD4_CTX *ctx, const void *data, unsigned long size)
 {
 	MD4_u32plus saved_lo;
@@ -262,4 +278,45 @@ void MD4_Final(unsigned char *result, MD4_CTX *ctx)
 	OUT(&result[12], ctx->d)
 
 	memset(ctx, 0, sizeof(*ctx));
-}
\ No newline at end of file
+}
+
+/*
+ * One-shot MD4 of a message that fits in a single block together with its
+ * padding.  The block is padded on the stack and compressed once, without the
+ * buffering and bit counters of MD4_Update and MD4_Final.  It is laid out as
+ * bytes, like any other input to body(), so the digest does not depend on the
+ * byte order of the host.  A NULL iv selects the standard initial values.
+ */
+void md4_oneblock(unsigned char *result, const MD4_u32plus *iv,
+    const void *data, unsigned long size)
+{
+	MD4_CTX ctx;
+	unsigned char *block = ctx.buffer;
+
+	assert(size <= MD4_ONEBLOCK_MAX_LENGTH);
+
+	memcpy(block, data, size);
+	block[size] = 0x80;
+	memset(&block[size + 1], 0, 56 - (size + 1));
+	OUT(&block[56], (MD4_u32plus)(size << 3))
+	OUT(&block[60], (MD4_u32plus)0)
+
+	if (iv) {
+		ctx.a = iv[0];
+		ctx.b = iv[1];
+		ctx.c = iv[2];
+		ctx.d = iv[3];
+	} else {
+		ctx.a = 0x67452301;
+		ctx.b = 0xefcdab89;
+		ctx.c = 0x98badcfe;
+		ctx.d = 0x10325476;
+	}
+
+	body(&ctx, block, 64);
+
+	OUT(&result[0], ctx.a)
+	OUT(&result[4], ctx.b)
+	OUT(&result[8], ctx.c)
+	OUT(&result[12], ctx.d)
+}
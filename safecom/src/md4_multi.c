@@ -0,0 +1,420 @@
+#include "md4_multi.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define MD4_MULTI_X86
+#include <immintrin.h>
+#endif
+
+#define MD4_A0  0x67452301U
+#define MD4_B0  0xefcdab89U
+#define MD4_C0  0x98badcfeU
+#define MD4_D0  0x10325476U
+#define MD4_K1  0x5a827999U
+#define MD4_K2  0x6ed9eba1U
+
+/* Padded single-block messages of all lanes, word-major so one vector load fetches a word of every lane */
+typedef struct {
+    uint32_t w[16][MD4_MULTI_MAX_LANES];
+    uint32_t h[4][MD4_MULTI_MAX_LANES];     /* Initial state in, digest words out */
+} Md4Lanes;
+
+typedef struct {
+    void (*run)(Md4Lanes *lanes, const size_t count);  /* count is a multiple of width */
+    size_t width;
+} Md4KernelDesc;
+
+/*
+ * One MD4 step and the three rounds, written against vector operations VADD, VROL, VF, VG
+ * and VH that every kernel defines for its own vector type before using them.
+ */
+#define VSTEP(f, a, b, c, d, x, s) \
+    (a) = VADD(VADD((a), f((b), (c), (d))), (x)); \
+    (a) = VROL((a), (s));
+
+#define MD4_MULTI_ROUNDS(a, b, c, d, x, k1, k2) \
+    VSTEP(VF, a, b, c, d, x[0], 3) \
+    VSTEP(VF, d, a, b, c, x[1], 7) \
+    VSTEP(VF, c, d, a, b, x[2], 11) \
+    VSTEP(VF, b, c, d, a, x[3], 19) \
+    VSTEP(VF, a, b, c, d, x[4], 3) \
+    VSTEP(VF, d, a, b, c, x[5], 7) \
+    VSTEP(VF, c, d, a, b, x[6], 11) \
+    VSTEP(VF, b, c, d, a, x[7], 19) \
+    VSTEP(VF, a, b, c, d, x[8], 3) \
+    VSTEP(VF, d, a, b, c, x[9], 7) \
+    VSTEP(VF, c, d, a, b, x[10], 11) \
+    VSTEP(VF, b, c, d, a, x[11], 19) \
+    VSTEP(VF, a, b, c, d, x[12], 3) \
+    VSTEP(VF, d, a, b, c, x[13], 7) \
+    VSTEP(VF, c, d, a, b, x[14], 11) \
+    VSTEP(VF, b, c, d, a, x[15], 19) \
+    VSTEP(VG, a, b, c, d, VADD(x[0], k1), 3) \
+    VSTEP(VG, d, a, b, c, VADD(x[4], k1), 5) \
+    VSTEP(VG, c, d, a, b, VADD(x[8], k1), 9) \
+    VSTEP(VG, b, c, d, a, VADD(x[12], k1), 13) \
+    VSTEP(VG, a, b, c, d, VADD(x[1], k1), 3) \
+    VSTEP(VG, d, a, b, c, VADD(x[5], k1), 5) \
+    VSTEP(VG, c, d, a, b, VADD(x[9], k1), 9) \
+    VSTEP(VG, b, c, d, a, VADD(x[13], k1), 13) \
+    VSTEP(VG, a, b, c, d, VADD(x[2], k1), 3) \
+    VSTEP(VG, d, a, b, c, VADD(x[6], k1), 5) \
+    VSTEP(VG, c, d, a, b, VADD(x[10], k1), 9) \
+    VSTEP(VG, b, c, d, a, VADD(x[14], k1), 13) \
+    VSTEP(VG, a, b, c, d, VADD(x[3], k1), 3) \
+    VSTEP(VG, d, a, b, c, VADD(x[7], k1), 5) \
+    VSTEP(VG, c, d, a, b, VADD(x[11], k1), 9) \
+    VSTEP(VG, b, c, d, a, VADD(x[15], k1), 13) \
+    VSTEP(VH, a, b, c, d, VADD(x[0], k2), 3) \
+    VSTEP(VH, d, a, b, c, VADD(x[8], k2), 9) \
+    VSTEP(VH, c, d, a, b, VADD(x[4], k2), 11) \
+    VSTEP(VH, b, c, d, a, VADD(x[12], k2), 15) \
+    VSTEP(VH, a, b, c, d, VADD(x[2], k2), 3) \
+    VSTEP(VH, d, a, b, c, VADD(x[10], k2), 9) \
+    VSTEP(VH, c, d, a, b, VADD(x[6], k2), 11) \
+    VSTEP(VH, b, c, d, a, VADD(x[14], k2), 15) \
+    VSTEP(VH, a, b, c, d, VADD(x[1], k2), 3) \
+    VSTEP(VH, d, a, b, c, VADD(x[9], k2), 9) \
+    VSTEP(VH, c, d, a, b, VADD(x[5], k2), 11) \
+    VSTEP(VH, b, c, d, a, VADD(x[13], k2), 15) \
+    VSTEP(VH, a, b, c, d, VADD(x[3], k2), 3) \
+    VSTEP(VH, d, a, b, c, VADD(x[11], k2), 9) \
+    VSTEP(VH, c, d, a, b, VADD(x[7], k2), 11) \
+    VSTEP(VH, b, c, d, a, VADD(x[15], k2), 15)
+
+/* Scalar kernel: the same rounds on plain words, one lane at a time */
+#define VADD(a, b)      ((uint32_t)((a) + (b)))
+#define VROL(v, s)      ((uint32_t)(((v) << (s)) | ((v) >> (32 - (s)))))
+#define VF(x, y, z)     ((z) ^ ((x) & ((y) ^ (z))))
+#define VG(x, y, z)     (((x) & ((y) | (z))) | ((y) & (z)))
+#define VH(x, y, z)     ((x) ^ (y) ^ (z))
+
+static void kernel_scalar(Md4Lanes *lanes, const size_t count)
+{
+    const uint32_t k1 = MD4_K1;
+    const uint32_t k2 = MD4_K2;
+
+    for (size_t l = 0; l < count; l++) {
+        uint32_t x[16];
+        for (unsigned int i = 0; i < 16; i++) {
+            x[i] = lanes->w[i][l];
+        }
+        uint32_t a = lanes->h[0][l];
+        uint32_t b = lanes->h[1][l];
+        uint32_t c = lanes->h[2][l];
+        uint32_t d = lanes->h[3][l];
+
+        MD4_MULTI_ROUNDS(a, b, c, d, x, k1, k2)
+
+        lanes->h[0][l] += a;
+        lanes->h[1][l] += b;
+        lanes->h[2][l] += c;
+        lanes->h[3][l] += d;
+    }
+}
+
+#undef VADD
+#undef VROL
+#undef VF
+#undef VG
+#undef VH
+
+#if defined(MD4_MULTI_X86)
+
+/* SSE2 kernel: 4 lanes */
+#define VADD(a, b)      _mm_add_epi32((a), (b))
+#define VROL(v, s)      _mm_or_si128(_mm_slli_epi32((v), (s)), _mm_srli_epi32((v), 32 - (s)))
+#define VF(x, y, z)     _mm_xor_si128((z), _mm_and_si128((x), _mm_xor_si128((y), (z))))
+#define VG(x, y, z)     _mm_or_si128(_mm_and_si128((x), _mm_or_si128((y), (z))), _mm_and_si128((y), (z)))
+#define VH(x, y, z)     _mm_xor_si128(_mm_xor_si128((x), (y)), (z))
+
+__attribute__((target("sse2")))
+static void kernel_sse2(Md4Lanes *lanes, const size_t count)
+{
+    const __m128i k1 = _mm_set1_epi32((int)MD4_K1);
+    const __m128i k2 = _mm_set1_epi32((int)MD4_K2);
+
+    for (size_t l = 0; l < count; l += 4) {
+        __m128i x[16];
+        __m128i h[4];
+        for (unsigned int i = 0; i < 16; i++) {
+            x[i] = _mm_loadu_si128((const __m128i *)&lanes->w[i][l]);
+        }
+        for (unsigned int i = 0; i < 4; i++) {
+            h[i] = _mm_loadu_si128((const __m128i *)&lanes->h[i][l]);
+        }
+        __m128i a = h[0], b = h[1], c = h[2], d = h[3];
+
+        MD4_MULTI_ROUNDS(a, b, c, d, x, k1, k2)
+
+        _mm_storeu_si128((__m128i *)&lanes->h[0][l], VADD(a, h[0]));
+        _mm_storeu_si128((__m128i *)&lanes->h[1][l], VADD(b, h[1]));
+        _mm_storeu_si128((__m128i *)&lanes->h[2][l], VADD(c, h[2]));
+        _mm_storeu_si128((__m128i *)&lanes->h[3][l], VADD(d, h[3]));
+    }
+}
+
+#undef VADD
+#undef VROL
+#undef VF
+#undef VG
+#undef VH
+
+/* AVX2 kernel: 8 lanes */
+#define VADD(a, b)      _mm256_add_epi32((a), (b))
+#define VROL(v, s)      _mm256_or_si256(_mm256_slli_epi32((v), (s)), _mm256_srli_epi32((v), 32 - (s)))
+#define VF(x, y, z)     _mm256_xor_si256((z), _mm256_and_si256((x), _mm256_xor_si256((y), (z))))
+#define VG(x, y, z)     _mm256_or_si256(_mm256_and_si256((x), _mm256_or_si256((y), (z))), _mm256_and_si256((y), (z)))
+#define VH(x, y, z)     _mm256_xor_si256(_mm256_xor_si256((x), (y)), (z))
+
+__attribute__((target("avx2")))
+static void kernel_avx2(Md4Lanes *lanes, const size_t count)
+{
+    const __m256i k1 = _mm256_set1_epi32((int)MD4_K1);
+    const __m256i k2 = _mm256_set1_epi32((int)MD4_K2);
+
+    for (size_t l = 0; l < count; l += 8) {
+        __m256i x[16];
+        __m256i h[4];
+        for (unsigned int i = 0; i < 16; i++) {
+            x[i] = _mm256_loadu_si256((const __m256i *)&lanes->w[i][l]);
+        }
+        for (unsigned int i = 0; i < 4; i++) {
+            h[i] = _mm256_loadu_si256((const __m256i *)&lanes->h[i][l]);
+        }
+        __m256i a = h[0], b = h[1], c = h[2], d = h[3];
+
+        MD4_MULTI_ROUNDS(a, b, c, d, x, k1, k2)
+
+        _mm256_storeu_si256((__m256i *)&lanes->h[0][l], VADD(a, h[0]));
+        _mm256_storeu_si256((__m256i *)&lanes->h[1][l], VADD(b, h[1]));
+        _mm256_storeu_si256((__m256i *)&lanes->h[2][l], VADD(c, h[2]));
+        _mm256_storeu_si256((__m256i *)&lanes->h[3][l], VADD(d, h[3]));
+    }
+}
+
+#undef VADD
+#undef VROL
+#undef VF
+#undef VG
+#undef VH
+
+/* AVX-512 kernel: 16 lanes, native rotates and the round functions as single ternary-logic ops */
+#define VADD(a, b)      _mm512_add_epi32((a), (b))
+#define VROL(v, s)      _mm512_rol_epi32((v), (s))
+#define VF(x, y, z)     _mm512_ternarylogic_epi32((x), (y), (z), 0xCA)
+#define VG(x, y, z)     _mm512_ternarylogic_epi32((x), (y), (z), 0xE8)
+#define VH(x, y, z)     _mm512_ternarylogic_epi32((x), (y), (z), 0x96)
+
+__attribute__((target("avx512f")))
+static void kernel_avx512(Md4Lanes *lanes, const size_t count)
+{
+    const __m512i k1 = _mm512_set1_epi32((int)MD4_K1);
+    const __m512i k2 = _mm512_set1_epi32((int)MD4_K2);
+
+    for (size_t l = 0; l < count; l += 16) {
+        __m512i x[16];
+        __m512i h[4];
+        for (unsigned int i = 0; i < 16; i++) {
+            x[i] = _mm512_loadu_si512((const void *)&lanes->w[i][l]);
+        }
+        for (unsigned int i = 0; i < 4; i++) {
+            h[i] = _mm512_loadu_si512((const void *)&lanes->h[i][l]);
+        }
+        __m512i a = h[0], b = h[1], c = h[2], d = h[3];
+
+        MD4_MULTI_ROUNDS(a, b, c, d, x, k1, k2)
+
+        _mm512_storeu_si512((void *)&lanes->h[0][l], VADD(a, h[0]));
+        _mm512_storeu_si512((void *)&lanes->h[1][l], VADD(b, h[1]));
+        _mm512_storeu_si512((void *)&lanes->h[2][l], VADD(c, h[2]));
+        _mm512_storeu_si512((void *)&lanes->h[3][l], VADD(d, h[3]));
+    }
+}
+
+#undef VADD
+#undef VROL
+#undef VF
+#undef VG
+#undef VH
+
+#endif /* MD4_MULTI_X86 */
+
+/* Indexed by Md4MultiKernel, kernels missing from this build have no run function */
+static const Md4KernelDesc kernels[] = {
+    { kernel_scalar, 1U },
+#if defined(MD4_MULTI_X86)
+    { kernel_sse2, 4U },
+    { kernel_avx2, 8U },
+    { kernel_avx512, 16U },
+#else
+    { NULL, 4U },
+    { NULL, 8U },
+    { NULL, 16U },
+#endif
+};
+
+/* Process-wide choice, resolved from the CPU features on first use. Instances on several threads
+   may resolve it concurrently; they all store the same kernel, atomically. */
+static const Md4KernelDesc *selected = NULL;
+
+static bool kernel_supported(const Md4MultiKernel kernel)
+{
+    bool ret = false;
+
+    switch (kernel) {
+        case MD4_MULTI_SCALAR:
+            ret = true;
+            break;
+#if defined(MD4_MULTI_X86)
+        case MD4_MULTI_SSE2:
+            ret = __builtin_cpu_supports("sse2");
+            break;
+        case MD4_MULTI_AVX2:
+            ret = __builtin_cpu_supports("avx2");
+            break;
+        case MD4_MULTI_AVX512:
+            ret = __builtin_cpu_supports("avx512f");
+            break;
+#endif
+        default:
+            break;
+    }
+
+    return ret;
+}
+
+static const Md4KernelDesc *current_kernel(void)
+{
+    const Md4KernelDesc *kernel_desc = __atomic_load_n(&selected, __ATOMIC_ACQUIRE);
+
+    if (kernel_desc == NULL) {
+#if defined(MD4_MULTI_X86)
+        __builtin_cpu_init();
+#endif
+        Md4MultiKernel kernel = MD4_MULTI_AVX512;
+        while (!kernel_supported(kernel)) {
+            kernel--;
+        }
+        kernel_desc = &kernels[kernel];
+        __atomic_store_n(&selected, kernel_desc, __ATOMIC_RELEASE);
+    }
+
+    return kernel_desc;
+}
+
+static uint32_t load_le32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/* Pad a short message into one block of a lane and start the lane from its initial values */
+static void load_lane(Md4Lanes *lanes, const size_t lane, const MD4_u32plus *iv, const uint8_t *msg, const size_t len)
+{
+    const size_t full = len / 4U;
+    size_t i = 0;
+
+    for (; i < full; i++) {
+        lanes->w[i][lane] = load_le32(&msg[i * 4U]);
+    }
+
+    /* The word with the message tail and the 0x80 terminator */
+    uint32_t tail = 0x80U << ((len % 4U) * 8U);
+    for (size_t j = 0; j < (len % 4U); j++) {
+        tail |= (uint32_t)msg[full * 4U + j] << (j * 8U);
+    }
+    lanes->w[i++][lane] = tail;
+
+    for (; i < 14U; i++) {
+        lanes->w[i][lane] = 0;
+    }
+    lanes->w[14][lane] = (uint32_t)len << 3;
+    lanes->w[15][lane] = 0;
+
+    lanes->h[0][lane] = (iv != NULL) ? (uint32_t)iv[0] : MD4_A0;
+    lanes->h[1][lane] = (iv != NULL) ? (uint32_t)iv[1] : MD4_B0;
+    lanes->h[2][lane] = (iv != NULL) ? (uint32_t)iv[2] : MD4_C0;
+    lanes->h[3][lane] = (iv != NULL) ? (uint32_t)iv[3] : MD4_D0;
+}
+
+/* Run the kernel over the loaded lanes and write out their digests */
+static void run_lanes(const Md4KernelDesc *kernel, Md4Lanes *lanes, const size_t used, const size_t *lane_msg,
+                      uint8_t (*digests)[MD4_DIGEST_LENGTH])
+{
+    /* Idle lanes of the last vector hash an empty message whose digest is discarded */
+    const size_t count = ((used + kernel->width - 1) / kernel->width) * kernel->width;
+    for (size_t l = used; l < count; l++) {
+        load_lane(lanes, l, NULL, NULL, 0);
+    }
+
+    kernel->run(lanes, count);
+
+    for (size_t l = 0; l < used; l++) {
+        uint8_t *out = digests[lane_msg[l]];
+        for (unsigned int i = 0; i < 4; i++) {
+            const uint32_t word = lanes->h[i][l];
+            out[i * 4] = (uint8_t)word;
+            out[i * 4 + 1] = (uint8_t)(word >> 8);
+            out[i * 4 + 2] = (uint8_t)(word >> 16);
+            out[i * 4 + 3] = (uint8_t)(word >> 24);
+        }
+    }
+}
+
+void md4_multi(const MD4_u32plus *const *ivs, const uint8_t *const *msgs, const size_t *lens,
+               uint8_t (*digests)[MD4_DIGEST_LENGTH], const size_t count)
+{
+    const Md4KernelDesc *kernel = current_kernel();
+    Md4Lanes lanes;
+    size_t lane_msg[MD4_MULTI_MAX_LANES];
+    size_t used = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        const MD4_u32plus *iv = (ivs != NULL) ? ivs[i] : NULL;
+
+        if (lens[i] > MD4_ONEBLOCK_MAX_LENGTH) {
+            MD4_CTX ctx;
+            if (iv != NULL) {
+                MD4_InitIV(&ctx, iv);
+            } else {
+                MD4_Init(&ctx);
+            }
+            MD4_Update(&ctx, msgs[i], lens[i]);
+            MD4_Final(digests[i], &ctx);
+            continue;
+        }
+
+        load_lane(&lanes, used, iv, msgs[i], lens[i]);
+        lane_msg[used++] = i;
+
+        if (used == MD4_MULTI_MAX_LANES) {
+            run_lanes(kernel, &lanes, used, lane_msg, digests);
+            used = 0;
+        }
+    }
+
+    if (used > 0) {
+        run_lanes(kernel, &lanes, used, lane_msg, digests);
+    }
+}
+
+bool md4_multi_select(const Md4MultiKernel kernel)
+{
+    bool ret = false;
+
+    if ((kernel <= MD4_MULTI_AVX512) && (kernels[kernel].run != NULL)) {
+#if defined(MD4_MULTI_X86)
+        __builtin_cpu_init();
+#endif
+        if (kernel_supported(kernel)) {
+            __atomic_store_n(&selected, &kernels[kernel], __ATOMIC_RELEASE);
+            ret = true;
+        }
+    }
+
+    return ret;
+}
+
+Md4MultiKernel md4_multi_kernel(void)
+{
+    return (Md4MultiKernel)(current_kernel() - kernels);
+}
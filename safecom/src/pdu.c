@@ -2,6 +2,9 @@
 #include "sm.h"
 #include "assert.h"
 #include "time_mon.h"
+#include "md4_multi.h"
+
+#define PAYLOAD_LENGTH_VARIABLE 0xFFFFU
 
 static void write_uint16(uint8_t *buffer, size_t *offset, uint16_t value)
  {
@@ -25,78 +28,58 @@ static void write_uint32(uint8_t *buffer, size_t *offset, uint32_t value)
     *offset += 4;
 }
 
-static uint16_t read_uint16(const uint8_t *buffer, size_t *offset) 
-{
-    assert(buffer != NULL);
-    assert(offset != NULL);
-
-    uint16_t value = (uint16_t)(buffer[*offset] << SHIFT_1_BYTES) | (uint16_t)buffer[*offset + 1];
-    *offset += 2;
-    return value;
-}
-
-static uint32_t read_uint32(const uint8_t *buffer, size_t *offset) 
+static uint16_t load_uint16(const uint8_t *p)
 {
-    assert(buffer != NULL);
-    assert(offset != NULL);
-
-    uint32_t value = (uint32_t)(buffer[*offset] << SHIFT_3_BYTES) | (uint32_t)(buffer[*offset + 1] << SHIFT_2_BYTES) |
-                     (uint32_t)(buffer[*offset + 2] << SHIFT_1_BYTES) | (uint32_t)buffer[*offset + 3];
-    *offset += 4;
-    return value;
+    return (uint16_t)(((uint16_t)p[0] << SHIFT_1_BYTES) | (uint16_t)p[1]);
 }
 
-/* Create payload for Connection Request */
-static uint8_t *ConnReqPayload()
+/* Expected payload length of a PDU type, PAYLOAD_LENGTH_VARIABLE for Data PDUs */
+static bool expected_payload_length(const MessageType type, uint16_t *length)
 {
-    static uint8_t buffer[CONN_REQ_PAYLOAD_LENGTH];
-
-    buffer[0] = (PROTOCOL_VERSION >> SHIFT_3_BYTES) & 0xFF;
-    buffer[1] = (PROTOCOL_VERSION >> SHIFT_2_BYTES ) & 0xFF;
-    buffer[2] = (PROTOCOL_VERSION >> SHIFT_1_BYTES) & 0xFF;
-    buffer[3] = PROTOCOL_VERSION & 0xFF;
-
-    /* Byte 4 - 5 is for Nsendmax: Size of the local receive buffer in number of messages */
-    buffer[4] = (N_SEND_MAX >> SHIFT_1_BYTES) & 0xFF;
-    buffer[5] = N_SEND_MAX & 0xFF;
-
-    /* Byte 6 - 13 are reserved for initial parameter adjustment (not used yet) with value = 0 */
-    for (uint8_t i = 6; i < CONN_REQ_PAYLOAD_LENGTH; i++)
-    {
-        buffer[i] = 0;
+    bool ret = true;
+
+    switch (type) {
+        case CONNECTION_REQUEST:
+            *length = CONN_REQ_PAYLOAD_LENGTH;
+            break;
+        case CONNECTION_RESPONSE:
+            *length = CONN_RESP_PAYLOAD_LENGTH;
+            break;
+        case DISCONNECTION_REQUEST:
+            *length = DISC_REQ_PAYLOAD_LENGTH;
+            break;
+        case RETRANSMISSION_REQUEST:
+        case RETRANSMISSION_RESPONSE:
+        case HEARTBEAT:
+            *length = 0;
+            break;
+        case DATA:
+        case RETRANSMITTED_DATA:
+            *length = PAYLOAD_LENGTH_VARIABLE;
+            break;
+        default:
+            ret = false;
+            break;
     }
-    
-    return buffer;
-}
-
-/* Create payload for Connection Response */
-static uint8_t *ConnRespPayload()
-{
-    static uint8_t buffer[CONN_RESP_PAYLOAD_LENGTH];
 
-    buffer[0] = (PROTOCOL_VERSION >> SHIFT_3_BYTES) & 0xFF;
-    buffer[1] = (PROTOCOL_VERSION >> SHIFT_2_BYTES ) & 0xFF;
-    buffer[2] = (PROTOCOL_VERSION >> SHIFT_1_BYTES) & 0xFF;
-    buffer[3] = PROTOCOL_VERSION & 0xFF;
-
-    /* Byte 4 - 5 is for Nsendmax: Size of the local receive buffer in number of messages */
-    buffer[4] = (N_SEND_MAX >> SHIFT_1_BYTES) & 0xFF;
-    buffer[5] = N_SEND_MAX & 0xFF;
-
-    /* Byte 6 - 13 are reserved for initial parameter adjustment (not used yet) with value = 0 */
-    for (uint8_t i = 6; i < CONN_REQ_PAYLOAD_LENGTH; i++)
-    {
-        buffer[i] = 0;
-    }
-    
-    return buffer;
+    return ret;
 }
 
+/* Payload of Connection Request and Connection Response: protocol version, Nsendmax (size of the
+   local receive buffer in number of messages) and 8 bytes reserved for initial parameter adjustment */
+static const uint8_t conn_payload[CONN_REQ_PAYLOAD_LENGTH] = {
+    (uint8_t)((PROTOCOL_VERSION >> SHIFT_3_BYTES) & 0xFFU),
+    (uint8_t)((PROTOCOL_VERSION >> SHIFT_2_BYTES) & 0xFFU),
+    (uint8_t)((PROTOCOL_VERSION >> SHIFT_1_BYTES) & 0xFFU),
+    (uint8_t)(PROTOCOL_VERSION & 0xFFU),
+    (uint8_t)((N_SEND_MAX >> SHIFT_1_BYTES) & 0xFFU),
+    (uint8_t)(N_SEND_MAX & 0xFFU),
+    0, 0, 0, 0, 0, 0, 0, 0
+};
+
 /* Create payload for Disconnection Request */
-static uint8_t *DiscReqPayload(DiscReasonType discReason, uint16_t detailedReason)
+static uint8_t *DiscReqPayload(uint8_t *buffer, DiscReasonType discReason, uint16_t detailedReason)
 {
-    static uint8_t buffer[DISC_REQ_PAYLOAD_LENGTH];
-
     /* TODO: RTR - Byte 0 - 1 are for detailed information regarding the reason for the disconnection request. */
     buffer[0] = detailedReason >> SHIFT_1_BYTES;
     buffer[1] = detailedReason;
@@ -107,38 +90,73 @@ static uint8_t *DiscReqPayload(DiscReasonType discReason, uint16_t detailedReaso
     return buffer;
 }
 
-/* Create payload for Data */
-static uint8_t *DataPayload(const uint8_t msgSize, const uint8_t *pMsgData)
+/* Write the fixed header fields, without payload and safety code */
+static void write_header(const PDU_S *pdu, uint8_t *buffer)
 {
-    static uint8_t buffer[DISC_REQ_PAYLOAD_LENGTH];
-    
-    for (uint8_t i = 0; i < msgSize; i++)
-    {
-        buffer[i] = pMsgData[i];
-    }
-    
-    return buffer;
+    size_t offset = 0;
+
+    write_uint16(buffer, &offset, pdu->message_length);
+    write_uint16(buffer, &offset, pdu->message_type);
+    write_uint32(buffer, &offset, pdu->receiver_id);
+    write_uint32(buffer, &offset, pdu->sender_id);
+    write_uint32(buffer, &offset, pdu->sequence_number);
+    write_uint32(buffer, &offset, pdu->confirmed_sequence_number);
+    write_uint32(buffer, &offset, pdu->timestamp);
+    write_uint32(buffer, &offset, pdu->confirmed_timestamp);
 }
 
-/* Calculate security code of a RaSTA telegram */
-static void calculate_MD4(PDU_S *pdu)
+/* Write the fields that change from PDU to PDU in to a header copied from a template */
+static void patch_header(const PDU_S *pdu, uint8_t *buffer)
 {
-    assert(pdu != NULL);
-    
-	MD4_CTX ctx;
+    size_t offset = PDU_OFFSET_SEQUENCE_NUMBER;
+
+    write_uint32(buffer, &offset, pdu->sequence_number);
+    write_uint32(buffer, &offset, pdu->confirmed_sequence_number);
+    write_uint32(buffer, &offset, pdu->timestamp);
+    write_uint32(buffer, &offset, pdu->confirmed_timestamp);
+}
 
-    uint8_t buffer[MAX_PDU_LENGTH];
+/* Template of the PDU if it has one that was encoded for its length, NULL otherwise */
+static const uint8_t *usable_template(const PDU_S *pdu)
+{
+    const uint8_t *frame_template = pdu->frame_template;
+
+    if ((frame_template != NULL) &&
+        (load_uint16(&frame_template[PDU_OFFSET_MESSAGE_LENGTH]) == pdu->message_length) &&
+        (load_uint16(&frame_template[PDU_OFFSET_MESSAGE_TYPE]) == (uint16_t)pdu->message_type)) {
+        return frame_template;
+    }
+
+    return NULL;
+}
 
-    uint8_t safety_code[16];
+/* Encode the constant part of a PDU in to its template */
+static void encode_template(uint8_t *frame_template, const MessageType type, const uint8_t *payload,
+                            const uint16_t payload_length, const SafetyCode *code, const uint32_t receiver_id, const uint32_t sender_id)
+{
+    PDU_S pdu = { 0 };
 
-    /* Serialize data without safety code */
-    serialize_pdu(pdu, buffer, pdu->message_length);
+    pdu.message_length = PDU_HEADER_LENGTH + payload_length + code->length;
+    pdu.message_type = type;
+    pdu.receiver_id = receiver_id;
+    pdu.sender_id = sender_id;
 
-    MD4_Init(&ctx);
-	MD4_Update(&ctx, buffer, pdu->message_length - SAFETY_CODE_LENGTH);
-    MD4_Final(safety_code, &ctx);
+    write_header(&pdu, frame_template);
+    if (payload_length > 0) {
+        memcpy(&frame_template[PDU_HEADER_LENGTH], payload, payload_length);
+    }
+}
+
+/* Encode the frame templates of a connection once */
+void pdu_templates_init(PduTemplates *templates, const SafetyCode *code, const uint32_t receiver_id, const uint32_t sender_id)
+{
+    assert(templates != NULL);
+    assert(code != NULL);
 
-    pdu->safety_code = safety_code;
+    encode_template(templates->conn_req, CONNECTION_REQUEST, conn_payload, CONN_REQ_PAYLOAD_LENGTH, code, receiver_id, sender_id);
+    encode_template(templates->conn_resp, CONNECTION_RESPONSE, conn_payload, CONN_RESP_PAYLOAD_LENGTH, code, receiver_id, sender_id);
+    encode_template(templates->retr_req, RETRANSMISSION_REQUEST, NULL, 0, code, receiver_id, sender_id);
+    encode_template(templates->hb, HEARTBEAT, NULL, 0, code, receiver_id, sender_id);
 }
 
 /* Serialize fields in to a buffer with data from PDU structure */
@@ -151,17 +169,10 @@ void serialize_pdu(const PDU_S *pdu, uint8_t *buffer, const size_t buffer_size)
         return;
     }
 
-    size_t offset = 0;
+    size_t offset = PDU_HEADER_LENGTH;
 
     /* Serialize fixed fields */
-    write_uint16(buffer, &offset, pdu->message_length);
-    write_uint16(buffer, &offset, pdu->message_type);
-    write_uint32(buffer, &offset, pdu->receiver_id);
-    write_uint32(buffer, &offset, pdu->sender_id);
-    write_uint32(buffer, &offset, pdu->sequence_number);
-    write_uint32(buffer, &offset, pdu->confirmed_sequence_number);
-    write_uint32(buffer, &offset, pdu->timestamp);
-    write_uint32(buffer, &offset, pdu->confirmed_timestamp);
+    write_header(pdu, buffer);
 
     /* Serialize payload */
     if (pdu->payload != NULL) {
@@ -180,41 +191,233 @@ void serialize_pdu(const PDU_S *pdu, uint8_t *buffer, const size_t buffer_size)
     }
 }
 
+/* Write header and payload of a PDU in to a transmit frame, the safety code is left to the caller */
+size_t write_pdu(const PDU_S *pdu, const SafetyCode *code, uint8_t *frame, const size_t frame_size)
+{
+    assert(pdu != NULL);
+    assert(code != NULL);
+    assert(frame != NULL);
+
+    if ((pdu->message_length < (PDU_HEADER_LENGTH + code->length)) || (frame_size < pdu->message_length)) {
+        return 0;
+    }
+
+    const size_t payload_length = pdu->message_length - PDU_HEADER_LENGTH - code->length;
+    const uint8_t *frame_template = usable_template(pdu);
+
+    if (frame_template != NULL) {
+        /* Constant fields and payload come from the template, only the changing fields are written */
+        memcpy(frame, frame_template, PDU_HEADER_LENGTH + payload_length);
+        patch_header(pdu, frame);
+    } else {
+        write_header(pdu, frame);
+        if ((pdu->payload != NULL) && (payload_length > 0)) {
+            memcpy(&frame[PDU_HEADER_LENGTH], pdu->payload, payload_length);
+        }
+    }
+
+    return pdu->message_length;
+}
+
+/* Encode a PDU in to a transmit frame and append the safety code calculated over that frame */
+size_t encode_pdu(const PDU_S *pdu, const SafetyCode *code, uint8_t *frame, const size_t frame_size)
+{
+    const size_t length = write_pdu(pdu, code, frame, frame_size);
+
+    if (length > 0) {
+        const size_t code_offset = length - code->length;
+        safety_code_calculate(code, frame, code_offset, &frame[code_offset]);
+    }
+
+    return length;
+}
+
+/* Encode header and safety code of a PDU whose payload is sent as a segment of its own */
+size_t encode_pdu_segments(const PDU_S *pdu, const SafetyCode *code, uint8_t *header, uint8_t *safety_code)
+{
+    assert(pdu != NULL);
+    assert(code != NULL);
+    assert(header != NULL);
+    assert(safety_code != NULL);
+
+    if (pdu->message_length < (PDU_HEADER_LENGTH + code->length)) {
+        return 0;
+    }
+
+    const size_t payload_length = pdu->message_length - PDU_HEADER_LENGTH - code->length;
+    if ((payload_length > 0) && (pdu->payload == NULL)) {
+        return 0;
+    }
+
+    const uint8_t *frame_template = usable_template(pdu);
+    if (frame_template != NULL) {
+        memcpy(header, frame_template, PDU_HEADER_LENGTH);
+        patch_header(pdu, header);
+    } else {
+        write_header(pdu, header);
+    }
+    safety_code_calculate_split(code, header, PDU_HEADER_LENGTH, pdu->payload, payload_length, safety_code);
+
+    return pdu->message_length;
+}
+
+/* Append the safety codes of written frames, hashing them together in the lanes of md4_multi */
+void seal_pdus(const SafetyCode *const *codes, uint8_t *const *frames, const uint16_t *lengths, const size_t count)
+{
+    const MD4_u32plus *ivs[MD4_MULTI_MAX_LANES];
+    const uint8_t *msgs[MD4_MULTI_MAX_LANES];
+    size_t lens[MD4_MULTI_MAX_LANES];
+    uint8_t *codes_out[MD4_MULTI_MAX_LANES];
+    uint8_t code_lengths[MD4_MULTI_MAX_LANES];
+    uint8_t digests[MD4_MULTI_MAX_LANES][MD4_DIGEST_LENGTH];
+    size_t n = 0;
+
+    assert((codes != NULL) && (frames != NULL) && (lengths != NULL));
+
+    for (size_t i = 0; i < count; i++) {
+        /* Frames of connections without safety code are complete as written */
+        if (codes[i]->length == 0) {
+            continue;
+        }
+
+        const size_t code_offset = (size_t)lengths[i] - codes[i]->length;
+        ivs[n] = codes[i]->iv;
+        msgs[n] = frames[i];
+        lens[n] = code_offset;
+        codes_out[n] = &frames[i][code_offset];
+        code_lengths[n] = codes[i]->length;
+        n++;
+
+        if (n == MD4_MULTI_MAX_LANES) {
+            md4_multi(ivs, msgs, lens, digests, n);
+            for (size_t j = 0; j < n; j++) {
+                memcpy(codes_out[j], digests[j], code_lengths[j]);
+            }
+            n = 0;
+        }
+    }
+
+    if (n > 0) {
+        md4_multi(ivs, msgs, lens, digests, n);
+        for (size_t j = 0; j < n; j++) {
+            memcpy(codes_out[j], digests[j], code_lengths[j]);
+        }
+    }
+}
+
+/* Check length and type of a received PDU once, without copying it */
+bool pdu_view_init(PDU_View *view, const uint8_t *buffer, const size_t buffer_size, const uint8_t code_length)
+{
+    assert(view != NULL);
+    assert(buffer != NULL);
+
+    const size_t min_length = PDU_HEADER_LENGTH + code_length;
+
+    if (buffer_size < min_length) {
+        return false;
+    }
+
+    const uint16_t message_length = load_uint16(&buffer[PDU_OFFSET_MESSAGE_LENGTH]);
+    const MessageType message_type = (MessageType)load_uint16(&buffer[PDU_OFFSET_MESSAGE_TYPE]);
+    uint16_t length = 0;
+
+    if (!expected_payload_length(message_type, &length)) {
+        return false;
+    }
+
+    if ((message_length < min_length) || (message_length > buffer_size) ||
+        ((length != PAYLOAD_LENGTH_VARIABLE) && (message_length != (min_length + length)))) {
+        return false;
+    }
+
+    view->frame = buffer;
+    view->message_length = message_length;
+    view->message_type = message_type;
+    view->code_length = code_length;
+
+    return true;
+}
+
+/* Decode the header and check the safety code of a received PDU in one go */
+bool pdu_view_init_verified(PDU_View *view, const uint8_t *buffer, const size_t buffer_size, const SafetyCode *code)
+{
+    assert(code != NULL);
+
+    if (!pdu_view_init(view, buffer, buffer_size, code->length)) {
+        return false;
+    }
+
+    const size_t code_offset = (size_t)view->message_length - code->length;
+
+    return safety_code_verify(code, buffer, code_offset, &buffer[code_offset]);
+}
+
+/* Check the safety codes of received PDUs, hashing them together in the lanes of md4_multi */
+void verify_pdus(const SafetyCode *const *codes, const PDU_View *views, bool *valid, const size_t count)
+{
+    const MD4_u32plus *ivs[MD4_MULTI_MAX_LANES];
+    const uint8_t *msgs[MD4_MULTI_MAX_LANES];
+    size_t lens[MD4_MULTI_MAX_LANES];
+    size_t index[MD4_MULTI_MAX_LANES];
+    uint8_t digests[MD4_MULTI_MAX_LANES][MD4_DIGEST_LENGTH];
+    size_t n = 0;
+
+    assert((codes != NULL) && (views != NULL) && (valid != NULL));
+
+    for (size_t i = 0; i < count; i++) {
+        /* Without safety code there is nothing to check */
+        valid[i] = true;
+        if (codes[i]->length == 0) {
+            continue;
+        }
+
+        ivs[n] = codes[i]->iv;
+        msgs[n] = views[i].frame;
+        lens[n] = (size_t)views[i].message_length - codes[i]->length;
+        index[n] = i;
+        n++;
+
+        if (n == MD4_MULTI_MAX_LANES) {
+            md4_multi(ivs, msgs, lens, digests, n);
+            for (size_t j = 0; j < n; j++) {
+                const size_t k = index[j];
+                valid[k] = safety_code_equal(pdu_view_safety_code(&views[k]), digests[j], codes[k]->length);
+            }
+            n = 0;
+        }
+    }
+
+    if (n > 0) {
+        md4_multi(ivs, msgs, lens, digests, n);
+        for (size_t j = 0; j < n; j++) {
+            const size_t k = index[j];
+            valid[k] = safety_code_equal(pdu_view_safety_code(&views[k]), digests[j], codes[k]->length);
+        }
+    }
+}
+
 /* Deserialize data in to the PDU structure from a buffer with serialized data */
 void deserialize_pdu(const uint8_t *buffer, const size_t buffer_size, PDU_S *pdu) 
 {
     assert(buffer != NULL);
     assert(pdu != NULL);
 
-    if (buffer_size < PDU_FIXED_FIELDS_LENGTH) {
-        return;
-    }
-
-    size_t offset = 0;
+    PDU_View view;
 
-    /* Deserialize fixed fields */
-    pdu->message_length = read_uint16(buffer, &offset);
-    pdu->message_type = (MessageType)read_uint16(buffer, &offset);
-    pdu->receiver_id = read_uint32(buffer, &offset);
-    pdu->sender_id = read_uint32(buffer, &offset);
-    pdu->sequence_number = read_uint32(buffer, &offset);
-    pdu->confirmed_sequence_number = read_uint32(buffer, &offset);
-    pdu->timestamp = read_uint32(buffer, &offset);
-    pdu->confirmed_timestamp = read_uint32(buffer, &offset);
-
-    /* Check if buffer size is sufficient for the full PDU */
-    if (buffer_size < pdu->message_length) {
+    if (!pdu_view_init(&view, buffer, buffer_size, SAFETY_CODE_LENGTH)) {
         return;
     }
 
-    /* Deserialize payload */
-    size_t payload_length = pdu->message_length - PDU_FIXED_FIELDS_LENGTH;
-    assert(payload_length >= 0);  /* Ensure payload length is valid */
-    pdu->payload = (uint8_t *)buffer + offset;
-    offset += payload_length;
-
-    /* Deserialize safety code */
-    pdu->safety_code = (uint8_t *)buffer + offset;
+    pdu->message_length = view.message_length;
+    pdu->message_type = view.message_type;
+    pdu->receiver_id = pdu_view_receiver_id(&view);
+    pdu->sender_id = pdu_view_sender_id(&view);
+    pdu->sequence_number = pdu_view_sequence_number(&view);
+    pdu->confirmed_sequence_number = pdu_view_confirmed_sequence_number(&view);
+    pdu->timestamp = pdu_view_timestamp(&view);
+    pdu->confirmed_timestamp = pdu_view_confirmed_timestamp(&view);
+    pdu->payload = pdu_view_payload(&view);
+    pdu->safety_code = (uint8_t *)pdu_view_safety_code(&view);
 }
 
 /* Create PDU for Connection Request */
@@ -222,18 +425,17 @@ void ConnReq(SmType *self, PDU_S *pdu)
 {
     // self->snt++;
 
-    pdu->message_length = PDU_FIXED_FIELDS_LENGTH + CONN_REQ_PAYLOAD_LENGTH;
+    pdu->message_length = PDU_HEADER_LENGTH + CONN_REQ_PAYLOAD_LENGTH + self->safety_code.length;
     pdu->message_type = CONNECTION_REQUEST;
-    pdu->receiver_id = RECEIVER_ID;
-    pdu->sender_id = SENDER_ID;
+    pdu->receiver_id = self->receiver_id;
+    pdu->sender_id = self->sender_id;
     pdu->sequence_number = self->snt;
     pdu->confirmed_sequence_number = 0;
-    pdu->timestamp = self->time.Tlocal();
+    pdu->timestamp = self->shared->Tlocal();
     pdu->confirmed_timestamp = 0;
-    pdu->payload = ConnReqPayload();
-
-    /* Calculate the safety code with MD4 protocol */
-    calculate_MD4(pdu);
+    pdu->payload = conn_payload;
+    pdu->safety_code = NULL;
+    pdu->frame_template = self->templates.conn_req;
 }
 
 /* Create PDU for Connection Response */
@@ -241,18 +443,17 @@ void ConnResp(SmType *self, PDU_S *pdu)
 {
     // self->snt++;
 
-    pdu->message_length = PDU_FIXED_FIELDS_LENGTH + CONN_RESP_PAYLOAD_LENGTH;
+    pdu->message_length = PDU_HEADER_LENGTH + CONN_RESP_PAYLOAD_LENGTH + self->safety_code.length;
     pdu->message_type = CONNECTION_RESPONSE;
-    pdu->receiver_id = RECEIVER_ID;
-    pdu->sender_id = SENDER_ID;
+    pdu->receiver_id = self->receiver_id;
+    pdu->sender_id = self->sender_id;
     pdu->sequence_number = self->snt;
     pdu->confirmed_sequence_number = self->cst;
-    pdu->timestamp = self->time.Tlocal();
+    pdu->timestamp = self->shared->Tlocal();
     pdu->confirmed_timestamp = self->ctsr;
-    pdu->payload = ConnRespPayload();
-
-    /* Calculate the safety code with MD4 protocol */
-    calculate_MD4(pdu);
+    pdu->payload = conn_payload;
+    pdu->safety_code = NULL;
+    pdu->frame_template = self->templates.conn_resp;
 }
 
 /* Create PDU for Retransmission Request */
@@ -260,18 +461,17 @@ void RetrReq(SmType *self, PDU_S *pdu)
 {
     self->snt++;
 
-    pdu->message_length = PDU_FIXED_FIELDS_LENGTH;
+    pdu->message_length = PDU_HEADER_LENGTH + self->safety_code.length;
     pdu->message_type = RETRANSMISSION_REQUEST;
-    pdu->receiver_id = RECEIVER_ID;
-    pdu->sender_id = SENDER_ID;
+    pdu->receiver_id = self->receiver_id;
+    pdu->sender_id = self->sender_id;
     pdu->sequence_number = self->snt;
     pdu->confirmed_sequence_number = self->cst;
-    pdu->timestamp = self->time.Tlocal();
+    pdu->timestamp = self->shared->Tlocal();
     pdu->confirmed_timestamp = self->ctsr;
     pdu->payload = NULL;
-
-    /* Calculate the safety code with MD4 protocol */
-    calculate_MD4(pdu);
+    pdu->safety_code = NULL;
+    pdu->frame_template = self->templates.retr_req;
 }
 
 /* Create PDU for Retransmission Response */
@@ -279,18 +479,17 @@ void RetrResp(SmType *self, PDU_S *pdu)
 {
     self->snt++;
 
-    pdu->message_length = PDU_FIXED_FIELDS_LENGTH;
+    pdu->message_length = PDU_HEADER_LENGTH + self->safety_code.length;
     pdu->message_type = RETRANSMISSION_RESPONSE;
-    pdu->receiver_id = RECEIVER_ID;
-    pdu->sender_id = SENDER_ID;
+    pdu->receiver_id = self->receiver_id;
+    pdu->sender_id = self->sender_id;
     pdu->sequence_number = self->snt;
     pdu->confirmed_sequence_number = self->cst;
-    pdu->timestamp = self->time.Tlocal();
+    pdu->timestamp = self->shared->Tlocal();
     pdu->confirmed_timestamp = self->ctsr;
     pdu->payload = NULL;
-
-    /* Calculate the safety code with MD4 protocol */
-    calculate_MD4(pdu);
+    pdu->safety_code = NULL;
+    pdu->frame_template = NULL;
 }
 
 /* Create PDU for Disconnection Request */
@@ -298,18 +497,17 @@ void DiscReq(SmType *self, PDU_S *pdu, const DiscReasonType discReason, const ui
 {
     self->snt++;
 
-    pdu->message_length = PDU_FIXED_FIELDS_LENGTH + DISC_REQ_PAYLOAD_LENGTH;
+    pdu->message_length = PDU_HEADER_LENGTH + DISC_REQ_PAYLOAD_LENGTH + self->safety_code.length;
     pdu->message_type = DISCONNECTION_REQUEST;
-    pdu->receiver_id = RECEIVER_ID;
-    pdu->sender_id = SENDER_ID;
+    pdu->receiver_id = self->receiver_id;
+    pdu->sender_id = self->sender_id;
     pdu->sequence_number = self->snt;
     pdu->confirmed_sequence_number = self->cst;
-    pdu->timestamp = self->time.Tlocal();
+    pdu->timestamp = self->shared->Tlocal();
     pdu->confirmed_timestamp = self->ctsr;
-    pdu->payload = DiscReqPayload(discReason, detailedReason);
-
-    /* Calculate the safety code with MD4 protocol */
-    calculate_MD4(pdu);
+    pdu->payload = DiscReqPayload(self->disc_payload, discReason, detailedReason);
+    pdu->safety_code = NULL;
+    pdu->frame_template = NULL;
 }
 
 /* Create PDU for Heartbeat */
@@ -317,18 +515,17 @@ void HB(SmType *self, PDU_S *pdu)
 {
     self->snt++;
 
-    pdu->message_length = PDU_FIXED_FIELDS_LENGTH;
+    pdu->message_length = PDU_HEADER_LENGTH + self->safety_code.length;
     pdu->message_type = HEARTBEAT;
-    pdu->receiver_id = RECEIVER_ID;
-    pdu->sender_id = SENDER_ID;
+    pdu->receiver_id = self->receiver_id;
+    pdu->sender_id = self->sender_id;
     pdu->sequence_number = self->snt;
     pdu->confirmed_sequence_number = self->cst;
-    pdu->timestamp = self->time.Tlocal();
+    pdu->timestamp = self->shared->Tlocal();
     pdu->confirmed_timestamp = self->ctsr;
     pdu->payload = NULL;
-
-    /* Calculate the safety code with MD4 protocol */
-    calculate_MD4(pdu);
+    pdu->safety_code = NULL;
+    pdu->frame_template = self->templates.hb;
 }
 
 /* Create PDU for Data */
@@ -336,16 +533,33 @@ void Data(SmType *self, PDU_S *pdu, const uint8_t msgLen, const uint8_t *pMsgDat
 {
     self->snt++;
 
-    pdu->message_length = PDU_FIXED_FIELDS_LENGTH + msgLen;
+    pdu->message_length = PDU_HEADER_LENGTH + msgLen + self->safety_code.length;
     pdu->message_type = DATA;
-    pdu->receiver_id = RECEIVER_ID;
-    pdu->sender_id = SENDER_ID;
+    pdu->receiver_id = self->receiver_id;
+    pdu->sender_id = self->sender_id;
     pdu->sequence_number = self->snt;
     pdu->confirmed_sequence_number = self->cst;
-    pdu->timestamp = self->time.Tlocal();
+    pdu->timestamp = self->shared->Tlocal();
     pdu->confirmed_timestamp = self->ctsr;
     pdu->payload = pMsgData;
+    pdu->safety_code = NULL;
+    pdu->frame_template = NULL;
+}
+
+/* Create PDU for Retransmitted Data */
+void RetrData(SmType *self, PDU_S *pdu, const uint8_t msgLen, const uint8_t *pMsgData)
+{
+    self->snt++;
 
-    /* Calculate the safety code with MD4 protocol */
-    calculate_MD4(pdu);
+    pdu->message_length = PDU_HEADER_LENGTH + msgLen + self->safety_code.length;
+    pdu->message_type = RETRANSMITTED_DATA;
+    pdu->receiver_id = self->receiver_id;
+    pdu->sender_id = self->sender_id;
+    pdu->sequence_number = self->snt;
+    pdu->confirmed_sequence_number = self->cst;
+    pdu->timestamp = self->shared->Tlocal();
+    pdu->confirmed_timestamp = self->ctsr;
+    pdu->payload = pMsgData;
+    pdu->safety_code = NULL;
+    pdu->frame_template = NULL;
 }
\ No newline at end of file
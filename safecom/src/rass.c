@@ -29,7 +29,7 @@ StdRet_t Rass_Init(SafeComConfig* const pConfig) {
         .config = RassConfig
     };
 
-    return (initialized==true) ? NOT_OK : (initialized=true, SafeCom_Init(&RassInstance, &config) );
+    return (initialized==true) ? NOT_OK : (initialized=true, SafeCom_Init(&RassInstance, &config));
 }
 
 StdRet_t Rass_Main(void) {
@@ -41,11 +41,31 @@ StdRet_t Rass_ReceiveSpdu(const NodeId_t nodeId, const SpduLen_t spduLen, const
     return SafeCom_ReceiveSpdu(&RassInstance, nodeId, spduLen, pSpduData);
 }
 
+StdRet_t Rass_ReceiveSpduBatch(const SafeComSpdu* const pSpdus, const uint32_t count) {
+    assert(pSpdus != NULL);
+    return SafeCom_ReceiveSpduBatch(&RassInstance, pSpdus, count);
+}
+
 StdRet_t Rass_SendData(const MsgId_t msgId, const MsgLen_t msgLen, const uint8_t* const pMsgData) {
     assert(pMsgData != NULL);
     return SafeCom_SendData(&RassInstance, msgId, msgLen, pMsgData);
 }
 
+StdRet_t Rass_SendDataBatch(const SafeComMsg* const pMsgs, const uint32_t count) {
+    assert(pMsgs != NULL);
+    return SafeCom_SendDataBatch(&RassInstance, pMsgs, count);
+}
+
+StdRet_t Rass_PostSpdu(const NodeId_t nodeId, const SpduLen_t spduLen, const uint8_t* const pSpduData) {
+    assert(pSpduData != NULL);
+    return SafeCom_PostSpdu(&RassInstance, nodeId, spduLen, pSpduData);
+}
+
+StdRet_t Rass_ReleaseSpdu(const NodeId_t nodeId, const uint8_t* const pSpduData) {
+    assert(pSpduData != NULL);
+    return SafeCom_ReleaseSpdu(&RassInstance, nodeId, pSpduData);
+}
+
 StdRet_t Rass_OpenConnection(const MsgId_t msgId) {
     return SafeCom_OpenConnection(&RassInstance, msgId);
 }
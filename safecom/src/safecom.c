@@ -14,7 +14,7 @@ StdRet_t SafeCom_Init(SafeCom* const self, const SafeComType* const pConfig) {
     return SafeCom_Init_Impl(self, pConfig);
 }
 
-StdRet_t SafeCom_Main(const SafeCom* const self) {
+StdRet_t SafeCom_Main(SafeCom* const self) {
     assert(self != NULL);
     return SafeCom_Main_Impl(self);
 }
@@ -25,12 +25,36 @@ StdRet_t SafeCom_ReceiveSpdu(const SafeCom* const self, const NodeId_t nodeId, c
     return SafeCom_ReceiveSpdu_Impl(self, nodeId, spduLen, pSpduData);
 }
 
+StdRet_t SafeCom_ReceiveSpduBatch(const SafeCom* const self, const SafeComSpdu* const pSpdus, const uint32_t count) {
+    assert(self != NULL);
+    assert(pSpdus != NULL);
+    return SafeCom_ReceiveSpduBatch_Impl(self, pSpdus, count);
+}
+
 StdRet_t SafeCom_SendData(const SafeCom* const self, const MsgId_t msgId, const MsgLen_t msgLen, const uint8_t* const pMsgData) {
     assert(self != NULL);
     assert(pMsgData != NULL);
     return SafeCom_SendData_Impl(self, msgId, msgLen, pMsgData);
 }
 
+StdRet_t SafeCom_SendDataBatch(const SafeCom* const self, const SafeComMsg* const pMsgs, const uint32_t count) {
+    assert(self != NULL);
+    assert(pMsgs != NULL);
+    return SafeCom_SendDataBatch_Impl(self, pMsgs, count);
+}
+
+StdRet_t SafeCom_PostSpdu(const SafeCom* const self, const NodeId_t nodeId, const SpduLen_t spduLen, const uint8_t* const pSpduData) {
+    assert(self != NULL);
+    assert(pSpduData != NULL);
+    return SafeCom_PostSpdu_Impl(self, nodeId, spduLen, pSpduData);
+}
+
+StdRet_t SafeCom_ReleaseSpdu(const SafeCom* const self, const NodeId_t nodeId, const uint8_t* const pSpduData) {
+    assert(self != NULL);
+    assert(pSpduData != NULL);
+    return SafeCom_ReleaseSpdu_Impl(self, nodeId, pSpduData);
+}
+
 StdRet_t SafeCom_OpenConnection(const SafeCom* const self, const MsgId_t msgId) {
     assert(self != NULL);
     return SafeCom_OpenConnection_Impl(self, msgId);
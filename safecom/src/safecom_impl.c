@@ -6,71 +6,373 @@
 
 static const StdRet_t INIT_RET = OK;
 
-static SmType* sms = NULL;
+/* Connection addressed by a node or message id, NULL if the instance does not own it */
+static SmType* connection(const SafeCom* const self, const uint32_t id) {
+    const uint32_t index = id - self->config.first_node;
+
+    return (index < self->config.max_connections) ? &self->config.sms[index] : NULL;
+}
+
+/* Connection a received SPDU belongs to, NULL if none. With a demux table the node and the RaSTA ids
+   of the header are looked up, so SPDUs of unknown peers are dropped before any safety code work. */
+static SmType* route(const SafeCom* const self, const NodeId_t nodeId, const SpduLen_t spduLen, const uint8_t* const pSpduData) {
+    Demux* const demux = self->config.demux;
+
+    if (demux == NULL) {
+        return connection(self, nodeId);
+    }
+
+    uint32_t index = DEMUX_NONE;
+    if (spduLen >= PDU_HEADER_LENGTH) {
+        const DemuxKey key = {
+            .nodeId = nodeId,
+            .sender_id = pdu_load_uint32(&pSpduData[PDU_OFFSET_SENDER_ID]),
+            .receiver_id = pdu_load_uint32(&pSpduData[PDU_OFFSET_RECEIVER_ID]),
+        };
+        index = demux_find(demux, &key);
+    }
+    if (index == DEMUX_NONE) {
+        demux->unknown++;
+        return NULL;
+    }
+
+    return &self->config.sms[index];
+}
 
 StdRet_t SafeCom_Init_Impl(SafeCom* const self, const SafeComType* const pConfig) {
     assert(self != NULL);
     assert(pConfig != NULL);
+    /* An instance without connections is valid, e.g. a worker of a sharded engine left empty */
+    assert((pConfig->config.sms != NULL) || (pConfig->config.max_connections == 0U));
  
     /* Implementation specific to SafeCom_Init */
     LOG_INFO("init module %s in role %i", pConfig->config.instname, pConfig->config.role);
     LOG_INFO("callouts of module %s: %p, %p", pConfig->config.instname, self->vtable.SendSpdu, self->vtable.ReceiveMsg);
 
-    sms = pConfig->config.sms;
-    sms->vtable = &self->vtable;
+    /* Connections live in the instance's own array, so independent instances share no state */
+    SmType* const sms = self->config.sms;
+    const SafeComPeer* const peers = pConfig->config.peers;
+    StdRet_t ret = OK;
 
-    sms->time.Tlocal = GetCurrentTimestamp;
+    /* The wheel runs on the clock the deadlines are taken from */
+    Sm_SharedInit(&self->shared, &self->vtable);
+    if (pConfig->config.Tlocal != NULL) {
+        self->shared.Tlocal = pConfig->config.Tlocal;
+    }
+    timer_wheel_init(&self->timers, self->shared.Tlocal());
 
     for (int i=0; i<pConfig->config.max_connections; i++) {
-        sms[i].channel = i;
+        sms[i].shared = &self->shared;
+        sms[i].channel = pConfig->config.first_node + i;
         sms[i].state = STATE_CLOSED;
         sms[i].role = pConfig->config.role;
+        sms[i].safety_code_config = (pConfig->config.safety_codes != NULL) ? &pConfig->config.safety_codes[i] : NULL;
+        sms[i].timers = &self->timers;
+        sms[i].sender_id = (peers != NULL) ? peers[i].sender_id : SENDER_ID;
+        sms[i].receiver_id = (peers != NULL) ? peers[i].receiver_id : RECEIVER_ID;
         Sm_Init(&sms[i]);
     }
+
+    /* The peer sends with its own id as sender and ours as receiver */
+    if (pConfig->config.demux != NULL) {
+        assert(peers != NULL);
+        for (uint32_t i = 0; i < pConfig->config.max_connections; i++) {
+            const DemuxKey key = { .nodeId = peers[i].nodeId, .sender_id = peers[i].receiver_id, .receiver_id = peers[i].sender_id };
+            if (demux_add(pConfig->config.demux, &key, i) != OK) {
+                LOG_ERROR("connection %u: node %u and RaSTA ids %u, %u are taken or the demux table is full", i, key.nodeId, key.sender_id, key.receiver_id);
+                ret = NOT_OK;
+            }
+        }
+    }
+
+    if (pConfig->config.ingress != NULL) {
+        ingress_init(pConfig->config.ingress);
+    }
     
-    return INIT_RET;
+    return ret;
 }
 
-StdRet_t SafeCom_Main_Impl(const SafeCom* const self) {
+static StdRet_t receive_burst(const SafeCom* const self, const SafeComSpdu* const pSpdus, const uint32_t count, SmTxBatch* const tx);
+
+/* Posted SPDUs are handled in place, in bursts, up to the budget; the rest waits for the next call */
+static StdRet_t drain_ingress(const SafeCom* const self, SmTxBatch* const tx, uint32_t budget) {
+    Ingress* const ingress = self->config.ingress;
+    SafeComSpdu burst[SAFECOM_MAX_BATCH];
+    StdRet_t ret = OK;
+
+    while (budget > 0U) {
+        const uint32_t count = ingress_peek(ingress, burst, (budget < SAFECOM_MAX_BATCH) ? budget : SAFECOM_MAX_BATCH);
+        if (count == 0U) {
+            break;
+        }
+        if (receive_burst(self, burst, count, tx) != OK) {
+            ret = NOT_OK;
+        }
+        ingress_release(ingress, count);
+        budget -= count;
+    }
+
+    return ret;
+}
+
+/* Only the connections whose deadline has come are touched; expired timers left over by the budget stay due */
+static void fire_timers(SafeCom* const self, SmTxBatch* const tx, uint32_t budget) {
+    const uint32_t now = self->shared.Tlocal();
+    TimerNode* node;
+
+    while ((budget > 0U) && ((node = timer_wheel_expire(&self->timers, now)) != NULL)) {
+        SmType* const sm = (SmType*)((uint8_t*)node - offsetof(SmType, timer));
+
+        sm->tx_batch = tx;
+        budget -= Sm_CheckTimers(sm, now);
+        sm->tx_batch = NULL;
+    }
+}
+
+StdRet_t SafeCom_Main_Impl(SafeCom* const self) {
     assert(self != NULL);
     /* Implementation specific to SafeCom_Main */
-    return INIT_RET;
+    const uint32_t budget = (self->config.main_budget > 0U) ? self->config.main_budget : SAFECOM_MAIN_BUDGET;
+    StdRet_t ret = OK;
+    SmTxBatch tx;
+
+    /* One run to completion: received SPDUs first, as they may restart Ti, then the timers.
+       Everything this sends goes to the transport together at the end. */
+    Sm_TxBatchInit(&tx);
+
+    if (self->config.ingress != NULL) {
+        ret = drain_ingress(self, &tx, budget);
+    }
+    fire_timers(self, &tx, budget);
+
+    Sm_TxBatchFlush(&tx, &self->vtable);
+
+    return ret;
 }
 
 StdRet_t SafeCom_ReceiveSpdu_Impl(const SafeCom* const self, const NodeId_t nodeId, const SpduLen_t spduLen, const uint8_t* const pSpduData) {
     assert(self != NULL);
     assert(pSpduData != NULL);
     /* Implementation specific to SafeCom_ReceiveSpdu */
-    self->vtable.ReceiveMsg(nodeId, spduLen, pSpduData);
+    /* The node id, or with a demux table node and RaSTA ids, selects the connection */
+    SmType* const sm = route(self, nodeId, spduLen, pSpduData);
+    if (sm == NULL) {
+        LOG_ERROR("SPDU from unknown node %u dropped", nodeId);
+        return NOT_OK;
+    }
+
+    /* Malformed and corrupted frames are rejected before any state machine work */
+    PDU_View rx;
+    if (!pdu_view_init_verified(&rx, pSpduData, spduLen, &sm->safety_code)) {
+        sm->rx_dropped++;
+        LOG_ERROR("malformed or corrupted SPDU of %u bytes from node %u dropped", spduLen, nodeId);
+        return NOT_OK;
+    }
+
+    Sm_HandlePdu(sm, &rx);
 
     return INIT_RET;
 }
 
+/* Validate a burst of at most SAFECOM_MAX_BATCH SPDUs in one pass, then run the state machines connection by connection */
+static StdRet_t receive_burst(const SafeCom* const self, const SafeComSpdu* const pSpdus, const uint32_t count, SmTxBatch* const tx) {
+    PDU_View views[SAFECOM_MAX_BATCH];
+    SmType* conns[SAFECOM_MAX_BATCH];
+    uint32_t order[SAFECOM_MAX_BATCH];
+    const SafetyCode* codes[SAFECOM_MAX_BATCH];
+    bool valid[SAFECOM_MAX_BATCH];
+    uint32_t accepted = 0;
+    StdRet_t ret = OK;
+
+    assert(count <= SAFECOM_MAX_BATCH);
+
+    /* Decode and check all headers first, malformed frames never reach a state machine */
+    for (uint32_t i = 0; i < count; i++) {
+        const SafeComSpdu* const spdu = &pSpdus[i];
+        SmType* const sm = (spdu->pSpduData != NULL) ? route(self, spdu->nodeId, spdu->spduLen, spdu->pSpduData) : NULL;
+
+        if (sm == NULL) {
+            LOG_ERROR("SPDU %u of burst from unknown node %u dropped", i, spdu->nodeId);
+            ret = NOT_OK;
+            continue;
+        }
+        if (!pdu_view_init(&views[accepted], spdu->pSpduData, spdu->spduLen, sm->safety_code.length)) {
+            sm->rx_dropped++;
+            LOG_ERROR("malformed SPDU %u of burst from node %u dropped", i, spdu->nodeId);
+            ret = NOT_OK;
+            continue;
+        }
+        conns[accepted] = sm;
+        codes[accepted] = &sm->safety_code;
+        accepted++;
+    }
+
+    /* Then the safety codes of all well-formed frames together; corrupted frames are dropped as well */
+    verify_pdus(codes, views, valid, accepted);
+
+    uint32_t verified = 0;
+    for (uint32_t i = 0; i < accepted; i++) {
+        if (!valid[i]) {
+            conns[i]->rx_dropped++;
+            LOG_ERROR("corrupted SPDU from node %u dropped", conns[i]->channel);
+            ret = NOT_OK;
+            continue;
+        }
+        views[verified] = views[i];
+        conns[verified] = conns[i];
+        order[verified] = verified;
+        verified++;
+    }
+    accepted = verified;
+
+    /* Group by connection; the sort is stable so every connection sees its SPDUs in arrival order */
+    for (uint32_t i = 1; i < accepted; i++) {
+        const uint32_t idx = order[i];
+        uint32_t j = i;
+        while ((j > 0) && (conns[order[j - 1]] > conns[idx])) {
+            order[j] = order[j - 1];
+            j--;
+        }
+        order[j] = idx;
+    }
+
+    /* Responses are collected in the caller's batch */
+    for (uint32_t i = 0; i < accepted; i++) {
+        SmType* const sm = conns[order[i]];
+        sm->tx_batch = tx;
+        Sm_HandlePdu(sm, &views[order[i]]);
+        sm->tx_batch = NULL;
+    }
+
+    return ret;
+}
+
+StdRet_t SafeCom_ReceiveSpduBatch_Impl(const SafeCom* const self, const SafeComSpdu* const pSpdus, const uint32_t count) {
+    assert(self != NULL);
+    assert(pSpdus != NULL);
+    /* Implementation specific to SafeCom_ReceiveSpduBatch */
+    StdRet_t ret = OK;
+    SmTxBatch tx;
+
+    /* Responses of the whole batch go to the transport together */
+    Sm_TxBatchInit(&tx);
+
+    for (uint32_t done = 0; done < count; done += SAFECOM_MAX_BATCH) {
+        const uint32_t burst = ((count - done) < SAFECOM_MAX_BATCH) ? (count - done) : SAFECOM_MAX_BATCH;
+        if (receive_burst(self, &pSpdus[done], burst, &tx) != OK) {
+            ret = NOT_OK;
+        }
+    }
+
+    Sm_TxBatchFlush(&tx, &self->vtable);
+
+    return ret;
+}
+
 StdRet_t SafeCom_SendData_Impl(const SafeCom* const self, const MsgId_t msgId, const MsgLen_t msgLen, const uint8_t* const pMsgData) {
     assert(self != NULL);
     assert(pMsgData != NULL);
     /* Implementation specific to SafeCom_SendData */
+    SmType* const sm = connection(self, msgId);
+    if (sm == NULL) {
+        LOG_ERROR("message for unknown connection %u dropped", msgId);
+        return NOT_OK;
+    }
+    if (msgLen > MAX_DATA_LENGTH) {
+        LOG_ERROR("message of %u bytes exceeds the maximum data length", msgLen);
+        return NOT_OK;
+    }
+
     PDU_S pdu = { 0 };
-    Data(&sms[msgId], &pdu, msgLen, pMsgData);
-    Sm_HandleEvent(&sms[msgId], EVENT_SEND_DATA, &pdu);
+    Data(sm, &pdu, msgLen, pMsgData);
+    Sm_HandleEvent(sm, EVENT_SEND_DATA, &pdu);
     return INIT_RET;
 }
 
+StdRet_t SafeCom_SendDataBatch_Impl(const SafeCom* const self, const SafeComMsg* const pMsgs, const uint32_t count) {
+    assert(self != NULL);
+    assert(pMsgs != NULL);
+    /* Implementation specific to SafeCom_SendDataBatch */
+    StdRet_t ret = OK;
+    SmTxBatch tx;
+
+    /* All frames are built in one contiguous arena and handed to the transport together */
+    Sm_TxBatchInit(&tx);
+
+    for (uint32_t i = 0; i < count; i++) {
+        const SafeComMsg* const msg = &pMsgs[i];
+        SmType* const sm = connection(self, msg->msgId);
+
+        if ((msg->pMsgData == NULL) || (sm == NULL) || (msg->msgLen > MAX_DATA_LENGTH)) {
+            LOG_ERROR("message %u of batch for connection %u dropped", i, msg->msgId);
+            ret = NOT_OK;
+            continue;
+        }
+
+        PDU_S pdu = { 0 };
+
+        sm->tx_batch = &tx;
+        Data(sm, &pdu, msg->msgLen, msg->pMsgData);
+        Sm_HandleEvent(sm, EVENT_SEND_DATA, &pdu);
+        sm->tx_batch = NULL;
+    }
+
+    Sm_TxBatchFlush(&tx, &self->vtable);
+
+    return ret;
+}
+
+StdRet_t SafeCom_PostSpdu_Impl(const SafeCom* const self, const NodeId_t nodeId, const SpduLen_t spduLen, const uint8_t* const pSpduData) {
+    assert(self != NULL);
+    assert(pSpduData != NULL);
+    /* Implementation specific to SafeCom_PostSpdu, may be called from any thread */
+    if (self->config.ingress == NULL) {
+        LOG_ERROR("SPDU from node %u posted without an ingress queue", nodeId);
+        return NOT_OK;
+    }
+
+    return ingress_push(self->config.ingress, nodeId, spduLen, pSpduData) ? OK : NOT_OK;
+}
+
+StdRet_t SafeCom_ReleaseSpdu_Impl(const SafeCom* const self, const NodeId_t nodeId, const uint8_t* const pSpduData) {
+    assert(self != NULL);
+    assert(pSpduData != NULL);
+    /* Implementation specific to SafeCom_ReleaseSpdu */
+    SmType* const sm = connection(self, nodeId);
+
+    if (sm == NULL) {
+        LOG_ERROR("release of a frame for unknown node %u", nodeId);
+        return NOT_OK;
+    }
+
+    return Sm_TxRelease(sm, pSpduData);
+}
+
 StdRet_t SafeCom_OpenConnection_Impl(const SafeCom* const self, const MsgId_t msgId) {
     assert(self != NULL);
     /* Implementation specific to SafeCom_OpenConnection */
-    
+    SmType* const sm = connection(self, msgId);
+    if (sm == NULL) {
+        LOG_ERROR("open of unknown connection %u", msgId);
+        return NOT_OK;
+    }
+
     PDU_S pdu = { 0 };
-    Sm_HandleEvent(&sms[msgId], EVENT_OPEN_CONN, &pdu);
+    Sm_HandleEvent(sm, EVENT_OPEN_CONN, &pdu);
     return INIT_RET;
 }
 
 StdRet_t SafeCom_CloseConnection_Impl(const SafeCom* const self, const MsgId_t msgId) {
     assert(self != NULL);
     /* Implementation specific to SafeCom_CloseConnection */
+    SmType* const sm = connection(self, msgId);
+    if (sm == NULL) {
+        LOG_ERROR("close of unknown connection %u", msgId);
+        return NOT_OK;
+    }
 
     PDU_S pdu = { 0 };
-    Sm_HandleEvent(&sms[msgId], EVENT_CLOSE_CONN, &pdu);
+    Sm_HandleEvent(sm, EVENT_CLOSE_CONN, &pdu);
     return INIT_RET;
 }
 
@@ -0,0 +1,128 @@
+#include <string.h>
+
+#include "safety_code.h"
+#include "assert.h"
+
+/* Initial values of MD4 (RFC 1320), used when no key is configured */
+static const MD4_u32plus md4_standard_iv[SAFETY_CODE_KEY_WORDS] = {
+    0x67452301U, 0xefcdab89U, 0x98badcfeU, 0x10325476U
+};
+
+void safety_code_init(SafetyCode *code, const SafetyCodeConfig *config)
+{
+    assert(code != NULL);
+
+    const SafetyCodeType type = (config != NULL) ? config->type : SAFETY_CODE_LOWER_MD4;
+    bool keyed = false;
+
+    switch (type) {
+        case SAFETY_CODE_NONE:
+            code->length = 0;
+            break;
+        case SAFETY_CODE_FULL_MD4:
+            code->length = MD4_DIGEST_LENGTH;
+            break;
+        case SAFETY_CODE_LOWER_MD4:
+        default:
+            code->length = MD4_DIGEST_LENGTH / 2U;
+            break;
+    }
+
+    if (config != NULL) {
+        for (size_t i = 0; i < SAFETY_CODE_KEY_WORDS; i++) {
+            keyed = keyed || (config->key[i] != 0U);
+        }
+    }
+
+    for (size_t i = 0; i < SAFETY_CODE_KEY_WORDS; i++) {
+        code->iv[i] = keyed ? (MD4_u32plus)config->key[i] : md4_standard_iv[i];
+    }
+}
+
+void safety_code_calculate(const SafetyCode *code, const uint8_t *data, const size_t length, uint8_t *out)
+{
+    assert(code != NULL);
+    assert(data != NULL);
+    assert(out != NULL);
+
+    uint8_t digest[MD4_DIGEST_LENGTH];
+
+    if (code->length == 0) {
+        return;
+    }
+
+    /* Everything but long Data PDUs is hashed in a single MD4 compression */
+    if (length <= MD4_ONEBLOCK_MAX_LENGTH) {
+        md4_oneblock(digest, code->iv, data, length);
+    } else {
+        MD4_CTX ctx;
+
+        MD4_InitIV(&ctx, code->iv);
+        MD4_Update(&ctx, data, length);
+        MD4_Final(digest, &ctx);
+    }
+
+    memcpy(out, digest, code->length);
+}
+
+void safety_code_calculate_split(const SafetyCode *code, const uint8_t *head, const size_t head_length,
+                                 const uint8_t *tail, const size_t tail_length, uint8_t *out)
+{
+    assert(code != NULL);
+    assert(head != NULL);
+    assert((tail != NULL) || (tail_length == 0));
+    assert(out != NULL);
+
+    uint8_t digest[MD4_DIGEST_LENGTH];
+
+    if (code->length == 0) {
+        return;
+    }
+
+    if ((head_length + tail_length) <= MD4_ONEBLOCK_MAX_LENGTH) {
+        uint8_t block[MD4_ONEBLOCK_MAX_LENGTH];
+
+        memcpy(block, head, head_length);
+        if (tail_length > 0) {
+            memcpy(&block[head_length], tail, tail_length);
+        }
+        md4_oneblock(digest, code->iv, block, head_length + tail_length);
+    } else {
+        MD4_CTX ctx;
+
+        MD4_InitIV(&ctx, code->iv);
+        MD4_Update(&ctx, head, head_length);
+        if (tail_length > 0) {
+            MD4_Update(&ctx, tail, tail_length);
+        }
+        MD4_Final(digest, &ctx);
+    }
+
+    memcpy(out, digest, code->length);
+}
+
+bool safety_code_equal(const uint8_t *received, const uint8_t *calculated, const size_t length)
+{
+    assert(received != NULL);
+    assert(calculated != NULL);
+
+    /* Accumulate all differences instead of returning at the first one */
+    uint8_t diff = 0;
+
+    for (size_t i = 0; i < length; i++) {
+        diff |= (uint8_t)(received[i] ^ calculated[i]);
+    }
+
+    return diff == 0;
+}
+
+bool safety_code_verify(const SafetyCode *code, const uint8_t *data, const size_t length, const uint8_t *received)
+{
+    assert(code != NULL);
+
+    uint8_t calculated[SAFETY_CODE_MAX_LENGTH];
+
+    safety_code_calculate(code, data, length, calculated);
+
+    return safety_code_equal(received, calculated, code->length);
+}
@@ -0,0 +1,272 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <sched.h>
+#include "shard.h"
+#include "assert.h"
+#include "log.h"
+
+/* Index of the worker owning a node or message id, SHARD_MAX_WORKERS if there is none */
+static uint32_t owner(const ShardEngine* const self, const NodeId_t nodeId)
+{
+    const uint32_t index = nodeId - self->first_node;
+
+    return (index < self->connections) ? (index / self->per_shard) : SHARD_MAX_WORKERS;
+}
+
+/* Only the producer thread of the ring writes head, only the worker writes tail */
+static StdRet_t post(ShardEngine* const self, const uint32_t producer, const ShardRequest request,
+                     const NodeId_t nodeId, const uint32_t len, const uint8_t* const pData)
+{
+    const uint32_t worker = owner(self, nodeId);
+
+    if ((producer >= self->producers) || (worker == SHARD_MAX_WORKERS) || (len > MAX_BUFF_SIZE)) {
+        LOG_ERROR("request %u for node %u from producer %u dropped", request, nodeId, producer);
+        return NOT_OK;
+    }
+
+    ShardRing* const ring = &self->shards[worker].rings[producer];
+    const uint32_t head = ring->head;
+
+    if ((head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE)) == SHARD_RING_SIZE) {
+        __atomic_store_n(&ring->full, ring->full + 1U, __ATOMIC_RELAXED);
+        return NOT_OK;
+    }
+
+    ShardEntry* const entry = &ring->entries[head & (SHARD_RING_SIZE - 1U)];
+    entry->request = request;
+    entry->nodeId = nodeId;
+    entry->len = len;
+    if (len > 0U) {
+        memcpy(entry->data, pData, len);
+    }
+    __atomic_store_n(&ring->head, head + 1U, __ATOMIC_RELEASE);
+
+    return OK;
+}
+
+static void handle(const SafeCom* const instance, const ShardEntry* const entry)
+{
+    switch (entry->request) {
+        case SHARD_SEND_DATA:
+            SafeCom_SendData(instance, entry->nodeId, entry->len, entry->data);
+            break;
+        case SHARD_OPEN_CONN:
+            SafeCom_OpenConnection(instance, entry->nodeId);
+            break;
+        case SHARD_CLOSE_CONN:
+            SafeCom_CloseConnection(instance, entry->nodeId);
+            break;
+        default:
+            SafeCom_ReceiveSpdu(instance, entry->nodeId, entry->len, entry->data);
+            break;
+    }
+}
+
+/* Drain one ring; SPDUs in a row go through the batch path straight from the ring entries */
+static uint32_t drain(const SafeCom* const instance, ShardRing* const ring)
+{
+    const uint32_t tail = ring->tail;
+    const uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    SafeComSpdu burst[SAFECOM_MAX_BATCH];
+    uint32_t count = 0;
+
+    for (uint32_t pos = tail; pos != head; pos++) {
+        const ShardEntry* const entry = &ring->entries[pos & (SHARD_RING_SIZE - 1U)];
+
+        if (entry->request == SHARD_RECEIVE_SPDU) {
+            burst[count].nodeId = entry->nodeId;
+            burst[count].spduLen = entry->len;
+            burst[count].pSpduData = entry->data;
+            count++;
+            if (count < SAFECOM_MAX_BATCH) {
+                continue;
+            }
+        }
+        if (count > 0U) {
+            SafeCom_ReceiveSpduBatch(instance, burst, count);
+            count = 0;
+        }
+        if (entry->request != SHARD_RECEIVE_SPDU) {
+            handle(instance, entry);
+        }
+    }
+    if (count > 0U) {
+        SafeCom_ReceiveSpduBatch(instance, burst, count);
+    }
+
+    /* The entries are only handed back once the state machines are done with them */
+    __atomic_store_n(&ring->tail, head, __ATOMIC_RELEASE);
+
+    return head - tail;
+}
+
+static void* worker_main(void* arg)
+{
+    Shard* const shard = (Shard*)arg;
+    ShardEngine* const engine = shard->engine;
+    const uint32_t worker = (uint32_t)(shard - engine->shards);
+
+    while (__atomic_load_n(&engine->running, __ATOMIC_ACQUIRE) != 0U) {
+        if (Shard_Poll(engine, worker) == 0U) {
+            sched_yield();
+        }
+        SafeCom_Main(&shard->instance);
+    }
+
+    /* Whatever was posted before the stop is still handled */
+    while (Shard_Poll(engine, worker) > 0U) {
+    }
+
+    return NULL;
+}
+
+StdRet_t Shard_Init(ShardEngine* const self, const SafeComType* const pConfig, const uint32_t workers, const uint32_t producers)
+{
+    assert(self != NULL);
+    assert(pConfig != NULL);
+    assert((pConfig->config.sms != NULL) || (pConfig->config.max_connections == 0U));
+
+    if ((workers == 0U) || (workers > SHARD_MAX_WORKERS) || (producers == 0U) || (producers > SHARD_MAX_PRODUCERS)) {
+        LOG_ERROR("%u workers and %u producers are not supported", workers, producers);
+        return NOT_OK;
+    }
+    if (pConfig->config.ingress != NULL) {
+        /* A single-consumer queue cannot be drained by every worker; SPDUs come in through Shard_ReceiveSpdu */
+        LOG_ERROR("an ingress queue is not supported by the sharded engine");
+        return NOT_OK;
+    }
+
+    const MsgId_t connections = pConfig->config.max_connections;
+
+    memset(self, 0, sizeof(*self));
+    self->workers = workers;
+    self->producers = producers;
+    self->first_node = pConfig->config.first_node;
+    self->connections = connections;
+    self->per_shard = (connections + workers - 1U) / workers;
+    if (self->per_shard == 0U) {
+        self->per_shard = 1U;
+    }
+
+    StdRet_t ret = OK;
+
+    for (uint32_t k = 0; k < workers; k++) {
+        const MsgId_t first = k * self->per_shard;
+        const MsgId_t count = (first < connections) ? (((connections - first) < self->per_shard) ? (connections - first) : self->per_shard) : 0U;
+        SafeComType config = *pConfig;
+
+        /* Trailing workers may own no connection; their slices stay NULL rather than point past the arrays */
+        config.config.first_node = self->first_node + first;
+        config.config.max_connections = count;
+        config.config.sms = (count > 0U) ? &pConfig->config.sms[first] : NULL;
+        config.config.safety_codes = ((count > 0U) && (pConfig->config.safety_codes != NULL)) ? &pConfig->config.safety_codes[first] : NULL;
+        config.config.peers = ((count > 0U) && (pConfig->config.peers != NULL)) ? &pConfig->config.peers[first] : NULL;
+        config.config.demux = NULL; /* Workers are picked by node id, which then addresses the connection */
+
+        self->shards[k].engine = self;
+        if (SafeCom_Init(&self->shards[k].instance, &config) != OK) {
+            ret = NOT_OK;
+        }
+    }
+
+    return ret;
+}
+
+StdRet_t Shard_Start(ShardEngine* const self)
+{
+    assert(self != NULL);
+
+    __atomic_store_n(&self->running, 1U, __ATOMIC_RELEASE);
+
+    for (uint32_t k = 0; k < self->workers; k++) {
+        if (pthread_create(&self->shards[k].thread, NULL, worker_main, &self->shards[k]) != 0) {
+            LOG_ERROR("worker %u could not be started", k);
+            self->workers = k;
+            Shard_Stop(self);
+            return NOT_OK;
+        }
+    }
+
+    return OK;
+}
+
+StdRet_t Shard_Stop(ShardEngine* const self)
+{
+    assert(self != NULL);
+
+    StdRet_t ret = OK;
+
+    __atomic_store_n(&self->running, 0U, __ATOMIC_RELEASE);
+
+    for (uint32_t k = 0; k < self->workers; k++) {
+        if (pthread_join(self->shards[k].thread, NULL) != 0) {
+            ret = NOT_OK;
+        }
+    }
+
+    return ret;
+}
+
+uint32_t Shard_Poll(ShardEngine* const self, const uint32_t worker)
+{
+    assert(self != NULL);
+    assert(worker < self->workers);
+
+    Shard* const shard = &self->shards[worker];
+    uint32_t handled = 0;
+
+    for (uint32_t p = 0; p < self->producers; p++) {
+        handled += drain(&shard->instance, &shard->rings[p]);
+    }
+    if (handled > 0U) {
+        __atomic_store_n(&shard->processed, shard->processed + handled, __ATOMIC_RELEASE);
+    }
+
+    return handled;
+}
+
+StdRet_t Shard_ReceiveSpdu(ShardEngine* const self, const uint32_t producer, const NodeId_t nodeId, const SpduLen_t spduLen, const uint8_t* const pSpduData)
+{
+    assert(self != NULL);
+    assert(pSpduData != NULL);
+    return post(self, producer, SHARD_RECEIVE_SPDU, nodeId, spduLen, pSpduData);
+}
+
+StdRet_t Shard_SendData(ShardEngine* const self, const uint32_t producer, const MsgId_t msgId, const MsgLen_t msgLen, const uint8_t* const pMsgData)
+{
+    assert(self != NULL);
+    assert(pMsgData != NULL);
+
+    if (msgLen > MAX_DATA_LENGTH) {
+        LOG_ERROR("message of %u bytes exceeds the maximum data length", msgLen);
+        return NOT_OK;
+    }
+
+    return post(self, producer, SHARD_SEND_DATA, msgId, msgLen, pMsgData);
+}
+
+StdRet_t Shard_OpenConnection(ShardEngine* const self, const uint32_t producer, const MsgId_t msgId)
+{
+    assert(self != NULL);
+    return post(self, producer, SHARD_OPEN_CONN, msgId, 0U, NULL);
+}
+
+StdRet_t Shard_CloseConnection(ShardEngine* const self, const uint32_t producer, const MsgId_t msgId)
+{
+    assert(self != NULL);
+    return post(self, producer, SHARD_CLOSE_CONN, msgId, 0U, NULL);
+}
+
+uint32_t Shard_Overflows(const ShardEngine* const self, const uint32_t worker)
+{
+    assert(self != NULL);
+    assert(worker < self->workers);
+
+    uint32_t full = 0;
+
+    for (uint32_t p = 0; p < self->producers; p++) {
+        full += __atomic_load_n(&self->shards[worker].rings[p].full, __ATOMIC_RELAXED);
+    }
+
+    return full;
+}
@@ -27,7 +27,8 @@ StdRet_t Sic_Init(SafeComConfig* const pConfig) {
         },
         .config = SicConfig
     };
-    return (initialized==true) ? NOT_OK : (initialized=true, SafeCom_Init(&SicInstance, &config) );
+
+    return (initialized==true) ? NOT_OK : (initialized=true, SafeCom_Init(&SicInstance, &config));
 }
 
 StdRet_t Sic_Main(void) {
@@ -39,11 +40,31 @@ StdRet_t Sic_ReceiveSpdu(const NodeId_t nodeId, const SpduLen_t spduLen, const u
     return SafeCom_ReceiveSpdu(&SicInstance, nodeId, spduLen, pSpduData);
 }
 
+StdRet_t Sic_ReceiveSpduBatch(const SafeComSpdu* const pSpdus, const uint32_t count) {
+    assert(pSpdus != NULL);
+    return SafeCom_ReceiveSpduBatch(&SicInstance, pSpdus, count);
+}
+
 StdRet_t Sic_SendData(const MsgId_t msgId, const MsgLen_t msgLen, const uint8_t* const pMsgData) {
     assert(pMsgData != NULL);
     return SafeCom_SendData(&SicInstance, msgId, msgLen, pMsgData);
 }
 
+StdRet_t Sic_SendDataBatch(const SafeComMsg* const pMsgs, const uint32_t count) {
+    assert(pMsgs != NULL);
+    return SafeCom_SendDataBatch(&SicInstance, pMsgs, count);
+}
+
+StdRet_t Sic_PostSpdu(const NodeId_t nodeId, const SpduLen_t spduLen, const uint8_t* const pSpduData) {
+    assert(pSpduData != NULL);
+    return SafeCom_PostSpdu(&SicInstance, nodeId, spduLen, pSpduData);
+}
+
+StdRet_t Sic_ReleaseSpdu(const NodeId_t nodeId, const uint8_t* const pSpduData) {
+    assert(pSpduData != NULL);
+    return SafeCom_ReleaseSpdu(&SicInstance, nodeId, pSpduData);
+}
+
 StdRet_t Sic_OpenConnection(const MsgId_t msgId) {
     return SafeCom_OpenConnection(&SicInstance, msgId);
 }
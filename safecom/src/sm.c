@@ -3,29 +3,190 @@
 #include "log.h"
 #include "rass.h"
 
-static uint8_t buff_to_send[MAX_BUFF_SIZE] = {0};
+#define STATE_COUNT (STATE_RETR_RUN + 1U)
+#define EVENT_COUNT (EVENT_RECV_RETR_DATA + 1U)
+
+/* The hot fields of a connection end within its first cache line */
+typedef char sm_hot_fields_fit[(offsetof(SmType, channel) <= SM_CACHE_LINE) ? 1 : -1];
+
+/* Checks made before a transition is taken, each yields one of the verdicts below */
+typedef enum {
+    GUARD_IGNORE = 0U,      /* The event has no effect in this state */
+    GUARD_ALWAYS,           /* No check */
+    GUARD_CLIENT,           /* The connection is a client */
+    GUARD_VERSION,          /* Protocol version of a ConnReq/ConnResp */
+    GUARD_CLIENT_VERSION,   /* Client role, then protocol version */
+    GUARD_SEQUENCE,         /* SNinSeq, then CTSinSeq */
+    GUARD_SERVER_SEQUENCE,  /* Server role, then SNinSeq and CTSinSeq */
+    GUARD_RETR_DATA,        /* Unconfirmed payload available, then SNinSeq */
+    GUARD_SN_RETR_DATA      /* SNinSeq, and unconfirmed payload available when not in sequence */
+} Guard;
+
+typedef enum {
+    VERDICT_PASS = 0U,
+    VERDICT_OTHER_ROLE,     /* The connection has the other role */
+    VERDICT_VERSION_ERROR,
+    VERDICT_SN_GAP,         /* Sequence number not the expected one */
+    VERDICT_CTS_ERROR,      /* Confirmed timestamp out of sequence */
+    VERDICT_NO_RETR_DATA,   /* Unconfirmed payload for a retransmission not available */
+    VERDICT_COUNT
+} Verdict;
+
+/* Shared routines a transition runs before the state is changed */
+typedef enum {
+    ACTION_NONE = 0U,
+    ACTION_OPEN_CLIENT,         /* Pick SNT, send ConnReq */
+    ACTION_OPEN_SERVER,         /* Pick SNT */
+    ACTION_ACCEPT_CONN_REQ,     /* Regular receipt, send ConnResp */
+    ACTION_ACCEPT_CONN_RESP,    /* Regular receipt, send HB */
+    ACTION_ACCEPT,              /* Regular receipt */
+    ACTION_ACCEPT_DATA,         /* Regular receipt, deliver the payload */
+    ACTION_RETRANSMIT,          /* Regular receipt of a RetrReq, send RetrResp, RetrData(s) and HB */
+    ACTION_RETRANSMIT_GAP,      /* Take over CSR of a RetrReq out of sequence, send RetrResp, RetrData(s) and HB */
+    ACTION_RETRANSMIT_REQUEST,  /* As ACTION_RETRANSMIT_GAP, then ask for a retransmission with RetrReq */
+    ACTION_SEND,                /* Send the PDU handed with the event */
+    ACTION_SEND_HB,
+    ACTION_SEND_RETR_REQ,
+    ACTION_CLOSE,               /* Close without DiscReq */
+    ACTION_DISC_USER_REQUEST,   /* Close and send DiscReq with the reason of the action */
+    ACTION_DISC_NOT_EXPECTED,
+    ACTION_DISC_SEQ_NBR_ERR,
+    ACTION_DISC_TIMEOUT,
+    ACTION_DISC_NOT_ALLOWED,
+    ACTION_DISC_VERSION_ERROR,
+    ACTION_DISC_FAIL_RETR,
+    ACTION_DISC_SEQ_ERR
+} Action;
+
+typedef struct {
+    uint8_t action;     /* Action */
+    uint8_t next;       /* State */
+} Step;
+
+/* Transition of one state on one event, with the step taken for each verdict of its guard */
+typedef struct {
+    uint8_t guard;      /* Guard */
+    Step steps[VERDICT_COUNT];
+} Transition;
+
+#define ON(verdict, action, next)   [verdict] = { (action), (next) }
+#define ALWAYS(action, next)        { GUARD_ALWAYS, { ON(VERDICT_PASS, action, next) } }
+#define SEQUENCE(pass, next)        { GUARD_SEQUENCE, { ON(VERDICT_PASS, pass, next),                                  \
+                                                        ON(VERDICT_SN_GAP, ACTION_SEND_RETR_REQ, STATE_RETR_REQ),     \
+                                                        ON(VERDICT_CTS_ERROR, ACTION_DISC_SEQ_ERR, STATE_CLOSED) } }
+
+/* All transitions, indexed by state and event. Events left out are ignored in that state. */
+static const Transition transitions[STATE_COUNT][EVENT_COUNT] = {
+    [STATE_CLOSED] = {
+        [EVENT_TI_ELAPSED]      = ALWAYS(ACTION_DISC_TIMEOUT, STATE_CLOSED),
+        [EVENT_OPEN_CONN]       = { GUARD_CLIENT, { ON(VERDICT_PASS, ACTION_OPEN_CLIENT, STATE_START),
+                                                    ON(VERDICT_OTHER_ROLE, ACTION_OPEN_SERVER, STATE_DOWN) } },
+    },
+    [STATE_DOWN] = {
+        [EVENT_TI_ELAPSED]      = ALWAYS(ACTION_DISC_TIMEOUT, STATE_CLOSED),
+        [EVENT_OPEN_CONN]       = ALWAYS(ACTION_CLOSE, STATE_CLOSED),
+        [EVENT_CLOSE_CONN]      = ALWAYS(ACTION_CLOSE, STATE_CLOSED),
+        [EVENT_SEND_DATA]       = ALWAYS(ACTION_CLOSE, STATE_CLOSED),
+        [EVENT_RECV_CONN_REQ]   = { GUARD_VERSION, { ON(VERDICT_PASS, ACTION_ACCEPT_CONN_REQ, STATE_START),
+                                                     ON(VERDICT_VERSION_ERROR, ACTION_DISC_VERSION_ERROR, STATE_CLOSED) } },
+    },
+    [STATE_START] = {
+        [EVENT_TH_ELAPSED]      = ALWAYS(ACTION_SEND_HB, STATE_START),
+        [EVENT_TI_ELAPSED]      = ALWAYS(ACTION_DISC_TIMEOUT, STATE_CLOSED),
+        [EVENT_OPEN_CONN]       = ALWAYS(ACTION_DISC_NOT_ALLOWED, STATE_CLOSED),
+        [EVENT_CLOSE_CONN]      = ALWAYS(ACTION_DISC_USER_REQUEST, STATE_CLOSED),
+        [EVENT_SEND_DATA]       = ALWAYS(ACTION_DISC_NOT_ALLOWED, STATE_CLOSED),
+        [EVENT_RECV_CONN_REQ]   = ALWAYS(ACTION_DISC_NOT_EXPECTED, STATE_CLOSED),
+        [EVENT_RECV_CONN_RESP]  = { GUARD_CLIENT_VERSION, { ON(VERDICT_PASS, ACTION_ACCEPT_CONN_RESP, STATE_UP),
+                                                            ON(VERDICT_OTHER_ROLE, ACTION_DISC_NOT_EXPECTED, STATE_CLOSED),
+                                                            ON(VERDICT_VERSION_ERROR, ACTION_DISC_VERSION_ERROR, STATE_CLOSED) } },
+        [EVENT_RECV_RETR_REQ]   = ALWAYS(ACTION_DISC_NOT_EXPECTED, STATE_CLOSED),
+        [EVENT_RECV_RETR_RESP]  = ALWAYS(ACTION_DISC_NOT_EXPECTED, STATE_CLOSED),
+        [EVENT_RECV_DISC_REQ]   = ALWAYS(ACTION_CLOSE, STATE_CLOSED),
+        [EVENT_RECV_HB]         = { GUARD_SERVER_SEQUENCE, { ON(VERDICT_PASS, ACTION_ACCEPT, STATE_UP),
+                                                             ON(VERDICT_OTHER_ROLE, ACTION_DISC_NOT_EXPECTED, STATE_CLOSED),
+                                                             ON(VERDICT_SN_GAP, ACTION_DISC_SEQ_NBR_ERR, STATE_CLOSED),
+                                                             ON(VERDICT_CTS_ERROR, ACTION_DISC_SEQ_ERR, STATE_CLOSED) } },
+        [EVENT_RECV_DATA]       = ALWAYS(ACTION_DISC_NOT_EXPECTED, STATE_CLOSED),
+        [EVENT_RECV_RETR_DATA]  = ALWAYS(ACTION_DISC_NOT_EXPECTED, STATE_CLOSED),
+    },
+    [STATE_UP] = {
+        [EVENT_TH_ELAPSED]      = ALWAYS(ACTION_SEND_HB, STATE_UP),
+        [EVENT_TI_ELAPSED]      = ALWAYS(ACTION_DISC_TIMEOUT, STATE_CLOSED),
+        [EVENT_OPEN_CONN]       = ALWAYS(ACTION_DISC_NOT_ALLOWED, STATE_CLOSED),
+        [EVENT_CLOSE_CONN]      = ALWAYS(ACTION_DISC_USER_REQUEST, STATE_CLOSED),
+        [EVENT_SEND_DATA]       = ALWAYS(ACTION_SEND, STATE_UP),
+        [EVENT_RECV_CONN_REQ]   = ALWAYS(ACTION_DISC_NOT_EXPECTED, STATE_CLOSED),
+        [EVENT_RECV_CONN_RESP]  = ALWAYS(ACTION_DISC_NOT_EXPECTED, STATE_CLOSED),
+        [EVENT_RECV_RETR_REQ]   = { GUARD_RETR_DATA, { ON(VERDICT_PASS, ACTION_RETRANSMIT, STATE_UP),
+                                                       ON(VERDICT_SN_GAP, ACTION_RETRANSMIT_REQUEST, STATE_RETR_REQ),
+                                                       ON(VERDICT_NO_RETR_DATA, ACTION_DISC_FAIL_RETR, STATE_CLOSED) } },
+        [EVENT_RECV_RETR_RESP]  = ALWAYS(ACTION_DISC_NOT_EXPECTED, STATE_CLOSED),
+        [EVENT_RECV_DISC_REQ]   = ALWAYS(ACTION_CLOSE, STATE_CLOSED),
+        [EVENT_RECV_HB]         = SEQUENCE(ACTION_ACCEPT, STATE_UP),
+        [EVENT_RECV_DATA]       = SEQUENCE(ACTION_ACCEPT_DATA, STATE_UP),
+        [EVENT_RECV_RETR_DATA]  = ALWAYS(ACTION_DISC_NOT_EXPECTED, STATE_CLOSED),
+    },
+    [STATE_RETR_REQ] = {
+        [EVENT_TH_ELAPSED]      = ALWAYS(ACTION_SEND_HB, STATE_RETR_REQ),
+        [EVENT_TI_ELAPSED]      = ALWAYS(ACTION_DISC_TIMEOUT, STATE_CLOSED),
+        [EVENT_OPEN_CONN]       = ALWAYS(ACTION_DISC_NOT_ALLOWED, STATE_CLOSED),
+        [EVENT_CLOSE_CONN]      = ALWAYS(ACTION_DISC_USER_REQUEST, STATE_CLOSED),
+        [EVENT_SEND_DATA]       = ALWAYS(ACTION_SEND, STATE_RETR_REQ),
+        [EVENT_RECV_CONN_REQ]   = ALWAYS(ACTION_DISC_NOT_EXPECTED, STATE_CLOSED),
+        [EVENT_RECV_CONN_RESP]  = ALWAYS(ACTION_DISC_NOT_EXPECTED, STATE_CLOSED),
+        [EVENT_RECV_RETR_REQ]   = { GUARD_RETR_DATA, { ON(VERDICT_PASS, ACTION_RETRANSMIT, STATE_RETR_REQ),
+                                                       ON(VERDICT_SN_GAP, ACTION_RETRANSMIT_GAP, STATE_RETR_REQ),
+                                                       ON(VERDICT_NO_RETR_DATA, ACTION_DISC_FAIL_RETR, STATE_CLOSED) } },
+        [EVENT_RECV_RETR_RESP]  = ALWAYS(ACTION_ACCEPT, STATE_RETR_RUN),  /* The RetrData(s) follow in sequence */
+        [EVENT_RECV_DISC_REQ]   = ALWAYS(ACTION_CLOSE, STATE_CLOSED),
+    },
+    [STATE_RETR_RUN] = {
+        [EVENT_TH_ELAPSED]      = ALWAYS(ACTION_SEND_HB, STATE_RETR_RUN),
+        [EVENT_TI_ELAPSED]      = ALWAYS(ACTION_DISC_TIMEOUT, STATE_CLOSED),
+        [EVENT_OPEN_CONN]       = ALWAYS(ACTION_DISC_NOT_ALLOWED, STATE_CLOSED),
+        [EVENT_CLOSE_CONN]      = ALWAYS(ACTION_DISC_USER_REQUEST, STATE_CLOSED),
+        [EVENT_SEND_DATA]       = ALWAYS(ACTION_SEND, STATE_RETR_RUN),
+        [EVENT_RECV_CONN_REQ]   = ALWAYS(ACTION_DISC_NOT_EXPECTED, STATE_CLOSED),
+        [EVENT_RECV_CONN_RESP]  = ALWAYS(ACTION_DISC_NOT_EXPECTED, STATE_CLOSED),
+        [EVENT_RECV_RETR_REQ]   = { GUARD_SN_RETR_DATA, { ON(VERDICT_PASS, ACTION_DISC_NOT_EXPECTED, STATE_CLOSED),
+                                                          ON(VERDICT_SN_GAP, ACTION_RETRANSMIT_REQUEST, STATE_RETR_REQ),
+                                                          ON(VERDICT_NO_RETR_DATA, ACTION_DISC_FAIL_RETR, STATE_CLOSED) } },
+        [EVENT_RECV_RETR_RESP]  = ALWAYS(ACTION_DISC_NOT_EXPECTED, STATE_CLOSED),
+        [EVENT_RECV_DISC_REQ]   = ALWAYS(ACTION_CLOSE, STATE_CLOSED),
+        [EVENT_RECV_HB]         = SEQUENCE(ACTION_ACCEPT, STATE_UP),
+        [EVENT_RECV_DATA]       = SEQUENCE(ACTION_ACCEPT_DATA, STATE_UP),
+        [EVENT_RECV_RETR_DATA]  = SEQUENCE(ACTION_ACCEPT_DATA, STATE_RETR_RUN),
+    },
+};
 
 /* Private function prototypes */
 static void set_initial_values(SmType *self);
-static void close_connection(SmType *self, const PDU_S *pdu);
-static void process_regular_receipt(SmType *self, const PDU_S *pdu);
-static void handle_closed(SmType *self, const Event event, PDU_S *pdu);
-static void handle_down(SmType *self, const Event event, PDU_S *pdu);
-static void handle_start(SmType *self, const Event event, PDU_S *pdu);
-static void handle_up(SmType *self, const Event event, PDU_S *pdu);
-static void handle_retr_req(SmType *self, const Event event, PDU_S *pdu);
-static void handle_retr_run(SmType *self, const Event event, PDU_S *pdu);
-static bool check_seq_confirmed_timestamp(SmType *self, const PDU_S *pdu);
-static bool check_version(const PDU_S *pdu);
-
-static bool check_seq_confirmed_timestamp(SmType *self, const PDU_S *pdu)
+static Event event_from_type(const MessageType type);
+static void deliver_data(SmType *self, const PDU_View *rx);
+static SmTxFrame *tx_acquire(SmType *self);
+static void tx_release(SmTxFrame *frame);
+static void send_pdu(SmType *self, const PDU_S *pdu);
+static void close_connection(SmType *self, const PDU_View *rx);
+static void process_regular_receipt(SmType *self, const PDU_View *rx);
+static void retr_reset(SmType *self);
+static void retr_store(SmType *self, const PDU_S *pdu);
+static void retr_trim(SmType *self);
+static void retransmit(SmType *self, PDU_S *pdu);
+static Verdict evaluate_guard(SmType *self, const Guard guard, const PDU_View *rx);
+static void run_action(SmType *self, const Action action, const PDU_View *rx, PDU_S *pdu);
+static bool check_seq_confirmed_timestamp(SmType *self, const PDU_View *rx);
+static bool check_version(const PDU_View *rx);
+
+static bool check_seq_confirmed_timestamp(SmType *self, const PDU_View *rx)
 {
     assert(self != NULL);
-    assert(pdu != NULL);
+    assert(rx != NULL);
 
     bool ret = false;
+    const uint32_t confirmed_timestamp = pdu_view_confirmed_timestamp(rx);
 
-    if(((pdu->confirmed_timestamp - self->ctsr) >= 0) && ((pdu->confirmed_timestamp - self->ctsr) < self->time.timeouts.Tmax))
+    if(((confirmed_timestamp - self->ctsr) >= 0) && ((confirmed_timestamp - self->ctsr) < self->shared->timeouts.Tmax))
     {
         ret=true;
     }
@@ -37,16 +198,18 @@ static bool check_seq_confirmed_timestamp(SmType *self, const PDU_S *pdu)
     return ret;
 }
 
-static bool check_version(const PDU_S *pdu)
+static bool check_version(const PDU_View *rx)
 {
-    assert(pdu->payload != NULL);
+    assert(rx != NULL);
 
     bool ret = false;
+    const uint8_t *payload = pdu_view_payload(rx);
     
-    if ((pdu->payload[0] == ((PROTOCOL_VERSION >> SHIFT_3_BYTES) & 0xFF)) &&
-        (pdu->payload[1] == ((PROTOCOL_VERSION >> SHIFT_2_BYTES) & 0xFF)) &&
-        (pdu->payload[2] == ((PROTOCOL_VERSION >> SHIFT_1_BYTES) & 0xFF)) &&
-        (pdu->payload[3] == (PROTOCOL_VERSION & 0xFF)))
+    if ((pdu_view_payload_length(rx) >= CONN_REQ_PAYLOAD_LENGTH) &&
+        (payload[0] == ((PROTOCOL_VERSION >> SHIFT_3_BYTES) & 0xFF)) &&
+        (payload[1] == ((PROTOCOL_VERSION >> SHIFT_2_BYTES) & 0xFF)) &&
+        (payload[2] == ((PROTOCOL_VERSION >> SHIFT_1_BYTES) & 0xFF)) &&
+        (payload[3] == (PROTOCOL_VERSION & 0xFF)))
     {
         ret =  true;
     }
@@ -58,13 +221,184 @@ static bool check_version(const PDU_S *pdu)
     return ret;
 }
 
-static bool unconfirmed_payload_available()
+/* All Data PDUs after the sequence number the RetrReq confirms are still kept for retransmission */
+static bool unconfirmed_payload_available(const SmType *self, const PDU_View *rx)
 {
-    /* TODO: RTR - all unconfirmed payload data available */
-    return false;
+    assert(self != NULL);
+    assert(rx != NULL);
+
+    const uint32_t confirmed = pdu_view_confirmed_sequence_number(rx);
+
+    return ((int32_t)(confirmed - self->retr.released) >= 0) && ((int32_t)((uint32_t)self->snt - confirmed) >= 0);
 }
 
 /* Private functions */
+static Event event_from_type(const MessageType type)
+{
+    Event event = EVENT_RECV_DATA;
+
+    /* The type was validated when the view was initialized */
+    switch (type) {
+        case CONNECTION_REQUEST:        event = EVENT_RECV_CONN_REQ; break;
+        case CONNECTION_RESPONSE:       event = EVENT_RECV_CONN_RESP; break;
+        case RETRANSMISSION_REQUEST:    event = EVENT_RECV_RETR_REQ; break;
+        case RETRANSMISSION_RESPONSE:   event = EVENT_RECV_RETR_RESP; break;
+        case DISCONNECTION_REQUEST:     event = EVENT_RECV_DISC_REQ; break;
+        case HEARTBEAT:                 event = EVENT_RECV_HB; break;
+        case DATA:                      event = EVENT_RECV_DATA; break;
+        case RETRANSMITTED_DATA:        event = EVENT_RECV_RETR_DATA; break;
+        default:                        assert(0); break;
+    }
+
+    return event;
+}
+
+/* Hand the payload of an accepted Data PDU to the application, straight from the received frame */
+static void deliver_data(SmType *self, const PDU_View *rx)
+{
+    assert(self != NULL);
+    assert(rx != NULL);
+
+    self->shared->vtable->ReceiveMsg(self->channel, pdu_view_payload_length(rx), pdu_view_payload(rx));
+}
+
+/* Hand a PDU to the transport as header, payload and safety code without copying the payload */
+static void send_pdu_segments(SmType *self, const PDU_S *pdu)
+{
+    uint8_t header[PDU_HEADER_LENGTH];
+    uint8_t code[SAFETY_CODE_MAX_LENGTH];
+    SafeComSegment segments[SAFECOM_SPDU_SEGMENTS];
+    uint32_t count = 0;
+
+    const size_t length = encode_pdu_segments(pdu, &self->safety_code, header, code);
+    if (length == 0)
+    {
+        LOG_ERROR("connection: %i, PDU of type %i is malformed", self->channel, pdu->message_type);
+        return;
+    }
+
+    const size_t payload_length = length - PDU_HEADER_LENGTH - self->safety_code.length;
+
+    segments[count].pData = header;
+    segments[count].len = PDU_HEADER_LENGTH;
+    count++;
+    if (payload_length > 0)
+    {
+        segments[count].pData = pdu->payload;
+        segments[count].len = (SpduLen_t)payload_length;
+        count++;
+    }
+    if (self->safety_code.length > 0)
+    {
+        segments[count].pData = code;
+        segments[count].len = self->safety_code.length;
+        count++;
+    }
+
+    self->shared->vtable->SendSpduV(self->channel, segments, count);
+}
+
+/* Only the thread driving the state machine acquires frames, so a free frame cannot be taken concurrently */
+static SmTxFrame *tx_acquire(SmType *self)
+{
+    for (uint32_t i = 0; i < SM_TX_FRAMES; i++)
+    {
+        SmTxFrame *frame = &self->tx_frames[i];
+        if (__atomic_load_n(&frame->busy, __ATOMIC_ACQUIRE) == 0U)
+        {
+            __atomic_store_n(&frame->busy, 1U, __ATOMIC_RELAXED);
+            return frame;
+        }
+    }
+
+    return NULL;
+}
+
+static void tx_release(SmTxFrame *frame)
+{
+    __atomic_store_n(&frame->busy, 0U, __ATOMIC_RELEASE);
+}
+
+static void send_pdu(SmType *self, const PDU_S *pdu)
+{
+    assert(self != NULL);
+    assert(pdu != NULL);
+
+    if ((pdu->message_type == DATA) || (pdu->message_type == RETRANSMITTED_DATA))
+    {
+        retr_store(self, pdu);
+    }
+    self->tx_time = self->shared->Tlocal();
+
+    /* Single PDUs go out in segments when the transport takes them, batches stay contiguous */
+    if ((self->tx_batch == NULL) && (self->shared->vtable->SendSpduV != NULL))
+    {
+        send_pdu_segments(self, pdu);
+        return;
+    }
+
+    SmTxBatch *batch = self->tx_batch;
+    SmTxFrame *tx_frame = NULL;
+    uint8_t *frame = NULL;
+    size_t frame_size = MAX_BUFF_SIZE;
+
+    if (batch == NULL)
+    {
+        tx_frame = tx_acquire(self);
+        if (tx_frame == NULL)
+        {
+            self->tx_dropped++;
+            LOG_ERROR("connection: %i, all transmit frames held by the transport, PDU of type %i dropped", self->channel, pdu->message_type);
+            return;
+        }
+        frame = tx_frame->data;
+    }
+    else
+    {
+        /* A batch that outgrows its arena is handed to the transport early */
+        if ((batch->count == SAFECOM_MAX_BATCH) || ((sizeof(batch->arena) - batch->used) < MAX_BUFF_SIZE))
+        {
+            Sm_TxBatchFlush(batch, self->shared->vtable);
+        }
+        frame = &batch->arena[batch->used];
+    }
+
+    /* Header, payload and safety code are written once, straight into the frame that is sent.
+       Frames of a batch get their safety codes together when the batch is flushed. */
+    const size_t length = (batch != NULL) ? write_pdu(pdu, &self->safety_code, frame, frame_size) :
+                                            encode_pdu(pdu, &self->safety_code, frame, frame_size);
+    if (length == 0)
+    {
+        LOG_ERROR("connection: %i, PDU of type %i does not fit in the transmit frame", self->channel, pdu->message_type);
+    }
+    else if (batch != NULL)
+    {
+        batch->spdus[batch->count].nodeId = self->channel;
+        batch->spdus[batch->count].spduLen = (SpduLen_t)length;
+        batch->spdus[batch->count].pSpduData = frame;
+        batch->codes[batch->count] = &self->safety_code;
+        batch->count++;
+        batch->used += length;
+    }
+    else if (self->shared->vtable->SendSpduAsync != NULL)
+    {
+        /* The transport owns the frame until it releases it, unless it refuses to take it */
+        if (self->shared->vtable->SendSpduAsync(self->channel, (SpduLen_t)length, frame) == OK)
+        {
+            return;
+        }
+    }
+    else
+    {
+        self->shared->vtable->SendSpdu(self->channel, (SpduLen_t)length, frame);
+    }
+
+    if (tx_frame != NULL)
+    {
+        tx_release(tx_frame);
+    }
+}
+
 static void set_initial_values(SmType *self)
 {
     assert(self != NULL);
@@ -77,638 +411,312 @@ static void set_initial_values(SmType *self)
     self->ctsr = 0;
 }
 
-static void close_connection(SmType *self, const PDU_S *pdu)
+static void close_connection(SmType *self, const PDU_View *rx)
 {
     assert(self != NULL);
-    self->cst = pdu->sequence_number;
-    self->state = STATE_CLOSED;
-    self->handle_event = handle_closed;
+
+    /* Events that were not triggered by a received PDU carry no sequence number to confirm */
+    self->cst = (rx != NULL) ? pdu_view_sequence_number(rx) : 0;
 }
 
-static void process_regular_receipt(SmType *self, const PDU_S *pdu)
+static void process_regular_receipt(SmType *self, const PDU_View *rx)
 {
     assert(self != NULL);
-    assert(pdu != NULL);
+    assert(rx != NULL);
 
-    self->snr = pdu->sequence_number + 1;
-    self->cst = pdu->sequence_number;
-    self->csr = pdu->confirmed_sequence_number;
-    self->tsr = pdu->timestamp;
-    self->ctsr = pdu->confirmed_timestamp;
+    const uint32_t sequence_number = pdu_view_sequence_number(rx);
+
+    self->snr = sequence_number + 1;
+    self->cst = sequence_number;
+    self->csr = pdu_view_confirmed_sequence_number(rx);
+    self->tsr = pdu_view_timestamp(rx);
+    self->ctsr = pdu_view_confirmed_timestamp(rx);
+    retr_trim(self);
 }
 
-/* Generates pseudo-random number between 0 and 100 */
-int snt_rand_value()
+/* Forget all retransmission entries, SNT is where the new connection starts counting */
+static void retr_reset(SmType *self)
 {
-    static unsigned int seed = 12345;
-    seed = (seed * 1103515245 + 12345) % 101;
+    assert(self != NULL);
 
-    return seed;
+    self->retr.head = 0;
+    self->retr.count = 0;
+    self->retr.released = (uint32_t)self->snt;
 }
 
-static void handle_closed(SmType *self, const Event event, PDU_S *pdu)
+static void retr_store(SmType *self, const PDU_S *pdu)
 {
     assert(self != NULL);
+    assert(pdu != NULL);
 
-    switch (event) {
-        case EVENT_OPEN_CONN:
-            if(self->role == ROLE_SERVER)
-            {
-                self->snt = snt_rand_value(); /* Random value for SNT */
-                self->state = STATE_DOWN;
-            }
-            else if(self->role == ROLE_CLIENT)
-            {
-                self->snt = snt_rand_value(); /* Random value for SNT */
-                self->cst = 0;
-                self->ctsr = self->time.Tlocal();
-                self->state = STATE_START;
-
-                /* Send ConnReq */
-                ConnReq(self, pdu);
-                serialize_pdu(pdu, buff_to_send, pdu->message_length);
-                self->vtable->SendSpdu(self->channel, pdu->message_length, buff_to_send);
-            }
-            break;
-        default:
-            /* No action for other events in STATE_CLOSED */
-            break;
+    SmRetrBuffer *retr = &self->retr;
+
+    /* A full buffer gives up its oldest entry, which can then no longer be retransmitted */
+    if (retr->count == RETR_BUFFER_SIZE)
+    {
+        retr->released = pdu_load_uint32(&retr->frames[retr->head][PDU_OFFSET_SEQUENCE_NUMBER]);
+        retr->head = (retr->head + 1U) % RETR_BUFFER_SIZE;
+        retr->count--;
+    }
+
+    const uint32_t tail = (retr->head + retr->count) % RETR_BUFFER_SIZE;
+    const size_t length = write_pdu(pdu, &self->safety_code, retr->frames[tail], sizeof(retr->frames[tail]));
+    if (length == 0)
+    {
+        return;
     }
+
+    retr->lengths[tail] = (uint16_t)(length - self->safety_code.length);
+    retr->count++;
 }
 
-static void handle_down(SmType *self, const Event event, PDU_S *pdu)
+/* Drop the entries the peer has confirmed with CSR */
+static void retr_trim(SmType *self)
 {
     assert(self != NULL);
-    
-    switch (event) {
-        case EVENT_OPEN_CONN:
-        case EVENT_CLOSE_CONN:
-        case EVENT_SEND_DATA:
-            close_connection(self, pdu);
-            break;
 
-        case EVENT_RECV_CONN_REQ:
-            if (check_version(pdu)) 
-            {
-                process_regular_receipt(self, pdu);
-                self->csr = self->snt - 1;
-                self->ctsr = self->time.Tlocal();
-                self->state = STATE_START;
-
-                self->time.Trtd = self->time.Tlocal() - self->ctsr;
-                self->time.Ti = self->time.timeouts.Tmax - self->time.Trtd;
-
-                /* Send ConnResp */
-                ConnResp(self, pdu);
-                serialize_pdu(pdu, buff_to_send, pdu->message_length);
-                self->vtable->SendSpdu(self->channel, pdu->message_length, buff_to_send);
-            }
-            else
-            {
-                close_connection(self, pdu);
+    SmRetrBuffer *retr = &self->retr;
 
-                /* Send DiscReq(6) */
-                DiscReq(self, pdu, PROTOCOL_VERSION_ERROR, NO_DETAILED_REASON);
-                serialize_pdu(pdu, buff_to_send, pdu->message_length);
-                self->vtable->SendSpdu(self->channel, pdu->message_length, buff_to_send);
-            }
-            break;
-        default:
-            /* No action for other events in STATE_DOWN */
+    while (retr->count > 0)
+    {
+        const uint32_t sequence_number = pdu_load_uint32(&retr->frames[retr->head][PDU_OFFSET_SEQUENCE_NUMBER]);
+        if ((int32_t)(sequence_number - (uint32_t)self->csr) > 0)
+        {
             break;
+        }
+        retr->released = sequence_number;
+        retr->head = (retr->head + 1U) % RETR_BUFFER_SIZE;
+        retr->count--;
+    }
+    if ((int32_t)((uint32_t)self->csr - retr->released) > 0)
+    {
+        retr->released = (uint32_t)self->csr;
     }
 }
 
-static void handle_start(SmType *self, const Event event, PDU_S *pdu)
+/* Answer a RetrReq: RetrResp, every unconfirmed Data PDU again as RetrData under a new sequence number, then HB.
+   The RetrData(s) take the place of the entries they were built from, so they can be retransmitted in turn. */
+static void retransmit(SmType *self, PDU_S *pdu)
 {
     assert(self != NULL);
+    assert(pdu != NULL);
 
-    switch (event) {
-        case EVENT_OPEN_CONN:
-        case EVENT_SEND_DATA:
-            close_connection(self, pdu);
-
-            /* Send DiscReq(5) */
-            DiscReq(self, pdu, STATE_SERVICE_NOT_ALLOWED, NO_DETAILED_REASON);
-            serialize_pdu(pdu, buff_to_send, pdu->message_length);
-            self->vtable->SendSpdu(self->channel, pdu->message_length, buff_to_send);
-            break;
-
-        case EVENT_RECV_CONN_REQ:
-        case EVENT_RECV_RETR_REQ:
-        case EVENT_RECV_RETR_RESP:
-        case EVENT_RECV_DATA:
-        case EVENT_RECV_RETR_DATA:
-            close_connection(self, pdu);
-
-            /* Send DiscReq(2) */
-            DiscReq(self, pdu, NOT_EXPECTED_RECV_MSG_TYPE, NO_DETAILED_REASON);
-            serialize_pdu(pdu, buff_to_send, pdu->message_length);
-            self->vtable->SendSpdu(self->channel, pdu->message_length, buff_to_send);
-            break;
+    SmRetrBuffer *retr = &self->retr;
+    uint8_t payload[MAX_DATA_LENGTH];
 
-        case EVENT_CLOSE_CONN:
-            close_connection(self, pdu);
+    RetrResp(self, pdu);
+    send_pdu(self, pdu);
 
-            /* Send DiscReq(0) */
-            DiscReq(self, pdu, USER_REQUEST, NO_DETAILED_REASON);
-            serialize_pdu(pdu, buff_to_send, pdu->message_length);
-            self->vtable->SendSpdu(self->channel, pdu->message_length, buff_to_send);
-            break;
+    for (uint32_t pending = retr->count; pending > 0; pending--)
+    {
+        const uint8_t *frame = retr->frames[retr->head];
+        const uint8_t length = (uint8_t)(retr->lengths[retr->head] - PDU_HEADER_LENGTH);
 
+        /* The entry is released before it is sent, a full buffer stores the RetrData in its place */
+        memcpy(payload, &frame[PDU_HEADER_LENGTH], length);
+        retr->released = pdu_load_uint32(&frame[PDU_OFFSET_SEQUENCE_NUMBER]);
+        retr->head = (retr->head + 1U) % RETR_BUFFER_SIZE;
+        retr->count--;
 
-        case EVENT_RECV_CONN_RESP:
-            if (self->role == ROLE_SERVER)
-            {
-                close_connection(self, pdu);
+        RetrData(self, pdu, length, payload);
+        send_pdu(self, pdu);
+    }
 
-                /* Send DiscReq(2) */
-                DiscReq(self, pdu, NOT_EXPECTED_RECV_MSG_TYPE, NO_DETAILED_REASON);
-                serialize_pdu(pdu, buff_to_send, pdu->message_length);
-                self->vtable->SendSpdu(self->channel, pdu->message_length, buff_to_send);
-            }
-            else if (self->role == ROLE_CLIENT)
-            {
-                if (check_version(pdu)) 
-                {
-                    process_regular_receipt(self, pdu);
-                    self->state = STATE_UP;
-
-                    self->time.Trtd = self->time.Tlocal() - self->ctsr;
-                    self->time.Ti = self->time.timeouts.Tmax - self->time.Trtd;
-
-                    /* Send HB */
-                    HB(self, pdu);
-                    serialize_pdu(pdu, buff_to_send, pdu->message_length);
-                    self->vtable->SendSpdu(self->channel, pdu->message_length, buff_to_send);
-                }
-                else
-                {
-                    close_connection(self, pdu);
-
-                    /* Send DiscReq(6) */
-                    DiscReq(self, pdu, PROTOCOL_VERSION_ERROR, NO_DETAILED_REASON);
-                    serialize_pdu(pdu, buff_to_send, pdu->message_length);
-                    self->vtable->SendSpdu(self->channel, pdu->message_length, buff_to_send);
-                }
-            }
-            break;
+    HB(self, pdu);
+    send_pdu(self, pdu);
+}
 
-            case EVENT_RECV_DISC_REQ:
-                close_connection(self, pdu);
-            break;
+/* Generates pseudo-random number between 0 and 100, from a generator of the connection */
+static int snt_rand_value(SmType *self)
+{
+    self->snt_seed = (self->snt_seed * 1103515245U + 12345U) % 101U;
 
-            case EVENT_RECV_HB:
-                if (self->role == ROLE_SERVER)
-                {
-                    /* Checking the sequence number SNinSeq == true */
-                    if (self->snr == pdu->sequence_number)
-                    {
-                        /* Checking the Sequence of the Confirmed Timestamps CTSinSeq == true */
-                        if (check_seq_confirmed_timestamp(self, pdu))
-                        {
-                            process_regular_receipt(self, pdu);
-                            self->state = STATE_UP;
-
-                            self->time.Trtd = self->time.Tlocal() - self->ctsr;
-                            self->time.Ti = self->time.timeouts.Tmax - self->time.Trtd;
-                        }
-                        else
-                        {
-                            close_connection(self, pdu);
-
-                            /* Send DiscReq(8) */
-                            DiscReq(self, pdu, SEQ_ERR, NO_DETAILED_REASON);
-                            serialize_pdu(pdu, buff_to_send, pdu->message_length);
-                            self->vtable->SendSpdu(self->channel, pdu->message_length, buff_to_send);
-                        }
-                    }
-                    else 
-                    {
-                        close_connection(self, pdu);
-
-                        /* Send DiscReq(3) */
-                        DiscReq(self, pdu, SEQ_NBR_ERR_FOR_CONNECTION, NO_DETAILED_REASON);
-                        serialize_pdu(pdu, buff_to_send, pdu->message_length);
-                        self->vtable->SendSpdu(self->channel, pdu->message_length, buff_to_send);
-                    }
-                }
-                else if (self->role == ROLE_CLIENT)
-                {
-                    close_connection(self, pdu);
-
-                    /* Send DiscReq(2) */
-                    DiscReq(self, pdu, NOT_EXPECTED_RECV_MSG_TYPE, NO_DETAILED_REASON);
-                    serialize_pdu(pdu, buff_to_send, pdu->message_length);
-                    self->vtable->SendSpdu(self->channel, pdu->message_length, buff_to_send);
-                }
-            break;
+    return (int)self->snt_seed;
+}
 
-        default:
-            /* No action for other events in STATE_START */
-            break;
-    }
+static bool sequence_number_in_seq(const SmType *self, const PDU_View *rx)
+{
+    return self->snr == pdu_view_sequence_number(rx);
 }
 
-static void handle_up(SmType *self, const Event event, PDU_S *pdu)
+static Verdict evaluate_guard(SmType *self, const Guard guard, const PDU_View *rx)
 {
     assert(self != NULL);
 
-    switch (event) {
-        case EVENT_OPEN_CONN:
-            close_connection(self, pdu);
+    Verdict verdict = VERDICT_PASS;
 
-            /* Send DiscReq(5) */
-            DiscReq(self, pdu, STATE_SERVICE_NOT_ALLOWED, NO_DETAILED_REASON);
-            serialize_pdu(pdu, buff_to_send, pdu->message_length);
-            self->vtable->SendSpdu(self->channel, pdu->message_length, buff_to_send);
+    switch (guard) {
+        case GUARD_CLIENT:
+            verdict = (self->role == ROLE_CLIENT) ? VERDICT_PASS : VERDICT_OTHER_ROLE;
             break;
 
-        case EVENT_CLOSE_CONN:
-            close_connection(self, pdu);
-
-            /* Send DiscReq(0) */
-            DiscReq(self, pdu, USER_REQUEST, NO_DETAILED_REASON);
-            serialize_pdu(pdu, buff_to_send, pdu->message_length);
-            self->vtable->SendSpdu(self->channel, pdu->message_length, buff_to_send);
+        case GUARD_VERSION:
+            verdict = check_version(rx) ? VERDICT_PASS : VERDICT_VERSION_ERROR;
             break;
 
-        case EVENT_SEND_DATA:
-            /* Send Data */
-            serialize_pdu(pdu, buff_to_send, pdu->message_length);
-            self->vtable->SendSpdu(self->channel, pdu->message_length, buff_to_send);
+        case GUARD_CLIENT_VERSION:
+            verdict = (self->role != ROLE_CLIENT) ? VERDICT_OTHER_ROLE :
+                      check_version(rx) ? VERDICT_PASS : VERDICT_VERSION_ERROR;
             break;
 
-        case EVENT_RECV_CONN_REQ:
-        case EVENT_RECV_CONN_RESP:
-        case EVENT_RECV_RETR_RESP:
-        case EVENT_RECV_RETR_DATA:
-            close_connection(self, pdu);
-
-            /* Send DiscReq(2) */
-            DiscReq(self, pdu, NOT_EXPECTED_RECV_MSG_TYPE, NO_DETAILED_REASON);
-            serialize_pdu(pdu, buff_to_send, pdu->message_length);
-            self->vtable->SendSpdu(self->channel, pdu->message_length, buff_to_send);
-            break;
-
-        case EVENT_RECV_DISC_REQ:
-            close_connection(self, pdu);
-            break;
-
-        case EVENT_RECV_RETR_REQ:
-            /* Checking the sequence number SNinSeq == true */
-            if (self->snr == pdu->sequence_number)
+        case GUARD_SERVER_SEQUENCE:
+            if (self->role != ROLE_SERVER)
             {
-                /* Verify all unconfirmed payload data available */
-                if (unconfirmed_payload_available()) 
-                {
-                    process_regular_receipt(self, pdu);
-                    /* TODO: RTR - Send RetrResp, RetrData(s), HB or Data */
-
-                    self->time.Trtd = self->time.Tlocal() - self->ctsr;
-                    self->time.Ti = self->time.timeouts.Tmax - self->time.Trtd;
-                } 
-                else 
-                {
-                    close_connection(self, pdu);
-
-                    /* Send DiscReq(7) */
-                    DiscReq(self, pdu, FAIL_RETRANSMISSION, NO_DETAILED_REASON);
-                    serialize_pdu(pdu, buff_to_send, pdu->message_length);
-                    self->vtable->SendSpdu(self->channel, pdu->message_length, buff_to_send);
-                }
-            }
-            else
-            {
-                /* Verify all unconfirmed payload data available */
-                if (unconfirmed_payload_available()) 
-                {
-                    self->csr = pdu->confirmed_sequence_number;
-                    self->state = STATE_RETR_REQ;
-                    /* TODO: RTR - Send RetrResp, RetrData(s), HB or Data */
-                }
-                else 
-                {
-                    close_connection(self, pdu);
-
-                    /* Send DiscReq(7) */
-                    DiscReq(self, pdu, FAIL_RETRANSMISSION, NO_DETAILED_REASON);
-                    serialize_pdu(pdu, buff_to_send, pdu->message_length);
-                    self->vtable->SendSpdu(self->channel, pdu->message_length, buff_to_send);
-                }
+                verdict = VERDICT_OTHER_ROLE;
+                break;
             }
+            /* Fall through */
+        case GUARD_SEQUENCE:
+            verdict = !sequence_number_in_seq(self, rx) ? VERDICT_SN_GAP :
+                      check_seq_confirmed_timestamp(self, rx) ? VERDICT_PASS : VERDICT_CTS_ERROR;
             break;
 
-        case EVENT_RECV_HB:
-            /* Checking the sequence number SNinSeq == true */
-            if (self->snr == pdu->sequence_number)
-            {
-                /* Checking the Sequence of the Confirmed Timestamps CTSinSeq == true */
-                if (check_seq_confirmed_timestamp(self, pdu))
-                {
-                    process_regular_receipt(self, pdu);
-                    self->time.Trtd = self->time.Tlocal() - self->ctsr;
-                    self->time.Ti = self->time.timeouts.Tmax - self->time.Trtd;
-                }
-                else
-                {
-                    close_connection(self, pdu);
-
-                    /* Send DiscReq(8) */
-                    DiscReq(self, pdu, SEQ_ERR, NO_DETAILED_REASON);
-                    serialize_pdu(pdu, buff_to_send, pdu->message_length);
-                    self->vtable->SendSpdu(self->channel, pdu->message_length, buff_to_send);
-                }
-            }
-            else
-            {
-                self->state = STATE_RETR_REQ;
-
-                /* Send RetrReq */
-                RetrReq(self, pdu);
-                serialize_pdu(pdu, buff_to_send, pdu->message_length);
-                self->vtable->SendSpdu(self->channel, pdu->message_length, buff_to_send);
-            }
+        case GUARD_RETR_DATA:
+            verdict = !unconfirmed_payload_available(self, rx) ? VERDICT_NO_RETR_DATA :
+                      sequence_number_in_seq(self, rx) ? VERDICT_PASS : VERDICT_SN_GAP;
             break;
 
-        case EVENT_RECV_DATA:
-            /* Checking the sequence number SNinSeq == true */
-            if (self->snr == pdu->sequence_number)
-            {
-                /* Checking the Sequence of the Confirmed Timestamps CTSinSeq == true */
-                if (check_seq_confirmed_timestamp(self, pdu))
-                {
-                    process_regular_receipt(self, pdu);
-                    self->time.Trtd = self->time.Tlocal() - self->ctsr;
-                    self->time.Ti = self->time.timeouts.Tmax - self->time.Trtd;
-                }
-                else
-                {
-                    close_connection(self, pdu);
-
-                    /* Send DiscReq(8) */
-                    DiscReq(self, pdu, SEQ_ERR, NO_DETAILED_REASON);
-                    serialize_pdu(pdu, buff_to_send, pdu->message_length);
-                    self->vtable->SendSpdu(self->channel, pdu->message_length, buff_to_send);
-                }
-            }
-            else
-            {
-                self->state = STATE_RETR_REQ;
-                
-                /* Send RetrReq */
-                RetrReq(self, pdu);
-                serialize_pdu(pdu, buff_to_send, pdu->message_length);
-                self->vtable->SendSpdu(self->channel, pdu->message_length, buff_to_send);
-            }
+        case GUARD_SN_RETR_DATA:
+            verdict = sequence_number_in_seq(self, rx) ? VERDICT_PASS :
+                      unconfirmed_payload_available(self, rx) ? VERDICT_SN_GAP : VERDICT_NO_RETR_DATA;
             break;
+
         default:
-            /* No action for other events in STATE_UP */
             break;
     }
+
+    return verdict;
 }
 
-static void handle_retr_req(SmType *self, const Event event, PDU_S *pdu)
+/* Every event may move a deadline: Th restarts with each send, Ti with each accepted receipt */
+static void arm_timer(SmType *self)
 {
-    assert(self != NULL);
+    if (self->timers == NULL)
+    {
+        return;
+    }
 
-    switch (event) {
-        case EVENT_OPEN_CONN:
-            close_connection(self, pdu);
+    if (self->state < STATE_START)
+    {
+        timer_wheel_disarm(&self->timer);
+        return;
+    }
 
-            /* Send DiscReq(5) */
-            DiscReq(self, pdu, STATE_SERVICE_NOT_ALLOWED, NO_DETAILED_REASON);
-            serialize_pdu(pdu, buff_to_send, pdu->message_length);
-            self->vtable->SendSpdu(self->channel, pdu->message_length, buff_to_send);
-            break;
+    const uint32_t th_deadline = self->tx_time + self->shared->timeouts.Th;
+    const uint32_t ti_deadline = self->rx_time + (uint32_t)self->time.Ti;
 
-        case EVENT_CLOSE_CONN:
-            close_connection(self, pdu);
+    timer_wheel_arm(self->timers, &self->timer, ((int32_t)(ti_deadline - th_deadline) < 0) ? ti_deadline : th_deadline);
+}
 
-            /* Send DiscReq(0) */
-            DiscReq(self, pdu, USER_REQUEST, NO_DETAILED_REASON);
-            serialize_pdu(pdu, buff_to_send, pdu->message_length);
-            self->vtable->SendSpdu(self->channel, pdu->message_length, buff_to_send);
-            break;
+static void update_round_trip(SmType *self)
+{
+    const uint32_t now = self->shared->Tlocal();
 
-        case EVENT_RECV_CONN_REQ:
-        case EVENT_RECV_CONN_RESP:
-            close_connection(self, pdu);
+    self->time.Trtd = now - self->ctsr;
+    self->time.Ti = self->shared->timeouts.Tmax - self->time.Trtd;
+    self->rx_time = now;
+}
 
-            /* Send DiscReq(2) */
-            DiscReq(self, pdu, NOT_EXPECTED_RECV_MSG_TYPE, NO_DETAILED_REASON);
-            serialize_pdu(pdu, buff_to_send, pdu->message_length);
-            self->vtable->SendSpdu(self->channel, pdu->message_length, buff_to_send);
-            break;
+static void disconnect(SmType *self, const PDU_View *rx, PDU_S *pdu, const DiscReasonType reason)
+{
+    close_connection(self, rx);
+    DiscReq(self, pdu, reason, NO_DETAILED_REASON);
+    send_pdu(self, pdu);
+}
 
-        case EVENT_RECV_DISC_REQ:
-            close_connection(self, pdu);
-            break;
+static void run_action(SmType *self, const Action action, const PDU_View *rx, PDU_S *pdu)
+{
+    assert(self != NULL);
 
-        case EVENT_RECV_RETR_REQ:
-            /* Checking the sequence number SNinSeq == true */
-            if (self->snr == pdu->sequence_number)
-            {
-                /* Verify all unconfirmed payload data available */
-                if (unconfirmed_payload_available()) 
-                {
-                    process_regular_receipt(self, pdu);
-                    self->time.Trtd = self->time.Tlocal() - self->ctsr;
-                    self->time.Ti = self->time.timeouts.Tmax - self->time.Trtd;
-                    /* TODO: RTR - Send RetrResp, RetrData(s), HB or Data */
-                } 
-                else 
-                {
-                    close_connection(self, pdu);
-
-                    /* Send DiscReq(7) */
-                    DiscReq(self, pdu, FAIL_RETRANSMISSION, NO_DETAILED_REASON);
-                    serialize_pdu(pdu, buff_to_send, pdu->message_length);
-                    self->vtable->SendSpdu(self->channel, pdu->message_length, buff_to_send);
-                }
-            }
-            else
-            {
-                if (unconfirmed_payload_available()) 
-                {
-                    self->csr = pdu->confirmed_sequence_number;
-                    /* TODO: RTR - Send RetrResp, RetrData(s), HB or Data */
-                }
-                else 
-                {
-                    close_connection(self, pdu);
-
-                    /* Send DiscReq(7) */
-                    DiscReq(self, pdu, FAIL_RETRANSMISSION, NO_DETAILED_REASON);
-                    serialize_pdu(pdu, buff_to_send, pdu->message_length);
-                    self->vtable->SendSpdu(self->channel, pdu->message_length, buff_to_send);
-                }
-            }
+    switch (action) {
+        case ACTION_OPEN_CLIENT:
+            self->snt = snt_rand_value(self); /* Random value for SNT */
+            retr_reset(self);
+            self->cst = 0;
+            self->ctsr = self->shared->Tlocal();
+            self->rx_time = self->ctsr;
+            ConnReq(self, pdu);
+            send_pdu(self, pdu);
             break;
 
-        case EVENT_SEND_DATA:
-            /* Send Data */
-            serialize_pdu(pdu, buff_to_send, pdu->message_length);
-            self->vtable->SendSpdu(self->channel, pdu->message_length, buff_to_send);
+        case ACTION_OPEN_SERVER:
+            self->snt = snt_rand_value(self); /* Random value for SNT */
+            retr_reset(self);
             break;
 
-        case EVENT_RECV_RETR_RESP:
-            self->state = STATE_RETR_RUN;
+        case ACTION_ACCEPT_CONN_REQ:
+            process_regular_receipt(self, rx);
+            self->csr = self->snt - 1;
+            self->ctsr = self->shared->Tlocal();
+            update_round_trip(self);
+            ConnResp(self, pdu);
+            send_pdu(self, pdu);
             break;
 
-        default:
-            /* No action for other events in STATE_RETR_REQ */
+        case ACTION_ACCEPT_CONN_RESP:
+            process_regular_receipt(self, rx);
+            update_round_trip(self);
+            HB(self, pdu);
+            send_pdu(self, pdu);
             break;
-    }
-}
 
-static void handle_retr_run(SmType *self, const Event event, PDU_S *pdu)
-{
-    assert(self != NULL);
-
-    switch (event) {
-        case EVENT_OPEN_CONN:
-            close_connection(self, pdu);
-
-            /* Send DiscReq(5) */
-            DiscReq(self, pdu, STATE_SERVICE_NOT_ALLOWED, NO_DETAILED_REASON);
-            serialize_pdu(pdu, buff_to_send, pdu->message_length);
-            self->vtable->SendSpdu(self->channel, pdu->message_length, buff_to_send);
+        case ACTION_ACCEPT:
+            process_regular_receipt(self, rx);
+            update_round_trip(self);
             break;
 
-        case EVENT_CLOSE_CONN:
-            close_connection(self, pdu);
-
-            /* Send DiscReq(0) */
-            DiscReq(self, pdu, USER_REQUEST, NO_DETAILED_REASON);
-            serialize_pdu(pdu, buff_to_send, pdu->message_length);
-            self->vtable->SendSpdu(self->channel, pdu->message_length, buff_to_send);
+        case ACTION_RETRANSMIT:
+            process_regular_receipt(self, rx);
+            update_round_trip(self);
+            retransmit(self, pdu);
             break;
 
-        case EVENT_SEND_DATA:
-            /* Send Data */
-            serialize_pdu(pdu, buff_to_send, pdu->message_length);
-            self->vtable->SendSpdu(self->channel, pdu->message_length, buff_to_send);
+        case ACTION_RETRANSMIT_GAP:
+        case ACTION_RETRANSMIT_REQUEST:
+            self->csr = pdu_view_confirmed_sequence_number(rx);
+            retr_trim(self);
+            retransmit(self, pdu);
+            if (action == ACTION_RETRANSMIT_REQUEST)
+            {
+                RetrReq(self, pdu);
+                send_pdu(self, pdu);
+            }
             break;
 
-        case EVENT_RECV_CONN_REQ:
-        case EVENT_RECV_CONN_RESP:
-        case EVENT_RECV_RETR_RESP:
-            close_connection(self, pdu);
-
-            /* Send DiscReq(2) */
-            DiscReq(self, pdu, NOT_EXPECTED_RECV_MSG_TYPE, NO_DETAILED_REASON);
-            serialize_pdu(pdu, buff_to_send, pdu->message_length);
-            self->vtable->SendSpdu(self->channel, pdu->message_length, buff_to_send);
+        case ACTION_ACCEPT_DATA:
+            process_regular_receipt(self, rx);
+            deliver_data(self, rx);
+            update_round_trip(self);
             break;
 
-        case EVENT_RECV_DISC_REQ:
-            close_connection(self, pdu);
+        case ACTION_SEND:
+            send_pdu(self, pdu);
             break;
 
-        case EVENT_RECV_RETR_REQ:
-            /* Checking the sequence number SNinSeq == true */
-            if (self->snr == pdu->sequence_number)
-            {
-                close_connection(self, pdu);
-
-                /* Send DiscReq(2) */
-                DiscReq(self, pdu, NOT_EXPECTED_RECV_MSG_TYPE, NO_DETAILED_REASON);
-                serialize_pdu(pdu, buff_to_send, pdu->message_length);
-                self->vtable->SendSpdu(self->channel, pdu->message_length, buff_to_send);
-            }
-            else
-            {
-                /* Verify all unconfirmed payload data available */
-                if (unconfirmed_payload_available()) 
-                {
-                    self->csr = pdu->confirmed_sequence_number;
-                    self->state = STATE_RETR_REQ;
-                    /* TODO: RTR - Send RetrResp RetrData(s) HB or Data RetrReq */
-                }
-                else
-                {
-                    close_connection(self, pdu);
-
-                    /* Send DiscReq(7) */
-                    DiscReq(self, pdu, FAIL_RETRANSMISSION, NO_DETAILED_REASON);
-                    serialize_pdu(pdu, buff_to_send, pdu->message_length);
-                    self->vtable->SendSpdu(self->channel, pdu->message_length, buff_to_send);
-                }
-            }
+        case ACTION_SEND_HB:
+            HB(self, pdu);
+            send_pdu(self, pdu);
             break;
 
-        case EVENT_RECV_HB:
-        case EVENT_RECV_DATA:
-            /* Checking the sequence number SNinSeq == true */
-            if (self->snr == pdu->sequence_number)
-            {
-                /* Checking the Sequence of the Confirmed Timestamps CTSinSeq == true */
-                if (check_seq_confirmed_timestamp(self, pdu))
-                {
-                    process_regular_receipt(self, pdu);
-                    self->state = STATE_UP;
-
-                    self->time.Trtd = self->time.Tlocal() - self->ctsr;
-                    self->time.Ti = self->time.timeouts.Tmax - self->time.Trtd;
-                } 
-                else
-                {
-                    close_connection(self, pdu);
-
-                    /* Send DiscReq(8) */
-                    DiscReq(self, pdu, SEQ_ERR, NO_DETAILED_REASON);
-                    serialize_pdu(pdu, buff_to_send, pdu->message_length);
-                    self->vtable->SendSpdu(self->channel, pdu->message_length, buff_to_send);
-                }
-            }
-            else
-            {
-                self->state = STATE_RETR_REQ;
-
-                /* Send RetrReq */
-                RetrReq(self, pdu);
-                serialize_pdu(pdu, buff_to_send, pdu->message_length);
-                self->vtable->SendSpdu(self->channel, pdu->message_length, buff_to_send);
-            }
+        case ACTION_SEND_RETR_REQ:
+            RetrReq(self, pdu);
+            send_pdu(self, pdu);
             break;
 
-            case EVENT_RECV_RETR_DATA:
-                /* Checking the sequence number SNinSeq == true */
-                if (self->snr == pdu->sequence_number)
-                {
-                    /* Checking the Sequence of the Confirmed Timestamps CTSinSeq == true */
-                    if (check_seq_confirmed_timestamp(self, pdu))
-                    {
-                        process_regular_receipt(self, pdu);
-                        self->state = STATE_RETR_RUN;
-
-                        self->time.Trtd = self->time.Tlocal() - self->ctsr;
-                        self->time.Ti = self->time.timeouts.Tmax - self->time.Trtd;
-                    } 
-                    else
-                    {
-                        close_connection(self, pdu);
-
-                        /* Send DiscReq(8) */
-                        DiscReq(self, pdu, SEQ_ERR, NO_DETAILED_REASON);
-                        serialize_pdu(pdu, buff_to_send, pdu->message_length);
-                        self->vtable->SendSpdu(self->channel, pdu->message_length, buff_to_send);
-                    }
-                }
-                else
-                {
-                    self->state = STATE_RETR_REQ;
-
-                    /* Send RetrReq */
-                    RetrReq(self, pdu);
-                    serialize_pdu(pdu, buff_to_send, pdu->message_length);
-                    self->vtable->SendSpdu(self->channel, pdu->message_length, buff_to_send);
-                }
+        case ACTION_CLOSE:
+            close_connection(self, rx);
             break;
 
+        case ACTION_DISC_USER_REQUEST:  disconnect(self, rx, pdu, USER_REQUEST); break;
+        case ACTION_DISC_NOT_EXPECTED:  disconnect(self, rx, pdu, NOT_EXPECTED_RECV_MSG_TYPE); break;
+        case ACTION_DISC_SEQ_NBR_ERR:   disconnect(self, rx, pdu, SEQ_NBR_ERR_FOR_CONNECTION); break;
+        case ACTION_DISC_TIMEOUT:       disconnect(self, rx, pdu, TIMEOUT_INCOMING_MSG); break;
+        case ACTION_DISC_NOT_ALLOWED:   disconnect(self, rx, pdu, STATE_SERVICE_NOT_ALLOWED); break;
+        case ACTION_DISC_VERSION_ERROR: disconnect(self, rx, pdu, PROTOCOL_VERSION_ERROR); break;
+        case ACTION_DISC_FAIL_RETR:     disconnect(self, rx, pdu, FAIL_RETRANSMISSION); break;
+        case ACTION_DISC_SEQ_ERR:       disconnect(self, rx, pdu, SEQ_ERR); break;
+
         default:
-            /* No action for other events in STATE_RETR_RUN */
             break;
     }
 }
@@ -718,101 +726,194 @@ StdRet_t Sm_Init(SmType *self)
 {
     assert(self != NULL);
 
+    assert(self->shared != NULL);
+
     StdRet_t ret = OK;
 
-    /* TODO: RTR - Config timeouts*/
-    self->time.timeouts.Th = 10;    /* Th = 10 sec */
-    self->time.timeouts.Tmax = 30;  /* Tmax = 30 sec */
-    self->time.Ti = self->time.timeouts.Tmax; /* Initially Ti = Tmax */
+    self->time.Ti = self->shared->timeouts.Tmax; /* Initially Ti = Tmax */
 
     set_initial_values(self);
-    
-    self->handle_event = handle_closed; /* Initial state handler */
+    safety_code_init(&self->safety_code, self->safety_code_config);
+    pdu_templates_init(&self->templates, &self->safety_code, self->receiver_id, self->sender_id);
+    timer_node_init(&self->timer);
+    self->rx_dropped = 0;
+    self->tx_dropped = 0;
+    self->snt_seed = 12345U + self->channel; /* Connections of one instance start from different SNTs */
+    for (uint32_t i = 0; i < SM_TX_FRAMES; i++)
+    {
+        tx_release(&self->tx_frames[i]);
+    }
 
     LOG_INFO("connection: %i, state: %i", self->channel, self->state);
 
     return ret;
 }
 
-void Sm_HandleEvent(SmType *self, const Event event, PDU_S *pdu)
+void Sm_SharedInit(SmShared *shared, SafeComVtable *vtable)
+{
+    assert(shared != NULL);
+
+    shared->vtable = vtable;
+    shared->Tlocal = GetCurrentTimestamp;
+    /* TODO: RTR - Config timeouts*/
+    shared->timeouts.Th = 10;    /* Th = 10 sec */
+    shared->timeouts.Tmax = 30;  /* Tmax = 30 sec */
+    shared->timeouts.Tseq = 0;
+}
+
+/* Every transition goes through here: the guard of the table entry picks the step, whose action runs before the state changes */
+static void dispatch_event(SmType *self, const Event event, const PDU_View *rx, PDU_S *pdu)
 {
     assert(self != NULL);
+    assert((self->state < STATE_COUNT) && (event < EVENT_COUNT));
 
-    LOG_INFO("connection: %i, state: %i", self->channel, self->state);
+    const Transition *transition = &transitions[self->state][event];
 
-    /* Delegate the event handling to the appropriate state handler */
-    self->handle_event(self, event, pdu);
+    if (transition->guard == GUARD_IGNORE)
+    {
+        return;
+    }
+
+    const Step *step = &transition->steps[evaluate_guard(self, (Guard)transition->guard, rx)];
+
+    LOG_INFO("connection: %i, state: %i, event: %i", self->channel, self->state, event);
+
+    run_action(self, (Action)step->action, rx, pdu);
+    self->state = (State)step->next;
+    arm_timer(self);
 
     LOG_INFO("connection: %i, state: %i", self->channel, self->state);
+}
+
+void Sm_TxBatchInit(SmTxBatch *batch)
+{
+    assert(batch != NULL);
 
-    /* Additional event handling for timer events */
-    if (event == EVENT_TH_ELAPSED) 
+    batch->used = 0;
+    batch->count = 0;
+}
+
+void Sm_TxBatchFlush(SmTxBatch *batch, const SafeComVtable *vtable)
+{
+    assert(batch != NULL);
+    assert(vtable != NULL);
+
+    if (batch->count == 0)
+    {
+        return;
+    }
+
+    /* The frames lie back to back in the arena */
+    uint8_t *frames[SAFECOM_MAX_BATCH];
+    uint16_t lengths[SAFECOM_MAX_BATCH];
+    size_t offset = 0;
+
+    for (uint32_t i = 0; i < batch->count; i++)
+    {
+        frames[i] = &batch->arena[offset];
+        lengths[i] = (uint16_t)batch->spdus[i].spduLen;
+        offset += batch->spdus[i].spduLen;
+    }
+    seal_pdus(batch->codes, frames, lengths, batch->count);
+
+    if (vtable->SendSpduBatch != NULL)
+    {
+        vtable->SendSpduBatch(batch->spdus, batch->count);
+    }
+    else
     {
-        switch (self->state) 
+        for (uint32_t i = 0; i < batch->count; i++)
         {
-            case STATE_START:
-                /* Send HB */
-                HB(self, pdu);
-                serialize_pdu(pdu, buff_to_send, pdu->message_length);
-                self->vtable->SendSpdu(self->channel, pdu->message_length, buff_to_send);
-                break;
+            vtable->SendSpdu(batch->spdus[i].nodeId, batch->spdus[i].spduLen, batch->spdus[i].pSpduData);
+        }
+    }
 
-            case STATE_UP:
-                /* Send HB */
-                HB(self, pdu);
-                serialize_pdu(pdu, buff_to_send, pdu->message_length);
-                self->vtable->SendSpdu(self->channel, pdu->message_length, buff_to_send);
-                break;
+    Sm_TxBatchInit(batch);
+}
 
-            case STATE_RETR_REQ:
-                /* Send HB */
-                HB(self, pdu);
-                serialize_pdu(pdu, buff_to_send, pdu->message_length);
-                self->vtable->SendSpdu(self->channel, pdu->message_length, buff_to_send);
-                break;
+StdRet_t Sm_TxRelease(SmType *self, const uint8_t *pSpduData)
+{
+    assert(self != NULL);
 
-            case STATE_RETR_RUN:
-                /* Send HB */
-                HB(self, pdu);
-                serialize_pdu(pdu, buff_to_send, pdu->message_length);
-                self->vtable->SendSpdu(self->channel, pdu->message_length, buff_to_send);
-                break;
+    for (uint32_t i = 0; i < SM_TX_FRAMES; i++)
+    {
+        SmTxFrame *frame = &self->tx_frames[i];
+        if ((pSpduData == frame->data) && (__atomic_load_n(&frame->busy, __ATOMIC_ACQUIRE) != 0U))
+        {
+            tx_release(frame);
+            return OK;
+        }
+    }
 
-            default:
-                break;
+    return NOT_OK;
+}
+
+void Sm_HandleEvent(SmType *self, const Event event, PDU_S *pdu)
+{
+    assert(self != NULL);
+    assert(pdu != NULL);
+
+    /* Receive events follow the local and timer events in Event */
+    if (event < EVENT_RECV_CONN_REQ)
+    {
+        dispatch_event(self, event, NULL, pdu);
+    }
+    else
+    {
+        /* A received PDU handed over as structure goes through the same view as a frame from the wire */
+        uint8_t frame[MAX_BUFF_SIZE] = {0};
+        PDU_View rx;
+
+        write_pdu(pdu, &self->safety_code, frame, sizeof(frame));
+        if (pdu_view_init(&rx, frame, sizeof(frame), self->safety_code.length))
+        {
+            dispatch_event(self, event, &rx, pdu);
         }
-    } else if (event == EVENT_TI_ELAPSED) {
-        close_connection(self, pdu);
+        else
+        {
+            LOG_ERROR("connection: %i, malformed PDU of type %i dropped", self->channel, pdu->message_type);
+        }
+    }
+}
 
-        /* Send DiscReq(4) */
-        DiscReq(self, pdu, TIMEOUT_INCOMING_MSG, NO_DETAILED_REASON);
-        serialize_pdu(pdu, buff_to_send, pdu->message_length);
-        self->vtable->SendSpdu(self->channel, pdu->message_length, buff_to_send);
+uint32_t Sm_CheckTimers(SmType *self, const uint32_t now)
+{
+    assert(self != NULL);
+
+    PDU_S pdu = { 0 };
+    Event event;
+
+    if (self->state < STATE_START)
+    {
+        arm_timer(self);
+        return 0;
     }
 
-    /* Update state handler */
-    switch (self->state) {
-        case STATE_CLOSED:
-            self->handle_event = handle_closed;
-            break;
-        case STATE_DOWN:
-            self->handle_event = handle_down;
-            break;
-        case STATE_START:
-            self->handle_event = handle_start;
-            break;
-        case STATE_UP:
-            self->handle_event = handle_up;
-            break;
-        case STATE_RETR_REQ:
-            self->handle_event = handle_retr_req;
-            break;
-        case STATE_RETR_RUN:
-            self->handle_event = handle_retr_run;
-            break;
-        default:
-            /* Should never reach this point if all states are handled */
-            assert(0);
-            break;
+    if ((int32_t)(now - self->rx_time) >= self->time.Ti)
+    {
+        event = EVENT_TI_ELAPSED;
     }
+    else if ((now - self->tx_time) >= self->shared->timeouts.Th)
+    {
+        event = EVENT_TH_ELAPSED;
+    }
+    else
+    {
+        arm_timer(self);
+        return 0;
+    }
+
+    dispatch_event(self, event, NULL, &pdu);
+
+    return 1;
 }
+
+void Sm_HandlePdu(SmType *self, const PDU_View *rx)
+{
+    assert(self != NULL);
+    assert(rx != NULL);
+
+    PDU_S pdu = { 0 };
+
+    dispatch_event(self, event_from_type(rx->message_type), rx, &pdu);
+}
\ No newline at end of file
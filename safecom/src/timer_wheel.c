@@ -0,0 +1,81 @@
+#include "timer_wheel.h"
+#include "assert.h"
+
+static TimerNode* slot_of(TimerWheel *wheel, const uint32_t tick)
+{
+    return &wheel->slots[tick & (TIMER_WHEEL_SLOTS - 1U)];
+}
+
+void timer_wheel_init(TimerWheel *wheel, const uint32_t now)
+{
+    assert(wheel != NULL);
+
+    for (uint32_t i = 0; i < TIMER_WHEEL_SLOTS; i++) {
+        wheel->slots[i].prev = &wheel->slots[i];
+        wheel->slots[i].next = &wheel->slots[i];
+    }
+    wheel->tick = now;
+}
+
+void timer_node_init(TimerNode *node)
+{
+    assert(node != NULL);
+
+    node->prev = NULL;
+    node->next = NULL;
+}
+
+void timer_wheel_disarm(TimerNode *node)
+{
+    assert(node != NULL);
+
+    if (node->next != NULL) {
+        node->prev->next = node->next;
+        node->next->prev = node->prev;
+        timer_node_init(node);
+    }
+}
+
+void timer_wheel_arm(TimerWheel *wheel, TimerNode *node, const uint32_t deadline)
+{
+    assert(wheel != NULL);
+    assert(node != NULL);
+
+    timer_wheel_disarm(node);
+
+    /* A deadline behind the wheel goes into the slot checked next */
+    node->deadline = ((int32_t)(deadline - wheel->tick) < 0) ? wheel->tick : deadline;
+
+    TimerNode *head = slot_of(wheel, node->deadline);
+    node->prev = head->prev;
+    node->next = head;
+    head->prev->next = node;
+    head->prev = node;
+}
+
+TimerNode* timer_wheel_expire(TimerWheel *wheel, const uint32_t now)
+{
+    assert(wheel != NULL);
+
+    /* After a gap of more than one turn every slot is due once anyway */
+    if ((int32_t)(now - wheel->tick) > (int32_t)TIMER_WHEEL_SLOTS) {
+        wheel->tick = now - TIMER_WHEEL_SLOTS;
+    }
+
+    for (;;) {
+        TimerNode *head = slot_of(wheel, wheel->tick);
+
+        for (TimerNode *node = head->next; node != head; node = node->next) {
+            if ((int32_t)(node->deadline - now) <= 0) {
+                timer_wheel_disarm(node);
+                return node;
+            }
+        }
+
+        /* The slot of now keeps its timers of later turns; the wheel stays there */
+        if ((int32_t)(now - wheel->tick) <= 0) {
+            return NULL;
+        }
+        wheel->tick++;
+    }
+}
@@ -1,10 +1,12 @@
 #include "rass.h"
 #include "sic.h"
+#include "loopback.h"
 #include "assert.h"
 #include <stdio.h>
 #include <string.h>
 
-#define MAX_CONNECTIONS 1U
+#define MAX_CONNECTIONS 4U
+#define MAX_ROUNDS      100U
 
 static StdRet_t My_Fec_ReceiveBtp(const MsgId_t msgId, const MsgLen_t msgLen, const uint8_t* const pMsgData) {
     assert(pMsgData != NULL);
@@ -13,37 +15,64 @@ static StdRet_t My_Fec_ReceiveBtp(const MsgId_t msgId, const MsgLen_t msgLen, co
     return OK;
 }
 
-static StdRet_t My_IscDispApp_SendSpdu(const NodeId_t nodeId, const SpduLen_t spduLen, const uint8_t* const pSpduData) {
-    assert(pSpduData != NULL);
-    /* Implementation of IscDispApp_SendSpdu */
-    printf("[My_Isc_SendSpdu]\n");
+static StdRet_t My_OsCom_ReceiveMsg(const MsgId_t msgId, const MsgLen_t msgLen, const uint8_t* const pMsgData) {
+    assert(pMsgData != NULL);
+    /* Implementation of OsCom_ReceiveMsg */
+    printf("[My_OsCom_ReceiveMsg] msgId: %d, msgLen: %d, msg: %s\n", msgId, msgLen, pMsgData);
     return OK;
 }
 
 
 int main(int argc, char* argv[]) {
-    // const MsgId_t MAX_CONNECTIONS = 1;
-    SmType sms[MAX_CONNECTIONS] = { 0 }; 
+    (void)argc;
+    (void)argv;
 
-    const SafeComConfig config_server = { .instname="server\0", 
-                                        .role=ROLE_SERVER, 
-                                        .max_connections=MAX_CONNECTIONS,
-                                        .sms=sms };
-    const SafeComConfig config_client = { .instname="client\0", 
-                                        .role=ROLE_CLIENT, 
-                                        .max_connections=MAX_CONNECTIONS,
-                                        .sms=sms}; 
+    /* Rass client and Sic server in one process, connected by the in-process loopback */
+    SmType client_sms[MAX_CONNECTIONS] = { 0 };
+    SmType server_sms[MAX_CONNECTIONS] = { 0 };
+    Loopback wire;
 
-    const SafeComVtable vtable = { .ReceiveMsg=My_Fec_ReceiveBtp, .SendSpdu=My_IscDispApp_SendSpdu};
+    const LoopbackConfig wire_config = { .ToClient = Rass_ReceiveSpduBatch, .ToServer = Sic_ReceiveSpduBatch };
+    const SafeComType config_client = { .vtable = { .ReceiveMsg = My_Fec_ReceiveBtp,
+                                                    .SendSpdu = Loopback_ClientSendSpdu,
+                                                    .SendSpduBatch = Loopback_ClientSendSpduBatch },
+                                        .config = { .instname = "client\0",
+                                                    .role = ROLE_CLIENT,
+                                                    .max_connections = MAX_CONNECTIONS,
+                                                    .sms = client_sms } };
+    SafeComType config_server = { .vtable = { .ReceiveMsg = My_OsCom_ReceiveMsg,
+                                              .SendSpdu = Loopback_ServerSendSpdu,
+                                              .SendSpduBatch = Loopback_ServerSendSpduBatch },
+                                  .config = { .instname = "server\0",
+                                              .role = ROLE_SERVER,
+                                              .max_connections = MAX_CONNECTIONS,
+                                              .sms = server_sms } };
 
-    SafeComType config = { .vtable = vtable, 
-                            .config = (argc==2 && (strcmp("server", argv[1])==0)) ? config_server : config_client };
+    Loopback_Init(&wire, &wire_config);
+    if ((Rass_Init_VTable(&config_client) != OK) || (Sic_Init_VTable(&config_server) != OK)) {
+        fprintf(stderr, "Failed to initialize the endpoints.\n");
+        return 1;
+    }
 
+    /* ConnReq, ConnResp and HB on every connection */
+    for (MsgId_t i = 0; i < MAX_CONNECTIONS; i++) {
+        Sic_OpenConnection(i);
+        Rass_OpenConnection(i);
+    }
+    Loopback_Run(&wire, MAX_ROUNDS);
 
-    if (Rass_Init_VTable(&config) != OK) {
-        fprintf(stderr, "Failed to initialize %s.\n", config.config.instname);
-        return 1;
+    /* Data both ways */
+    for (MsgId_t i = 0; i < MAX_CONNECTIONS; i++) {
+        static const uint8_t request[] = "hello from the client";
+        static const uint8_t response[] = "hello from the server";
+
+        Rass_SendData(i, sizeof(request), request);
+        Sic_SendData(i, sizeof(response), response);
     }
+    Loopback_Run(&wire, MAX_ROUNDS);
+
+    printf("%lu SPDUs over the loopback, %lu dropped\n", (unsigned long)wire.delivered,
+           (unsigned long)(wire.to_server.dropped + wire.to_client.dropped));
 
-    Rass_OpenConnection(0);
+    return 0;
 }
@@ -12,6 +12,24 @@ extern int test_rass_server(void);
 extern int test_rass_client(void);
 extern int test_rass_send_data(void);
 extern int test_timeout(void);
+extern int test_pdu(void);
+extern int test_md4(void);
+extern int test_safecom_batch(void);
+extern int test_safecom_ingress(void);
+extern int test_safecom_main(void);
+extern int test_safecom_demux(void);
+extern int test_sm_transitions(void);
+extern int test_sm_retransmission(void);
+extern int test_shard(void);
+extern int test_timer_wheel(void);
+extern int test_loopback(void);
+#ifdef RASTAS_TRANSPORT
+extern int test_udp(void);
+extern int test_shm(void);
+#endif
+#ifdef RASTAS_IO_URING
+extern int test_uring(void);
+#endif
 
 static void simple_test(void **state) 
 {
@@ -37,7 +55,7 @@ static int group_teardown(void **state)
 }
 
 int main(int argc, char* argv[]) {
-    int return_value = -1;
+    int return_value = 0;
 
     printf("LOG_LEVEL: %i\n", get_loglevel_filter());
     set_loglevel_filter(LOG_ERROR);
@@ -54,6 +72,24 @@ int main(int argc, char* argv[]) {
     // return_value |= test_rass_client();
     // return_value |= test_rass_send_data();
     return_value |= test_timeout();
+    return_value |= test_pdu();
+    return_value |= test_md4();
+    return_value |= test_safecom_batch();
+    return_value |= test_safecom_ingress();
+    return_value |= test_safecom_demux();
+    return_value |= test_safecom_main();
+    return_value |= test_sm_transitions();
+    return_value |= test_sm_retransmission();
+    return_value |= test_shard();
+    return_value |= test_timer_wheel();
+    return_value |= test_loopback();
+#ifdef RASTAS_TRANSPORT
+    return_value |= test_udp();
+    return_value |= test_shm();
+#endif
+#ifdef RASTAS_IO_URING
+    return_value |= test_uring();
+#endif
 
     return return_value;
 }
\ No newline at end of file
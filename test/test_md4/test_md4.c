@@ -0,0 +1,184 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdarg.h>
+#include <setjmp.h>
+#include <string.h>
+#include "cmocka.h"
+
+#include "md4.h"
+#include "md4_multi.h"
+#include "sm.h"
+#include "pdu.h"
+
+#define MESSAGES 37U    /* Not a multiple of any lane count, so every kernel has idle lanes */
+
+static const MD4_u32plus key[4] = { 0x01234567U, 0x89abcdefU, 0xfedcba98U, 0x76543210U };
+
+static void reference_md4_iv(const MD4_u32plus *iv, const uint8_t *msg, const size_t len, uint8_t *digest)
+{
+    MD4_CTX ctx;
+
+    if (iv != NULL) {
+        MD4_InitIV(&ctx, iv);
+    } else {
+        MD4_Init(&ctx);
+    }
+    MD4_Update(&ctx, msg, len);
+    MD4_Final(digest, &ctx);
+}
+
+static void reference_md4(const uint8_t *msg, const size_t len, uint8_t *digest)
+{
+    MD4_CTX ctx;
+
+    MD4_Init(&ctx);
+    MD4_Update(&ctx, msg, len);
+    MD4_Final(digest, &ctx);
+}
+
+static void test_md4_oneblock(void **state)
+{
+    (void)state;
+
+    uint8_t msg[MD4_ONEBLOCK_MAX_LENGTH];
+    uint8_t digest[MD4_DIGEST_LENGTH];
+    uint8_t expected[MD4_DIGEST_LENGTH];
+
+    for (size_t i = 0; i < sizeof(msg); i++) {
+        msg[i] = (uint8_t)(0xA5U ^ (i * 13U));
+    }
+
+    /* Every length up to the last one that still leaves room for the padding */
+    for (size_t len = 0; len <= MD4_ONEBLOCK_MAX_LENGTH; len++) {
+        reference_md4(msg, len, expected);
+        md4_oneblock(digest, NULL, msg, len);
+        assert_memory_equal(digest, expected, MD4_DIGEST_LENGTH);
+
+        reference_md4_iv(key, msg, len, expected);
+        md4_oneblock(digest, key, msg, len);
+        assert_memory_equal(digest, expected, MD4_DIGEST_LENGTH);
+    }
+}
+
+static void test_md4_multi_rfc1320(void **state)
+{
+    (void)state;
+
+    /* Test suite of RFC 1320, the last two are longer than one block */
+    const char *inputs[] = {
+        "",
+        "a",
+        "abc",
+        "message digest",
+        "abcdefghijklmnopqrstuvwxyz",
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789",
+        "12345678901234567890123456789012345678901234567890123456789012345678901234567890",
+    };
+    const uint8_t expected[][MD4_DIGEST_LENGTH] = {
+        { 0x31, 0xd6, 0xcf, 0xe0, 0xd1, 0x6a, 0xe9, 0x31, 0xb7, 0x3c, 0x59, 0xd7, 0xe0, 0xc0, 0x89, 0xc0 },
+        { 0xbd, 0xe5, 0x2c, 0xb3, 0x1d, 0xe3, 0x3e, 0x46, 0x24, 0x5e, 0x05, 0xfb, 0xdb, 0xd6, 0xfb, 0x24 },
+        { 0xa4, 0x48, 0x01, 0x7a, 0xaf, 0x21, 0xd8, 0x52, 0x5f, 0xc1, 0x0a, 0xe8, 0x7a, 0xa6, 0x72, 0x9d },
+        { 0xd9, 0x13, 0x0a, 0x81, 0x64, 0x54, 0x9f, 0xe8, 0x18, 0x87, 0x48, 0x06, 0xe1, 0xc7, 0x01, 0x4b },
+        { 0xd7, 0x9e, 0x1c, 0x30, 0x8a, 0xa5, 0xbb, 0xcd, 0xee, 0xa8, 0xed, 0x63, 0xdf, 0x41, 0x2d, 0xa9 },
+        { 0x04, 0x3f, 0x85, 0x82, 0xf2, 0x41, 0xdb, 0x35, 0x1c, 0xe6, 0x27, 0xe1, 0x53, 0xe7, 0xf0, 0xe4 },
+        { 0xe3, 0x3b, 0x4d, 0xdc, 0x9c, 0x38, 0xf2, 0x19, 0x9c, 0x3e, 0x7b, 0x16, 0x4f, 0xcc, 0x05, 0x36 },
+    };
+    const size_t count = sizeof(inputs) / sizeof(inputs[0]);
+    const uint8_t *msgs[sizeof(inputs) / sizeof(inputs[0])];
+    size_t lens[sizeof(inputs) / sizeof(inputs[0])];
+    uint8_t digests[sizeof(inputs) / sizeof(inputs[0])][MD4_DIGEST_LENGTH];
+
+    for (size_t i = 0; i < count; i++) {
+        msgs[i] = (const uint8_t *)inputs[i];
+        lens[i] = strlen(inputs[i]);
+    }
+
+    md4_multi(NULL, msgs, lens, digests, count);
+
+    for (size_t i = 0; i < count; i++) {
+        assert_memory_equal(digests[i], expected[i], MD4_DIGEST_LENGTH);
+    }
+}
+
+static void test_md4_multi_kernels(void **state)
+{
+    (void)state;
+
+    const Md4MultiKernel initial = md4_multi_kernel();
+    uint8_t data[MESSAGES][MAX_BUFF_SIZE];
+    const uint8_t *msgs[MESSAGES];
+    const MD4_u32plus *ivs[MESSAGES];
+    size_t lens[MESSAGES];
+    uint8_t digests[MESSAGES][MD4_DIGEST_LENGTH];
+    uint8_t expected[MESSAGES][MD4_DIGEST_LENGTH];
+
+    /* Keyed and standard initial values mixed, lengths around the one-block limit and every PDU size in between */
+    for (size_t i = 0; i < MESSAGES; i++) {
+        for (size_t j = 0; j < MAX_BUFF_SIZE; j++) {
+            data[i][j] = (uint8_t)(i * 31U + j * 7U);
+        }
+        msgs[i] = data[i];
+        ivs[i] = ((i % 3U) == 0U) ? key : NULL;
+        lens[i] = (i * 3U) % (MAX_BUFF_SIZE - SAFETY_CODE_LENGTH);
+        reference_md4_iv(ivs[i], msgs[i], lens[i], expected[i]);
+    }
+
+    assert_true(md4_multi_select(MD4_MULTI_SCALAR));
+    for (Md4MultiKernel kernel = MD4_MULTI_SCALAR; kernel <= MD4_MULTI_AVX512; kernel++) {
+        if (!md4_multi_select(kernel)) {
+            continue;   /* Not available on this CPU */
+        }
+        assert_int_equal(md4_multi_kernel(), kernel);
+
+        memset(digests, 0, sizeof(digests));
+        md4_multi(ivs, msgs, lens, digests, MESSAGES);
+        assert_memory_equal(digests, expected, sizeof(expected));
+    }
+
+    assert_true(md4_multi_select(initial));
+}
+
+static void test_seal_pdus(void **state)
+{
+    (void)state;
+
+    uint8_t frames[3][MAX_BUFF_SIZE];
+    uint8_t expected[3][MAX_BUFF_SIZE];
+    uint8_t *ptrs[3] = { frames[0], frames[1], frames[2] };
+    const SafetyCodeConfig full = { .type = SAFETY_CODE_FULL_MD4, .key = { 1U, 2U, 3U, 4U } };
+    SafetyCode lower;
+    SafetyCode keyed;
+    safety_code_init(&lower, NULL);
+    safety_code_init(&keyed, &full);
+    const SafetyCode *codes[3] = { &lower, &keyed, &lower };
+    const uint16_t lengths[3] = { PDU_FIXED_FIELDS_LENGTH, PDU_FIXED_FIELDS_LENGTH + CONN_REQ_PAYLOAD_LENGTH, MAX_BUFF_SIZE };
+
+    for (size_t i = 0; i < 3; i++) {
+        uint8_t digest[MD4_DIGEST_LENGTH];
+
+        memset(frames[i], (int)(0x20U + i), sizeof(frames[i]));
+        memcpy(expected[i], frames[i], sizeof(frames[i]));
+        reference_md4_iv(codes[i]->iv, expected[i], lengths[i] - codes[i]->length, digest);
+        memcpy(&expected[i][lengths[i] - codes[i]->length], digest, codes[i]->length);
+    }
+
+    seal_pdus(codes, ptrs, lengths, 3);
+
+    assert_memory_equal(frames, expected, sizeof(expected));
+}
+
+extern int test_md4(void) {
+    int return_value = -1;
+
+    const struct CMUnitTest md4_tests[] = {
+        cmocka_unit_test(test_md4_oneblock),        /* One-shot MD4 matches MD4_Init/Update/Final */
+        cmocka_unit_test(test_md4_multi_rfc1320),   /* Test vectors of the MD4 specification */
+        cmocka_unit_test(test_md4_multi_kernels),   /* Every kernel the CPU supports matches the scalar MD4 */
+        cmocka_unit_test(test_seal_pdus),           /* Safety codes of different connections appended to a set of frames */
+    };
+
+    return_value = cmocka_run_group_tests_name("md4_tests", md4_tests, NULL, NULL);
+
+    return return_value;
+}
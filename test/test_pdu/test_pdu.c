@@ -0,0 +1,279 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdarg.h>
+#include <setjmp.h>
+#include "cmocka.h"
+
+#include "sm.h"
+#include "pdu.h"
+#include "md4.h"
+#include "log.h"
+
+static uint32_t My_GetTimestamp(void)
+{
+    return 1234U;
+}
+
+static const SmShared shared = { .Tlocal = My_GetTimestamp };
+
+static SmType sm = {
+    .channel = 0U,
+    .role = ROLE_CLIENT,
+    .state = STATE_UP,
+    .snt = 41,
+    .cst = 7,
+    .ctsr = 99,
+    .shared = &shared,
+};
+
+static int group_setup(void **state)
+{
+    (void)state;
+
+    /* Default safety code and frame templates, as Sm_Init derives them without configuration */
+    safety_code_init(&sm.safety_code, NULL);
+    pdu_templates_init(&sm.templates, &sm.safety_code, sm.receiver_id, sm.sender_id);
+
+    return 0;
+}
+
+/* Reference safety code: serialize without safety code, then MD4 over everything but the code */
+static void reference_frame(const PDU_S *pdu, uint8_t *buffer)
+{
+    MD4_CTX ctx;
+    uint8_t digest[MD4_DIGEST_LENGTH];
+    PDU_S tmp = *pdu;
+
+    tmp.safety_code = NULL;
+    serialize_pdu(&tmp, buffer, tmp.message_length);
+
+    MD4_Init(&ctx);
+    MD4_Update(&ctx, buffer, tmp.message_length - SAFETY_CODE_LENGTH);
+    MD4_Final(digest, &ctx);
+    memcpy(&buffer[tmp.message_length - SAFETY_CODE_LENGTH], digest, SAFETY_CODE_LENGTH);
+}
+
+static void test_encode_heartbeat(void **state)
+{
+    (void)state;
+
+    PDU_S pdu = { 0 };
+    uint8_t expected[MAX_BUFF_SIZE] = { 0 };
+    uint8_t frame[MAX_BUFF_SIZE] = { 0 };
+
+    HB(&sm, &pdu);
+    reference_frame(&pdu, expected);
+
+    assert_int_equal(encode_pdu(&pdu, &sm.safety_code, frame, sizeof(frame)), PDU_FIXED_FIELDS_LENGTH);
+    assert_memory_equal(frame, expected, PDU_FIXED_FIELDS_LENGTH);
+}
+
+static void test_encode_conn_req(void **state)
+{
+    (void)state;
+
+    PDU_S pdu = { 0 };
+    uint8_t expected[MAX_BUFF_SIZE] = { 0 };
+    uint8_t frame[MAX_BUFF_SIZE] = { 0 };
+
+    ConnReq(&sm, &pdu);
+    reference_frame(&pdu, expected);
+
+    assert_int_equal(encode_pdu(&pdu, &sm.safety_code, frame, sizeof(frame)), PDU_FIXED_FIELDS_LENGTH + CONN_REQ_PAYLOAD_LENGTH);
+    assert_memory_equal(frame, expected, pdu.message_length);
+}
+
+static void test_encode_data(void **state)
+{
+    (void)state;
+
+    PDU_S pdu = { 0 };
+    uint8_t expected[MAX_BUFF_SIZE] = { 0 };
+    uint8_t frame[MAX_BUFF_SIZE] = { 0 };
+    const uint8_t data[MAX_DATA_LENGTH] = "A payload long enough to need a second MD4 block";
+
+    Data(&sm, &pdu, sizeof(data), data);
+    reference_frame(&pdu, expected);
+
+    assert_int_equal(encode_pdu(&pdu, &sm.safety_code, frame, sizeof(frame)), PDU_FIXED_FIELDS_LENGTH + MAX_DATA_LENGTH);
+    assert_memory_equal(frame, expected, pdu.message_length);
+}
+
+static void test_encode_templates(void **state)
+{
+    (void)state;
+
+    PDU_S pdu = { 0 };
+    uint8_t from_template[MAX_BUFF_SIZE] = { 0 };
+    uint8_t from_fields[MAX_BUFF_SIZE] = { 0 };
+    void (*const builders[])(SmType *, PDU_S *) = { ConnReq, ConnResp, RetrReq, HB };
+
+    /* Patching a template gives the same frame as encoding every field */
+    for (size_t i = 0; i < sizeof(builders) / sizeof(builders[0]); i++) {
+        builders[i](&sm, &pdu);
+        assert_non_null(pdu.frame_template);
+        const size_t length = encode_pdu(&pdu, &sm.safety_code, from_template, sizeof(from_template));
+
+        pdu.frame_template = NULL;
+        assert_int_equal(encode_pdu(&pdu, &sm.safety_code, from_fields, sizeof(from_fields)), length);
+        assert_memory_equal(from_template, from_fields, length);
+    }
+
+    /* A template encoded for another safety code length is not used */
+    SmType other = sm;
+    const SafetyCodeConfig full = { .type = SAFETY_CODE_FULL_MD4 };
+    safety_code_init(&other.safety_code, &full);
+    HB(&other, &pdu);
+    encode_pdu(&pdu, &other.safety_code, from_template, sizeof(from_template));
+    assert_int_equal(from_template[PDU_OFFSET_MESSAGE_LENGTH + 1], PDU_HEADER_LENGTH + MD4_DIGEST_LENGTH);
+}
+
+static void test_encode_frame_too_small(void **state)
+{
+    (void)state;
+
+    PDU_S pdu = { 0 };
+    uint8_t frame[PDU_FIXED_FIELDS_LENGTH] = { 0 };
+
+    ConnReq(&sm, &pdu);
+
+    assert_int_equal(encode_pdu(&pdu, &sm.safety_code, frame, sizeof(frame)), 0);
+}
+
+static void test_encode_keyed_full_md4(void **state)
+{
+    (void)state;
+
+    const SafetyCodeConfig config = {
+        .type = SAFETY_CODE_FULL_MD4,
+        .key = { 0x01234567U, 0x89abcdefU, 0xfedcba98U, 0x76543210U },
+    };
+    SmType keyed = sm;
+    PDU_S pdu = { 0 };
+    PDU_View view;
+    MD4_CTX ctx;
+    uint8_t digest[MD4_DIGEST_LENGTH];
+    uint8_t frame[MAX_BUFF_SIZE] = { 0 };
+    const uint8_t data[MAX_DATA_LENGTH] = "Long enough for the general MD4 path";
+
+    keyed.safety_code_config = &config;
+    safety_code_init(&keyed.safety_code, keyed.safety_code_config);
+
+    /* One PDU hashed in a single block and one that takes the general path */
+    HB(&keyed, &pdu);
+    assert_int_equal(encode_pdu(&pdu, &keyed.safety_code, frame, sizeof(frame)), PDU_HEADER_LENGTH + MD4_DIGEST_LENGTH);
+    MD4_InitIV(&ctx, keyed.safety_code.iv);
+    MD4_Update(&ctx, frame, PDU_HEADER_LENGTH);
+    MD4_Final(digest, &ctx);
+    assert_memory_equal(&frame[PDU_HEADER_LENGTH], digest, MD4_DIGEST_LENGTH);
+    assert_int_equal(keyed.safety_code.iv[0], config.key[0]);
+
+    Data(&keyed, &pdu, sizeof(data), data);
+    assert_int_equal(encode_pdu(&pdu, &keyed.safety_code, frame, sizeof(frame)), MAX_BUFF_SIZE);
+    MD4_InitIV(&ctx, keyed.safety_code.iv);
+    MD4_Update(&ctx, frame, PDU_HEADER_LENGTH + sizeof(data));
+    MD4_Final(digest, &ctx);
+    assert_memory_equal(&frame[PDU_HEADER_LENGTH + sizeof(data)], digest, MD4_DIGEST_LENGTH);
+
+    /* The view takes the connection's code length to find payload and safety code */
+    assert_true(pdu_view_init(&view, frame, sizeof(frame), keyed.safety_code.length));
+    assert_int_equal(pdu_view_payload_length(&view), sizeof(data));
+    assert_ptr_equal(pdu_view_safety_code(&view), &frame[PDU_HEADER_LENGTH + sizeof(data)]);
+}
+
+static void test_encode_no_safety_code(void **state)
+{
+    (void)state;
+
+    const SafetyCodeConfig config = { .type = SAFETY_CODE_NONE };
+    SmType plain = sm;
+    PDU_S pdu = { 0 };
+    PDU_View view;
+    uint8_t frame[MAX_BUFF_SIZE] = { 0 };
+
+    plain.safety_code_config = &config;
+    safety_code_init(&plain.safety_code, plain.safety_code_config);
+
+    ConnReq(&plain, &pdu);
+    assert_int_equal(encode_pdu(&pdu, &plain.safety_code, frame, sizeof(frame)), PDU_HEADER_LENGTH + CONN_REQ_PAYLOAD_LENGTH);
+    assert_true(pdu_view_init(&view, frame, pdu.message_length, plain.safety_code.length));
+    assert_int_equal(pdu_view_payload_length(&view), CONN_REQ_PAYLOAD_LENGTH);
+}
+
+static void test_view_decodes_fields(void **state)
+{
+    (void)state;
+
+    PDU_S pdu = { 0 };
+    PDU_View view;
+    uint8_t frame[MAX_BUFF_SIZE] = { 0 };
+    const uint8_t data[5] = "data";
+
+    Data(&sm, &pdu, sizeof(data), data);
+    encode_pdu(&pdu, &sm.safety_code, frame, sizeof(frame));
+
+    assert_true(pdu_view_init(&view, frame, pdu.message_length, SAFETY_CODE_LENGTH));
+    assert_int_equal(view.message_length, pdu.message_length);
+    assert_int_equal(view.message_type, DATA);
+    assert_int_equal(pdu_view_receiver_id(&view), pdu.receiver_id);
+    assert_int_equal(pdu_view_sender_id(&view), pdu.sender_id);
+    assert_int_equal(pdu_view_sequence_number(&view), pdu.sequence_number);
+    assert_int_equal(pdu_view_confirmed_sequence_number(&view), pdu.confirmed_sequence_number);
+    assert_int_equal(pdu_view_timestamp(&view), pdu.timestamp);
+    assert_int_equal(pdu_view_confirmed_timestamp(&view), pdu.confirmed_timestamp);
+    assert_int_equal(pdu_view_payload_length(&view), sizeof(data));
+    assert_memory_equal(pdu_view_payload(&view), data, sizeof(data));
+    assert_ptr_equal(pdu_view_safety_code(&view), &frame[pdu.message_length - SAFETY_CODE_LENGTH]);
+}
+
+static void test_view_rejects_malformed(void **state)
+{
+    (void)state;
+
+    PDU_S pdu = { 0 };
+    PDU_View view;
+    uint8_t frame[MAX_BUFF_SIZE] = { 0 };
+
+    HB(&sm, &pdu);
+    encode_pdu(&pdu, &sm.safety_code, frame, sizeof(frame));
+
+    /* Shorter than the fixed fields */
+    assert_false(pdu_view_init(&view, frame, PDU_FIXED_FIELDS_LENGTH - 1, SAFETY_CODE_LENGTH));
+
+    /* Length that does not match the message type */
+    frame[PDU_OFFSET_MESSAGE_LENGTH + 1] = PDU_FIXED_FIELDS_LENGTH + 4;
+    assert_false(pdu_view_init(&view, frame, sizeof(frame), SAFETY_CODE_LENGTH));
+    frame[PDU_OFFSET_MESSAGE_LENGTH + 1] = PDU_FIXED_FIELDS_LENGTH;
+
+    /* Unknown message type */
+    frame[PDU_OFFSET_MESSAGE_TYPE + 1] = 0;
+    assert_false(pdu_view_init(&view, frame, sizeof(frame), SAFETY_CODE_LENGTH));
+
+    /* Data longer than the buffer that holds it */
+    const uint8_t data[8] = "payload";
+    Data(&sm, &pdu, sizeof(data), data);
+    encode_pdu(&pdu, &sm.safety_code, frame, sizeof(frame));
+    assert_false(pdu_view_init(&view, frame, pdu.message_length - 1, SAFETY_CODE_LENGTH));
+    assert_true(pdu_view_init(&view, frame, pdu.message_length, SAFETY_CODE_LENGTH));
+}
+
+extern int test_pdu(void) {
+    int return_value = -1;
+
+    const struct CMUnitTest pdu_tests[] = {
+        cmocka_unit_test(test_encode_heartbeat),        /* Heartbeat encodes to header plus safety code */
+        cmocka_unit_test(test_encode_conn_req),         /* ConnReq carries the version payload */
+        cmocka_unit_test(test_encode_data),             /* Data spanning more than one MD4 block */
+        cmocka_unit_test(test_encode_templates),        /* Frames built from templates match fully encoded ones */
+        cmocka_unit_test(test_encode_frame_too_small),  /* Frames that cannot hold the PDU are refused */
+        cmocka_unit_test(test_encode_keyed_full_md4),   /* Full MD4 safety code from a keyed initial state */
+        cmocka_unit_test(test_encode_no_safety_code),   /* Connections configured without safety code */
+        cmocka_unit_test(test_view_decodes_fields),     /* The view decodes the fields the encoder wrote */
+        cmocka_unit_test(test_view_rejects_malformed),  /* Bad lengths and types never produce a view */
+    };
+
+    return_value = cmocka_run_group_tests_name("pdu_tests", pdu_tests, group_setup, NULL);
+
+    return return_value;
+}
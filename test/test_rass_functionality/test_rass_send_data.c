@@ -122,9 +122,9 @@ static void test_rass_receive_spdu(void **state)
 {
     PDU_S *pPdu = (PDU_S*)(*state);
     StdRet_t ret = OK;
-    uint8_t buffer[50];
+    uint8_t buffer[MAX_BUFF_SIZE];
 
-    serialize_pdu(pPdu, buffer, pPdu->message_length);
+    encode_pdu(pPdu, &sms[0].safety_code, buffer, sizeof(buffer));
     ret = Rass_ReceiveSpdu(0, pPdu->message_length, buffer);
     assert_true(ret == OK);
     printf("state: %d\n", sms[0].state);
@@ -0,0 +1,331 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdarg.h>
+#include <setjmp.h>
+#include "cmocka.h"
+
+#include "sm.h"
+#include "safecom.h"
+#include "log.h"
+
+#define MAX_CONNECTIONS 3U
+
+static StdRet_t My_ReceiveMsg(const MsgId_t msgId, const MsgLen_t msgLen, const uint8_t* const pMsgData);
+static StdRet_t My_SendSpdu(const NodeId_t nodeId, const SpduLen_t spduLen, const uint8_t* const pSpduData);
+static StdRet_t My_SendSpduBatch(const SafeComSpdu* const pSpdus, const uint32_t count);
+static StdRet_t My_SendSpduV(const NodeId_t nodeId, const SafeComSegment* const pSegments, const uint32_t count);
+static StdRet_t My_SendSpduAsync(const NodeId_t nodeId, const SpduLen_t spduLen, const uint8_t* const pSpduData);
+
+static SmType sms[MAX_CONNECTIONS] = { 0 };
+static SafeCom server;
+static uint32_t sent_spdus = 0;
+static uint32_t sent_batches = 0;
+static SafeComSpdu last_batch[SAFECOM_MAX_BATCH];
+static SafeComSegment last_segments[SAFECOM_SPDU_SEGMENTS];
+static uint32_t last_segment_count = 0;
+static uint8_t gathered[MAX_BUFF_SIZE];
+static SpduLen_t gathered_len = 0;
+static const uint8_t *held[SM_TX_FRAMES + 1];
+static uint32_t held_count = 0;
+
+/* Clock of the peer connection, which has no instance */
+static const SmShared peer_shared = { .Tlocal = GetCurrentTimestamp };
+
+/* Peer connection used to build the SPDUs the server receives */
+static SmType peer = {
+    .role = ROLE_CLIENT,
+    .shared = &peer_shared,
+};
+
+static void test_batch_init(void **state)
+{
+    (void)state;
+
+    const SafeComType config = {
+        .vtable = { .SendSpdu = My_SendSpdu, .ReceiveMsg = My_ReceiveMsg },
+        .config = { .instname = "server", .role = ROLE_SERVER, .max_connections = MAX_CONNECTIONS, .sms = sms },
+    };
+
+    assert_true(SafeCom_Init(&server, &config) == OK);
+    safety_code_init(&peer.safety_code, NULL);
+    for (MsgId_t i = 0; i < MAX_CONNECTIONS; i++)
+    {
+        assert_true(SafeCom_OpenConnection(&server, i) == OK);
+        assert_true(sms[i].state == STATE_DOWN);
+    }
+}
+
+static void test_batch_receive(void **state)
+{
+    (void)state;
+
+    PDU_S pdu = { 0 };
+    uint8_t conn_req[MAX_BUFF_SIZE];
+    uint8_t hb[MAX_BUFF_SIZE];
+    const uint8_t malformed[PDU_FIXED_FIELDS_LENGTH] = { 0 };
+
+    ConnReq(&peer, &pdu);
+    const SpduLen_t conn_req_len = (SpduLen_t)encode_pdu(&pdu, &peer.safety_code, conn_req, sizeof(conn_req));
+    peer.ctsr = GetCurrentTimestamp() + 1;
+    HB(&peer, &pdu);
+    const SpduLen_t hb_len = (SpduLen_t)encode_pdu(&pdu, &peer.safety_code, hb, sizeof(hb));
+
+    /* Connection 0 gets its ConnReq and HB interleaved with frames for other connections */
+    const SafeComSpdu burst[] = {
+        { .nodeId = 2, .spduLen = conn_req_len, .pSpduData = conn_req },
+        { .nodeId = 0, .spduLen = conn_req_len, .pSpduData = conn_req },
+        { .nodeId = 1, .spduLen = sizeof(malformed), .pSpduData = malformed },
+        { .nodeId = MAX_CONNECTIONS, .spduLen = conn_req_len, .pSpduData = conn_req },
+        { .nodeId = 0, .spduLen = hb_len, .pSpduData = hb },
+    };
+
+    sent_spdus = 0;
+    assert_true(SafeCom_ReceiveSpduBatch(&server, burst, sizeof(burst) / sizeof(burst[0])) == NOT_OK);
+
+    assert_true(sms[0].state == STATE_UP);      /* ConnReq handled before the HB that followed it */
+    assert_true(sms[1].state == STATE_DOWN);    /* Malformed frame never reached the state machine */
+    assert_int_equal(sms[1].rx_dropped, 1);
+    assert_true(sms[2].state == STATE_START);
+    assert_int_equal(sent_spdus, 2);            /* One ConnResp per accepted ConnReq */
+}
+
+static void test_receive_corrupted(void **state)
+{
+    (void)state;
+
+    PDU_S pdu = { 0 };
+    uint8_t hb[MAX_BUFF_SIZE];
+    uint8_t corrupted[MAX_BUFF_SIZE];
+
+    peer.snt++;
+    peer.ctsr = GetCurrentTimestamp() + 1;
+    HB(&peer, &pdu);
+    const SpduLen_t hb_len = (SpduLen_t)encode_pdu(&pdu, &peer.safety_code, hb, sizeof(hb));
+    memcpy(corrupted, hb, hb_len);
+    corrupted[PDU_OFFSET_TIMESTAMP] ^= 0x01U;
+
+    const uint32_t dropped = sms[0].rx_dropped;
+    const int32_t snr = sms[0].snr;
+
+    /* Single frame and burst: a flipped bit in the header is caught by the safety code */
+    assert_true(SafeCom_ReceiveSpdu(&server, 0, hb_len, corrupted) == NOT_OK);
+    assert_int_equal(sms[0].rx_dropped, dropped + 1);
+
+    const SafeComSpdu burst[] = {
+        { .nodeId = 0, .spduLen = hb_len, .pSpduData = corrupted },
+        { .nodeId = 2, .spduLen = hb_len, .pSpduData = corrupted },
+    };
+    assert_true(SafeCom_ReceiveSpduBatch(&server, burst, sizeof(burst) / sizeof(burst[0])) == NOT_OK);
+    assert_int_equal(sms[0].rx_dropped, dropped + 2);
+    assert_int_equal(sms[2].rx_dropped, 1);
+    assert_int_equal(sms[0].snr, snr);
+    assert_true(sms[0].state == STATE_UP);
+
+    /* The intact frame still gets through */
+    assert_true(SafeCom_ReceiveSpdu(&server, 0, hb_len, hb) == OK);
+    assert_int_equal(sms[0].rx_dropped, dropped + 2);
+}
+
+static void test_batch_send(void **state)
+{
+    (void)state;
+
+    const uint8_t first[] = "first";
+    const uint8_t second[] = "second message";
+    const SafeComMsg msgs[] = {
+        { .msgId = 0, .msgLen = sizeof(first), .pMsgData = first },
+        { .msgId = MAX_CONNECTIONS, .msgLen = sizeof(first), .pMsgData = first },
+        { .msgId = 0, .msgLen = sizeof(second), .pMsgData = second },
+        { .msgId = 0, .msgLen = MAX_DATA_LENGTH + 1, .pMsgData = second },
+    };
+
+    server.vtable.SendSpduBatch = My_SendSpduBatch;
+    sent_spdus = 0;
+    sent_batches = 0;
+
+    assert_true(SafeCom_SendDataBatch(&server, msgs, sizeof(msgs) / sizeof(msgs[0])) == NOT_OK);
+
+    /* Valid messages leave in one batch, as consecutive frames of one arena */
+    assert_int_equal(sent_batches, 1);
+    assert_int_equal(sent_spdus, 2);
+    assert_ptr_equal(last_batch[1].pSpduData, last_batch[0].pSpduData + last_batch[0].spduLen);
+
+    PDU_View first_view;
+    PDU_View second_view;
+    assert_true(pdu_view_init(&first_view, last_batch[0].pSpduData, last_batch[0].spduLen, SAFETY_CODE_LENGTH));
+    assert_true(pdu_view_init(&second_view, last_batch[1].pSpduData, last_batch[1].spduLen, SAFETY_CODE_LENGTH));
+    assert_int_equal(first_view.message_type, DATA);
+    assert_memory_equal(pdu_view_payload(&first_view), first, sizeof(first));
+    assert_memory_equal(pdu_view_payload(&second_view), second, sizeof(second));
+    assert_int_equal(pdu_view_sequence_number(&second_view), pdu_view_sequence_number(&first_view) + 1);
+
+    server.vtable.SendSpduBatch = NULL;
+}
+
+static void test_send_segments(void **state)
+{
+    (void)state;
+
+    const uint8_t data[] = "sent without a copy";
+    PDU_View view;
+
+    server.vtable.SendSpduV = My_SendSpduV;
+    sent_spdus = 0;
+
+    assert_true(SafeCom_SendData(&server, 0, sizeof(data), data) == OK);
+
+    /* Header, the application's own buffer and the safety code */
+    assert_int_equal(sent_spdus, 1);
+    assert_int_equal(last_segment_count, 3);
+    assert_int_equal(last_segments[0].len, PDU_HEADER_LENGTH);
+    assert_ptr_equal(last_segments[1].pData, data);
+    assert_int_equal(last_segments[1].len, sizeof(data));
+    assert_int_equal(last_segments[2].len, SAFETY_CODE_LENGTH);
+
+    /* Put together, the segments are the frame SendSpdu would have sent */
+    assert_true(pdu_view_init_verified(&view, gathered, gathered_len, &sms[0].safety_code));
+    assert_int_equal(view.message_type, DATA);
+    assert_memory_equal(pdu_view_payload(&view), data, sizeof(data));
+
+    server.vtable.SendSpduV = NULL;
+}
+
+static void test_send_async(void **state)
+{
+    (void)state;
+
+    const uint8_t data[] = "held by the transport";
+    const uint8_t foreign[MAX_BUFF_SIZE] = { 0 };
+
+    server.vtable.SendSpduAsync = My_SendSpduAsync;
+    held_count = 0;
+
+    /* Every frame the transport holds is a different one of the connection */
+    for (uint32_t i = 0; i < SM_TX_FRAMES; i++)
+    {
+        assert_true(SafeCom_SendData(&server, 0, sizeof(data), data) == OK);
+        assert_int_equal(held_count, i + 1);
+        assert_ptr_equal(held[i], sms[0].tx_frames[i].data);
+    }
+
+    /* With all frames held, the next PDU cannot be sent */
+    const uint32_t dropped = sms[0].tx_dropped;
+    assert_true(SafeCom_SendData(&server, 0, sizeof(data), data) == OK);
+    assert_int_equal(held_count, SM_TX_FRAMES);
+    assert_int_equal(sms[0].tx_dropped, dropped + 1);
+
+    /* A released frame is used again */
+    assert_true(SafeCom_ReleaseSpdu(&server, 0, held[1]) == OK);
+    assert_true(SafeCom_ReleaseSpdu(&server, 0, held[1]) == NOT_OK);
+    assert_true(SafeCom_ReleaseSpdu(&server, 0, foreign) == NOT_OK);
+    assert_true(SafeCom_ReleaseSpdu(&server, MAX_CONNECTIONS, held[0]) == NOT_OK);
+    assert_true(SafeCom_SendData(&server, 0, sizeof(data), data) == OK);
+    assert_int_equal(held_count, SM_TX_FRAMES + 1);
+    assert_ptr_equal(held[SM_TX_FRAMES], held[1]);
+
+    for (uint32_t i = 0; i < SM_TX_FRAMES; i++)
+    {
+        assert_true(SafeCom_ReleaseSpdu(&server, 0, sms[0].tx_frames[i].data) == OK);
+    }
+    server.vtable.SendSpduAsync = NULL;
+}
+
+static void test_two_instances(void **state)
+{
+    (void)state;
+
+    SmType other_sms[MAX_CONNECTIONS] = { 0 };
+    SafeCom other;
+    const SafeComType config = {
+        .vtable = { .SendSpdu = My_SendSpdu, .ReceiveMsg = My_ReceiveMsg },
+        .config = { .instname = "other", .role = ROLE_CLIENT, .max_connections = MAX_CONNECTIONS, .sms = other_sms },
+    };
+    const State state_before = sms[0].state;
+    const int32_t snt_before = sms[0].snt;
+
+    /* A second endpoint in the same process works on its own connections only */
+    assert_true(SafeCom_Init(&other, &config) == OK);
+    assert_true(SafeCom_OpenConnection(&other, 0) == OK);
+    assert_true(other_sms[0].state == STATE_START);
+    assert_true(other_sms[0].shared->vtable == &other.vtable);
+
+    assert_true(sms[0].state == state_before);
+    assert_int_equal(sms[0].snt, snt_before);
+    assert_true(sms[0].shared->vtable == &server.vtable);
+
+    const uint8_t data[] = "still the server";
+    assert_true(SafeCom_SendData(&server, 0, sizeof(data), data) == OK);
+    assert_int_equal(sms[0].snt, snt_before + 1);
+    assert_true(other_sms[0].state == STATE_START);
+}
+
+extern int test_safecom_batch(void) {
+    int return_value = -1;
+
+    const struct CMUnitTest safecom_batch_tests[] = {
+        cmocka_unit_test(test_batch_init),      /* Server with all connections waiting for ConnReq */
+        cmocka_unit_test(test_batch_receive),   /* One burst for several connections */
+        cmocka_unit_test(test_receive_corrupted), /* Frames with a wrong safety code are dropped and counted */
+        cmocka_unit_test(test_batch_send),      /* Several messages handed to the transport at once */
+        cmocka_unit_test(test_send_segments),   /* Header, payload and safety code as separate segments */
+        cmocka_unit_test(test_send_async),      /* Frames held by the transport until released */
+        cmocka_unit_test(test_two_instances),   /* Independent instances in one process */
+    };
+
+    return_value = cmocka_run_group_tests_name("safecom_batch_tests", safecom_batch_tests, NULL, NULL);
+
+    return return_value;
+}
+
+static StdRet_t My_ReceiveMsg(const MsgId_t msgId, const MsgLen_t msgLen, const uint8_t* const pMsgData)
+{
+    (void)msgId;
+    (void)msgLen;
+    (void)pMsgData;
+
+    return OK;
+}
+
+static StdRet_t My_SendSpdu(const NodeId_t nodeId, const SpduLen_t spduLen, const uint8_t* const pSpduData)
+{
+    (void)nodeId;
+    (void)spduLen;
+    (void)pSpduData;
+
+    sent_spdus++;
+    return OK;
+}
+
+static StdRet_t My_SendSpduBatch(const SafeComSpdu* const pSpdus, const uint32_t count)
+{
+    memcpy(last_batch, pSpdus, count * sizeof(SafeComSpdu));
+    sent_spdus += count;
+    sent_batches++;
+    return OK;
+}
+
+static StdRet_t My_SendSpduV(const NodeId_t nodeId, const SafeComSegment* const pSegments, const uint32_t count)
+{
+    (void)nodeId;
+
+    gathered_len = 0;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        last_segments[i] = pSegments[i];
+        memcpy(&gathered[gathered_len], pSegments[i].pData, pSegments[i].len);
+        gathered_len += pSegments[i].len;
+    }
+    last_segment_count = count;
+    sent_spdus++;
+    return OK;
+}
+
+static StdRet_t My_SendSpduAsync(const NodeId_t nodeId, const SpduLen_t spduLen, const uint8_t* const pSpduData)
+{
+    (void)nodeId;
+    (void)spduLen;
+
+    held[held_count++] = pSpduData;
+    return OK;
+}
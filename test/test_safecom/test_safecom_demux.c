@@ -0,0 +1,190 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdarg.h>
+#include <setjmp.h>
+#include "cmocka.h"
+
+#include "sm.h"
+#include "safecom.h"
+#include "demux.h"
+#include "log.h"
+
+#define MAX_CONNECTIONS 3U
+#define DEMUX_ENTRIES   8U
+#define OWN_ID          100U
+
+static StdRet_t My_ReceiveMsg(const MsgId_t msgId, const MsgLen_t msgLen, const uint8_t* const pMsgData);
+static StdRet_t My_SendSpdu(const NodeId_t nodeId, const SpduLen_t spduLen, const uint8_t* const pSpduData);
+
+static SmType sms[MAX_CONNECTIONS] = { 0 };
+static const SmShared peer_shared = { .Tlocal = GetCurrentTimestamp };
+static DemuxEntry entries[DEMUX_ENTRIES];
+static Demux demux;
+static SafeCom server;
+static uint32_t sent_spdus = 0;
+static NodeId_t last_channel = 0;
+static uint32_t last_sender_id = 0;
+static uint32_t last_receiver_id = 0;
+
+/* Connections 0 and 1 share node 7 and are told apart by the peer's RaSTA id */
+static const SafeComPeer peers[MAX_CONNECTIONS] = {
+    { .nodeId = 7, .sender_id = OWN_ID, .receiver_id = 200 },
+    { .nodeId = 7, .sender_id = OWN_ID, .receiver_id = 201 },
+    { .nodeId = 8, .sender_id = OWN_ID, .receiver_id = 200 },
+};
+
+/* ConnReq of a peer with the given RaSTA ids */
+static SpduLen_t conn_req(const uint32_t sender_id, const uint32_t receiver_id, uint8_t* const buffer)
+{
+    SmType peer = { .role = ROLE_CLIENT, .shared = &peer_shared };
+    PDU_S pdu = { 0 };
+
+    peer.sender_id = sender_id;
+    peer.receiver_id = receiver_id;
+    safety_code_init(&peer.safety_code, NULL);
+    ConnReq(&peer, &pdu);
+
+    return (SpduLen_t)encode_pdu(&pdu, &peer.safety_code, buffer, MAX_BUFF_SIZE);
+}
+
+static void test_demux_table(void **state)
+{
+    (void)state;
+
+    const DemuxKey a = { .nodeId = 1, .sender_id = 2, .receiver_id = 3 };
+    const DemuxKey b = { .nodeId = 1, .sender_id = 3, .receiver_id = 2 };
+
+    assert_true(demux_init(&demux, entries, 6) == NOT_OK);
+    assert_true(demux_init(&demux, entries, 4) == OK);
+
+    assert_int_equal(demux_find(&demux, &a), DEMUX_NONE);
+    assert_true(demux_add(&demux, &a, 0) == OK);
+    assert_true(demux_add(&demux, &b, 1) == OK);
+    assert_true(demux_add(&demux, &a, 2) == NOT_OK);
+    assert_int_equal(demux_find(&demux, &a), 0);
+    assert_int_equal(demux_find(&demux, &b), 1);
+
+    /* Keys beyond the size of the table are refused, the others still found */
+    for (uint32_t i = 2; i < 4; i++) {
+        const DemuxKey key = { .nodeId = i, .sender_id = 2, .receiver_id = 3 };
+        assert_true(demux_add(&demux, &key, i) == OK);
+    }
+    const DemuxKey extra = { .nodeId = 9, .sender_id = 2, .receiver_id = 3 };
+    assert_true(demux_add(&demux, &extra, 4) == NOT_OK);
+    assert_int_equal(demux_find(&demux, &extra), DEMUX_NONE);
+    assert_int_equal(demux_find(&demux, &b), 1);
+}
+
+static void test_demux_route(void **state)
+{
+    (void)state;
+
+    uint8_t frame[MAX_BUFF_SIZE];
+    const SafeComType config = {
+        .vtable = { .SendSpdu = My_SendSpdu, .ReceiveMsg = My_ReceiveMsg },
+        .config = { .instname = "server", .role = ROLE_SERVER, .max_connections = MAX_CONNECTIONS, .sms = sms,
+                    .peers = peers, .demux = &demux },
+    };
+
+    assert_true(demux_init(&demux, entries, DEMUX_ENTRIES) == OK);
+    assert_true(SafeCom_Init(&server, &config) == OK);
+    for (MsgId_t i = 0; i < MAX_CONNECTIONS; i++) {
+        assert_true(SafeCom_OpenConnection(&server, i) == OK);
+    }
+
+    /* Node 7, peer 201: the second connection, answered with its own ids on its channel */
+    SpduLen_t len = conn_req(201, OWN_ID, frame);
+    sent_spdus = 0;
+    assert_true(SafeCom_ReceiveSpdu(&server, 7, len, frame) == OK);
+    assert_true(sms[0].state == STATE_DOWN);
+    assert_true(sms[1].state == STATE_START);
+    assert_int_equal(sent_spdus, 1);
+    assert_int_equal(last_channel, 1);
+    assert_int_equal(last_sender_id, OWN_ID);
+    assert_int_equal(last_receiver_id, 201);
+
+    /* The same ids from another node belong to another connection */
+    len = conn_req(200, OWN_ID, frame);
+    const SafeComSpdu burst[] = {
+        { .nodeId = 8, .spduLen = len, .pSpduData = frame },
+        { .nodeId = 9, .spduLen = len, .pSpduData = frame },
+    };
+    assert_true(SafeCom_ReceiveSpduBatch(&server, burst, sizeof(burst) / sizeof(burst[0])) == NOT_OK);
+    assert_true(sms[0].state == STATE_DOWN);
+    assert_true(sms[2].state == STATE_START);
+    assert_int_equal(demux.unknown, 1);
+}
+
+static void test_demux_unknown(void **state)
+{
+    (void)state;
+
+    uint8_t frame[MAX_BUFF_SIZE];
+    const uint32_t unknown = demux.unknown;
+
+    /* Unknown sender or receiver id: rejected by the table, no connection sees the SPDU */
+    SpduLen_t len = conn_req(999, OWN_ID, frame);
+    assert_true(SafeCom_ReceiveSpdu(&server, 7, len, frame) == NOT_OK);
+    len = conn_req(200, OWN_ID + 1U, frame);
+    assert_true(SafeCom_ReceiveSpdu(&server, 7, len, frame) == NOT_OK);
+    /* Too short to carry the ids */
+    assert_true(SafeCom_ReceiveSpdu(&server, 7, PDU_OFFSET_SENDER_ID, frame) == NOT_OK);
+
+    assert_int_equal(demux.unknown, unknown + 3U);
+    for (MsgId_t i = 0; i < MAX_CONNECTIONS; i++) {
+        assert_int_equal(sms[i].rx_dropped, 0);
+    }
+    assert_true(sms[0].state == STATE_DOWN);
+
+    /* Taken ids make the init fail; a table of its own, the server keeps routing through demux */
+    SafeCom twice;
+    Demux twice_demux;
+    DemuxEntry twice_entries[DEMUX_ENTRIES];
+    const SafeComPeer same[2] = { peers[0], peers[0] };
+    SmType pair[2] = { 0 };
+    const SafeComType config = {
+        .vtable = { .SendSpdu = My_SendSpdu, .ReceiveMsg = My_ReceiveMsg },
+        .config = { .instname = "twice", .role = ROLE_SERVER, .max_connections = 2, .sms = pair, .peers = same, .demux = &twice_demux },
+    };
+    assert_true(demux_init(&twice_demux, twice_entries, DEMUX_ENTRIES) == OK);
+    assert_true(SafeCom_Init(&twice, &config) == NOT_OK);
+    const DemuxKey second = { .nodeId = 7, .sender_id = 201, .receiver_id = OWN_ID };
+    assert_int_equal(demux_find(&demux, &second), 1);
+}
+
+extern int test_safecom_demux(void) {
+    int return_value = -1;
+
+    const struct CMUnitTest safecom_demux_tests[] = {
+        cmocka_unit_test(test_demux_table),     /* Add, find, duplicate keys and a full table */
+        cmocka_unit_test(test_demux_route),     /* SPDUs reach the connection of their node and RaSTA ids */
+        cmocka_unit_test(test_demux_unknown),   /* Unknown ids are rejected before the state machines */
+    };
+
+    return_value = cmocka_run_group_tests_name("safecom_demux_tests", safecom_demux_tests, NULL, NULL);
+
+    return return_value;
+}
+
+static StdRet_t My_ReceiveMsg(const MsgId_t msgId, const MsgLen_t msgLen, const uint8_t* const pMsgData)
+{
+    (void)msgId;
+    (void)msgLen;
+    (void)pMsgData;
+
+    return OK;
+}
+
+static StdRet_t My_SendSpdu(const NodeId_t nodeId, const SpduLen_t spduLen, const uint8_t* const pSpduData)
+{
+    PDU_View view;
+
+    if (pdu_view_init(&view, pSpduData, spduLen, SAFETY_CODE_LENGTH)) {
+        last_sender_id = pdu_view_sender_id(&view);
+        last_receiver_id = pdu_view_receiver_id(&view);
+    }
+    last_channel = nodeId;
+    sent_spdus++;
+    return OK;
+}
@@ -0,0 +1,202 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdarg.h>
+#include <setjmp.h>
+#include <pthread.h>
+#include "cmocka.h"
+
+#include "safecom.h"
+#include "ingress.h"
+#include "log.h"
+
+#define MAX_CONNECTIONS 2U
+#define PRODUCERS       4U
+#define PER_PRODUCER    20000U
+
+static StdRet_t My_ReceiveMsg(const MsgId_t msgId, const MsgLen_t msgLen, const uint8_t* const pMsgData);
+static StdRet_t My_SendSpdu(const NodeId_t nodeId, const SpduLen_t spduLen, const uint8_t* const pSpduData);
+
+static Ingress queue;
+static SmType sms[MAX_CONNECTIONS] = { 0 };
+static const SmShared peer_shared = { .Tlocal = GetCurrentTimestamp };
+static uint32_t sent_spdus = 0;
+
+/* Producer threads post (producer, counter) pairs as node id and payload */
+static void* produce(void* arg)
+{
+    const NodeId_t producer = (NodeId_t)(uintptr_t)arg;
+
+    for (uint32_t i = 0; i < PER_PRODUCER; i++) {
+        while (!ingress_push(&queue, producer, sizeof(i), (const uint8_t *)&i)) {
+        }
+    }
+
+    return NULL;
+}
+
+static void test_ingress_order(void **state)
+{
+    (void)state;
+
+    const uint8_t frames[3][4] = { { 1 }, { 2, 2 }, { 3, 3, 3 } };
+    SafeComSpdu spdus[SAFECOM_MAX_BATCH];
+    uint32_t high_water = 0;
+    uint32_t overflows = 0;
+
+    ingress_init(&queue);
+    for (NodeId_t i = 0; i < 3; i++) {
+        assert_true(ingress_push(&queue, i, i + 1U, frames[i]));
+    }
+
+    /* Peeking leaves the SPDUs in the queue */
+    assert_int_equal(ingress_peek(&queue, spdus, 2), 2);
+    assert_int_equal(ingress_peek(&queue, spdus, SAFECOM_MAX_BATCH), 3);
+    for (NodeId_t i = 0; i < 3; i++) {
+        assert_int_equal(spdus[i].nodeId, i);
+        assert_int_equal(spdus[i].spduLen, i + 1U);
+        assert_memory_equal(spdus[i].pSpduData, frames[i], i + 1U);
+    }
+
+    ingress_release(&queue, 2);
+    assert_int_equal(ingress_peek(&queue, spdus, SAFECOM_MAX_BATCH), 1);
+    assert_int_equal(spdus[0].nodeId, 2);
+    ingress_release(&queue, 1);
+    assert_int_equal(ingress_peek(&queue, spdus, SAFECOM_MAX_BATCH), 0);
+
+    ingress_stats(&queue, &high_water, &overflows);
+    assert_int_equal(high_water, 3);
+    assert_int_equal(overflows, 0);
+}
+
+static void test_ingress_overflow(void **state)
+{
+    (void)state;
+
+    const uint8_t frame[MAX_BUFF_SIZE + 1U] = { 0 };
+    SafeComSpdu spdus[SAFECOM_MAX_BATCH];
+    uint32_t high_water = 0;
+    uint32_t overflows = 0;
+
+    ingress_init(&queue);
+    for (uint32_t i = 0; i < INGRESS_SIZE; i++) {
+        assert_true(ingress_push(&queue, 0, PDU_FIXED_FIELDS_LENGTH, frame));
+    }
+    assert_false(ingress_push(&queue, 0, PDU_FIXED_FIELDS_LENGTH, frame));
+
+    /* Space comes back once the consumer releases */
+    assert_int_equal(ingress_peek(&queue, spdus, 1), 1);
+    ingress_release(&queue, 1);
+    assert_true(ingress_push(&queue, 0, PDU_FIXED_FIELDS_LENGTH, frame));
+    assert_false(ingress_push(&queue, 0, sizeof(frame), frame));
+
+    ingress_stats(&queue, &high_water, &overflows);
+    assert_int_equal(high_water, INGRESS_SIZE);
+    assert_int_equal(overflows, 2);
+}
+
+static void test_ingress_threads(void **state)
+{
+    (void)state;
+
+    pthread_t threads[PRODUCERS];
+    uint32_t next[PRODUCERS] = { 0 };
+    SafeComSpdu spdus[SAFECOM_MAX_BATCH];
+    uint32_t received = 0;
+
+    ingress_init(&queue);
+    for (uintptr_t p = 0; p < PRODUCERS; p++) {
+        assert_int_equal(pthread_create(&threads[p], NULL, produce, (void *)p), 0);
+    }
+
+    /* Drained while the producers are still running; every producer's SPDUs arrive in order */
+    while (received < (PRODUCERS * PER_PRODUCER)) {
+        const uint32_t count = ingress_peek(&queue, spdus, SAFECOM_MAX_BATCH);
+
+        for (uint32_t i = 0; i < count; i++) {
+            uint32_t value;
+
+            assert_true(spdus[i].nodeId < PRODUCERS);
+            memcpy(&value, spdus[i].pSpduData, sizeof(value));
+            assert_int_equal(value, next[spdus[i].nodeId]);
+            next[spdus[i].nodeId]++;
+        }
+        ingress_release(&queue, count);
+        received += count;
+    }
+
+    for (uint32_t p = 0; p < PRODUCERS; p++) {
+        assert_int_equal(pthread_join(threads[p], NULL), 0);
+        assert_int_equal(next[p], PER_PRODUCER);
+    }
+}
+
+static void test_ingress_main(void **state)
+{
+    (void)state;
+
+    SafeCom server;
+    SmType peer = { .role = ROLE_CLIENT, .shared = &peer_shared };
+    PDU_S pdu = { 0 };
+    uint8_t conn_req[MAX_BUFF_SIZE];
+    const SafeComType config = {
+        .vtable = { .SendSpdu = My_SendSpdu, .ReceiveMsg = My_ReceiveMsg },
+        .config = { .instname = "server", .role = ROLE_SERVER, .max_connections = MAX_CONNECTIONS, .sms = sms, .ingress = &queue },
+    };
+
+    assert_true(SafeCom_Init(&server, &config) == OK);
+    assert_true(SafeCom_OpenConnection(&server, 1) == OK);
+
+    safety_code_init(&peer.safety_code, NULL);
+    ConnReq(&peer, &pdu);
+    const SpduLen_t conn_req_len = (SpduLen_t)encode_pdu(&pdu, &peer.safety_code, conn_req, sizeof(conn_req));
+
+    /* Posting only queues, SafeCom_Main hands the SPDU to the connection */
+    sent_spdus = 0;
+    assert_true(SafeCom_PostSpdu(&server, 1, conn_req_len, conn_req) == OK);
+    assert_true(sms[1].state == STATE_DOWN);
+    assert_true(SafeCom_Main(&server) == OK);
+    assert_true(sms[1].state == STATE_START);
+    assert_int_equal(sent_spdus, 1);
+
+    /* Without a queue, posting is refused */
+    SafeCom direct;
+    SafeComType direct_config = config;
+    direct_config.config.ingress = NULL;
+    assert_true(SafeCom_Init(&direct, &direct_config) == OK);
+    assert_true(SafeCom_PostSpdu(&direct, 1, conn_req_len, conn_req) == NOT_OK);
+}
+
+extern int test_safecom_ingress(void) {
+    int return_value = -1;
+
+    const struct CMUnitTest safecom_ingress_tests[] = {
+        cmocka_unit_test(test_ingress_order),       /* Queued SPDUs come out in order, in place */
+        cmocka_unit_test(test_ingress_overflow),    /* Full queue rejects and counts */
+        cmocka_unit_test(test_ingress_threads),     /* Several producers and a concurrent consumer */
+        cmocka_unit_test(test_ingress_main),        /* SafeCom_Main handles posted SPDUs */
+    };
+
+    return_value = cmocka_run_group_tests_name("safecom_ingress_tests", safecom_ingress_tests, NULL, NULL);
+
+    return return_value;
+}
+
+static StdRet_t My_ReceiveMsg(const MsgId_t msgId, const MsgLen_t msgLen, const uint8_t* const pMsgData)
+{
+    (void)msgId;
+    (void)msgLen;
+    (void)pMsgData;
+
+    return OK;
+}
+
+static StdRet_t My_SendSpdu(const NodeId_t nodeId, const SpduLen_t spduLen, const uint8_t* const pSpduData)
+{
+    (void)nodeId;
+    (void)spduLen;
+    (void)pSpduData;
+
+    sent_spdus++;
+    return OK;
+}
@@ -0,0 +1,203 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdarg.h>
+#include <setjmp.h>
+#include "cmocka.h"
+
+#include "safecom.h"
+#include "log.h"
+
+#define MAX_CONNECTIONS 5U
+#define BUDGET          2U
+
+static StdRet_t My_ReceiveMsg(const MsgId_t msgId, const MsgLen_t msgLen, const uint8_t* const pMsgData);
+static StdRet_t My_SendSpdu(const NodeId_t nodeId, const SpduLen_t spduLen, const uint8_t* const pSpduData);
+static StdRet_t My_SendSpduBatch(const SafeComSpdu* const pSpdus, const uint32_t count);
+
+static SmType sms[MAX_CONNECTIONS] = { 0 };
+static Ingress queue;
+static SafeCom server;
+static uint32_t now = 0xFFFFFF00U;   /* Behind GetCurrentTimestamp, so a wheel on the wrong clock would hold the timers back */
+static uint32_t sent_by_type[RETRANSMITTED_DATA - CONNECTION_REQUEST + 1];
+static uint32_t sent_spdus = 0;
+static uint32_t sent_batches = 0;
+
+static uint32_t Now(void)
+{
+    return now;
+}
+
+/* Clock of the peers that build the SPDUs the server receives */
+static const SmShared peer_shared = { .Tlocal = Now };
+
+static uint32_t sent(const MessageType type)
+{
+    return sent_by_type[type - CONNECTION_REQUEST];
+}
+
+static void reset_counters(void)
+{
+    memset(sent_by_type, 0, sizeof(sent_by_type));
+    sent_spdus = 0;
+    sent_batches = 0;
+}
+
+/* All connections of the server past a ConnReq, waiting for the client's first HB */
+static int start_server(void **state)
+{
+    (void)state;
+
+    const SafeComType config = {
+        .vtable = { .SendSpdu = My_SendSpdu, .ReceiveMsg = My_ReceiveMsg, .SendSpduBatch = My_SendSpduBatch },
+        .config = { .instname = "server", .role = ROLE_SERVER, .max_connections = MAX_CONNECTIONS, .sms = sms,
+                    .ingress = &queue, .main_budget = BUDGET, .Tlocal = Now },
+    };
+    SmType peer = { .role = ROLE_CLIENT, .shared = &peer_shared };
+    PDU_S pdu = { 0 };
+    uint8_t conn_req[MAX_BUFF_SIZE];
+
+    assert_true(SafeCom_Init(&server, &config) == OK);
+    safety_code_init(&peer.safety_code, NULL);
+    ConnReq(&peer, &pdu);
+    const SpduLen_t conn_req_len = (SpduLen_t)encode_pdu(&pdu, &peer.safety_code, conn_req, sizeof(conn_req));
+
+    for (MsgId_t i = 0; i < MAX_CONNECTIONS; i++) {
+        assert_true(SafeCom_OpenConnection(&server, i) == OK);
+        assert_true(SafeCom_ReceiveSpdu(&server, i, conn_req_len, conn_req) == OK);
+        assert_true(sms[i].state == STATE_START);
+    }
+    reset_counters();
+
+    return 0;
+}
+
+static void test_main_idle(void **state)
+{
+    (void)state;
+
+    /* Nothing due, nothing sent */
+    now += server.shared.timeouts.Th - 1U;
+    assert_true(SafeCom_Main(&server) == OK);
+    assert_int_equal(sent_spdus, 0);
+    assert_int_equal(sent_batches, 0);
+}
+
+static void test_main_heartbeat(void **state)
+{
+    (void)state;
+
+    /* Th elapsed: a HB per connection, BUDGET connections per call, one batch per call */
+    now += server.shared.timeouts.Th;
+    assert_true(SafeCom_Main(&server) == OK);
+    assert_int_equal(sent(HEARTBEAT), BUDGET);
+    assert_int_equal(sent_batches, 1);
+
+    assert_true(SafeCom_Main(&server) == OK);
+    assert_true(SafeCom_Main(&server) == OK);
+    assert_int_equal(sent(HEARTBEAT), MAX_CONNECTIONS);
+    assert_int_equal(sent_batches, 3);
+
+    /* The HBs restarted Th */
+    assert_true(SafeCom_Main(&server) == OK);
+    assert_int_equal(sent_spdus, MAX_CONNECTIONS);
+    for (MsgId_t i = 0; i < MAX_CONNECTIONS; i++) {
+        assert_true(sms[i].state == STATE_START);
+    }
+}
+
+static void test_main_timeout(void **state)
+{
+    (void)state;
+
+    /* Ti elapsed without anything received: every connection is closed with a DiscReq */
+    now += server.shared.timeouts.Tmax;
+    for (uint32_t call = 0; call < ((MAX_CONNECTIONS + BUDGET - 1U) / BUDGET); call++) {
+        assert_true(SafeCom_Main(&server) == OK);
+    }
+    assert_int_equal(sent(DISCONNECTION_REQUEST), MAX_CONNECTIONS);
+    assert_int_equal(sent(HEARTBEAT), 0);
+    for (MsgId_t i = 0; i < MAX_CONNECTIONS; i++) {
+        assert_true(sms[i].state == STATE_CLOSED);
+    }
+
+    /* Closed connections are not monitored */
+    reset_counters();
+    now += server.shared.timeouts.Tmax;
+    assert_true(SafeCom_Main(&server) == OK);
+    assert_int_equal(sent_spdus, 0);
+}
+
+static void test_main_rx_and_timers(void **state)
+{
+    (void)state;
+
+    SmType peer = { .role = ROLE_CLIENT, .shared = &peer_shared };
+    PDU_S pdu = { 0 };
+    uint8_t disc_req[MAX_BUFF_SIZE];
+
+    /* A posted DiscReq and a due HB in one call leave in one batch */
+    safety_code_init(&peer.safety_code, NULL);
+    peer.snt = sms[0].snr;
+    peer.cst = sms[0].snt - 1;
+    DiscReq(&peer, &pdu, USER_REQUEST, NO_DETAILED_REASON);
+    const SpduLen_t disc_req_len = (SpduLen_t)encode_pdu(&pdu, &peer.safety_code, disc_req, sizeof(disc_req));
+
+    now += server.shared.timeouts.Th;
+    assert_true(SafeCom_PostSpdu(&server, 0, disc_req_len, disc_req) == OK);
+    assert_true(SafeCom_Main(&server) == OK);
+
+    assert_true(sms[0].state == STATE_CLOSED);
+    assert_int_equal(sent_batches, 1);
+    assert_int_equal(sent(HEARTBEAT), BUDGET);
+}
+
+extern int test_safecom_main(void) {
+    int return_value = -1;
+
+    const struct CMUnitTest safecom_main_tests[] = {
+        cmocka_unit_test_setup(test_main_idle, start_server),           /* No timer due */
+        cmocka_unit_test_setup(test_main_heartbeat, start_server),      /* Th fired within the budget */
+        cmocka_unit_test_setup(test_main_timeout, start_server),        /* Ti fired, connections closed */
+        cmocka_unit_test_setup(test_main_rx_and_timers, start_server),  /* Posted SPDUs and timers in one batch */
+    };
+
+    return_value = cmocka_run_group_tests_name("safecom_main_tests", safecom_main_tests, NULL, NULL);
+
+    return return_value;
+}
+
+static StdRet_t My_ReceiveMsg(const MsgId_t msgId, const MsgLen_t msgLen, const uint8_t* const pMsgData)
+{
+    (void)msgId;
+    (void)msgLen;
+    (void)pMsgData;
+
+    return OK;
+}
+
+static void count(const SpduLen_t spduLen, const uint8_t* const pSpduData)
+{
+    PDU_View view;
+
+    assert_true(pdu_view_init(&view, pSpduData, spduLen, SAFETY_CODE_LENGTH));
+    sent_by_type[view.message_type - CONNECTION_REQUEST]++;
+    sent_spdus++;
+}
+
+static StdRet_t My_SendSpdu(const NodeId_t nodeId, const SpduLen_t spduLen, const uint8_t* const pSpduData)
+{
+    (void)nodeId;
+
+    count(spduLen, pSpduData);
+    return OK;
+}
+
+static StdRet_t My_SendSpduBatch(const SafeComSpdu* const pSpdus, const uint32_t count_spdus)
+{
+    for (uint32_t i = 0; i < count_spdus; i++) {
+        count(pSpdus[i].spduLen, pSpdus[i].pSpduData);
+    }
+    sent_batches++;
+    return OK;
+}
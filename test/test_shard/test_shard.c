@@ -0,0 +1,210 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdarg.h>
+#include <setjmp.h>
+#include "cmocka.h"
+
+#include "shard.h"
+#include "log.h"
+
+#define CONNECTIONS 10U
+#define FIRST_NODE  100U
+#define WORKERS     3U
+#define PRODUCERS   2U
+
+static StdRet_t My_ReceiveMsg(const MsgId_t msgId, const MsgLen_t msgLen, const uint8_t* const pMsgData);
+static StdRet_t My_SendSpdu(const NodeId_t nodeId, const SpduLen_t spduLen, const uint8_t* const pSpduData);
+
+static SmType sms[CONNECTIONS] = { 0 };
+static ShardEngine engine;
+static uint32_t sent_spdus = 0;
+static NodeId_t last_node = 0;
+
+static const SafeComType config = {
+    .vtable = { .SendSpdu = My_SendSpdu, .ReceiveMsg = My_ReceiveMsg },
+    .config = { .instname = "gateway", .role = ROLE_SERVER, .max_connections = CONNECTIONS, .first_node = FIRST_NODE, .sms = sms },
+};
+
+/* Clock of the peer connection, which has no instance */
+static const SmShared peer_shared = { .Tlocal = GetCurrentTimestamp };
+
+/* Peer connection used to build the SPDUs the workers receive */
+static SmType peer = {
+    .role = ROLE_CLIENT,
+    .shared = &peer_shared,
+};
+
+static uint32_t poll_all(void)
+{
+    uint32_t handled = 0;
+
+    for (uint32_t k = 0; k < WORKERS; k++) {
+        handled += Shard_Poll(&engine, k);
+    }
+
+    return handled;
+}
+
+static void test_shard_init(void **state)
+{
+    (void)state;
+
+    assert_true(Shard_Init(&engine, &config, 0, PRODUCERS) == NOT_OK);
+    assert_true(Shard_Init(&engine, &config, SHARD_MAX_WORKERS + 1U, PRODUCERS) == NOT_OK);
+    assert_true(Shard_Init(&engine, &config, WORKERS, SHARD_MAX_PRODUCERS + 1U) == NOT_OK);
+    assert_true(Shard_Init(&engine, &config, WORKERS, PRODUCERS) == OK);
+
+    /* Contiguous slices of 4, 4 and 2 connections, which keep their global node ids */
+    assert_ptr_equal(engine.shards[0].instance.config.sms, &sms[0]);
+    assert_ptr_equal(engine.shards[1].instance.config.sms, &sms[4]);
+    assert_ptr_equal(engine.shards[2].instance.config.sms, &sms[8]);
+    assert_int_equal(engine.shards[2].instance.config.max_connections, 2);
+    assert_int_equal(sms[5].channel, FIRST_NODE + 5U);
+    assert_true(sms[5].shared == &engine.shards[1].instance.shared);
+
+    /* 5 connections on 4 workers: slices of 2, 2 and 1, the last worker owns none and gets no array */
+    SafeComType five = config;
+    five.config.max_connections = 5U;
+    assert_true(Shard_Init(&engine, &five, 4U, PRODUCERS) == OK);
+    assert_int_equal(engine.shards[2].instance.config.max_connections, 1);
+    assert_ptr_equal(engine.shards[2].instance.config.sms, &sms[4]);
+    assert_int_equal(engine.shards[3].instance.config.max_connections, 0);
+    assert_null(engine.shards[3].instance.config.sms);
+    assert_null(engine.shards[3].instance.config.safety_codes);
+    assert_null(engine.shards[3].instance.config.peers);
+    assert_int_equal(Shard_Poll(&engine, 3), 0);
+    assert_true(SafeCom_Main(&engine.shards[3].instance) == OK);
+}
+
+static void test_shard_ingress(void **state)
+{
+    (void)state;
+
+    static Ingress ingress;
+    SafeComType shared_ingress = config;
+
+    /* The workers would all consume from the one queue; the engine refuses it */
+    shared_ingress.config.ingress = &ingress;
+    assert_true(Shard_Init(&engine, &shared_ingress, WORKERS, PRODUCERS) == NOT_OK);
+    assert_true(Shard_Init(&engine, &config, WORKERS, PRODUCERS) == OK);
+    for (uint32_t k = 0; k < WORKERS; k++) {
+        assert_null(engine.shards[k].instance.config.ingress);
+    }
+}
+
+static void test_shard_poll(void **state)
+{
+    (void)state;
+
+    PDU_S pdu = { 0 };
+    uint8_t conn_req[MAX_BUFF_SIZE];
+
+    assert_true(Shard_Init(&engine, &config, WORKERS, PRODUCERS) == OK);
+
+    /* Requests only take effect once the owning worker polls */
+    for (MsgId_t i = 0; i < CONNECTIONS; i++) {
+        assert_true(Shard_OpenConnection(&engine, i % PRODUCERS, FIRST_NODE + i) == OK);
+    }
+    assert_true(Shard_OpenConnection(&engine, 0, FIRST_NODE + CONNECTIONS) == NOT_OK);
+    assert_true(Shard_OpenConnection(&engine, PRODUCERS, FIRST_NODE) == NOT_OK);
+    assert_true(sms[0].state == STATE_CLOSED);
+    assert_int_equal(Shard_Poll(&engine, 0), 4);
+    assert_true(sms[0].state == STATE_DOWN);
+    assert_true(sms[4].state == STATE_CLOSED);
+    assert_int_equal(poll_all(), CONNECTIONS - 4U);
+    assert_true(sms[CONNECTIONS - 1U].state == STATE_DOWN);
+
+    /* A received SPDU reaches the connection of its node, the answer goes to the same node */
+    safety_code_init(&peer.safety_code, NULL);
+    ConnReq(&peer, &pdu);
+    const SpduLen_t conn_req_len = (SpduLen_t)encode_pdu(&pdu, &peer.safety_code, conn_req, sizeof(conn_req));
+
+    sent_spdus = 0;
+    assert_true(Shard_ReceiveSpdu(&engine, 1, FIRST_NODE + 5U, conn_req_len, conn_req) == OK);
+    assert_true(Shard_ReceiveSpdu(&engine, 1, FIRST_NODE - 1U, conn_req_len, conn_req) == NOT_OK);
+    assert_int_equal(poll_all(), 1);
+    assert_true(sms[5].state == STATE_START);
+    assert_int_equal(sent_spdus, 1);
+    assert_int_equal(last_node, FIRST_NODE + 5U);
+}
+
+static void test_shard_overflow(void **state)
+{
+    (void)state;
+
+    const uint8_t data[] = "queued";
+
+    assert_true(Shard_Init(&engine, &config, WORKERS, PRODUCERS) == OK);
+
+    /* A full ring rejects and counts, other rings of the worker are unaffected */
+    for (uint32_t i = 0; i < SHARD_RING_SIZE; i++) {
+        assert_true(Shard_SendData(&engine, 0, FIRST_NODE, sizeof(data), data) == OK);
+    }
+    assert_true(Shard_SendData(&engine, 0, FIRST_NODE, sizeof(data), data) == NOT_OK);
+    assert_true(Shard_SendData(&engine, 1, FIRST_NODE, sizeof(data), data) == OK);
+    assert_int_equal(Shard_Overflows(&engine, 0), 1);
+    assert_int_equal(Shard_Overflows(&engine, 1), 0);
+
+    assert_int_equal(Shard_Poll(&engine, 0), SHARD_RING_SIZE + 1U);
+    assert_true(Shard_SendData(&engine, 0, FIRST_NODE, sizeof(data), data) == OK);
+}
+
+static void test_shard_threads(void **state)
+{
+    (void)state;
+
+    assert_true(Shard_Init(&engine, &config, WORKERS, PRODUCERS) == OK);
+    assert_true(Shard_Start(&engine) == OK);
+
+    for (MsgId_t i = 0; i < CONNECTIONS; i++) {
+        assert_true(Shard_OpenConnection(&engine, i % PRODUCERS, FIRST_NODE + i) == OK);
+    }
+
+    /* Stopping handles everything posted so far */
+    assert_true(Shard_Stop(&engine) == OK);
+
+    uint64_t processed = 0;
+    for (uint32_t k = 0; k < WORKERS; k++) {
+        processed += __atomic_load_n(&engine.shards[k].processed, __ATOMIC_ACQUIRE);
+    }
+    assert_int_equal(processed, CONNECTIONS);
+    for (MsgId_t i = 0; i < CONNECTIONS; i++) {
+        assert_true(sms[i].state == STATE_DOWN);
+    }
+}
+
+extern int test_shard(void) {
+    int return_value = -1;
+
+    const struct CMUnitTest shard_tests[] = {
+        cmocka_unit_test(test_shard_init),      /* Connections split over the workers */
+        cmocka_unit_test(test_shard_ingress),   /* A shared ingress queue is refused */
+        cmocka_unit_test(test_shard_poll),      /* Requests handled by the worker owning the node */
+        cmocka_unit_test(test_shard_overflow),  /* Full rings reject and count */
+        cmocka_unit_test(test_shard_threads),   /* Worker threads drain the rings */
+    };
+
+    return_value = cmocka_run_group_tests_name("shard_tests", shard_tests, NULL, NULL);
+
+    return return_value;
+}
+
+static StdRet_t My_ReceiveMsg(const MsgId_t msgId, const MsgLen_t msgLen, const uint8_t* const pMsgData)
+{
+    (void)msgId;
+    (void)msgLen;
+    (void)pMsgData;
+
+    return OK;
+}
+
+static StdRet_t My_SendSpdu(const NodeId_t nodeId, const SpduLen_t spduLen, const uint8_t* const pSpduData)
+{
+    (void)spduLen;
+    (void)pSpduData;
+
+    __atomic_store_n(&last_node, nodeId, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&sent_spdus, 1U, __ATOMIC_RELAXED);
+    return OK;
+}
@@ -0,0 +1,250 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdarg.h>
+#include <setjmp.h>
+#include "cmocka.h"
+
+#include "sm.h"
+#include "log.h"
+
+#define NOW         1000U
+#define WIRE_FRAMES 64U
+#define NOT_DROPPED 0U
+
+static StdRet_t Client_SendSpdu(const NodeId_t nodeId, const SpduLen_t spduLen, const uint8_t* const pSpduData);
+static StdRet_t Server_SendSpdu(const NodeId_t nodeId, const SpduLen_t spduLen, const uint8_t* const pSpduData);
+static StdRet_t Server_ReceiveMsg(const MsgId_t msgId, const MsgLen_t msgLen, const uint8_t* const pMsgData);
+static StdRet_t Client_ReceiveMsg(const MsgId_t msgId, const MsgLen_t msgLen, const uint8_t* const pMsgData);
+
+static uint32_t Now(void)
+{
+    return NOW;
+}
+
+static SafeComVtable client_vtable = { .SendSpdu = Client_SendSpdu, .ReceiveMsg = Client_ReceiveMsg };
+static SafeComVtable server_vtable = { .SendSpdu = Server_SendSpdu, .ReceiveMsg = Server_ReceiveMsg };
+static SmShared client_shared;
+static SmShared server_shared;
+static SmType client = { .role = ROLE_CLIENT, .shared = &client_shared };
+static SmType server = { .role = ROLE_SERVER, .shared = &server_shared };
+
+/* Frames in flight between the two connections, in the order they were sent */
+typedef struct {
+    SmType *to;
+    SpduLen_t len;
+    uint8_t data[MAX_BUFF_SIZE];
+} WireFrame;
+
+static WireFrame wire[WIRE_FRAMES];
+static uint32_t wire_count = 0;
+static uint32_t sent_by_type[RETRANSMITTED_DATA - CONNECTION_REQUEST + 1];
+static DiscReasonType last_reason = USER_REQUEST;
+static char delivered[WIRE_FRAMES][MAX_DATA_LENGTH];
+static uint32_t delivered_count = 0;
+
+static void put_on_wire(SmType *to, const SpduLen_t spduLen, const uint8_t *pSpduData)
+{
+    PDU_View view;
+
+    assert_true(wire_count < WIRE_FRAMES);
+    assert_true(pdu_view_init(&view, pSpduData, spduLen, SAFETY_CODE_LENGTH));
+    sent_by_type[view.message_type - CONNECTION_REQUEST]++;
+    if (view.message_type == DISCONNECTION_REQUEST)
+    {
+        last_reason = (DiscReasonType)pdu_view_payload(&view)[3];
+    }
+
+    wire[wire_count].to = to;
+    wire[wire_count].len = spduLen;
+    memcpy(wire[wire_count].data, pSpduData, spduLen);
+    wire_count++;
+}
+
+static uint32_t sent(const MessageType type)
+{
+    return sent_by_type[type - CONNECTION_REQUEST];
+}
+
+/* Deliver everything in flight, including the answers, except the n-th Data PDU (counted from 1) */
+static void pump(const uint32_t drop_data)
+{
+    uint32_t data_seen = 0;
+
+    while (wire_count > 0)
+    {
+        WireFrame frame = wire[0];
+        PDU_View view;
+
+        wire_count--;
+        memmove(&wire[0], &wire[1], wire_count * sizeof(wire[0]));
+
+        assert_true(pdu_view_init_verified(&view, frame.data, frame.len, &frame.to->safety_code));
+        if ((view.message_type == DATA) && (++data_seen == drop_data))
+        {
+            continue;
+        }
+        Sm_HandlePdu(frame.to, &view);
+    }
+}
+
+static void send_data(const char *text)
+{
+    PDU_S pdu = { 0 };
+
+    Data(&client, &pdu, (uint8_t)(strlen(text) + 1U), (const uint8_t *)text);
+    Sm_HandleEvent(&client, EVENT_SEND_DATA, &pdu);
+}
+
+static void reset_counters(void)
+{
+    memset(sent_by_type, 0, sizeof(sent_by_type));
+    delivered_count = 0;
+}
+
+static int connect_peers(void **state)
+{
+    (void)state;
+
+    PDU_S pdu = { 0 };
+
+    client.state = STATE_CLOSED;
+    server.state = STATE_CLOSED;
+    wire_count = 0;
+    Sm_SharedInit(&client_shared, &client_vtable);
+    Sm_SharedInit(&server_shared, &server_vtable);
+    client_shared.Tlocal = Now;
+    server_shared.Tlocal = Now;
+    assert_true(Sm_Init(&client) == OK);
+    assert_true(Sm_Init(&server) == OK);
+
+    Sm_HandleEvent(&server, EVENT_OPEN_CONN, &pdu);
+    Sm_HandleEvent(&client, EVENT_OPEN_CONN, &pdu);
+    pump(NOT_DROPPED);
+
+    assert_true(client.state == STATE_UP);
+    assert_true(server.state == STATE_UP);
+    reset_counters();
+
+    return 0;
+}
+
+static void test_retr_lost_data(void **state)
+{
+    (void)state;
+
+    send_data("one");
+    send_data("two");
+    send_data("three");
+    assert_int_equal(client.retr.count, 3);
+
+    /* "two" is lost, "three" reveals the gap */
+    pump(2);
+
+    /* One RetrReq, answered by RetrResp, both missing PDUs as RetrData and HB, instead of a reconnect */
+    assert_int_equal(sent(RETRANSMISSION_REQUEST), 1);
+    assert_int_equal(sent(RETRANSMISSION_RESPONSE), 1);
+    assert_int_equal(sent(RETRANSMITTED_DATA), 2);
+    assert_int_equal(sent(DISCONNECTION_REQUEST), 0);
+    assert_true(client.state == STATE_UP);
+    assert_true(server.state == STATE_UP);
+
+    assert_int_equal(delivered_count, 3);
+    assert_string_equal(delivered[0], "one");
+    assert_string_equal(delivered[1], "two");
+    assert_string_equal(delivered[2], "three");
+
+    /* The RetrData(s) replaced "two" and "three" and are kept until confirmed */
+    assert_int_equal(client.retr.count, 2);
+}
+
+static void test_retr_trim(void **state)
+{
+    (void)state;
+
+    PDU_S pdu = { 0 };
+
+    test_retr_lost_data(state);
+
+    /* Any PDU of the server confirms everything the client sent */
+    Sm_HandleEvent(&server, EVENT_TH_ELAPSED, &pdu);
+    pump(NOT_DROPPED);
+
+    assert_int_equal(client.retr.count, 0);
+    assert_int_equal(client.retr.released, (uint32_t)client.csr);
+    assert_true(client.state == STATE_UP);
+}
+
+static void test_retr_overflow(void **state)
+{
+    (void)state;
+
+    char text[RETR_BUFFER_SIZE + 1U][4];
+
+    for (uint32_t i = 0; i <= RETR_BUFFER_SIZE; i++)
+    {
+        text[i][0] = 'a' + (char)i;
+        text[i][1] = '\0';
+        send_data(text[i]);
+    }
+    assert_int_equal(client.retr.count, RETR_BUFFER_SIZE);
+
+    /* The lost first PDU was pushed out of the buffer, so the connection is closed */
+    pump(1);
+
+    assert_int_equal(sent(RETRANSMISSION_REQUEST), 1);
+    assert_int_equal(sent(RETRANSMITTED_DATA), 0);
+    assert_int_equal(sent(DISCONNECTION_REQUEST), 1);
+    assert_int_equal(last_reason, FAIL_RETRANSMISSION);
+    assert_true(client.state == STATE_CLOSED);
+    assert_true(server.state == STATE_CLOSED);
+    assert_int_equal(delivered_count, 0);
+}
+
+extern int test_sm_retransmission(void) {
+    int return_value = -1;
+
+    const struct CMUnitTest sm_retransmission_tests[] = {
+        cmocka_unit_test_setup(test_retr_lost_data, connect_peers),   /* A lost Data PDU is retransmitted */
+        cmocka_unit_test_setup(test_retr_trim, connect_peers),        /* Confirmed PDUs leave the buffer */
+        cmocka_unit_test_setup(test_retr_overflow, connect_peers),    /* More unconfirmed PDUs than the buffer holds */
+    };
+
+    return_value = cmocka_run_group_tests_name("sm_retransmission_tests", sm_retransmission_tests, NULL, NULL);
+
+    return return_value;
+}
+
+static StdRet_t Client_SendSpdu(const NodeId_t nodeId, const SpduLen_t spduLen, const uint8_t* const pSpduData)
+{
+    (void)nodeId;
+
+    put_on_wire(&server, spduLen, pSpduData);
+    return OK;
+}
+
+static StdRet_t Server_SendSpdu(const NodeId_t nodeId, const SpduLen_t spduLen, const uint8_t* const pSpduData)
+{
+    (void)nodeId;
+
+    put_on_wire(&client, spduLen, pSpduData);
+    return OK;
+}
+
+static StdRet_t Server_ReceiveMsg(const MsgId_t msgId, const MsgLen_t msgLen, const uint8_t* const pMsgData)
+{
+    (void)msgId;
+
+    assert_true(msgLen <= MAX_DATA_LENGTH);
+    memcpy(delivered[delivered_count++], pMsgData, msgLen);
+    return OK;
+}
+
+static StdRet_t Client_ReceiveMsg(const MsgId_t msgId, const MsgLen_t msgLen, const uint8_t* const pMsgData)
+{
+    (void)msgId;
+    (void)msgLen;
+    (void)pMsgData;
+
+    return OK;
+}
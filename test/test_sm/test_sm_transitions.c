@@ -0,0 +1,371 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdarg.h>
+#include <setjmp.h>
+#include "cmocka.h"
+
+#include "sm.h"
+#include "log.h"
+
+#define NOW             1000U   /* Local time seen by both sides, constant so timestamps are always in sequence */
+#define SN_GAP          5U      /* Sequence numbers skipped by an out of sequence PDU */
+#define NOTHING_SENT    0U
+
+#define ROLE_BIT(role)  (1U << (role))
+#define ROLES_CLIENT    ROLE_BIT(ROLE_CLIENT)
+#define ROLES_SERVER    ROLE_BIT(ROLE_SERVER)
+#define ROLES_ALL       (ROLES_CLIENT | ROLES_SERVER)
+
+/* Ways a received PDU can deviate from the one the state machine expects */
+typedef enum {
+    INPUT_VALID = 0U,
+    INPUT_SN_GAP,       /* Sequence number ahead of the expected one */
+    INPUT_CTS_OUT,      /* Confirmed timestamp outside of Tmax */
+    INPUT_BAD_VERSION,  /* Protocol version in ConnReq/ConnResp not supported */
+    INPUT_COUNT
+} Input;
+
+#define INPUT_BIT(input)    (1U << (input))
+#define INPUTS_ALL          ((1U << INPUT_COUNT) - 1U)
+#define INPUTS_VERSION_OK   (INPUTS_ALL & ~INPUT_BIT(INPUT_BAD_VERSION))            /* Only the version is checked */
+#define INPUTS_IN_SEQ       (INPUT_BIT(INPUT_VALID) | INPUT_BIT(INPUT_BAD_VERSION)) /* The version is not checked */
+#define INPUTS_SN_IN_SEQ    (INPUTS_ALL & ~INPUT_BIT(INPUT_SN_GAP))                 /* Only the sequence number is checked */
+
+/* Outcome of one event in one state, for the roles and inputs it applies to */
+typedef struct {
+    uint8_t roles;
+    State state;
+    Event event;
+    uint8_t inputs;
+    State next;
+    uint16_t sent;          /* Type of the first PDU sent in response, NOTHING_SENT if none */
+    DiscReasonType reason;  /* Reason of a DiscReq sent first */
+    bool accepted;          /* Regular receipt processed, i.e. SNR advanced */
+    bool delivered;         /* Payload handed to the application */
+} Transition;
+
+/* Behaviour of the state machine per state and event. Events that do not depend on the received PDU
+   apply to all inputs. Every combination that is not listed leaves the state unchanged and sends nothing. */
+static const Transition transitions[] = {
+    { ROLES_ALL, STATE_CLOSED, EVENT_TI_ELAPSED, INPUTS_ALL, STATE_CLOSED, DISCONNECTION_REQUEST, TIMEOUT_INCOMING_MSG, false, false },
+    { ROLES_CLIENT, STATE_CLOSED, EVENT_OPEN_CONN, INPUTS_ALL, STATE_START, CONNECTION_REQUEST, USER_REQUEST, false, false },
+    { ROLES_SERVER, STATE_CLOSED, EVENT_OPEN_CONN, INPUTS_ALL, STATE_DOWN, NOTHING_SENT, USER_REQUEST, false, false },
+    { ROLES_SERVER, STATE_DOWN, EVENT_TI_ELAPSED, INPUTS_ALL, STATE_CLOSED, DISCONNECTION_REQUEST, TIMEOUT_INCOMING_MSG, false, false },
+    { ROLES_SERVER, STATE_DOWN, EVENT_OPEN_CONN, INPUTS_ALL, STATE_CLOSED, NOTHING_SENT, USER_REQUEST, false, false },
+    { ROLES_SERVER, STATE_DOWN, EVENT_CLOSE_CONN, INPUTS_ALL, STATE_CLOSED, NOTHING_SENT, USER_REQUEST, false, false },
+    { ROLES_SERVER, STATE_DOWN, EVENT_SEND_DATA, INPUTS_ALL, STATE_CLOSED, NOTHING_SENT, USER_REQUEST, false, false },
+    { ROLES_SERVER, STATE_DOWN, EVENT_RECV_CONN_REQ, INPUTS_VERSION_OK, STATE_START, CONNECTION_RESPONSE, USER_REQUEST, true, false },
+    { ROLES_SERVER, STATE_DOWN, EVENT_RECV_CONN_REQ, INPUT_BIT(INPUT_BAD_VERSION), STATE_CLOSED, DISCONNECTION_REQUEST, PROTOCOL_VERSION_ERROR, false, false },
+    { ROLES_ALL, STATE_START, EVENT_TH_ELAPSED, INPUTS_ALL, STATE_START, HEARTBEAT, USER_REQUEST, false, false },
+    { ROLES_ALL, STATE_START, EVENT_TI_ELAPSED, INPUTS_ALL, STATE_CLOSED, DISCONNECTION_REQUEST, TIMEOUT_INCOMING_MSG, false, false },
+    { ROLES_ALL, STATE_START, EVENT_OPEN_CONN, INPUTS_ALL, STATE_CLOSED, DISCONNECTION_REQUEST, STATE_SERVICE_NOT_ALLOWED, false, false },
+    { ROLES_ALL, STATE_START, EVENT_CLOSE_CONN, INPUTS_ALL, STATE_CLOSED, DISCONNECTION_REQUEST, USER_REQUEST, false, false },
+    { ROLES_ALL, STATE_START, EVENT_SEND_DATA, INPUTS_ALL, STATE_CLOSED, DISCONNECTION_REQUEST, STATE_SERVICE_NOT_ALLOWED, false, false },
+    { ROLES_ALL, STATE_START, EVENT_RECV_CONN_REQ, INPUTS_ALL, STATE_CLOSED, DISCONNECTION_REQUEST, NOT_EXPECTED_RECV_MSG_TYPE, false, false },
+    { ROLES_CLIENT, STATE_START, EVENT_RECV_CONN_RESP, INPUTS_VERSION_OK, STATE_UP, HEARTBEAT, USER_REQUEST, true, false },
+    { ROLES_CLIENT, STATE_START, EVENT_RECV_CONN_RESP, INPUT_BIT(INPUT_BAD_VERSION), STATE_CLOSED, DISCONNECTION_REQUEST, PROTOCOL_VERSION_ERROR, false, false },
+    { ROLES_SERVER, STATE_START, EVENT_RECV_CONN_RESP, INPUTS_ALL, STATE_CLOSED, DISCONNECTION_REQUEST, NOT_EXPECTED_RECV_MSG_TYPE, false, false },
+    { ROLES_ALL, STATE_START, EVENT_RECV_RETR_REQ, INPUTS_ALL, STATE_CLOSED, DISCONNECTION_REQUEST, NOT_EXPECTED_RECV_MSG_TYPE, false, false },
+    { ROLES_ALL, STATE_START, EVENT_RECV_RETR_RESP, INPUTS_ALL, STATE_CLOSED, DISCONNECTION_REQUEST, NOT_EXPECTED_RECV_MSG_TYPE, false, false },
+    { ROLES_ALL, STATE_START, EVENT_RECV_DISC_REQ, INPUTS_ALL, STATE_CLOSED, NOTHING_SENT, USER_REQUEST, false, false },
+    { ROLES_CLIENT, STATE_START, EVENT_RECV_HB, INPUTS_ALL, STATE_CLOSED, DISCONNECTION_REQUEST, NOT_EXPECTED_RECV_MSG_TYPE, false, false },
+    { ROLES_SERVER, STATE_START, EVENT_RECV_HB, INPUTS_IN_SEQ, STATE_UP, NOTHING_SENT, USER_REQUEST, true, false },
+    { ROLES_SERVER, STATE_START, EVENT_RECV_HB, INPUT_BIT(INPUT_SN_GAP), STATE_CLOSED, DISCONNECTION_REQUEST, SEQ_NBR_ERR_FOR_CONNECTION, false, false },
+    { ROLES_SERVER, STATE_START, EVENT_RECV_HB, INPUT_BIT(INPUT_CTS_OUT), STATE_CLOSED, DISCONNECTION_REQUEST, SEQ_ERR, false, false },
+    { ROLES_ALL, STATE_START, EVENT_RECV_DATA, INPUTS_ALL, STATE_CLOSED, DISCONNECTION_REQUEST, NOT_EXPECTED_RECV_MSG_TYPE, false, false },
+    { ROLES_ALL, STATE_START, EVENT_RECV_RETR_DATA, INPUTS_ALL, STATE_CLOSED, DISCONNECTION_REQUEST, NOT_EXPECTED_RECV_MSG_TYPE, false, false },
+    { ROLES_ALL, STATE_UP, EVENT_TH_ELAPSED, INPUTS_ALL, STATE_UP, HEARTBEAT, USER_REQUEST, false, false },
+    { ROLES_ALL, STATE_UP, EVENT_TI_ELAPSED, INPUTS_ALL, STATE_CLOSED, DISCONNECTION_REQUEST, TIMEOUT_INCOMING_MSG, false, false },
+    { ROLES_ALL, STATE_UP, EVENT_OPEN_CONN, INPUTS_ALL, STATE_CLOSED, DISCONNECTION_REQUEST, STATE_SERVICE_NOT_ALLOWED, false, false },
+    { ROLES_ALL, STATE_UP, EVENT_CLOSE_CONN, INPUTS_ALL, STATE_CLOSED, DISCONNECTION_REQUEST, USER_REQUEST, false, false },
+    { ROLES_ALL, STATE_UP, EVENT_SEND_DATA, INPUTS_ALL, STATE_UP, DATA, USER_REQUEST, false, false },
+    { ROLES_ALL, STATE_UP, EVENT_RECV_CONN_REQ, INPUTS_ALL, STATE_CLOSED, DISCONNECTION_REQUEST, NOT_EXPECTED_RECV_MSG_TYPE, false, false },
+    { ROLES_ALL, STATE_UP, EVENT_RECV_CONN_RESP, INPUTS_ALL, STATE_CLOSED, DISCONNECTION_REQUEST, NOT_EXPECTED_RECV_MSG_TYPE, false, false },
+    { ROLES_ALL, STATE_UP, EVENT_RECV_RETR_REQ, INPUTS_SN_IN_SEQ, STATE_UP, RETRANSMISSION_RESPONSE, USER_REQUEST, true, false },
+    { ROLES_ALL, STATE_UP, EVENT_RECV_RETR_REQ, INPUT_BIT(INPUT_SN_GAP), STATE_RETR_REQ, RETRANSMISSION_RESPONSE, USER_REQUEST, false, false },
+    { ROLES_ALL, STATE_UP, EVENT_RECV_RETR_RESP, INPUTS_ALL, STATE_CLOSED, DISCONNECTION_REQUEST, NOT_EXPECTED_RECV_MSG_TYPE, false, false },
+    { ROLES_ALL, STATE_UP, EVENT_RECV_DISC_REQ, INPUTS_ALL, STATE_CLOSED, NOTHING_SENT, USER_REQUEST, false, false },
+    { ROLES_ALL, STATE_UP, EVENT_RECV_HB, INPUTS_IN_SEQ, STATE_UP, NOTHING_SENT, USER_REQUEST, true, false },
+    { ROLES_ALL, STATE_UP, EVENT_RECV_HB, INPUT_BIT(INPUT_SN_GAP), STATE_RETR_REQ, RETRANSMISSION_REQUEST, USER_REQUEST, false, false },
+    { ROLES_ALL, STATE_UP, EVENT_RECV_HB, INPUT_BIT(INPUT_CTS_OUT), STATE_CLOSED, DISCONNECTION_REQUEST, SEQ_ERR, false, false },
+    { ROLES_ALL, STATE_UP, EVENT_RECV_DATA, INPUTS_IN_SEQ, STATE_UP, NOTHING_SENT, USER_REQUEST, true, true },
+    { ROLES_ALL, STATE_UP, EVENT_RECV_DATA, INPUT_BIT(INPUT_SN_GAP), STATE_RETR_REQ, RETRANSMISSION_REQUEST, USER_REQUEST, false, false },
+    { ROLES_ALL, STATE_UP, EVENT_RECV_DATA, INPUT_BIT(INPUT_CTS_OUT), STATE_CLOSED, DISCONNECTION_REQUEST, SEQ_ERR, false, false },
+    { ROLES_ALL, STATE_UP, EVENT_RECV_RETR_DATA, INPUTS_ALL, STATE_CLOSED, DISCONNECTION_REQUEST, NOT_EXPECTED_RECV_MSG_TYPE, false, false },
+    { ROLES_ALL, STATE_RETR_REQ, EVENT_TH_ELAPSED, INPUTS_ALL, STATE_RETR_REQ, HEARTBEAT, USER_REQUEST, false, false },
+    { ROLES_ALL, STATE_RETR_REQ, EVENT_TI_ELAPSED, INPUTS_ALL, STATE_CLOSED, DISCONNECTION_REQUEST, TIMEOUT_INCOMING_MSG, false, false },
+    { ROLES_ALL, STATE_RETR_REQ, EVENT_OPEN_CONN, INPUTS_ALL, STATE_CLOSED, DISCONNECTION_REQUEST, STATE_SERVICE_NOT_ALLOWED, false, false },
+    { ROLES_ALL, STATE_RETR_REQ, EVENT_CLOSE_CONN, INPUTS_ALL, STATE_CLOSED, DISCONNECTION_REQUEST, USER_REQUEST, false, false },
+    { ROLES_ALL, STATE_RETR_REQ, EVENT_SEND_DATA, INPUTS_ALL, STATE_RETR_REQ, DATA, USER_REQUEST, false, false },
+    { ROLES_ALL, STATE_RETR_REQ, EVENT_RECV_CONN_REQ, INPUTS_ALL, STATE_CLOSED, DISCONNECTION_REQUEST, NOT_EXPECTED_RECV_MSG_TYPE, false, false },
+    { ROLES_ALL, STATE_RETR_REQ, EVENT_RECV_CONN_RESP, INPUTS_ALL, STATE_CLOSED, DISCONNECTION_REQUEST, NOT_EXPECTED_RECV_MSG_TYPE, false, false },
+    { ROLES_ALL, STATE_RETR_REQ, EVENT_RECV_RETR_REQ, INPUTS_SN_IN_SEQ, STATE_RETR_REQ, RETRANSMISSION_RESPONSE, USER_REQUEST, true, false },
+    { ROLES_ALL, STATE_RETR_REQ, EVENT_RECV_RETR_REQ, INPUT_BIT(INPUT_SN_GAP), STATE_RETR_REQ, RETRANSMISSION_RESPONSE, USER_REQUEST, false, false },
+    { ROLES_ALL, STATE_RETR_REQ, EVENT_RECV_RETR_RESP, INPUTS_ALL, STATE_RETR_RUN, NOTHING_SENT, USER_REQUEST, true, false },
+    { ROLES_ALL, STATE_RETR_REQ, EVENT_RECV_DISC_REQ, INPUTS_ALL, STATE_CLOSED, NOTHING_SENT, USER_REQUEST, false, false },
+    { ROLES_ALL, STATE_RETR_RUN, EVENT_TH_ELAPSED, INPUTS_ALL, STATE_RETR_RUN, HEARTBEAT, USER_REQUEST, false, false },
+    { ROLES_ALL, STATE_RETR_RUN, EVENT_TI_ELAPSED, INPUTS_ALL, STATE_CLOSED, DISCONNECTION_REQUEST, TIMEOUT_INCOMING_MSG, false, false },
+    { ROLES_ALL, STATE_RETR_RUN, EVENT_OPEN_CONN, INPUTS_ALL, STATE_CLOSED, DISCONNECTION_REQUEST, STATE_SERVICE_NOT_ALLOWED, false, false },
+    { ROLES_ALL, STATE_RETR_RUN, EVENT_CLOSE_CONN, INPUTS_ALL, STATE_CLOSED, DISCONNECTION_REQUEST, USER_REQUEST, false, false },
+    { ROLES_ALL, STATE_RETR_RUN, EVENT_SEND_DATA, INPUTS_ALL, STATE_RETR_RUN, DATA, USER_REQUEST, false, false },
+    { ROLES_ALL, STATE_RETR_RUN, EVENT_RECV_CONN_REQ, INPUTS_ALL, STATE_CLOSED, DISCONNECTION_REQUEST, NOT_EXPECTED_RECV_MSG_TYPE, false, false },
+    { ROLES_ALL, STATE_RETR_RUN, EVENT_RECV_CONN_RESP, INPUTS_ALL, STATE_CLOSED, DISCONNECTION_REQUEST, NOT_EXPECTED_RECV_MSG_TYPE, false, false },
+    { ROLES_ALL, STATE_RETR_RUN, EVENT_RECV_RETR_REQ, INPUTS_SN_IN_SEQ, STATE_CLOSED, DISCONNECTION_REQUEST, NOT_EXPECTED_RECV_MSG_TYPE, false, false },
+    { ROLES_ALL, STATE_RETR_RUN, EVENT_RECV_RETR_REQ, INPUT_BIT(INPUT_SN_GAP), STATE_RETR_REQ, RETRANSMISSION_RESPONSE, USER_REQUEST, false, false },
+    { ROLES_ALL, STATE_RETR_RUN, EVENT_RECV_RETR_RESP, INPUTS_ALL, STATE_CLOSED, DISCONNECTION_REQUEST, NOT_EXPECTED_RECV_MSG_TYPE, false, false },
+    { ROLES_ALL, STATE_RETR_RUN, EVENT_RECV_DISC_REQ, INPUTS_ALL, STATE_CLOSED, NOTHING_SENT, USER_REQUEST, false, false },
+    { ROLES_ALL, STATE_RETR_RUN, EVENT_RECV_HB, INPUTS_IN_SEQ, STATE_UP, NOTHING_SENT, USER_REQUEST, true, false },
+    { ROLES_ALL, STATE_RETR_RUN, EVENT_RECV_HB, INPUT_BIT(INPUT_SN_GAP), STATE_RETR_REQ, RETRANSMISSION_REQUEST, USER_REQUEST, false, false },
+    { ROLES_ALL, STATE_RETR_RUN, EVENT_RECV_HB, INPUT_BIT(INPUT_CTS_OUT), STATE_CLOSED, DISCONNECTION_REQUEST, SEQ_ERR, false, false },
+    { ROLES_ALL, STATE_RETR_RUN, EVENT_RECV_DATA, INPUTS_IN_SEQ, STATE_UP, NOTHING_SENT, USER_REQUEST, true, true },
+    { ROLES_ALL, STATE_RETR_RUN, EVENT_RECV_DATA, INPUT_BIT(INPUT_SN_GAP), STATE_RETR_REQ, RETRANSMISSION_REQUEST, USER_REQUEST, false, false },
+    { ROLES_ALL, STATE_RETR_RUN, EVENT_RECV_DATA, INPUT_BIT(INPUT_CTS_OUT), STATE_CLOSED, DISCONNECTION_REQUEST, SEQ_ERR, false, false },
+    { ROLES_ALL, STATE_RETR_RUN, EVENT_RECV_RETR_DATA, INPUTS_IN_SEQ, STATE_RETR_RUN, NOTHING_SENT, USER_REQUEST, true, true },
+    { ROLES_ALL, STATE_RETR_RUN, EVENT_RECV_RETR_DATA, INPUT_BIT(INPUT_SN_GAP), STATE_RETR_REQ, RETRANSMISSION_REQUEST, USER_REQUEST, false, false },
+    { ROLES_ALL, STATE_RETR_RUN, EVENT_RECV_RETR_DATA, INPUT_BIT(INPUT_CTS_OUT), STATE_CLOSED, DISCONNECTION_REQUEST, SEQ_ERR, false, false },
+};
+
+static StdRet_t My_SendSpdu(const NodeId_t nodeId, const SpduLen_t spduLen, const uint8_t* const pSpduData);
+static StdRet_t My_ReceiveMsg(const MsgId_t msgId, const MsgLen_t msgLen, const uint8_t* const pMsgData);
+
+static SafeComVtable vtable = { .SendSpdu = My_SendSpdu, .ReceiveMsg = My_ReceiveMsg };
+static SmShared shared;
+static uint32_t sent_count = 0;
+static uint16_t sent_type = NOTHING_SENT;
+static DiscReasonType sent_reason = USER_REQUEST;
+static uint32_t delivered_count = 0;
+
+static uint32_t Now(void)
+{
+    return NOW;
+}
+
+/* Peer whose PDUs the state machine under test receives */
+static SmType peer = {
+    .role = ROLE_SERVER,
+    .shared = &shared,
+};
+
+static bool is_receive_event(const Event event)
+{
+    return event >= EVENT_RECV_CONN_REQ;
+}
+
+/* Build the PDU behind a receive event, in sequence with the state machine unless the input says otherwise */
+static void build_rx(SmType *sm, const Event event, const Input input, PDU_S *pdu)
+{
+    static const uint8_t bad_version[CONN_REQ_PAYLOAD_LENGTH] = { '0', '2', '0', '1' };
+    static const uint8_t data[] = "payload";
+
+    switch (event) {
+        case EVENT_RECV_CONN_REQ:   ConnReq(&peer, pdu); break;
+        case EVENT_RECV_CONN_RESP:  ConnResp(&peer, pdu); break;
+        case EVENT_RECV_RETR_REQ:   RetrReq(&peer, pdu); break;
+        case EVENT_RECV_RETR_RESP:  RetrResp(&peer, pdu); break;
+        case EVENT_RECV_DISC_REQ:   DiscReq(&peer, pdu, USER_REQUEST, NO_DETAILED_REASON); break;
+        case EVENT_RECV_HB:         HB(&peer, pdu); break;
+        case EVENT_RECV_DATA:
+        case EVENT_RECV_RETR_DATA:
+            Data(&peer, pdu, sizeof(data), data);
+            pdu->message_type = (event == EVENT_RECV_DATA) ? DATA : RETRANSMITTED_DATA;
+            break;
+        default: assert_true(false); break;
+    }
+
+    pdu->frame_template = NULL;
+    pdu->sequence_number = (uint32_t)sm->snr + ((input == INPUT_SN_GAP) ? SN_GAP : 0U);
+    pdu->confirmed_sequence_number = (uint32_t)sm->snt;
+    pdu->confirmed_timestamp = (uint32_t)sm->ctsr + ((input == INPUT_CTS_OUT) ? sm->shared->timeouts.Tmax : 0U);
+    if ((input == INPUT_BAD_VERSION) &&
+        ((pdu->message_type == CONNECTION_REQUEST) || (pdu->message_type == CONNECTION_RESPONSE)))
+    {
+        pdu->payload = bad_version;
+    }
+}
+
+/* Apply an event with the given input, returns whether regular receipt was processed */
+static bool apply(SmType *sm, const Event event, const Input input)
+{
+    PDU_S pdu = { 0 };
+    const int32_t snr = sm->snr;
+
+    if (is_receive_event(event))
+    {
+        build_rx(sm, event, input, &pdu);
+    }
+    else if (event == EVENT_SEND_DATA)
+    {
+        static const uint8_t data[] = "message";
+        Data(sm, &pdu, sizeof(data), data);
+    }
+
+    Sm_HandleEvent(sm, event, &pdu);
+
+    return sm->snr != snr;
+}
+
+/* Bring a fresh state machine into a state over the regular protocol path */
+static bool enter_state(SmType *sm, const SmRole role, const State state)
+{
+    *sm = (SmType){ .role = role, .state = STATE_CLOSED, .shared = &shared };
+    assert_true(Sm_Init(sm) == OK);
+
+    if (state == STATE_CLOSED)
+    {
+        return true;
+    }
+    if ((role == ROLE_CLIENT) && (state == STATE_DOWN))
+    {
+        return false;   /* A client goes from Closed to Start directly */
+    }
+
+    apply(sm, EVENT_OPEN_CONN, INPUT_VALID);
+    if ((role == ROLE_SERVER) && (state != STATE_DOWN))
+    {
+        apply(sm, EVENT_RECV_CONN_REQ, INPUT_VALID);
+    }
+    if (state >= STATE_UP)
+    {
+        apply(sm, (role == ROLE_CLIENT) ? EVENT_RECV_CONN_RESP : EVENT_RECV_HB, INPUT_VALID);
+    }
+    if (state >= STATE_RETR_REQ)
+    {
+        apply(sm, EVENT_RECV_HB, INPUT_SN_GAP);
+    }
+    if (state == STATE_RETR_RUN)
+    {
+        apply(sm, EVENT_RECV_RETR_RESP, INPUT_VALID);
+    }
+
+    assert_int_equal(sm->state, state);
+    return true;
+}
+
+static Transition expected(const SmRole role, const State state, const Event event, const Input input)
+{
+    Transition nothing = { ROLE_BIT(role), state, event, INPUT_BIT(input), state, NOTHING_SENT, USER_REQUEST, false, false };
+
+    for (size_t i = 0; i < sizeof(transitions) / sizeof(transitions[0]); i++)
+    {
+        const Transition *t = &transitions[i];
+        if ((t->state == state) && (t->event == event) &&
+            ((t->roles & ROLE_BIT(role)) != 0U) && ((t->inputs & INPUT_BIT(input)) != 0U))
+        {
+            return *t;
+        }
+    }
+
+    return nothing;
+}
+
+/* Run one combination on a fresh state machine and record what it did */
+static bool observe(const SmRole role, const State state, const Event event, const Input input, Transition *outcome)
+{
+    SmType sm;
+
+    if (!enter_state(&sm, role, state))
+    {
+        return false;
+    }
+
+    sent_count = 0;
+    sent_type = NOTHING_SENT;
+    sent_reason = USER_REQUEST;
+    delivered_count = 0;
+
+    const bool accepted = apply(&sm, event, input);
+
+    *outcome = (Transition){ ROLE_BIT(role), state, event, INPUT_BIT(input), sm.state, sent_type, sent_reason,
+                             accepted, delivered_count > 0 };
+    return true;
+}
+
+static void test_sm_transitions_init(void **state)
+{
+    (void)state;
+
+    Sm_SharedInit(&shared, &vtable);
+    shared.Tlocal = Now;
+    assert_true(Sm_Init(&peer) == OK);
+}
+
+/* Every event in every reachable state, for both roles and all inputs, against the transition list */
+static void test_sm_transitions_all(void **state)
+{
+    (void)state;
+
+    for (SmRole role = ROLE_CLIENT; role <= ROLE_SERVER; role++)
+    {
+        for (State s = STATE_CLOSED; s <= STATE_RETR_RUN; s++)
+        {
+            for (Event event = EVENT_TH_ELAPSED; event <= EVENT_RECV_RETR_DATA; event++)
+            {
+                const Input last = is_receive_event(event) ? INPUT_BAD_VERSION : INPUT_VALID;
+
+                for (Input input = INPUT_VALID; input <= last; input++)
+                {
+                    Transition outcome;
+                    if (!observe(role, s, event, input, &outcome))
+                    {
+                        continue;
+                    }
+
+                    const Transition want = expected(role, s, event, input);
+                    const bool equal = (outcome.next == want.next) && (outcome.sent == want.sent) &&
+                                       ((want.sent != DISCONNECTION_REQUEST) || (outcome.reason == want.reason)) &&
+                                       (outcome.accepted == want.accepted) && (outcome.delivered == want.delivered);
+                    if (!equal)
+                    {
+                        print_error("role %i, state %i, event %i, input %i: state %i, sent %i, reason %i, accepted %i, delivered %i\n",
+                                    role, s, event, input, outcome.next, outcome.sent, outcome.reason,
+                                    outcome.accepted, outcome.delivered);
+                    }
+                    assert_true(equal);
+                }
+            }
+        }
+    }
+}
+
+extern int test_sm_transitions(void) {
+    int return_value = -1;
+
+    const struct CMUnitTest sm_transitions_tests[] = {
+        cmocka_unit_test(test_sm_transitions_init), /* Peer building the received PDUs */
+        cmocka_unit_test(test_sm_transitions_all),  /* Exhaustive state/event walk */
+    };
+
+    return_value = cmocka_run_group_tests_name("sm_transitions_tests", sm_transitions_tests, NULL, NULL);
+
+    return return_value;
+}
+
+static StdRet_t My_SendSpdu(const NodeId_t nodeId, const SpduLen_t spduLen, const uint8_t* const pSpduData)
+{
+    (void)nodeId;
+
+    PDU_View view;
+
+    assert_true(pdu_view_init(&view, pSpduData, spduLen, SAFETY_CODE_LENGTH));
+    if (sent_count++ > 0)
+    {
+        return OK;
+    }
+    sent_type = (uint16_t)view.message_type;
+    if (view.message_type == DISCONNECTION_REQUEST)
+    {
+        sent_reason = (DiscReasonType)pdu_view_payload(&view)[3];
+    }
+    return OK;
+}
+
+static StdRet_t My_ReceiveMsg(const MsgId_t msgId, const MsgLen_t msgLen, const uint8_t* const pMsgData)
+{
+    (void)msgId;
+    (void)msgLen;
+    (void)pMsgData;
+
+    delivered_count++;
+    return OK;
+}
@@ -9,17 +9,19 @@
 #include "safecom_config.h"
 #include "log.h"
 
+static const SmShared shared = { .Tlocal = GetCurrentTimestamp };
+
 static SmType sm_server = { 
     .channel=0U,
     .role=ROLE_SERVER,
     .state=STATE_CLOSED,
-    .vtable = NULL,
+    .shared = &shared,
 }; 
 static SmType sm_client = {
     .channel=0U,
     .role=ROLE_CLIENT,
     .state=STATE_CLOSED,
-    .vtable = NULL,
+    .shared = &shared,
 };
 
 static void test_sm_client_init(void** state)
@@ -103,9 +103,9 @@ static void test_rass_receive_spdu(void **state)
 {
     PDU_S *pPdu = (PDU_S*)(*state);
     StdRet_t ret = OK;
-    uint8_t buffer[50];
+    uint8_t buffer[MAX_BUFF_SIZE];
 
-    serialize_pdu(pPdu, buffer, pPdu->message_length);
+    encode_pdu(pPdu, &sms[0].safety_code, buffer, sizeof(buffer));
     ret = Rass_ReceiveSpdu(0, pPdu->message_length, buffer);
     assert_true(ret == OK);
 
@@ -125,7 +125,7 @@ static void test_elapsed_time(void** state)
     {
         for(int i = 0; i < 500000000; i++);
         sms[0].time.Ti--;
-        if ((sms[0].time.Tlocal() % sms[0].time.timeouts.Th) == 0)
+        if ((sms[0].shared->Tlocal() % sms[0].shared->timeouts.Th) == 0)
         {
             Sm_HandleEvent(&sms[0], EVENT_TH_ELAPSED, &pdu);
         }
@@ -133,7 +133,7 @@ static void test_elapsed_time(void** state)
         {
             Sm_HandleEvent(&sms[0], EVENT_TI_ELAPSED, &pdu);
         }
-        if (sms[0].time.Tlocal() == 5)
+        if (sms[0].shared->Tlocal() == 5)
         {
             HB(&sms[0], &pdu);
             Sm_HandleEvent(&sms[0], EVENT_RECV_HB, &pdu);
@@ -0,0 +1,102 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdarg.h>
+#include <setjmp.h>
+#include "cmocka.h"
+
+#include "timer_wheel.h"
+
+#define START   1000U
+#define TIMERS  8U
+
+static TimerWheel wheel;
+static TimerNode timers[TIMERS];
+
+static int init_wheel(void **state)
+{
+    (void)state;
+
+    timer_wheel_init(&wheel, START);
+    for (uint32_t i = 0; i < TIMERS; i++) {
+        timer_node_init(&timers[i]);
+    }
+
+    return 0;
+}
+
+static void test_wheel_expire(void **state)
+{
+    (void)state;
+
+    timer_wheel_arm(&wheel, &timers[0], START + 10U);
+    timer_wheel_arm(&wheel, &timers[1], START + 5U);
+    timer_wheel_arm(&wheel, &timers[2], START + 10U);
+
+    assert_null(timer_wheel_expire(&wheel, START + 4U));
+    assert_ptr_equal(timer_wheel_expire(&wheel, START + 5U), &timers[1]);
+    assert_null(timer_wheel_expire(&wheel, START + 5U));
+
+    /* Both timers of one tick, then nothing */
+    assert_ptr_equal(timer_wheel_expire(&wheel, START + 12U), &timers[0]);
+    assert_ptr_equal(timer_wheel_expire(&wheel, START + 12U), &timers[2]);
+    assert_null(timer_wheel_expire(&wheel, START + 12U));
+}
+
+static void test_wheel_rearm(void **state)
+{
+    (void)state;
+
+    /* Moving or disarming a timer takes it out of its old slot */
+    timer_wheel_arm(&wheel, &timers[0], START + 3U);
+    timer_wheel_arm(&wheel, &timers[1], START + 3U);
+    timer_wheel_arm(&wheel, &timers[0], START + 20U);
+    timer_wheel_disarm(&timers[1]);
+    timer_wheel_disarm(&timers[1]);
+
+    assert_null(timer_wheel_expire(&wheel, START + 19U));
+    assert_ptr_equal(timer_wheel_expire(&wheel, START + 20U), &timers[0]);
+
+    /* A deadline already passed expires on the next check */
+    timer_wheel_arm(&wheel, &timers[2], START);
+    assert_ptr_equal(timer_wheel_expire(&wheel, START + 20U), &timers[2]);
+}
+
+static void test_wheel_later_turns(void **state)
+{
+    (void)state;
+
+    /* Same slot, one and two turns later */
+    timer_wheel_arm(&wheel, &timers[0], START + 7U);
+    timer_wheel_arm(&wheel, &timers[1], START + 7U + TIMER_WHEEL_SLOTS);
+    timer_wheel_arm(&wheel, &timers[2], START + 7U + 2U * TIMER_WHEEL_SLOTS);
+
+    assert_ptr_equal(timer_wheel_expire(&wheel, START + 7U), &timers[0]);
+    assert_null(timer_wheel_expire(&wheel, START + 6U + TIMER_WHEEL_SLOTS));
+    assert_ptr_equal(timer_wheel_expire(&wheel, START + 7U + TIMER_WHEEL_SLOTS), &timers[1]);
+    assert_null(timer_wheel_expire(&wheel, START + 7U + TIMER_WHEEL_SLOTS));
+
+    /* After a long gap all expired timers still come out, the later one stays */
+    timer_wheel_arm(&wheel, &timers[3], START + 500U);
+    timer_wheel_arm(&wheel, &timers[4], START + 100000U);
+    uint32_t expired = 0;
+    while (timer_wheel_expire(&wheel, START + 50000U) != NULL) {
+        expired++;
+    }
+    assert_int_equal(expired, 2);
+    assert_ptr_equal(timer_wheel_expire(&wheel, START + 100000U), &timers[4]);
+}
+
+extern int test_timer_wheel(void) {
+    int return_value = -1;
+
+    const struct CMUnitTest timer_wheel_tests[] = {
+        cmocka_unit_test_setup(test_wheel_expire, init_wheel),      /* Timers expire at their deadline, not before */
+        cmocka_unit_test_setup(test_wheel_rearm, init_wheel),       /* Moved and disarmed timers */
+        cmocka_unit_test_setup(test_wheel_later_turns, init_wheel), /* Deadlines beyond one turn and long gaps */
+    };
+
+    return_value = cmocka_run_group_tests_name("timer_wheel_tests", timer_wheel_tests, NULL, NULL);
+
+    return return_value;
+}
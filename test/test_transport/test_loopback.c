@@ -0,0 +1,170 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdarg.h>
+#include <setjmp.h>
+#include <string.h>
+#include "cmocka.h"
+
+#include "loopback.h"
+#include "log.h"
+
+#define PAIRS       16U
+#define CLIENT_NODE 0U      /* first_node of the client, connection i is node CLIENT_NODE + i */
+#define SERVER_NODE 100U    /* first_node of the server */
+#define ROUNDS      100U
+
+static StdRet_t Client_Receive(const SafeComSpdu* const pSpdus, const uint32_t count);
+static StdRet_t Client_ReceiveMsg(const MsgId_t msgId, const MsgLen_t msgLen, const uint8_t* const pMsgData);
+static StdRet_t Server_Receive(const SafeComSpdu* const pSpdus, const uint32_t count);
+static StdRet_t Server_ReceiveMsg(const MsgId_t msgId, const MsgLen_t msgLen, const uint8_t* const pMsgData);
+
+static Loopback wire;
+static SafeCom client;
+static SafeCom server;
+static SmType client_sms[PAIRS];
+static SmType server_sms[PAIRS];
+static uint8_t client_received[PAIRS];  /* Last payload byte per connection, 0 for none */
+static uint8_t server_received[PAIRS];
+
+static int open_wire(void **state)
+{
+    (void)state;
+
+    const SafeComType client_config = {
+        .vtable = { .SendSpdu = Loopback_ClientSendSpdu, .SendSpduBatch = Loopback_ClientSendSpduBatch, .ReceiveMsg = Client_ReceiveMsg },
+        .config = { .instname = "client", .role = ROLE_CLIENT, .max_connections = PAIRS, .first_node = CLIENT_NODE, .sms = client_sms },
+    };
+    const SafeComType server_config = {
+        .vtable = { .SendSpdu = Loopback_ServerSendSpdu, .SendSpduBatch = Loopback_ServerSendSpduBatch, .ReceiveMsg = Server_ReceiveMsg },
+        .config = { .instname = "server", .role = ROLE_SERVER, .max_connections = PAIRS, .first_node = SERVER_NODE, .sms = server_sms },
+    };
+    const LoopbackConfig wire_config = { .ToClient = Client_Receive, .ToServer = Server_Receive,
+                                         .client_first_node = CLIENT_NODE, .server_first_node = SERVER_NODE };
+
+    memset(client_sms, 0, sizeof(client_sms));
+    memset(server_sms, 0, sizeof(server_sms));
+    memset(client_received, 0, sizeof(client_received));
+    memset(server_received, 0, sizeof(server_received));
+    Loopback_Init(&wire, &wire_config);
+    if ((SafeCom_Init(&client, &client_config) != OK) || (SafeCom_Init(&server, &server_config) != OK)) {
+        return -1;
+    }
+
+    return 0;
+}
+
+static void connect_all(void)
+{
+    for (uint32_t i = 0; i < PAIRS; i++) {
+        assert_true(SafeCom_OpenConnection(&server, SERVER_NODE + i) == OK);
+        assert_true(SafeCom_OpenConnection(&client, CLIENT_NODE + i) == OK);
+    }
+    Loopback_Run(&wire, ROUNDS);
+}
+
+static void test_loopback_handshake(void **state)
+{
+    (void)state;
+
+    /* ConnReq, ConnResp and HB per pair, then the wire is quiet */
+    connect_all();
+    for (uint32_t i = 0; i < PAIRS; i++) {
+        assert_true(client_sms[i].state == STATE_UP);
+        assert_true(server_sms[i].state == STATE_UP);
+        assert_int_equal(server_sms[i].rx_dropped, 0);
+    }
+    assert_int_equal(wire.delivered, 3U * PAIRS);
+    assert_int_equal(Loopback_Pump(&wire), 0);
+}
+
+static void test_loopback_data(void **state)
+{
+    (void)state;
+
+    connect_all();
+
+    /* Every client connection sends to its pair, which answers */
+    for (uint32_t i = 0; i < PAIRS; i++) {
+        const uint8_t data[4] = { (uint8_t)(i + 1U), 0xA5, 0x5A, (uint8_t)(i + 1U) };
+
+        assert_true(SafeCom_SendData(&client, CLIENT_NODE + i, sizeof(data), data) == OK);
+    }
+    assert_int_equal(Loopback_Pump(&wire), PAIRS);
+    for (uint32_t i = 0; i < PAIRS; i++) {
+        const uint8_t data[1] = { (uint8_t)(0x80U + i) };
+
+        assert_int_equal(server_received[i], i + 1U);
+        assert_true(SafeCom_SendData(&server, SERVER_NODE + i, sizeof(data), data) == OK);
+    }
+    Loopback_Run(&wire, ROUNDS);
+    for (uint32_t i = 0; i < PAIRS; i++) {
+        assert_int_equal(client_received[i], 0x80U + i);
+        assert_int_equal(client_sms[i].rx_dropped, 0);
+    }
+    assert_int_equal(wire.to_server.dropped + wire.to_client.dropped, 0);
+}
+
+static void test_loopback_full(void **state)
+{
+    (void)state;
+
+    const uint8_t frame[8] = { 0 };
+
+    /* The queue takes LOOPBACK_FRAMES until pumped, the rest is dropped */
+    for (uint32_t i = 0; i <= LOOPBACK_FRAMES; i++) {
+        Loopback_ClientSendSpdu(CLIENT_NODE, sizeof(frame), frame);
+    }
+    assert_int_equal(wire.to_server.count, LOOPBACK_FRAMES);
+    assert_int_equal(wire.to_server.dropped, 1);
+    assert_true(Loopback_ServerSendSpdu(SERVER_NODE, MAX_BUFF_SIZE + 1U, frame) == NOT_OK);
+    assert_int_equal(wire.to_client.dropped, 1);
+
+    /* Garbage is refused by the server and nothing comes back */
+    assert_int_equal(Loopback_Pump(&wire), LOOPBACK_FRAMES);
+    assert_int_equal(Loopback_Pump(&wire), 0);
+}
+
+extern int test_loopback(void) {
+    int return_value = -1;
+
+    const struct CMUnitTest loopback_tests[] = {
+        cmocka_unit_test_setup(test_loopback_handshake, open_wire), /* All pairs come up over the wire */
+        cmocka_unit_test_setup(test_loopback_data, open_wire),      /* Data both ways on every pair */
+        cmocka_unit_test_setup(test_loopback_full, open_wire),      /* A full queue drops */
+    };
+
+    return_value = cmocka_run_group_tests_name("loopback_tests", loopback_tests, NULL, NULL);
+
+    return return_value;
+}
+
+static StdRet_t Client_Receive(const SafeComSpdu* const pSpdus, const uint32_t count)
+{
+    return SafeCom_ReceiveSpduBatch(&client, pSpdus, count);
+}
+
+static StdRet_t Client_ReceiveMsg(const MsgId_t msgId, const MsgLen_t msgLen, const uint8_t* const pMsgData)
+{
+    const uint32_t index = msgId - CLIENT_NODE;
+
+    if ((index < PAIRS) && (msgLen > 0U)) {
+        client_received[index] = pMsgData[msgLen - 1U];
+    }
+    return OK;
+}
+
+static StdRet_t Server_Receive(const SafeComSpdu* const pSpdus, const uint32_t count)
+{
+    return SafeCom_ReceiveSpduBatch(&server, pSpdus, count);
+}
+
+static StdRet_t Server_ReceiveMsg(const MsgId_t msgId, const MsgLen_t msgLen, const uint8_t* const pMsgData)
+{
+    const uint32_t index = msgId - SERVER_NODE;
+
+    if ((index < PAIRS) && (msgLen > 0U)) {
+        server_received[index] = pMsgData[msgLen - 1U];
+    }
+    return OK;
+}
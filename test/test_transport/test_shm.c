@@ -0,0 +1,256 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdarg.h>
+#include <setjmp.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sched.h>
+#include <sys/wait.h>
+#include "cmocka.h"
+
+#include "shm.h"
+#include "log.h"
+
+#define CLIENT_NODE 20U     /* Node ids of connection 0 on the server side ... */
+#define SERVER_NODE 10U     /* ... and on the client side */
+#define PEERS       2U
+#define ROUNDS      1000U
+#define SPINS       10000000U
+
+static StdRet_t Client_SendSpdu(const NodeId_t nodeId, const SpduLen_t spduLen, const uint8_t* const pSpduData);
+static StdRet_t Client_ReceiveMsg(const MsgId_t msgId, const MsgLen_t msgLen, const uint8_t* const pMsgData);
+static StdRet_t Server_SendSpdu(const NodeId_t nodeId, const SpduLen_t spduLen, const uint8_t* const pSpduData);
+static StdRet_t Server_SendSpduBatch(const SafeComSpdu* const pSpdus, const uint32_t count);
+static StdRet_t Server_ReceiveMsg(const MsgId_t msgId, const MsgLen_t msgLen, const uint8_t* const pMsgData);
+
+/* The client creates the region, the server attaches to it */
+static ShmTransport client_shm;
+static ShmTransport server_shm;
+static uint8_t delivered[MAX_DATA_LENGTH];
+static MsgLen_t delivered_len = 0;
+
+static int open_pair(void **state)
+{
+    (void)state;
+
+    const ShmConfig client_config = { .first_node = SERVER_NODE, .peer_count = PEERS };
+    const ShmConfig server_config = { .first_node = CLIENT_NODE, .peer_count = PEERS };
+
+    if ((Shm_Create(&client_shm, &client_config) != OK) ||
+        (Shm_Attach(&server_shm, &server_config, dup(client_shm.fd)) != OK)) {
+        return -1;
+    }
+
+    return 0;
+}
+
+static int close_pair(void **state)
+{
+    (void)state;
+
+    Shm_Close(&client_shm);
+    Shm_Close(&server_shm);
+
+    return 0;
+}
+
+static void test_shm_ring(void **state)
+{
+    (void)state;
+
+    const uint8_t frame[] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+    const SafeComSpdu* rx;
+    uint32_t received = 0;
+
+    /* Node ids map by index, SPDUs are handed on in the shared slots */
+    assert_true(Shm_SendSpdu(&client_shm, SERVER_NODE, sizeof(frame), frame) == OK);
+    assert_true(Shm_SendSpdu(&client_shm, SERVER_NODE + 1U, 4, frame) == OK);
+    assert_int_equal(Shm_Receive(&server_shm, &rx), 2);
+    assert_int_equal(rx[0].nodeId, CLIENT_NODE);
+    assert_int_equal(rx[0].spduLen, sizeof(frame));
+    assert_memory_equal(rx[0].pSpduData, frame, sizeof(frame));
+    assert_ptr_equal(rx[0].pSpduData, server_shm.region->rings[0].slots[0].data);
+    assert_int_equal(rx[1].nodeId, CLIENT_NODE + 1U);
+    assert_int_equal(rx[1].spduLen, 4);
+
+    /* Unknown nodes and long frames are refused */
+    assert_true(Shm_SendSpdu(&client_shm, SERVER_NODE + PEERS, sizeof(frame), frame) == NOT_OK);
+    assert_true(Shm_SendSpdu(&client_shm, SERVER_NODE, MAX_BUFF_SIZE + 1U, frame) == NOT_OK);
+    assert_int_equal(client_shm.stats.tx_dropped, 2);
+
+    /* The two slots handed out stay taken until the next receive, so the ring is full early */
+    for (uint32_t i = 0; i < SHM_SLOTS; i++) {
+        Shm_SendSpdu(&client_shm, SERVER_NODE, sizeof(frame), frame);
+    }
+    assert_int_equal(client_shm.stats.tx_dropped, 4);
+
+    /* Drained SHM_BATCH at a time, across the end of the ring */
+    for (uint32_t count = Shm_Receive(&server_shm, &rx); count > 0U; count = Shm_Receive(&server_shm, &rx)) {
+        assert_true(count <= SHM_BATCH);
+        received += count;
+    }
+    assert_int_equal(received, SHM_SLOTS - 2U);
+    assert_true(Shm_SendSpdu(&client_shm, SERVER_NODE, sizeof(frame), frame) == OK);
+    assert_int_equal(server_shm.stats.rx_invalid, 0);
+
+    /* A descriptor that is no region is refused, and closed like any other handed over */
+    ShmTransport other;
+    int fds[2];
+    const ShmConfig config = { .first_node = CLIENT_NODE, .peer_count = PEERS };
+
+    assert_int_equal(pipe(fds), 0);
+    assert_true(Shm_Attach(&other, &config, fds[0]) == NOT_OK);
+    assert_int_equal(fcntl(fds[0], F_GETFD), -1);
+    assert_int_equal(errno, EBADF);
+    close(fds[1]);
+}
+
+static void test_shm_fork(void **state)
+{
+    (void)state;
+
+    const pid_t pid = fork();
+    assert_true(pid >= 0);
+
+    if (pid == 0) {
+        /* Child: a process of its own on the server side, echoing every SPDU */
+        ShmTransport echo;
+        const ShmConfig config = { .first_node = CLIENT_NODE, .peer_count = PEERS };
+        uint32_t echoed = 0;
+
+        Shm_Close(&server_shm);
+        if (Shm_Attach(&echo, &config, dup(client_shm.fd)) != OK) {
+            _exit(1);
+        }
+        for (uint32_t spin = 0; (spin < SPINS) && (echoed < ROUNDS); spin++) {
+            const SafeComSpdu* rx;
+            const uint32_t count = Shm_Receive(&echo, &rx);
+
+            Shm_SendSpduBatch(&echo, rx, count);
+            echoed += count;
+            if (count == 0U) {
+                sched_yield();  /* Both processes may share one CPU */
+            }
+        }
+        _exit((echoed == ROUNDS) ? 0 : 2);
+    }
+
+    /* Parent: ping-pong with the child, one frame in flight */
+    uint32_t round = 0;
+    for (uint32_t spin = 0; (spin < SPINS) && (round < ROUNDS); spin++) {
+        const SafeComSpdu* rx;
+        uint8_t frame[8];
+
+        if (client_shm.stats.tx_frames == round) {
+            memset(frame, (int)round, sizeof(frame));
+            assert_true(Shm_SendSpdu(&client_shm, SERVER_NODE + (round % PEERS), sizeof(frame), frame) == OK);
+        }
+        if (Shm_Receive(&client_shm, &rx) == 1U) {
+            memset(frame, (int)round, sizeof(frame));
+            assert_int_equal(rx[0].nodeId, SERVER_NODE + (round % PEERS));
+            assert_memory_equal(rx[0].pSpduData, frame, sizeof(frame));
+            round++;
+        } else {
+            sched_yield();
+        }
+    }
+    assert_int_equal(round, ROUNDS);
+
+    int status = -1;
+    assert_int_equal(waitpid(pid, &status, 0), pid);
+    assert_true(WIFEXITED(status) && (WEXITSTATUS(status) == 0));
+}
+
+static void test_shm_safecom(void **state)
+{
+    (void)state;
+
+    SmType client_sms[PEERS] = { 0 };
+    SmType server_sms[PEERS] = { 0 };
+    SafeCom client;
+    SafeCom server;
+    const SafeComType client_config = {
+        .vtable = { .SendSpdu = Client_SendSpdu, .ReceiveMsg = Client_ReceiveMsg },
+        .config = { .instname = "client", .role = ROLE_CLIENT, .max_connections = PEERS, .first_node = SERVER_NODE, .sms = client_sms },
+    };
+    const SafeComType server_config = {
+        .vtable = { .SendSpdu = Server_SendSpdu, .SendSpduBatch = Server_SendSpduBatch, .ReceiveMsg = Server_ReceiveMsg },
+        .config = { .instname = "server", .role = ROLE_SERVER, .max_connections = PEERS, .first_node = CLIENT_NODE, .sms = server_sms },
+    };
+    const uint8_t data[] = "over shared memory";
+
+    assert_true(SafeCom_Init(&client, &client_config) == OK);
+    assert_true(SafeCom_Init(&server, &server_config) == OK);
+    for (uint32_t i = 0; i < PEERS; i++) {
+        assert_true(SafeCom_OpenConnection(&server, CLIENT_NODE + i) == OK);
+        assert_true(SafeCom_OpenConnection(&client, SERVER_NODE + i) == OK);
+    }
+
+    /* ConnReq, ConnResp and HB pass through the rings */
+    for (uint32_t poll = 0; (poll < 100U) && (server_sms[PEERS - 1U].state != STATE_UP); poll++) {
+        Shm_Poll(&server_shm, &server);
+        Shm_Poll(&client_shm, &client);
+    }
+    for (uint32_t i = 0; i < PEERS; i++) {
+        assert_true(client_sms[i].state == STATE_UP);
+        assert_true(server_sms[i].state == STATE_UP);
+    }
+
+    delivered_len = 0;
+    assert_true(SafeCom_SendData(&client, SERVER_NODE + 1U, sizeof(data), data) == OK);
+    assert_int_equal(Shm_Poll(&server_shm, &server), 1);
+    assert_int_equal(delivered_len, sizeof(data));
+    assert_memory_equal(delivered, data, sizeof(data));
+    assert_int_equal(server_sms[1].rx_dropped, 0);
+    assert_int_equal(client_shm.stats.tx_dropped + server_shm.stats.tx_dropped, 0);
+}
+
+extern int test_shm(void) {
+    int return_value = -1;
+
+    const struct CMUnitTest shm_tests[] = {
+        cmocka_unit_test_setup_teardown(test_shm_ring, open_pair, close_pair),      /* In place, node mapping, full ring */
+        cmocka_unit_test_setup_teardown(test_shm_fork, open_pair, close_pair),      /* Ping-pong with another process */
+        cmocka_unit_test_setup_teardown(test_shm_safecom, open_pair, close_pair),   /* Connections come up and carry data */
+    };
+
+    return_value = cmocka_run_group_tests_name("shm_tests", shm_tests, NULL, NULL);
+
+    return return_value;
+}
+
+static StdRet_t Client_SendSpdu(const NodeId_t nodeId, const SpduLen_t spduLen, const uint8_t* const pSpduData)
+{
+    return Shm_SendSpdu(&client_shm, nodeId, spduLen, pSpduData);
+}
+
+static StdRet_t Client_ReceiveMsg(const MsgId_t msgId, const MsgLen_t msgLen, const uint8_t* const pMsgData)
+{
+    (void)msgId;
+    (void)msgLen;
+    (void)pMsgData;
+
+    return OK;
+}
+
+static StdRet_t Server_SendSpdu(const NodeId_t nodeId, const SpduLen_t spduLen, const uint8_t* const pSpduData)
+{
+    return Shm_SendSpdu(&server_shm, nodeId, spduLen, pSpduData);
+}
+
+static StdRet_t Server_SendSpduBatch(const SafeComSpdu* const pSpdus, const uint32_t count)
+{
+    return Shm_SendSpduBatch(&server_shm, pSpdus, count);
+}
+
+static StdRet_t Server_ReceiveMsg(const MsgId_t msgId, const MsgLen_t msgLen, const uint8_t* const pMsgData)
+{
+    (void)msgId;
+
+    memcpy(delivered, pMsgData, msgLen);
+    delivered_len = msgLen;
+    return OK;
+}
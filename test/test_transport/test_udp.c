@@ -0,0 +1,303 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdarg.h>
+#include <setjmp.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include "cmocka.h"
+
+#include "udp.h"
+#include "log.h"
+
+#define FRAMES      100U
+#define ROUTES      4U
+#define CLIENT_NODE 0U
+#define SERVER_NODE 0U
+#define POLLS       10000U
+
+static StdRet_t Client_SendSpdu(const NodeId_t nodeId, const SpduLen_t spduLen, const uint8_t* const pSpduData);
+static StdRet_t Client_SendSpduBatch(const SafeComSpdu* const pSpdus, const uint32_t count);
+static StdRet_t Client_ReceiveMsg(const MsgId_t msgId, const MsgLen_t msgLen, const uint8_t* const pMsgData);
+static StdRet_t Server_SendSpdu(const NodeId_t nodeId, const SpduLen_t spduLen, const uint8_t* const pSpduData);
+static StdRet_t Server_ReceiveMsg(const MsgId_t msgId, const MsgLen_t msgLen, const uint8_t* const pMsgData);
+
+static UdpTransport client_udp;
+static UdpTransport server_udp;
+static struct sockaddr_in client_peers[1];
+static struct sockaddr_in server_peers[1];
+static UdpRoute client_routes[ROUTES];
+static UdpRoute server_routes[ROUTES];
+static uint8_t delivered[MAX_DATA_LENGTH];
+static MsgLen_t delivered_len = 0;
+
+static struct sockaddr_in loopback(void)
+{
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_port = 0 };
+
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    return addr;
+}
+
+/* Two transports on ephemeral loopback ports, each the only peer of the other */
+static int open_transports(const bool offload)
+{
+    const UdpConfig client_config = { .local = loopback(), .peers = client_peers, .peer_count = 1,
+                                      .first_node = SERVER_NODE, .routes = client_routes, .route_count = ROUTES, .offload = offload };
+    const UdpConfig server_config = { .local = loopback(), .peers = server_peers, .peer_count = 1,
+                                      .first_node = CLIENT_NODE, .routes = server_routes, .route_count = ROUTES, .offload = offload };
+
+    memset(client_peers, 0, sizeof(client_peers));
+    memset(server_peers, 0, sizeof(server_peers));
+    if ((Udp_Init(&client_udp, &client_config) != OK) || (Udp_Init(&server_udp, &server_config) != OK) ||
+        (Udp_AddPeer(&client_udp, SERVER_NODE, &server_udp.local) != OK) ||
+        (Udp_AddPeer(&server_udp, CLIENT_NODE, &client_udp.local) != OK)) {
+        return -1;
+    }
+
+    return 0;
+}
+
+static int open_pair(void **state)
+{
+    (void)state;
+
+    return open_transports(false);
+}
+
+static int open_offload_pair(void **state)
+{
+    (void)state;
+
+    return open_transports(true);
+}
+
+static int close_pair(void **state)
+{
+    (void)state;
+
+    Udp_Close(&client_udp);
+    Udp_Close(&server_udp);
+
+    return 0;
+}
+
+static void test_udp_batch(void **state)
+{
+    (void)state;
+
+    uint8_t frames[FRAMES][8];
+    SafeComSpdu spdus[FRAMES];
+    uint32_t received = 0;
+
+    /* Queued single SPDUs leave 64 per syscall */
+    for (uint32_t i = 0; i < FRAMES; i++) {
+        memset(frames[i], (int)i, sizeof(frames[i]));
+        assert_true(Udp_SendSpdu(&client_udp, SERVER_NODE, sizeof(frames[i]), frames[i]) == OK);
+        spdus[i] = (SafeComSpdu){ .nodeId = SERVER_NODE, .spduLen = sizeof(frames[i]), .pSpduData = frames[i] };
+    }
+    assert_int_equal(Udp_Flush(&client_udp), FRAMES - UDP_BATCH);
+    assert_int_equal(client_udp.stats.tx_syscalls, 2);
+
+    /* They arrive in order and in place, tagged with the node of the sender */
+    for (uint32_t poll = 0; (poll < POLLS) && (received < FRAMES); poll++) {
+        const SafeComSpdu* rx;
+        const uint32_t count = Udp_Receive(&server_udp, &rx);
+
+        for (uint32_t i = 0; i < count; i++) {
+            assert_int_equal(rx[i].nodeId, CLIENT_NODE);
+            assert_int_equal(rx[i].spduLen, sizeof(frames[0]));
+            assert_memory_equal(rx[i].pSpduData, frames[received + i], sizeof(frames[0]));
+            assert_true((rx[i].pSpduData >= &server_udp.rx_frames[0][0]) && (rx[i].pSpduData < &server_udp.rx_frames[UDP_BATCH][0]));
+        }
+        received += count;
+    }
+    assert_int_equal(received, FRAMES);
+    assert_int_equal(server_udp.stats.rx_datagrams, FRAMES);
+
+    /* A batch goes out straight from the caller's frames, again 64 per syscall */
+    assert_true(Udp_SendSpduBatch(&server_udp, spdus, FRAMES) == OK);
+    assert_int_equal(server_udp.stats.tx_datagrams, FRAMES);
+    assert_int_equal(server_udp.stats.tx_syscalls, 2);
+
+    /* Unknown nodes are refused */
+    assert_true(Udp_SendSpdu(&client_udp, SERVER_NODE + 1U, sizeof(frames[0]), frames[0]) == NOT_OK);
+    spdus[0].nodeId = SERVER_NODE + 1U;
+    assert_true(Udp_SendSpduBatch(&server_udp, spdus, 2) == NOT_OK);
+    assert_int_equal(server_udp.stats.tx_dropped, 1);
+}
+
+static void test_udp_foreign(void **state)
+{
+    (void)state;
+
+    const int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    const uint8_t big[MAX_BUFF_SIZE + 1] = { 0 };
+    const SafeComSpdu* rx;
+    uint32_t polls = 0;
+
+    /* Datagrams from an address that is no peer, and one too long for an SPDU */
+    assert_true(fd >= 0);
+    assert_int_equal(sendto(fd, big, 16, 0, (const struct sockaddr*)&server_udp.local, sizeof(server_udp.local)), 16);
+    assert_int_equal(sendto(fd, big, sizeof(big), 0, (const struct sockaddr*)&server_udp.local, sizeof(server_udp.local)), sizeof(big));
+    close(fd);
+
+    while ((polls < POLLS) && ((server_udp.stats.rx_unknown + server_udp.stats.rx_truncated) < 2U)) {
+        assert_int_equal(Udp_Receive(&server_udp, &rx), 0);
+        polls++;
+    }
+    assert_int_equal(server_udp.stats.rx_unknown, 1);
+    assert_int_equal(server_udp.stats.rx_truncated, 1);
+
+    /* A node keeps its address */
+    assert_true(Udp_AddPeer(&server_udp, CLIENT_NODE, &server_udp.local) == NOT_OK);
+}
+
+static void test_udp_offload(void **state)
+{
+    (void)state;
+
+    /* Runs to one peer break where a datagram is longer, or follows a shorter one */
+    static const SpduLen_t lengths[] = { 8, 8, 8, 4, 8, 8, 12 };
+    const uint32_t total = sizeof(lengths) / sizeof(lengths[0]);
+    uint8_t frames[sizeof(lengths) / sizeof(lengths[0])][12];
+    uint32_t received = 0;
+
+    for (uint32_t i = 0; i < total; i++) {
+        memset(frames[i], (int)i + 1, sizeof(frames[i]));
+        assert_true(Udp_SendSpdu(&client_udp, SERVER_NODE, lengths[i], frames[i]) == OK);
+    }
+    assert_int_equal(Udp_Flush(&client_udp), total);
+    assert_int_equal(client_udp.stats.tx_syscalls, 1);
+    if (client_udp.gso) {
+        assert_int_equal(client_udp.stats.tx_coalesced, 6);   /* 8, 8, 8, 4 and 8, 8; the 12 goes alone */
+    }
+
+    /* Bursts are split back into the datagrams, in order and in place */
+    for (uint32_t poll = 0; (poll < POLLS) && (received < total); poll++) {
+        const SafeComSpdu* rx;
+        const uint32_t count = Udp_Receive(&server_udp, &rx);
+
+        for (uint32_t i = 0; i < count; i++) {
+            assert_int_equal(rx[i].nodeId, CLIENT_NODE);
+            assert_int_equal(rx[i].spduLen, lengths[received + i]);
+            assert_memory_equal(rx[i].pSpduData, frames[received + i], lengths[received + i]);
+        }
+        received += count;
+    }
+    assert_int_equal(received, total);
+    assert_int_equal(server_udp.stats.rx_truncated, 0);
+    if (client_udp.gso && server_udp.gro) {
+        assert_int_equal(server_udp.stats.rx_coalesced, 6);
+    }
+
+    /* A full batch to one peer is a single burst */
+    for (uint32_t i = 0; i < UDP_BATCH; i++) {
+        assert_true(Udp_SendSpdu(&client_udp, SERVER_NODE, lengths[0], frames[0]) == OK);
+    }
+    assert_int_equal(Udp_Flush(&client_udp), UDP_BATCH);
+    received = 0;
+    for (uint32_t poll = 0; (poll < POLLS) && (received < UDP_BATCH); poll++) {
+        const SafeComSpdu* rx;
+
+        received += Udp_Receive(&server_udp, &rx);
+    }
+    assert_int_equal(received, UDP_BATCH);
+    if (client_udp.gso && server_udp.gro) {
+        assert_int_equal(server_udp.stats.rx_coalesced, 6U + UDP_BATCH);
+    }
+}
+
+static void test_udp_safecom(void **state)
+{
+    (void)state;
+
+    SmType client_sms[1] = { 0 };
+    SmType server_sms[1] = { 0 };
+    SafeCom client;
+    SafeCom server;
+    const SafeComType client_config = {
+        .vtable = { .SendSpdu = Client_SendSpdu, .SendSpduBatch = Client_SendSpduBatch, .ReceiveMsg = Client_ReceiveMsg },
+        .config = { .instname = "client", .role = ROLE_CLIENT, .max_connections = 1, .first_node = SERVER_NODE, .sms = client_sms },
+    };
+    const SafeComType server_config = {
+        .vtable = { .SendSpdu = Server_SendSpdu, .ReceiveMsg = Server_ReceiveMsg },
+        .config = { .instname = "server", .role = ROLE_SERVER, .max_connections = 1, .first_node = CLIENT_NODE, .sms = server_sms },
+    };
+    const uint8_t data[] = "over loopback";
+
+    assert_true(SafeCom_Init(&client, &client_config) == OK);
+    assert_true(SafeCom_Init(&server, &server_config) == OK);
+    assert_true(SafeCom_OpenConnection(&server, CLIENT_NODE) == OK);
+    assert_true(SafeCom_OpenConnection(&client, SERVER_NODE) == OK);
+    Udp_Flush(&client_udp);
+
+    /* ConnReq, ConnResp and HB cross the sockets */
+    for (uint32_t poll = 0; (poll < POLLS) && (server_sms[0].state != STATE_UP); poll++) {
+        Udp_Poll(&server_udp, &server);
+        Udp_Poll(&client_udp, &client);
+    }
+    assert_true(client_sms[0].state == STATE_UP);
+    assert_true(server_sms[0].state == STATE_UP);
+
+    delivered_len = 0;
+    assert_true(SafeCom_SendData(&client, SERVER_NODE, sizeof(data), data) == OK);
+    Udp_Flush(&client_udp);
+    for (uint32_t poll = 0; (poll < POLLS) && (delivered_len == 0U); poll++) {
+        Udp_Poll(&server_udp, &server);
+    }
+    assert_int_equal(delivered_len, sizeof(data));
+    assert_memory_equal(delivered, data, sizeof(data));
+    assert_int_equal(server_sms[0].rx_dropped, 0);
+}
+
+extern int test_udp(void) {
+    int return_value = -1;
+
+    const struct CMUnitTest udp_tests[] = {
+        cmocka_unit_test_setup_teardown(test_udp_batch, open_pair, close_pair),     /* 64 datagrams per syscall, received in place */
+        cmocka_unit_test_setup_teardown(test_udp_foreign, open_pair, close_pair),   /* Unknown senders and oversized datagrams */
+        cmocka_unit_test_setup_teardown(test_udp_safecom, open_pair, close_pair),   /* A connection comes up and carries data */
+        cmocka_unit_test_setup_teardown(test_udp_offload, open_offload_pair, close_pair),       /* GSO bursts split back into SPDUs */
+        cmocka_unit_test_setup_teardown(test_udp_foreign, open_offload_pair, close_pair),       /* The same checks on a GRO socket */
+        cmocka_unit_test_setup_teardown(test_udp_safecom, open_offload_pair, close_pair),       /* The same connection with offload */
+    };
+
+    return_value = cmocka_run_group_tests_name("udp_tests", udp_tests, NULL, NULL);
+
+    return return_value;
+}
+
+static StdRet_t Client_SendSpdu(const NodeId_t nodeId, const SpduLen_t spduLen, const uint8_t* const pSpduData)
+{
+    return Udp_SendSpdu(&client_udp, nodeId, spduLen, pSpduData);
+}
+
+static StdRet_t Client_SendSpduBatch(const SafeComSpdu* const pSpdus, const uint32_t count)
+{
+    return Udp_SendSpduBatch(&client_udp, pSpdus, count);
+}
+
+static StdRet_t Client_ReceiveMsg(const MsgId_t msgId, const MsgLen_t msgLen, const uint8_t* const pMsgData)
+{
+    (void)msgId;
+    (void)msgLen;
+    (void)pMsgData;
+
+    return OK;
+}
+
+static StdRet_t Server_SendSpdu(const NodeId_t nodeId, const SpduLen_t spduLen, const uint8_t* const pSpduData)
+{
+    return Udp_SendSpdu(&server_udp, nodeId, spduLen, pSpduData);
+}
+
+static StdRet_t Server_ReceiveMsg(const MsgId_t msgId, const MsgLen_t msgLen, const uint8_t* const pMsgData)
+{
+    (void)msgId;
+
+    memcpy(delivered, pMsgData, msgLen);
+    delivered_len = msgLen;
+    return OK;
+}
@@ -0,0 +1,322 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdarg.h>
+#include <setjmp.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include "cmocka.h"
+
+#include "uring.h"
+#include "log.h"
+
+#define FRAMES      100U
+#define ROUTES      4U
+#define CLIENT_NODE 0U
+#define SERVER_NODE 0U
+#define POLLS       10000U
+
+static StdRet_t Client_SendSpdu(const NodeId_t nodeId, const SpduLen_t spduLen, const uint8_t* const pSpduData);
+static StdRet_t Client_ReceiveMsg(const MsgId_t msgId, const MsgLen_t msgLen, const uint8_t* const pMsgData);
+static StdRet_t Server_SendSpdu(const NodeId_t nodeId, const SpduLen_t spduLen, const uint8_t* const pSpduData);
+static StdRet_t Server_SendSpduBatch(const SafeComSpdu* const pSpdus, const uint32_t count);
+static StdRet_t Server_ReceiveMsg(const MsgId_t msgId, const MsgLen_t msgLen, const uint8_t* const pMsgData);
+
+/* The client is a plain UDP transport, the server runs on io_uring */
+static UdpTransport client_udp;
+static UringTransport server_uring;
+static bool uring_available = false;
+static struct sockaddr_in client_peers[1];
+static struct sockaddr_in server_peers[1];
+static UdpRoute client_routes[ROUTES];
+static UdpRoute server_routes[ROUTES];
+static uint8_t delivered[MAX_DATA_LENGTH];
+static MsgLen_t delivered_len = 0;
+
+static struct sockaddr_in loopback(void)
+{
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_port = 0 };
+
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    return addr;
+}
+
+/* Without io_uring (disabled by sysctl, seccomp or an old kernel) the tests are skipped */
+static int open_pair(void **state)
+{
+    (void)state;
+
+    const UdpConfig client_config = { .local = loopback(), .peers = client_peers, .peer_count = 1,
+                                      .first_node = SERVER_NODE, .routes = client_routes, .route_count = ROUTES };
+    const UdpConfig server_config = { .local = loopback(), .peers = server_peers, .peer_count = 1,
+                                      .first_node = CLIENT_NODE, .routes = server_routes, .route_count = ROUTES };
+
+    memset(client_peers, 0, sizeof(client_peers));
+    memset(server_peers, 0, sizeof(server_peers));
+    if (Udp_Init(&client_udp, &client_config) != OK) {
+        return -1;
+    }
+    uring_available = (Uring_Init(&server_uring, &server_config) == OK);
+    if (uring_available &&
+        ((Udp_AddPeer(&client_udp, SERVER_NODE, &server_uring.udp.local) != OK) ||
+         (Udp_AddPeer(&server_uring.udp, CLIENT_NODE, &client_udp.local) != OK))) {
+        return -1;
+    }
+
+    return 0;
+}
+
+static int close_pair(void **state)
+{
+    (void)state;
+
+    Udp_Close(&client_udp);
+    if (uring_available) {
+        Uring_Close(&server_uring);
+    }
+
+    return 0;
+}
+
+static void test_uring_batch(void **state)
+{
+    (void)state;
+
+    if (!uring_available) {
+        skip();
+    }
+
+    uint8_t frames[FRAMES][8];
+    SafeComSpdu spdus[FRAMES];
+    uint32_t received = 0;
+
+    for (uint32_t i = 0; i < FRAMES; i++) {
+        memset(frames[i], (int)i, sizeof(frames[i]));
+        spdus[i] = (SafeComSpdu){ .nodeId = CLIENT_NODE, .spduLen = sizeof(frames[i]), .pSpduData = frames[i] };
+    }
+    assert_true(Udp_SendSpduBatch(&client_udp, spdus, FRAMES) == OK);
+
+    /* They arrive in order, in the registered buffers, tagged with the node of the sender */
+    for (uint32_t poll = 0; (poll < POLLS) && (received < FRAMES); poll++) {
+        const SafeComSpdu* rx;
+        const uint32_t count = Uring_Receive(&server_uring, &rx);
+
+        for (uint32_t i = 0; i < count; i++) {
+            assert_int_equal(rx[i].nodeId, CLIENT_NODE);
+            assert_int_equal(rx[i].spduLen, sizeof(frames[0]));
+            assert_memory_equal(rx[i].pSpduData, frames[received + i], sizeof(frames[0]));
+            assert_true((rx[i].pSpduData >= &server_uring.buffers[0][0]) && (rx[i].pSpduData < &server_uring.buffers[URING_BUFFERS][0]));
+        }
+        received += count;
+    }
+    assert_int_equal(received, FRAMES);
+    assert_int_equal(server_uring.udp.stats.rx_datagrams, FRAMES);
+
+    /* A batch goes out straight from the caller's frames, one io_uring_enter per UDP_BATCH */
+    assert_true(Uring_SendSpduBatch(&server_uring, spdus, FRAMES) == OK);
+    assert_int_equal(server_uring.udp.stats.tx_datagrams, FRAMES);
+    assert_int_equal(server_uring.tx_inflight, 0);
+
+    received = 0;
+    for (uint32_t poll = 0; (poll < POLLS) && (received < FRAMES); poll++) {
+        const SafeComSpdu* rx;
+
+        received += Udp_Receive(&client_udp, &rx);
+    }
+    assert_int_equal(received, FRAMES);
+
+    /* Queued single SPDUs are copied and go with the flush */
+    for (uint32_t i = 0; i < FRAMES; i++) {
+        assert_true(Uring_SendSpdu(&server_uring, CLIENT_NODE, sizeof(frames[i]), frames[i]) == OK);
+    }
+    assert_int_equal(Uring_Flush(&server_uring), FRAMES - UDP_BATCH);
+    assert_int_equal(server_uring.udp.stats.tx_datagrams, 2U * FRAMES);
+
+    /* Unknown nodes are refused */
+    assert_true(Uring_SendSpdu(&server_uring, CLIENT_NODE + 1U, sizeof(frames[0]), frames[0]) == NOT_OK);
+    spdus[0].nodeId = CLIENT_NODE + 1U;
+    assert_true(Uring_SendSpduBatch(&server_uring, spdus, 2) == NOT_OK);
+    assert_int_equal(server_uring.udp.stats.tx_dropped, 2);
+}
+
+static void test_uring_failed_enter(void **state)
+{
+    (void)state;
+
+    if (!uring_available) {
+        skip();
+    }
+
+    const uint8_t frame[8] = { 0 };
+    const SafeComSpdu spdus[2] = { { .nodeId = CLIENT_NODE, .spduLen = sizeof(frame), .pSpduData = frame },
+                                   { .nodeId = CLIENT_NODE, .spduLen = sizeof(frame), .pSpduData = frame } };
+    const int ring_fd = server_uring.ring_fd;
+
+    /* io_uring_enter on a descriptor that is no ring fails every time; the sends are dropped, nothing spins */
+    server_uring.ring_fd = server_uring.udp.fd;
+    assert_true(Uring_SendSpdu(&server_uring, CLIENT_NODE, sizeof(frame), frame) == OK);
+    assert_int_equal(Uring_Flush(&server_uring), 0);
+    assert_int_equal(server_uring.udp.stats.tx_dropped, 1);
+    assert_true(Uring_SendSpduBatch(&server_uring, spdus, 2) == NOT_OK);
+    assert_int_equal(server_uring.udp.stats.tx_dropped, 3);
+    assert_int_equal(server_uring.tx_inflight, 0);
+    assert_int_equal(server_uring.to_submit, 0);
+
+    /* The dropped SQEs were taken back, the ring sends again once it works */
+    server_uring.ring_fd = ring_fd;
+    assert_true(Uring_SendSpdu(&server_uring, CLIENT_NODE, sizeof(frame), frame) == OK);
+    assert_int_equal(Uring_Flush(&server_uring), 1);
+    assert_int_equal(server_uring.udp.stats.tx_datagrams, 1);
+}
+
+static void test_uring_foreign(void **state)
+{
+    (void)state;
+
+    if (!uring_available) {
+        skip();
+    }
+
+    const int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    const uint8_t big[MAX_BUFF_SIZE + 1] = { 0 };
+    const SafeComSpdu* rx;
+    uint32_t polls = 0;
+
+    /* Datagrams from an address that is no peer, and one too long for an SPDU */
+    assert_true(fd >= 0);
+    assert_int_equal(sendto(fd, big, 16, 0, (const struct sockaddr*)&server_uring.udp.local, sizeof(server_uring.udp.local)), 16);
+    assert_int_equal(sendto(fd, big, sizeof(big), 0, (const struct sockaddr*)&server_uring.udp.local, sizeof(server_uring.udp.local)), sizeof(big));
+    close(fd);
+
+    while ((polls < POLLS) && ((server_uring.udp.stats.rx_unknown + server_uring.udp.stats.rx_truncated) < 2U)) {
+        assert_int_equal(Uring_Receive(&server_uring, &rx), 0);
+        polls++;
+    }
+    assert_int_equal(server_uring.udp.stats.rx_unknown, 1);
+    assert_int_equal(server_uring.udp.stats.rx_truncated, 1);
+}
+
+static void test_uring_recycle(void **state)
+{
+    (void)state;
+
+    if (!uring_available) {
+        skip();
+    }
+
+    uint8_t frame[8] = { 0 };
+    uint32_t received = 0;
+    const uint32_t total = 4U * URING_BUFFERS;
+
+    /* Four times as many datagrams as buffers: each buffer goes back to the kernel once handed on */
+    for (uint32_t sent = 0; sent < total; sent++) {
+        assert_true(Udp_SendSpdu(&client_udp, SERVER_NODE, sizeof(frame), frame) == OK);
+        if ((sent % UDP_BATCH) == (UDP_BATCH - 1U)) {
+            Udp_Flush(&client_udp);
+            for (uint32_t poll = 0; (poll < POLLS) && (received <= sent); poll++) {
+                const SafeComSpdu* rx;
+
+                received += Uring_Receive(&server_uring, &rx);
+            }
+        }
+    }
+    assert_int_equal(received, total);
+    assert_true(server_uring.udp.stats.rx_syscalls < total);
+}
+
+static void test_uring_safecom(void **state)
+{
+    (void)state;
+
+    if (!uring_available) {
+        skip();
+    }
+
+    SmType client_sms[1] = { 0 };
+    SmType server_sms[1] = { 0 };
+    SafeCom client;
+    SafeCom server;
+    const SafeComType client_config = {
+        .vtable = { .SendSpdu = Client_SendSpdu, .ReceiveMsg = Client_ReceiveMsg },
+        .config = { .instname = "client", .role = ROLE_CLIENT, .max_connections = 1, .first_node = SERVER_NODE, .sms = client_sms },
+    };
+    const SafeComType server_config = {
+        .vtable = { .SendSpdu = Server_SendSpdu, .SendSpduBatch = Server_SendSpduBatch, .ReceiveMsg = Server_ReceiveMsg },
+        .config = { .instname = "server", .role = ROLE_SERVER, .max_connections = 1, .first_node = CLIENT_NODE, .sms = server_sms },
+    };
+    const uint8_t data[] = "over io_uring";
+
+    assert_true(SafeCom_Init(&client, &client_config) == OK);
+    assert_true(SafeCom_Init(&server, &server_config) == OK);
+    assert_true(SafeCom_OpenConnection(&server, CLIENT_NODE) == OK);
+    assert_true(SafeCom_OpenConnection(&client, SERVER_NODE) == OK);
+    Udp_Flush(&client_udp);
+
+    /* ConnReq, ConnResp and HB cross the sockets */
+    for (uint32_t poll = 0; (poll < POLLS) && (server_sms[0].state != STATE_UP); poll++) {
+        Uring_Poll(&server_uring, &server);
+        Udp_Poll(&client_udp, &client);
+    }
+    assert_true(client_sms[0].state == STATE_UP);
+    assert_true(server_sms[0].state == STATE_UP);
+
+    delivered_len = 0;
+    assert_true(SafeCom_SendData(&client, SERVER_NODE, sizeof(data), data) == OK);
+    Udp_Flush(&client_udp);
+    for (uint32_t poll = 0; (poll < POLLS) && (delivered_len == 0U); poll++) {
+        Uring_Poll(&server_uring, &server);
+    }
+    assert_int_equal(delivered_len, sizeof(data));
+    assert_memory_equal(delivered, data, sizeof(data));
+    assert_int_equal(server_sms[0].rx_dropped, 0);
+}
+
+extern int test_uring(void) {
+    int return_value = -1;
+
+    const struct CMUnitTest uring_tests[] = {
+        cmocka_unit_test_setup_teardown(test_uring_batch, open_pair, close_pair),   /* Batches each way, received in place */
+        cmocka_unit_test_setup_teardown(test_uring_failed_enter, open_pair, close_pair), /* A failing ring drops instead of spinning */
+        cmocka_unit_test_setup_teardown(test_uring_foreign, open_pair, close_pair), /* Unknown senders and oversized datagrams */
+        cmocka_unit_test_setup_teardown(test_uring_recycle, open_pair, close_pair), /* Buffers go back to the kernel */
+        cmocka_unit_test_setup_teardown(test_uring_safecom, open_pair, close_pair), /* A connection comes up and carries data */
+    };
+
+    return_value = cmocka_run_group_tests_name("uring_tests", uring_tests, NULL, NULL);
+
+    return return_value;
+}
+
+static StdRet_t Client_SendSpdu(const NodeId_t nodeId, const SpduLen_t spduLen, const uint8_t* const pSpduData)
+{
+    return Udp_SendSpdu(&client_udp, nodeId, spduLen, pSpduData);
+}
+
+static StdRet_t Client_ReceiveMsg(const MsgId_t msgId, const MsgLen_t msgLen, const uint8_t* const pMsgData)
+{
+    (void)msgId;
+    (void)msgLen;
+    (void)pMsgData;
+
+    return OK;
+}
+
+static StdRet_t Server_SendSpdu(const NodeId_t nodeId, const SpduLen_t spduLen, const uint8_t* const pSpduData)
+{
+    return Uring_SendSpdu(&server_uring, nodeId, spduLen, pSpduData);
+}
+
+static StdRet_t Server_SendSpduBatch(const SafeComSpdu* const pSpdus, const uint32_t count)
+{
+    return Uring_SendSpduBatch(&server_uring, pSpdus, count);
+}
+
+static StdRet_t Server_ReceiveMsg(const MsgId_t msgId, const MsgLen_t msgLen, const uint8_t* const pMsgData)
+{
+    (void)msgId;
+
+    memcpy(delivered, pMsgData, msgLen);
+    delivered_len = msgLen;
+    return OK;
+}
@@ -0,0 +1,85 @@
+#ifndef LOOPBACK_H
+#define LOOPBACK_H
+
+#include <stdint.h>
+#include "safecom.h"
+
+#define LOOPBACK_FRAMES 1024U   /* Frames in flight in each direction */
+
+/* Hands a burst of SPDUs to an endpoint: Rass_ReceiveSpduBatch, Sic_ReceiveSpduBatch or a
+   wrapper of SafeCom_ReceiveSpduBatch for an instance of the caller's */
+typedef StdRet_t (*LoopbackDeliver_t)(const SafeComSpdu* const pSpdus, const uint32_t count);
+
+typedef struct {
+    LoopbackDeliver_t ToClient;
+    LoopbackDeliver_t ToServer;
+    NodeId_t client_first_node;     /* first_node of the client instance, its connection 0 */
+    NodeId_t server_first_node;     /* first_node of the server instance; connection i pairs with client connection i */
+} LoopbackConfig;
+
+typedef struct {
+    uint8_t frames[LOOPBACK_FRAMES][MAX_BUFF_SIZE];
+    SafeComSpdu spdus[LOOPBACK_FRAMES];
+    uint32_t count;
+    uint64_t dropped;   /* Refused, the queue was full */
+} LoopbackQueue;
+
+/* In-process wire between a client and a server instance, without sockets or threads. Sent
+   SPDUs are copied into a queue and delivered in place by Loopback_Pump, so an endpoint is
+   never entered from inside its own send. SendSpdu carries no context, so the vtable entries
+   below serve the loopback of the last Loopback_Init; one wire at a time. */
+typedef struct {
+    LoopbackConfig config;
+    LoopbackQueue to_server;
+    LoopbackQueue to_client;
+    uint64_t delivered;
+} Loopback;
+
+/**
+ * @brief Set up the wire and make it the one the vtable entries below send on.
+ *
+ * @param[out]  self    Wire, owned by the caller.
+ * @param[in]   pConfig Endpoints and the node ids of their first connections.
+ */
+void Loopback_Init(Loopback* const self, const LoopbackConfig* const pConfig);
+
+/**
+ * @brief SendSpdu of the client instance. Copies the frame into the queue to the server.
+ *
+ * @retval - `OK`       Queued.
+ * @retval - `NOT_OK`   Frame too long or queue full.
+ */
+StdRet_t Loopback_ClientSendSpdu(const NodeId_t nodeId, const SpduLen_t spduLen, const uint8_t* const pSpduData);
+
+/**
+ * @brief SendSpdu of the server instance. Copies the frame into the queue to the client.
+ */
+StdRet_t Loopback_ServerSendSpdu(const NodeId_t nodeId, const SpduLen_t spduLen, const uint8_t* const pSpduData);
+
+/**
+ * @brief SendSpduBatch of the client instance.
+ */
+StdRet_t Loopback_ClientSendSpduBatch(const SafeComSpdu* const pSpdus, const uint32_t count);
+
+/**
+ * @brief SendSpduBatch of the server instance.
+ */
+StdRet_t Loopback_ServerSendSpduBatch(const SafeComSpdu* const pSpdus, const uint32_t count);
+
+/**
+ * @brief Deliver what is queued, first to the server and then to the client.
+ *
+ * The server's responses reach the client in the same call, the client's wait for the next.
+ *
+ * @retval Number of SPDUs delivered.
+ */
+uint32_t Loopback_Pump(Loopback* const self);
+
+/**
+ * @brief Pump until both queues stay empty, at most maxRounds times.
+ *
+ * @retval Number of SPDUs delivered.
+ */
+uint64_t Loopback_Run(Loopback* const self, const uint32_t maxRounds);
+
+#endif /* LOOPBACK_H */
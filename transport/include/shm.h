@@ -0,0 +1,136 @@
+#ifndef SHM_H
+#define SHM_H
+
+#include <stdint.h>
+#include "safecom.h"
+
+#define SHM_SLOTS   256U                /* Frames in each direction, a power of two */
+#define SHM_BATCH   SAFECOM_MAX_BATCH   /* SPDUs handed on by one Shm_Receive */
+#define SHM_MAGIC   0x5253484DU         /* Marks a region set up by Shm_Create */
+
+typedef struct {
+    uint32_t index;                 /* Peer index, node id minus first_node of the sender */
+    SpduLen_t len;
+    uint8_t data[MAX_BUFF_SIZE];
+} ShmSlot;
+
+/* Single-producer single-consumer ring. Each index sits on its own cache line and only its
+   owner writes it: the producer the tail, the consumer the head. */
+typedef struct {
+    uint32_t tail __attribute__((aligned(SM_CACHE_LINE)));
+    uint32_t head __attribute__((aligned(SM_CACHE_LINE)));
+    ShmSlot slots[SHM_SLOTS] __attribute__((aligned(SM_CACHE_LINE)));
+} ShmRing;
+
+/* Layout of the memfd, mapped by both processes */
+typedef struct {
+    uint32_t magic;
+    uint32_t size;                  /* sizeof(ShmRegion) of the creator, checked on attach */
+    ShmRing rings[2];               /* The creator sends on rings[0] and receives on rings[1] */
+} ShmRegion;
+
+typedef struct {
+    NodeId_t first_node;            /* Node id of connection 0 over the region on this side */
+    uint32_t peer_count;            /* Connections over the region, node first_node + i is index i on both sides */
+    uint32_t busy_poll;             /* Empty polls Shm_Poll spins before it returns, 0 returns at once */
+} ShmConfig;
+
+typedef struct {
+    uint64_t rx_frames;     /* Handed on as SPDUs */
+    uint64_t rx_invalid;    /* Dropped, peer index or length out of range */
+    uint64_t rx_spins;      /* Empty polls while busy-polling */
+    uint64_t tx_frames;
+    uint64_t tx_dropped;    /* Not sent, the ring is full or the node is unknown */
+} ShmStats;
+
+/* Shared-memory transport between two processes on one host. SPDUs are copied once, straight
+   into the ring, and handed on in place on the other side. No system calls after setup.
+   One thread per side sends and polls, like UdpTransport. */
+typedef struct {
+    int fd;
+    ShmConfig config;
+    ShmRegion *region;
+    ShmRing *tx;
+    ShmRing *rx;
+    uint32_t tx_tail;               /* Own copy of tx->tail */
+    uint32_t tx_head;               /* Last tx->head seen, refreshed when the ring looks full */
+    uint32_t rx_head;               /* Own copy of rx->head */
+    uint32_t rx_held;               /* Slots handed out by the last Shm_Receive, released by the next */
+    SafeComSpdu rx_spdus[SHM_BATCH];
+    ShmStats stats;
+} ShmTransport;
+
+/**
+ * @brief Create the shared region in a memfd and map it.
+ *
+ * The other process attaches with the descriptor in self->fd, inherited over fork or passed
+ * with SCM_RIGHTS.
+ *
+ * @param[out]  self    Transport, owned by the caller.
+ * @param[in]   pConfig Connections over the region.
+ *
+ * @retval - `OK`       Mapped.
+ * @retval - `NOT_OK`   The memfd could not be created or mapped.
+ */
+StdRet_t Shm_Create(ShmTransport* const self, const ShmConfig* const pConfig);
+
+/**
+ * @brief Map a region created by Shm_Create in another process.
+ *
+ * @param[out]  self    Transport, owned by the caller.
+ * @param[in]   pConfig Connections over the region.
+ * @param[in]   fd      Descriptor of the memfd; the transport owns it from now on and closes it
+ *                      if the call fails.
+ *
+ * @retval - `OK`       Mapped.
+ * @retval - `NOT_OK`   The descriptor is no region of this layout.
+ */
+StdRet_t Shm_Attach(ShmTransport* const self, const ShmConfig* const pConfig, const int fd);
+
+/**
+ * @brief Return the slots handed out, unmap the region and close the descriptor.
+ *
+ * The peer keeps its mapping; another process may attach to the same side later.
+ */
+void Shm_Close(ShmTransport* const self);
+
+/**
+ * @brief Copy an SPDU into the ring, visible to the peer at once.
+ *
+ * Matches SendSpdu_t once bound to a transport by the caller.
+ *
+ * @retval - `OK`       In the ring.
+ * @retval - `NOT_OK`   Unknown node, frame too long or ring full.
+ */
+StdRet_t Shm_SendSpdu(ShmTransport* const self, const NodeId_t nodeId, const SpduLen_t spduLen, const uint8_t* const pSpduData);
+
+/**
+ * @brief Copy a batch of SPDUs into the ring and publish them together.
+ *
+ * Matches SendSpduBatch_t once bound to a transport.
+ *
+ * @retval - `OK`       All SPDUs are in the ring.
+ * @retval - `NOT_OK`   Some were dropped, see the statistics.
+ */
+StdRet_t Shm_SendSpduBatch(ShmTransport* const self, const SafeComSpdu* const pSpdus, const uint32_t count);
+
+/**
+ * @brief Take the SPDUs waiting in the ring, up to SHM_BATCH, without blocking.
+ *
+ * The slots of the previous call go back to the peer first.
+ *
+ * @param[in]   self    Transport.
+ * @param[out]  pSpdus  SPDUs in the shared slots. Valid until the next Shm_Receive or Shm_Poll.
+ *
+ * @retval Number of SPDUs.
+ */
+uint32_t Shm_Receive(ShmTransport* const self, const SafeComSpdu** const pSpdus);
+
+/**
+ * @brief Hand the waiting SPDUs to an instance, spinning up to busy_poll times on an empty ring.
+ *
+ * @retval Number of SPDUs received.
+ */
+uint32_t Shm_Poll(ShmTransport* const self, const SafeCom* const instance);
+
+#endif /* SHM_H */
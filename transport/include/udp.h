@@ -0,0 +1,170 @@
+#ifndef UDP_H
+#define UDP_H
+
+#include <stdint.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include "safecom.h"
+
+#define UDP_BATCH   SAFECOM_MAX_BATCH   /* Datagrams moved by one recvmmsg or sendmmsg */
+#define UDP_NO_NODE 0xFFFFFFFFU         /* Free entry of the route table */
+#define UDP_GRO_MSGS    8U                          /* Coalesced bursts taken by one recvmmsg with offload */
+#define UDP_GRO_SIZE    (UDP_BATCH * MAX_BUFF_SIZE) /* The kernel merges at most 64 datagrams into a burst */
+#define UDP_RX_MAX      (UDP_GRO_MSGS * UDP_BATCH)  /* SPDUs handed on by one Udp_Receive */
+
+/* Source address of a peer and the node id its SPDUs are handed on with */
+typedef struct {
+    uint32_t addr;      /* IPv4 address, network byte order */
+    uint16_t port;      /* Network byte order */
+    NodeId_t nodeId;    /* UDP_NO_NODE for a free entry */
+} UdpRoute;
+
+typedef struct {
+    struct sockaddr_in local;           /* Address to bind, port 0 for an ephemeral one */
+    struct sockaddr_in *peers;          /* Address of node first_node + i, owned by the caller; entries
+                                           other than AF_INET are unset and may be added by Udp_AddPeer */
+    uint32_t peer_count;
+    NodeId_t first_node;
+    UdpRoute *routes;                   /* Storage of the source address table, owned by the caller */
+    uint32_t route_count;               /* Entries in routes, a power of two larger than peer_count */
+    bool offload;                       /* Send runs of SPDUs to one peer as a UDP_SEGMENT (GSO) burst
+                                           and receive bursts whole with UDP_GRO, where the kernel can */
+} UdpConfig;
+
+typedef struct {
+    uint64_t rx_datagrams;  /* Handed on as SPDUs */
+    uint64_t rx_unknown;    /* Dropped, from an address that is no peer */
+    uint64_t rx_truncated;  /* Dropped, larger than MAX_BUFF_SIZE or past UDP_RX_MAX in a burst */
+    uint64_t rx_syscalls;
+    uint64_t rx_coalesced;  /* Of rx_datagrams, split from a GRO burst */
+    uint64_t tx_datagrams;
+    uint64_t tx_dropped;    /* Not sent, the socket refused them or the node is unknown */
+    uint64_t tx_syscalls;
+    uint64_t tx_coalesced;  /* Datagrams handed to the socket in a GSO burst */
+} UdpStats;
+
+/* Control message carrying a GSO or GRO segment size */
+typedef union {
+    struct cmsghdr hdr;
+    uint8_t buf[CMSG_SPACE(sizeof(int))];
+} UdpCmsg;
+
+/* Non-blocking UDP socket moving SPDUs in batches. All frame buffers and message headers are
+   set up once by Udp_Init; received SPDUs are handed on in place. Not thread-safe: one thread
+   sends and polls, usually the one driving the SafeCom instance. */
+typedef struct {
+    int fd;
+    UdpConfig config;
+    struct sockaddr_in local;   /* Bound address, with the port picked by the kernel */
+    bool gso;                   /* Runs of SPDUs to one peer leave as one burst */
+    bool gro;                   /* UDP_GRO is on, datagrams arrive in rx_bursts */
+    uint8_t rx_frames[UDP_BATCH][MAX_BUFF_SIZE];
+    struct sockaddr_in rx_addrs[UDP_BATCH];
+    struct iovec rx_iov[UDP_BATCH];
+    struct mmsghdr rx_msgs[UDP_BATCH];
+    uint8_t rx_bursts[UDP_GRO_MSGS][UDP_GRO_SIZE];
+    struct iovec rx_burst_iov[UDP_GRO_MSGS];
+    struct mmsghdr rx_burst_msgs[UDP_GRO_MSGS];
+    UdpCmsg rx_burst_cmsgs[UDP_GRO_MSGS];
+    SafeComSpdu rx_spdus[UDP_RX_MAX];
+    uint8_t tx_frames[UDP_BATCH][MAX_BUFF_SIZE];   /* Copies of single SPDUs queued by Udp_SendSpdu */
+    struct iovec tx_iov[UDP_BATCH];
+    struct mmsghdr tx_msgs[UDP_BATCH];
+    struct mmsghdr tx_bursts[UDP_BATCH];    /* tx_msgs with runs to one peer merged, for GSO */
+    uint32_t tx_burst_len[UDP_BATCH];       /* Datagrams in each burst */
+    UdpCmsg tx_burst_cmsgs[UDP_BATCH];
+    uint32_t tx_count;          /* SPDUs queued and not flushed yet */
+    UdpStats stats;
+} UdpTransport;
+
+/**
+ * @brief Open and bind the socket and fill the route table.
+ *
+ * With offload, GSO and GRO are each used if the kernel supports them (4.18 and 5.0).
+ *
+ * @param[out]  self    Transport, owned by the caller.
+ * @param[in]   pConfig Addresses of the transport and its peers.
+ *
+ * @retval - `OK`       The socket is bound.
+ * @retval - `NOT_OK`   The socket could not be opened or bound, the route table is too small
+ *                      or two peers share an address.
+ */
+StdRet_t Udp_Init(UdpTransport* const self, const UdpConfig* const pConfig);
+
+/**
+ * @brief Set the address of a node whose address was not configured, e.g. an ephemeral port.
+ *
+ * @retval - `OK`       The node is reachable from now on.
+ * @retval - `NOT_OK`   The node is not one of the peers, already has an address, or the address is taken.
+ */
+StdRet_t Udp_AddPeer(UdpTransport* const self, const NodeId_t nodeId, const struct sockaddr_in* const addr);
+
+/**
+ * @brief Node a datagram came from.
+ *
+ * @retval Node id of the peer with the source address, UDP_NO_NODE if there is none.
+ */
+NodeId_t Udp_NodeOf(const UdpTransport* const self, const struct sockaddr_in* const addr);
+
+/**
+ * @brief Address SPDUs for a node go to.
+ *
+ * @retval Address of the node, NULL if the node is unknown or has no address yet.
+ */
+const struct sockaddr_in* Udp_PeerOf(const UdpTransport* const self, const NodeId_t nodeId);
+
+/**
+ * @brief Close the socket. Queued SPDUs are dropped.
+ */
+void Udp_Close(UdpTransport* const self);
+
+/**
+ * @brief Queue an SPDU for its node, to be sent with the next flush.
+ *
+ * The frame is copied, as SendSpdu requires. A full queue is flushed first.
+ * Matches SendSpdu_t once bound to a transport by the caller.
+ *
+ * @retval - `OK`       Queued.
+ * @retval - `NOT_OK`   Unknown node or frame too long.
+ */
+StdRet_t Udp_SendSpdu(UdpTransport* const self, const NodeId_t nodeId, const SpduLen_t spduLen, const uint8_t* const pSpduData);
+
+/**
+ * @brief Send a batch of SPDUs straight from the caller's frames, UDP_BATCH per syscall.
+ *
+ * SPDUs queued by Udp_SendSpdu go first. With GSO, consecutive SPDUs to one peer of the
+ * same length (the last may be shorter) leave as one burst. Matches SendSpduBatch_t once bound to a transport.
+ *
+ * @retval - `OK`       All SPDUs were sent.
+ * @retval - `NOT_OK`   Some were dropped, see the statistics.
+ */
+StdRet_t Udp_SendSpduBatch(UdpTransport* const self, const SafeComSpdu* const pSpdus, const uint32_t count);
+
+/**
+ * @brief Send the queued SPDUs.
+ *
+ * @retval Number of SPDUs sent.
+ */
+uint32_t Udp_Flush(UdpTransport* const self);
+
+/**
+ * @brief Receive the datagrams waiting on the socket, up to UDP_BATCH, without blocking.
+ *
+ * With GRO, up to UDP_GRO_MSGS bursts are received instead and split into up to UDP_RX_MAX SPDUs.
+ *
+ * @param[in]   self    Transport.
+ * @param[out]  pSpdus  SPDUs from known peers, in the receive buffers of the transport.
+ *                      Valid until the next Udp_Receive or Udp_Poll.
+ *
+ * @retval Number of SPDUs.
+ */
+uint32_t Udp_Receive(UdpTransport* const self, const SafeComSpdu** const pSpdus);
+
+/**
+ * @brief Hand the waiting SPDUs to an instance and flush what it sent in response.
+ *
+ * @retval Number of SPDUs received.
+ */
+uint32_t Udp_Poll(UdpTransport* const self, const SafeCom* const instance);
+
+#endif /* UDP_H */
@@ -0,0 +1,121 @@
+#ifndef URING_H
+#define URING_H
+
+#include <stdint.h>
+#include <linux/io_uring.h>
+#include "udp.h"
+
+#define URING_ENTRIES   128U    /* Submission queue entries: a batch of sends and the receive */
+#define URING_BUFFERS   256U    /* Receive buffers provided to the kernel, a power of two */
+#define URING_BUF_SIZE  (sizeof(struct io_uring_recvmsg_out) + sizeof(struct sockaddr_in) + MAX_BUFF_SIZE)
+#define URING_STASH     (2U * URING_BUFFERS) /* Receive completions waiting to be handed on */
+#define URING_FLUSH_TIMEOUT_NS 100000000U   /* A flush gives up on sends not completed by then */
+
+/* io_uring backend of the UDP transport. One multishot recvmsg receives into a ring of buffers
+   registered with the kernel and SPDUs are handed on in place. Sends are prepared as SQEs and
+   submitted together, one io_uring_enter per batch. Socket, peers and statistics are those of
+   the embedded UdpTransport. Not thread-safe, like UdpTransport. */
+typedef struct {
+    UdpTransport udp;
+    int ring_fd;
+    void *sq_ring;
+    size_t sq_ring_len;
+    void *cq_ring;              /* Same mapping as sq_ring with IORING_FEAT_SINGLE_MMAP */
+    size_t cq_ring_len;
+    struct io_uring_sqe *sqes;
+    size_t sqes_len;
+    uint32_t *sq_head;
+    uint32_t *sq_tail;
+    uint32_t *sq_mask;
+    uint32_t *sq_array;
+    uint32_t *cq_head;
+    uint32_t *cq_tail;
+    uint32_t *cq_mask;
+    struct io_uring_cqe *cqes;
+    uint32_t to_submit;         /* SQEs written since the last io_uring_enter */
+    struct io_uring_buf_ring *buf_ring; /* Page-aligned, registered with IORING_REGISTER_PBUF_RING */
+    uint16_t buf_tail;
+    uint8_t buffers[URING_BUFFERS][URING_BUF_SIZE];
+    struct msghdr rx_msg;       /* Layout of the multishot recvmsg: source address, no control data */
+    bool rx_armed;              /* The multishot recvmsg is active */
+    struct io_uring_cqe stash[URING_STASH]; /* Receive completions reaped while sends were completing */
+    uint32_t stash_head;
+    uint32_t stash_count;
+    uint16_t held[UDP_BATCH];   /* Buffers of the SPDUs handed out by the last Uring_Receive */
+    uint32_t held_count;
+    struct msghdr tx_msgs[UDP_BATCH];
+    uint32_t tx_queued;         /* Sends prepared and not submitted */
+    uint32_t tx_inflight;       /* Sends submitted and not completed */
+    uint32_t tx_epoch;          /* Bumped when a flush gives up on its sends */
+} UringTransport;
+
+/**
+ * @brief Open the UDP socket, set up the ring and its receive buffers and start receiving.
+ *
+ * @param[out]  self    Transport, owned by the caller.
+ * @param[in]   pConfig Addresses of the transport and its peers, as for Udp_Init. Offload is not
+ *                      used, each registered buffer takes one datagram.
+ *
+ * @retval - `OK`       Receiving.
+ * @retval - `NOT_OK`   The socket or the ring could not be set up, e.g. io_uring is disabled or
+ *                      the kernel lacks provided-buffer rings or multishot recvmsg (before 6.0).
+ */
+StdRet_t Uring_Init(UringTransport* const self, const UdpConfig* const pConfig);
+
+/**
+ * @brief Tear down the ring and close the socket. Queued SPDUs are dropped.
+ */
+void Uring_Close(UringTransport* const self);
+
+/**
+ * @brief Queue an SPDU for its node, to be submitted with the next flush.
+ *
+ * The frame is copied, as SendSpdu requires. A full queue is flushed first.
+ *
+ * @retval - `OK`       Queued.
+ * @retval - `NOT_OK`   Unknown node or frame too long.
+ */
+StdRet_t Uring_SendSpdu(UringTransport* const self, const NodeId_t nodeId, const SpduLen_t spduLen, const uint8_t* const pSpduData);
+
+/**
+ * @brief Send a batch of SPDUs straight from the caller's frames.
+ *
+ * Up to UDP_BATCH sends are submitted with one io_uring_enter, which also waits for them,
+ * so the frames are free again on return.
+ *
+ * @retval - `OK`       All SPDUs were sent.
+ * @retval - `NOT_OK`   Some were dropped, see the statistics.
+ */
+StdRet_t Uring_SendSpduBatch(UringTransport* const self, const SafeComSpdu* const pSpdus, const uint32_t count);
+
+/**
+ * @brief Submit the queued SPDUs and wait until they are sent.
+ *
+ * If io_uring_enter fails or the sends do not complete within URING_FLUSH_TIMEOUT_NS, the
+ * sends in flight are counted as tx_dropped and given up, so the flush does not block.
+ *
+ * @retval Number of SPDUs sent.
+ */
+uint32_t Uring_Flush(UringTransport* const self);
+
+/**
+ * @brief Collect received SPDUs, up to UDP_BATCH, without blocking.
+ *
+ * The buffers of the previous call go back to the kernel first.
+ *
+ * @param[in]   self    Transport.
+ * @param[out]  pSpdus  SPDUs from known peers, in the registered buffers.
+ *                      Valid until the next Uring_Receive or Uring_Poll.
+ *
+ * @retval Number of SPDUs.
+ */
+uint32_t Uring_Receive(UringTransport* const self, const SafeComSpdu** const pSpdus);
+
+/**
+ * @brief Hand the received SPDUs to an instance and flush what it sent in response.
+ *
+ * @retval Number of SPDUs received.
+ */
+uint32_t Uring_Poll(UringTransport* const self, const SafeCom* const instance);
+
+#endif /* URING_H */
@@ -0,0 +1,127 @@
+#include <string.h>
+#include "loopback.h"
+#include "assert.h"
+
+static Loopback *active = NULL;
+
+static StdRet_t enqueue(LoopbackQueue* const queue, const NodeId_t nodeId, const SpduLen_t spduLen, const uint8_t* const pSpduData)
+{
+    if ((queue->count == LOOPBACK_FRAMES) || (spduLen > MAX_BUFF_SIZE)) {
+        queue->dropped++;
+        return NOT_OK;
+    }
+
+    const uint32_t slot = queue->count++;
+    memcpy(queue->frames[slot], pSpduData, spduLen);
+    queue->spdus[slot].nodeId = nodeId;
+    queue->spdus[slot].spduLen = spduLen;
+    queue->spdus[slot].pSpduData = queue->frames[slot];
+
+    return OK;
+}
+
+/* Connection i keeps its index across the wire, its node id changes to the one of the other side */
+static uint32_t deliver(LoopbackQueue* const queue, const LoopbackDeliver_t deliver_to, const NodeId_t from_first, const NodeId_t to_first)
+{
+    const uint32_t count = queue->count;
+
+    for (uint32_t i = 0; i < count; i++) {
+        queue->spdus[i].nodeId = to_first + (queue->spdus[i].nodeId - from_first);
+    }
+    if (count > 0U) {
+        deliver_to(queue->spdus, count);
+    }
+    queue->count = 0;
+
+    return count;
+}
+
+void Loopback_Init(Loopback* const self, const LoopbackConfig* const pConfig)
+{
+    assert(self != NULL);
+    assert(pConfig != NULL);
+    assert(pConfig->ToClient != NULL);
+    assert(pConfig->ToServer != NULL);
+
+    memset(self, 0, sizeof(*self));
+    self->config = *pConfig;
+    active = self;
+}
+
+StdRet_t Loopback_ClientSendSpdu(const NodeId_t nodeId, const SpduLen_t spduLen, const uint8_t* const pSpduData)
+{
+    assert(active != NULL);
+    assert(pSpduData != NULL);
+
+    return enqueue(&active->to_server, nodeId, spduLen, pSpduData);
+}
+
+StdRet_t Loopback_ServerSendSpdu(const NodeId_t nodeId, const SpduLen_t spduLen, const uint8_t* const pSpduData)
+{
+    assert(active != NULL);
+    assert(pSpduData != NULL);
+
+    return enqueue(&active->to_client, nodeId, spduLen, pSpduData);
+}
+
+StdRet_t Loopback_ClientSendSpduBatch(const SafeComSpdu* const pSpdus, const uint32_t count)
+{
+    assert(active != NULL);
+    assert((pSpdus != NULL) || (count == 0U));
+
+    StdRet_t ret = OK;
+
+    for (uint32_t i = 0; i < count; i++) {
+        if (enqueue(&active->to_server, pSpdus[i].nodeId, pSpdus[i].spduLen, pSpdus[i].pSpduData) != OK) {
+            ret = NOT_OK;
+        }
+    }
+
+    return ret;
+}
+
+StdRet_t Loopback_ServerSendSpduBatch(const SafeComSpdu* const pSpdus, const uint32_t count)
+{
+    assert(active != NULL);
+    assert((pSpdus != NULL) || (count == 0U));
+
+    StdRet_t ret = OK;
+
+    for (uint32_t i = 0; i < count; i++) {
+        if (enqueue(&active->to_client, pSpdus[i].nodeId, pSpdus[i].spduLen, pSpdus[i].pSpduData) != OK) {
+            ret = NOT_OK;
+        }
+    }
+
+    return ret;
+}
+
+uint32_t Loopback_Pump(Loopback* const self)
+{
+    assert(self != NULL);
+
+    /* The server answers into to_client and the client into to_server, never the queue being delivered */
+    uint32_t count = deliver(&self->to_server, self->config.ToServer, self->config.client_first_node, self->config.server_first_node);
+    count += deliver(&self->to_client, self->config.ToClient, self->config.server_first_node, self->config.client_first_node);
+    self->delivered += count;
+
+    return count;
+}
+
+uint64_t Loopback_Run(Loopback* const self, const uint32_t maxRounds)
+{
+    assert(self != NULL);
+
+    uint64_t count = 0;
+
+    for (uint32_t round = 0; round < maxRounds; round++) {
+        const uint32_t pumped = Loopback_Pump(self);
+
+        if (pumped == 0U) {
+            break;
+        }
+        count += pumped;
+    }
+
+    return count;
+}
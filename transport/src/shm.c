@@ -0,0 +1,239 @@
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "shm.h"
+#include "assert.h"
+#include "log.h"
+
+static inline void cpu_relax(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    __asm__ volatile("yield");
+#endif
+}
+
+static StdRet_t map_region(ShmTransport* const self, const ShmConfig* const pConfig, const int fd, const bool creator)
+{
+    self->fd = fd;
+    self->config = *pConfig;
+
+    void* const addr = mmap(NULL, sizeof(ShmRegion), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, 0);
+    if (addr == MAP_FAILED) {
+        LOG_ERROR("shared region not mapped: %s", strerror(errno));
+        Shm_Close(self);
+        return NOT_OK;
+    }
+    self->region = addr;
+    self->tx = &self->region->rings[creator ? 0 : 1];
+    self->rx = &self->region->rings[creator ? 1 : 0];
+
+    /* A reattaching side picks up where the rings are */
+    self->tx_tail = __atomic_load_n(&self->tx->tail, __ATOMIC_RELAXED);
+    self->tx_head = __atomic_load_n(&self->tx->head, __ATOMIC_ACQUIRE);
+    self->rx_head = __atomic_load_n(&self->rx->head, __ATOMIC_RELAXED);
+
+    return OK;
+}
+
+/* Copy into the next free slot; published by the caller */
+static StdRet_t put_slot(ShmTransport* const self, const NodeId_t nodeId, const SpduLen_t spduLen, const uint8_t* const pSpduData)
+{
+    const uint32_t index = nodeId - self->config.first_node;
+
+    if ((index >= self->config.peer_count) || (spduLen > MAX_BUFF_SIZE)) {
+        self->stats.tx_dropped++;
+        return NOT_OK;
+    }
+    if ((self->tx_tail - self->tx_head) == SHM_SLOTS) {
+        /* Only touch the consumer's line when the ring looks full */
+        self->tx_head = __atomic_load_n(&self->tx->head, __ATOMIC_ACQUIRE);
+        if ((self->tx_tail - self->tx_head) == SHM_SLOTS) {
+            self->stats.tx_dropped++;
+            return NOT_OK;
+        }
+    }
+
+    ShmSlot* const slot = &self->tx->slots[self->tx_tail & (SHM_SLOTS - 1U)];
+    slot->index = index;
+    slot->len = spduLen;
+    memcpy(slot->data, pSpduData, spduLen);
+    self->tx_tail++;
+    self->stats.tx_frames++;
+
+    return OK;
+}
+
+static void publish(ShmTransport* const self)
+{
+    __atomic_store_n(&self->tx->tail, self->tx_tail, __ATOMIC_RELEASE);
+}
+
+StdRet_t Shm_Create(ShmTransport* const self, const ShmConfig* const pConfig)
+{
+    assert(self != NULL);
+    assert(pConfig != NULL);
+
+    memset(self, 0, sizeof(*self));
+    const int fd = memfd_create("rastas-shm", MFD_CLOEXEC);
+    if ((fd < 0) || (ftruncate(fd, sizeof(ShmRegion)) != 0)) {
+        LOG_ERROR("memfd not created: %s", strerror(errno));
+        if (fd >= 0) {
+            close(fd);
+        }
+        self->fd = -1;
+        return NOT_OK;
+    }
+    if (map_region(self, pConfig, fd, true) != OK) {
+        return NOT_OK;
+    }
+
+    /* The pages of a fresh memfd are zero, so both rings start empty */
+    self->region->size = sizeof(ShmRegion);
+    __atomic_store_n(&self->region->magic, SHM_MAGIC, __ATOMIC_RELEASE);
+
+    return OK;
+}
+
+StdRet_t Shm_Attach(ShmTransport* const self, const ShmConfig* const pConfig, const int fd)
+{
+    assert(self != NULL);
+    assert(pConfig != NULL);
+
+    memset(self, 0, sizeof(*self));
+    off_t size = lseek(fd, 0, SEEK_END);
+    if (size != (off_t)sizeof(ShmRegion)) {
+        LOG_ERROR("descriptor %d is no shared region", fd);
+        close(fd);
+        self->fd = -1;
+        return NOT_OK;
+    }
+    if (map_region(self, pConfig, fd, false) != OK) {
+        return NOT_OK;
+    }
+    if ((__atomic_load_n(&self->region->magic, __ATOMIC_ACQUIRE) != SHM_MAGIC) || (self->region->size != sizeof(ShmRegion))) {
+        LOG_ERROR("shared region of another layout");
+        Shm_Close(self);
+        return NOT_OK;
+    }
+
+    return OK;
+}
+
+void Shm_Close(ShmTransport* const self)
+{
+    assert(self != NULL);
+
+    if (self->region != NULL) {
+        /* Slots still handed out go back, so a side attaching later starts at the next frame */
+        self->rx_head += self->rx_held;
+        __atomic_store_n(&self->rx->head, self->rx_head, __ATOMIC_RELEASE);
+        munmap(self->region, sizeof(ShmRegion));
+        self->region = NULL;
+        self->tx = NULL;
+        self->rx = NULL;
+    }
+    if (self->fd >= 0) {
+        close(self->fd);
+        self->fd = -1;
+    }
+    self->rx_held = 0;
+}
+
+StdRet_t Shm_SendSpdu(ShmTransport* const self, const NodeId_t nodeId, const SpduLen_t spduLen, const uint8_t* const pSpduData)
+{
+    assert(self != NULL);
+    assert(pSpduData != NULL);
+
+    if (put_slot(self, nodeId, spduLen, pSpduData) != OK) {
+        return NOT_OK;
+    }
+    publish(self);
+
+    return OK;
+}
+
+StdRet_t Shm_SendSpduBatch(ShmTransport* const self, const SafeComSpdu* const pSpdus, const uint32_t count)
+{
+    assert(self != NULL);
+    assert((pSpdus != NULL) || (count == 0U));
+
+    StdRet_t ret = OK;
+
+    for (uint32_t i = 0; i < count; i++) {
+        if (put_slot(self, pSpdus[i].nodeId, pSpdus[i].spduLen, pSpdus[i].pSpduData) != OK) {
+            ret = NOT_OK;
+        }
+    }
+    publish(self);
+
+    return ret;
+}
+
+uint32_t Shm_Receive(ShmTransport* const self, const SafeComSpdu** const pSpdus)
+{
+    assert(self != NULL);
+    assert(pSpdus != NULL);
+
+    /* The slots handed out last time are free for the producer again */
+    if (self->rx_held > 0U) {
+        self->rx_head += self->rx_held;
+        self->rx_held = 0;
+        __atomic_store_n(&self->rx->head, self->rx_head, __ATOMIC_RELEASE);
+    }
+
+    const uint32_t tail = __atomic_load_n(&self->rx->tail, __ATOMIC_ACQUIRE);
+    uint32_t waiting = tail - self->rx_head;
+    uint32_t count = 0;
+
+    if (waiting > SHM_SLOTS) {
+        /* Corrupt indices from the peer: skip what was published */
+        self->stats.rx_invalid += waiting;
+        self->rx_head = tail;
+        __atomic_store_n(&self->rx->head, self->rx_head, __ATOMIC_RELEASE);
+        waiting = 0;
+    }
+    if (waiting > SHM_BATCH) {
+        waiting = SHM_BATCH;
+    }
+
+    for (uint32_t i = 0; i < waiting; i++) {
+        const ShmSlot* const slot = &self->rx->slots[(self->rx_head + i) & (SHM_SLOTS - 1U)];
+
+        if ((slot->index >= self->config.peer_count) || (slot->len > MAX_BUFF_SIZE)) {
+            self->stats.rx_invalid++;
+            continue;
+        }
+        self->rx_spdus[count].nodeId = self->config.first_node + slot->index;
+        self->rx_spdus[count].spduLen = slot->len;
+        self->rx_spdus[count].pSpduData = slot->data;
+        count++;
+    }
+    self->rx_held = waiting;
+    self->stats.rx_frames += count;
+    *pSpdus = self->rx_spdus;
+
+    return count;
+}
+
+uint32_t Shm_Poll(ShmTransport* const self, const SafeCom* const instance)
+{
+    assert(self != NULL);
+    assert(instance != NULL);
+
+    const SafeComSpdu* spdus;
+    uint32_t count = Shm_Receive(self, &spdus);
+
+    for (uint32_t spin = 0; (count == 0U) && (spin < self->config.busy_poll); spin++) {
+        cpu_relax();
+        self->stats.rx_spins++;
+        count = Shm_Receive(self, &spdus);
+    }
+    if (count > 0U) {
+        SafeCom_ReceiveSpduBatch(instance, spdus, count);
+    }
+
+    return count;
+}
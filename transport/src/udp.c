@@ -0,0 +1,428 @@
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <netinet/udp.h>
+#include "udp.h"
+#include "assert.h"
+#include "log.h"
+
+static uint32_t hash_addr(const uint32_t addr, const uint16_t port)
+{
+    uint32_t h = (addr ^ ((uint32_t)port << 16)) * 0x9E3779B1U;
+
+    return h ^ (h >> 15);
+}
+
+static StdRet_t route_add(UdpTransport* const self, const struct sockaddr_in* const addr, const NodeId_t nodeId)
+{
+    const uint32_t mask = self->config.route_count - 1U;
+    uint32_t index = hash_addr(addr->sin_addr.s_addr, addr->sin_port) & mask;
+
+    for (uint32_t probe = 0; probe <= mask; probe++) {
+        UdpRoute* const route = &self->config.routes[index];
+
+        if (route->nodeId == UDP_NO_NODE) {
+            route->addr = addr->sin_addr.s_addr;
+            route->port = addr->sin_port;
+            route->nodeId = nodeId;
+            return OK;
+        }
+        if ((route->addr == addr->sin_addr.s_addr) && (route->port == addr->sin_port)) {
+            return NOT_OK;
+        }
+        index = (index + 1U) & mask;
+    }
+
+    return NOT_OK;
+}
+
+NodeId_t Udp_NodeOf(const UdpTransport* const self, const struct sockaddr_in* const addr)
+{
+    assert(self != NULL);
+    assert(addr != NULL);
+
+    if (self->config.route_count == 0U) {
+        return UDP_NO_NODE;
+    }
+
+    const uint32_t mask = self->config.route_count - 1U;
+    uint32_t index = hash_addr(addr->sin_addr.s_addr, addr->sin_port) & mask;
+
+    for (uint32_t probe = 0; probe <= mask; probe++) {
+        const UdpRoute* const route = &self->config.routes[index];
+
+        if (route->nodeId == UDP_NO_NODE) {
+            break;
+        }
+        if ((route->addr == addr->sin_addr.s_addr) && (route->port == addr->sin_port)) {
+            return route->nodeId;
+        }
+        index = (index + 1U) & mask;
+    }
+
+    return UDP_NO_NODE;
+}
+
+const struct sockaddr_in* Udp_PeerOf(const UdpTransport* const self, const NodeId_t nodeId)
+{
+    assert(self != NULL);
+
+    const uint32_t index = nodeId - self->config.first_node;
+
+    return ((index < self->config.peer_count) && (self->config.peers[index].sin_family == AF_INET)) ? &self->config.peers[index] : NULL;
+}
+
+/* Datagrams in the entries first to end of a send, one per entry without bursts */
+static uint32_t datagrams(const uint32_t* const segs, const uint32_t first, const uint32_t end)
+{
+    uint32_t count = end - first;
+
+    if (segs != NULL) {
+        count = 0;
+        for (uint32_t i = first; i < end; i++) {
+            count += segs[i];
+        }
+    }
+
+    return count;
+}
+
+/* The first count entries of msgs go out, entry i carrying segs[i] datagrams if segs is given;
+   what the socket refuses is dropped, RaSTA recovers lost PDUs */
+static uint32_t send_msgs(UdpTransport* const self, struct mmsghdr* const msgs, const uint32_t* const segs, const uint32_t count)
+{
+    uint32_t pos = 0;
+    uint32_t sent = 0;
+
+    while (pos < count) {
+        const int n = sendmmsg(self->fd, &msgs[pos], count - pos, 0);
+
+        self->stats.tx_syscalls++;
+        if (n > 0) {
+            sent += datagrams(segs, pos, pos + (uint32_t)n);
+            pos += (uint32_t)n;
+        } else if ((n < 0) && (errno == EINTR)) {
+            continue;
+        } else if ((n < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK))) {
+            /* Socket buffer full: the rest of the batch would be refused as well */
+            self->stats.tx_dropped += datagrams(segs, pos, count);
+            break;
+        } else {
+            /* Only the entry at pos is refused, the ones after it get another chance */
+            LOG_ERROR("datagram %u of %u dropped: %s", pos, count, strerror(errno));
+            if ((segs != NULL) && (errno == EIO)) {
+                /* The device cannot segment, later sends go one datagram each */
+                self->gso = false;
+            }
+            self->stats.tx_dropped += datagrams(segs, pos, pos + 1U);
+            pos++;
+        }
+    }
+    self->stats.tx_datagrams += sent;
+
+    return sent;
+}
+
+/* Merge runs of the first count tx_msgs to one peer into GSO bursts: all datagrams of a run
+   are as long as the first, the last may be shorter */
+static uint32_t coalesce(UdpTransport* const self, const uint32_t count)
+{
+    uint32_t bursts = 0;
+
+    for (uint32_t first = 0; first < count; bursts++) {
+        const void* const peer = self->tx_msgs[first].msg_hdr.msg_name;
+        const size_t size = self->tx_iov[first].iov_len;
+        struct msghdr* const msg = &self->tx_bursts[bursts].msg_hdr;
+        uint32_t end = first + 1U;
+
+        while ((end < count) && (self->tx_msgs[end].msg_hdr.msg_name == peer) &&
+               (self->tx_iov[end - 1U].iov_len == size) && (self->tx_iov[end].iov_len <= size)) {
+            end++;
+        }
+
+        msg->msg_name = (void*)peer;
+        msg->msg_namelen = sizeof(struct sockaddr_in);
+        msg->msg_iov = &self->tx_iov[first];
+        msg->msg_iovlen = end - first;
+        msg->msg_control = NULL;
+        msg->msg_controllen = 0;
+        if ((end - first) > 1U) {
+            struct cmsghdr* const cmsg = &self->tx_burst_cmsgs[bursts].hdr;
+            const uint16_t segment = (uint16_t)size;
+
+            cmsg->cmsg_level = SOL_UDP;
+            cmsg->cmsg_type = UDP_SEGMENT;
+            cmsg->cmsg_len = CMSG_LEN(sizeof(segment));
+            memcpy(CMSG_DATA(cmsg), &segment, sizeof(segment));
+            msg->msg_control = cmsg;
+            msg->msg_controllen = CMSG_SPACE(sizeof(segment));
+            self->stats.tx_coalesced += end - first;
+        }
+        self->tx_burst_len[bursts] = end - first;
+        first = end;
+    }
+
+    return bursts;
+}
+
+static uint32_t transmit(UdpTransport* const self, const uint32_t count)
+{
+    if (!self->gso) {
+        return send_msgs(self, self->tx_msgs, NULL, count);
+    }
+
+    const uint32_t bursts = coalesce(self, count);
+
+    return send_msgs(self, self->tx_bursts, self->tx_burst_len, bursts);
+}
+
+/* Segment size of a GRO burst, 0 for a single datagram */
+static uint32_t gro_size(struct msghdr* const msg)
+{
+    for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(msg); cmsg != NULL; cmsg = CMSG_NXTHDR(msg, cmsg)) {
+        if ((cmsg->cmsg_level == SOL_UDP) && (cmsg->cmsg_type == UDP_GRO)) {
+            int size;
+
+            memcpy(&size, CMSG_DATA(cmsg), sizeof(size));
+            return (size > 0) ? (uint32_t)size : 0U;
+        }
+    }
+
+    return 0;
+}
+
+static void set_tx(UdpTransport* const self, const uint32_t slot, const struct sockaddr_in* const peer, const uint8_t* const pData, const SpduLen_t len)
+{
+    self->tx_iov[slot].iov_base = (void*)pData;
+    self->tx_iov[slot].iov_len = len;
+    self->tx_msgs[slot].msg_hdr.msg_name = (void*)peer;
+}
+
+StdRet_t Udp_Init(UdpTransport* const self, const UdpConfig* const pConfig)
+{
+    assert(self != NULL);
+    assert(pConfig != NULL);
+
+    memset(self, 0, sizeof(*self));
+    self->fd = -1;
+    self->config = *pConfig;
+
+    const uint32_t count = pConfig->route_count;
+    if ((pConfig->peer_count > 0U) &&
+        ((pConfig->routes == NULL) || (count <= pConfig->peer_count) || ((count & (count - 1U)) != 0U))) {
+        LOG_ERROR("route table of %u entries for %u peers", count, pConfig->peer_count);
+        return NOT_OK;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        pConfig->routes[i].nodeId = UDP_NO_NODE;
+    }
+    for (uint32_t i = 0; i < pConfig->peer_count; i++) {
+        if ((pConfig->peers[i].sin_family == AF_INET) && (route_add(self, &pConfig->peers[i], pConfig->first_node + i) != OK)) {
+            LOG_ERROR("peer %u has the address of another peer", i);
+            return NOT_OK;
+        }
+    }
+
+    self->fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    socklen_t len = sizeof(self->local);
+    if ((self->fd < 0) ||
+        (bind(self->fd, (const struct sockaddr*)&pConfig->local, sizeof(pConfig->local)) != 0) ||
+        (getsockname(self->fd, (struct sockaddr*)&self->local, &len) != 0)) {
+        LOG_ERROR("UDP socket not bound: %s", strerror(errno));
+        Udp_Close(self);
+        return NOT_OK;
+    }
+    if (pConfig->offload) {
+        const int on = 1;
+        int segment = 0;
+        socklen_t optlen = sizeof(segment);
+
+        self->gso = (getsockopt(self->fd, SOL_UDP, UDP_SEGMENT, &segment, &optlen) == 0);
+        self->gro = (setsockopt(self->fd, SOL_UDP, UDP_GRO, &on, sizeof(on)) == 0);
+        if (!self->gso || !self->gro) {
+            LOG_WARNING("UDP offload partly unavailable: GSO %d, GRO %d", self->gso, self->gro);
+        }
+    }
+
+    /* The headers point at their buffers for good; only lengths and addresses change per datagram */
+    for (uint32_t i = 0; i < UDP_BATCH; i++) {
+        self->rx_iov[i].iov_base = self->rx_frames[i];
+        self->rx_iov[i].iov_len = MAX_BUFF_SIZE;
+        self->rx_msgs[i].msg_hdr.msg_iov = &self->rx_iov[i];
+        self->rx_msgs[i].msg_hdr.msg_iovlen = 1;
+        self->rx_msgs[i].msg_hdr.msg_name = &self->rx_addrs[i];
+        self->tx_msgs[i].msg_hdr.msg_iov = &self->tx_iov[i];
+        self->tx_msgs[i].msg_hdr.msg_iovlen = 1;
+        self->tx_msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+    }
+    for (uint32_t i = 0; i < UDP_GRO_MSGS; i++) {
+        self->rx_burst_iov[i].iov_base = self->rx_bursts[i];
+        self->rx_burst_iov[i].iov_len = UDP_GRO_SIZE;
+        self->rx_burst_msgs[i].msg_hdr.msg_iov = &self->rx_burst_iov[i];
+        self->rx_burst_msgs[i].msg_hdr.msg_iovlen = 1;
+        self->rx_burst_msgs[i].msg_hdr.msg_name = &self->rx_addrs[i];
+        self->rx_burst_msgs[i].msg_hdr.msg_control = &self->rx_burst_cmsgs[i];
+    }
+
+    return OK;
+}
+
+StdRet_t Udp_AddPeer(UdpTransport* const self, const NodeId_t nodeId, const struct sockaddr_in* const addr)
+{
+    assert(self != NULL);
+    assert(addr != NULL);
+
+    const uint32_t index = nodeId - self->config.first_node;
+
+    if ((index >= self->config.peer_count) || (self->config.peers[index].sin_family == AF_INET) ||
+        (addr->sin_family != AF_INET) || (route_add(self, addr, nodeId) != OK)) {
+        LOG_ERROR("node %u cannot be added as a UDP peer", nodeId);
+        return NOT_OK;
+    }
+    self->config.peers[index] = *addr;
+
+    return OK;
+}
+
+void Udp_Close(UdpTransport* const self)
+{
+    assert(self != NULL);
+
+    if (self->fd >= 0) {
+        close(self->fd);
+        self->fd = -1;
+    }
+    self->tx_count = 0;
+}
+
+StdRet_t Udp_SendSpdu(UdpTransport* const self, const NodeId_t nodeId, const SpduLen_t spduLen, const uint8_t* const pSpduData)
+{
+    assert(self != NULL);
+    assert(pSpduData != NULL);
+
+    const struct sockaddr_in* const peer = Udp_PeerOf(self, nodeId);
+    if ((peer == NULL) || (spduLen > MAX_BUFF_SIZE)) {
+        self->stats.tx_dropped++;
+        return NOT_OK;
+    }
+
+    if (self->tx_count == UDP_BATCH) {
+        Udp_Flush(self);
+    }
+    const uint32_t slot = self->tx_count++;
+    memcpy(self->tx_frames[slot], pSpduData, spduLen);
+    set_tx(self, slot, peer, self->tx_frames[slot], spduLen);
+
+    return OK;
+}
+
+StdRet_t Udp_SendSpduBatch(UdpTransport* const self, const SafeComSpdu* const pSpdus, const uint32_t count)
+{
+    assert(self != NULL);
+    assert((pSpdus != NULL) || (count == 0U));
+
+    const uint64_t dropped = self->stats.tx_dropped;
+
+    Udp_Flush(self);
+    for (uint32_t first = 0; first < count; first += UDP_BATCH) {
+        const uint32_t end = ((count - first) < UDP_BATCH) ? count : (first + UDP_BATCH);
+        uint32_t slots = 0;
+
+        for (uint32_t i = first; i < end; i++) {
+            const struct sockaddr_in* const peer = Udp_PeerOf(self, pSpdus[i].nodeId);
+
+            if (peer == NULL) {
+                self->stats.tx_dropped++;
+                continue;
+            }
+            set_tx(self, slots++, peer, pSpdus[i].pSpduData, pSpdus[i].spduLen);
+        }
+        transmit(self, slots);
+    }
+
+    return (self->stats.tx_dropped == dropped) ? OK : NOT_OK;
+}
+
+uint32_t Udp_Flush(UdpTransport* const self)
+{
+    assert(self != NULL);
+
+    const uint32_t count = self->tx_count;
+
+    self->tx_count = 0;
+    return (count > 0U) ? transmit(self, count) : 0U;
+}
+
+uint32_t Udp_Receive(UdpTransport* const self, const SafeComSpdu** const pSpdus)
+{
+    assert(self != NULL);
+    assert(pSpdus != NULL);
+
+    struct mmsghdr* const msgs = self->gro ? self->rx_burst_msgs : self->rx_msgs;
+    const uint32_t vlen = self->gro ? UDP_GRO_MSGS : UDP_BATCH;
+
+    for (uint32_t i = 0; i < vlen; i++) {
+        msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+        msgs[i].msg_hdr.msg_controllen = self->gro ? sizeof(self->rx_burst_cmsgs[i]) : 0U;
+    }
+
+    int n;
+    do {
+        n = recvmmsg(self->fd, msgs, vlen, MSG_DONTWAIT, NULL);
+        self->stats.rx_syscalls++;
+    } while ((n < 0) && (errno == EINTR));
+
+    uint32_t count = 0;
+    for (int i = 0; i < n; i++) {
+        struct msghdr* const msg = &msgs[i].msg_hdr;
+        const uint8_t* const data = msg->msg_iov->iov_base;
+        const uint32_t len = msgs[i].msg_len;
+        const uint32_t gro = self->gro ? gro_size(msg) : 0U;
+        const uint32_t segment = (gro > 0U) ? gro : len;
+        const NodeId_t nodeId = Udp_NodeOf(self, &self->rx_addrs[i]);
+
+        if ((msg->msg_flags & MSG_TRUNC) != 0) {
+            self->stats.rx_truncated++;
+            continue;
+        }
+
+        /* A burst is split back into its datagrams, in place */
+        uint32_t offset = 0;
+        do {
+            const uint32_t size = ((len - offset) < segment) ? (len - offset) : segment;
+
+            if ((size > MAX_BUFF_SIZE) || (count == UDP_RX_MAX)) {
+                self->stats.rx_truncated++;
+            } else if (nodeId == UDP_NO_NODE) {
+                self->stats.rx_unknown++;
+            } else {
+                self->rx_spdus[count].nodeId = nodeId;
+                self->rx_spdus[count].spduLen = size;
+                self->rx_spdus[count].pSpduData = &data[offset];
+                count++;
+                self->stats.rx_coalesced += (gro > 0U) ? 1U : 0U;
+            }
+            offset += segment;
+        } while (offset < len);
+    }
+    self->stats.rx_datagrams += count;
+    *pSpdus = self->rx_spdus;
+
+    return count;
+}
+
+uint32_t Udp_Poll(UdpTransport* const self, const SafeCom* const instance)
+{
+    assert(self != NULL);
+    assert(instance != NULL);
+
+    const SafeComSpdu* spdus;
+    const uint32_t count = Udp_Receive(self, &spdus);
+
+    if (count > 0U) {
+        SafeCom_ReceiveSpduBatch(instance, spdus, count);
+    }
+    Udp_Flush(self);
+
+    return count;
+}
@@ -0,0 +1,468 @@
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include "uring.h"
+#include "assert.h"
+#include "log.h"
+
+/* What a completion belongs to, in the low half of user_data; sends carry tx_epoch in the high half */
+#define URING_TX    1U
+#define URING_RX    2U
+#define URING_KIND  0xFFFFFFFFULL
+
+/* liburing is not required; the three system calls are all the transport needs */
+static int uring_setup(const uint32_t entries, struct io_uring_params* const params)
+{
+    return (int)syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int uring_enter(const int fd, const uint32_t to_submit, const uint32_t min_complete, const uint32_t flags,
+                       const struct io_uring_getevents_arg* const arg)
+{
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, arg, (arg != NULL) ? sizeof(*arg) : 0U);
+}
+
+static int uring_register(const int fd, const uint32_t opcode, void* const arg, const uint32_t nr_args)
+{
+    return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+static StdRet_t map_rings(UringTransport* const self, const struct io_uring_params* const params)
+{
+    self->sq_ring_len = params->sq_off.array + params->sq_entries * sizeof(uint32_t);
+    self->cq_ring_len = params->cq_off.cqes + params->cq_entries * sizeof(struct io_uring_cqe);
+    if ((params->features & IORING_FEAT_SINGLE_MMAP) != 0U) {
+        if (self->cq_ring_len > self->sq_ring_len) {
+            self->sq_ring_len = self->cq_ring_len;
+        }
+        self->cq_ring_len = 0;
+    }
+
+    self->sq_ring = mmap(NULL, self->sq_ring_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, self->ring_fd, IORING_OFF_SQ_RING);
+    if (self->sq_ring == MAP_FAILED) {
+        self->sq_ring = NULL;
+        return NOT_OK;
+    }
+    self->cq_ring = self->sq_ring;
+    if (self->cq_ring_len > 0U) {
+        self->cq_ring = mmap(NULL, self->cq_ring_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, self->ring_fd, IORING_OFF_CQ_RING);
+        if (self->cq_ring == MAP_FAILED) {
+            self->cq_ring = NULL;
+            return NOT_OK;
+        }
+    }
+    self->sqes_len = params->sq_entries * sizeof(struct io_uring_sqe);
+    self->sqes = mmap(NULL, self->sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, self->ring_fd, IORING_OFF_SQES);
+    if (self->sqes == MAP_FAILED) {
+        self->sqes = NULL;
+        return NOT_OK;
+    }
+
+    uint8_t* const sq = self->sq_ring;
+    uint8_t* const cq = self->cq_ring;
+    self->sq_head = (uint32_t*)(sq + params->sq_off.head);
+    self->sq_tail = (uint32_t*)(sq + params->sq_off.tail);
+    self->sq_mask = (uint32_t*)(sq + params->sq_off.ring_mask);
+    self->sq_array = (uint32_t*)(sq + params->sq_off.array);
+    self->cq_head = (uint32_t*)(cq + params->cq_off.head);
+    self->cq_tail = (uint32_t*)(cq + params->cq_off.tail);
+    self->cq_mask = (uint32_t*)(cq + params->cq_off.ring_mask);
+    self->cqes = (struct io_uring_cqe*)(cq + params->cq_off.cqes);
+
+    return OK;
+}
+
+/* Hand a receive buffer back to the kernel; visible once the tail is published */
+static void return_buffer(UringTransport* const self, const uint16_t bid)
+{
+    struct io_uring_buf* const buf = &self->buf_ring->bufs[self->buf_tail & (URING_BUFFERS - 1U)];
+
+    buf->addr = (uint64_t)(uintptr_t)self->buffers[bid];
+    buf->len = URING_BUF_SIZE;
+    buf->bid = bid;
+    self->buf_tail++;
+}
+
+static void publish_buffers(UringTransport* const self)
+{
+    __atomic_store_n(&self->buf_ring->tail, self->buf_tail, __ATOMIC_RELEASE);
+}
+
+static StdRet_t register_buffers(UringTransport* const self)
+{
+    const size_t len = URING_BUFFERS * sizeof(struct io_uring_buf);
+
+    self->buf_ring = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (self->buf_ring == MAP_FAILED) {
+        self->buf_ring = NULL;
+        return NOT_OK;
+    }
+
+    struct io_uring_buf_reg reg = { .ring_addr = (uint64_t)(uintptr_t)self->buf_ring, .ring_entries = URING_BUFFERS, .bgid = 0 };
+    if (uring_register(self->ring_fd, IORING_REGISTER_PBUF_RING, &reg, 1) != 0) {
+        return NOT_OK;
+    }
+    for (uint32_t i = 0; i < URING_BUFFERS; i++) {
+        return_buffer(self, (uint16_t)i);
+    }
+    publish_buffers(self);
+
+    return OK;
+}
+
+/* The caller fills the entry and then pushes it; the kernel only reads it on io_uring_enter */
+static struct io_uring_sqe* next_sqe(UringTransport* const self)
+{
+    const uint32_t tail = *self->sq_tail;
+
+    /* At most a batch of sends and one receive are outstanding, well below URING_ENTRIES */
+    assert((tail - __atomic_load_n(self->sq_head, __ATOMIC_ACQUIRE)) < URING_ENTRIES);
+
+    struct io_uring_sqe* const sqe = &self->sqes[tail & *self->sq_mask];
+    memset(sqe, 0, sizeof(*sqe));
+    return sqe;
+}
+
+static void push_sqe(UringTransport* const self)
+{
+    const uint32_t tail = *self->sq_tail;
+    const uint32_t index = tail & *self->sq_mask;
+
+    self->sq_array[index] = index;
+    __atomic_store_n(self->sq_tail, tail + 1U, __ATOMIC_RELEASE);
+    self->to_submit++;
+}
+
+/* Submit and wait for min_complete completions, at most timeout_ns if that is not 0.
+   NOT_OK if the ring failed or the wait timed out; EBUSY only means the completions must be reaped first. */
+static StdRet_t enter(UringTransport* const self, const uint32_t min_complete, const uint64_t timeout_ns, uint64_t* const syscalls)
+{
+    struct __kernel_timespec ts = { .tv_sec = (int64_t)(timeout_ns / 1000000000U), .tv_nsec = (int64_t)(timeout_ns % 1000000000U) };
+    const struct io_uring_getevents_arg arg = { .ts = (uint64_t)(uintptr_t)&ts };
+    const bool timed = (timeout_ns > 0U);
+    int ret;
+
+    do {
+        ret = uring_enter(self->ring_fd, self->to_submit, min_complete,
+                          IORING_ENTER_GETEVENTS | (timed ? IORING_ENTER_EXT_ARG : 0U), timed ? &arg : NULL);
+        (*syscalls)++;
+    } while ((ret < 0) && (errno == EINTR));
+
+    if (ret >= 0) {
+        self->to_submit -= ((uint32_t)ret < self->to_submit) ? (uint32_t)ret : self->to_submit;
+    } else if (errno == ETIME) {
+        LOG_ERROR("%u sends not completed in time", self->tx_inflight);
+        return NOT_OK;
+    } else if (errno != EBUSY) {
+        LOG_ERROR("io_uring_enter failed: %s", strerror(errno));
+        return NOT_OK;
+    }
+
+    return OK;
+}
+
+/* Sends in flight are given up and SQEs not yet submitted are taken back, so nothing waits on them.
+   Completions that still come for them carry an old epoch and are ignored. */
+static void drop_sends(UringTransport* const self)
+{
+    const uint32_t tail = *self->sq_tail;
+
+    for (uint32_t i = 1; i <= self->to_submit; i++) {
+        if ((self->sqes[(tail - i) & *self->sq_mask].user_data & URING_KIND) == URING_RX) {
+            self->rx_armed = false;
+        }
+    }
+    __atomic_store_n(self->sq_tail, tail - self->to_submit, __ATOMIC_RELEASE);
+    self->to_submit = 0;
+    self->udp.stats.tx_dropped += self->tx_inflight;
+    self->tx_inflight = 0;
+    self->tx_epoch++;
+}
+
+/* Completions of sends are counted, those of the receive are kept for Uring_Receive */
+static void reap(UringTransport* const self)
+{
+    uint32_t head = *self->cq_head;
+    const uint32_t tail = __atomic_load_n(self->cq_tail, __ATOMIC_ACQUIRE);
+
+    for (; head != tail; head++) {
+        const struct io_uring_cqe* const cqe = &self->cqes[head & *self->cq_mask];
+
+        if ((cqe->user_data & URING_KIND) == URING_TX) {
+            if ((cqe->user_data >> 32) != self->tx_epoch) {
+                continue;
+            }
+            self->tx_inflight--;
+            if (cqe->res < 0) {
+                self->udp.stats.tx_dropped++;
+            } else {
+                self->udp.stats.tx_datagrams++;
+            }
+        } else {
+            /* Every receive completion holds a buffer, so there are never more than URING_BUFFERS and a few errors */
+            assert(self->stash_count < URING_STASH);
+            self->stash[(self->stash_head + self->stash_count) & (URING_STASH - 1U)] = *cqe;
+            self->stash_count++;
+        }
+    }
+    __atomic_store_n(self->cq_head, head, __ATOMIC_RELEASE);
+}
+
+static void arm_receive(UringTransport* const self)
+{
+    struct io_uring_sqe* const sqe = next_sqe(self);
+
+    sqe->opcode = IORING_OP_RECVMSG;
+    sqe->fd = self->udp.fd;
+    sqe->addr = (uint64_t)(uintptr_t)&self->rx_msg;
+    sqe->len = 1;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = 0;
+    sqe->user_data = URING_RX;
+    push_sqe(self);
+    self->rx_armed = true;
+}
+
+static void prep_send(UringTransport* const self, const struct sockaddr_in* const peer, const uint8_t* const pData, const SpduLen_t len)
+{
+    const uint32_t slot = self->tx_queued++;
+    struct msghdr* const msg = &self->tx_msgs[slot];
+    struct iovec* const iov = &self->udp.tx_iov[slot];
+    struct io_uring_sqe* const sqe = next_sqe(self);
+
+    iov->iov_base = (void*)pData;
+    iov->iov_len = len;
+    msg->msg_name = (void*)peer;
+    msg->msg_namelen = sizeof(*peer);
+    msg->msg_iov = iov;
+    msg->msg_iovlen = 1;
+
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = self->udp.fd;
+    sqe->addr = (uint64_t)(uintptr_t)msg;
+    sqe->len = 1;
+    sqe->user_data = URING_TX | ((uint64_t)self->tx_epoch << 32);
+    push_sqe(self);
+}
+
+StdRet_t Uring_Init(UringTransport* const self, const UdpConfig* const pConfig)
+{
+    assert(self != NULL);
+    assert(pConfig != NULL);
+
+    /* The registered buffers take one datagram each, GRO bursts would not fit */
+    UdpConfig config = *pConfig;
+    config.offload = false;
+
+    memset(self, 0, sizeof(*self));
+    self->ring_fd = -1;
+    if (Udp_Init(&self->udp, &config) != OK) {
+        return NOT_OK;
+    }
+
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    self->ring_fd = uring_setup(URING_ENTRIES, &params);
+    if ((self->ring_fd < 0) || (map_rings(self, &params) != OK) || (register_buffers(self) != OK)) {
+        LOG_ERROR("io_uring not available: %s", strerror(errno));
+        Uring_Close(self);
+        return NOT_OK;
+    }
+
+    self->rx_msg.msg_namelen = sizeof(struct sockaddr_in);
+    arm_receive(self);
+    enter(self, 0, 0, &self->udp.stats.rx_syscalls);
+    reap(self);
+
+    /* A kernel without multishot recvmsg fails the request right away */
+    if ((self->stash_count > 0U) && (self->stash[self->stash_head].res == -EINVAL)) {
+        LOG_ERROR("multishot recvmsg not supported");
+        Uring_Close(self);
+        return NOT_OK;
+    }
+
+    return OK;
+}
+
+void Uring_Close(UringTransport* const self)
+{
+    assert(self != NULL);
+
+    if (self->ring_fd >= 0) {
+        close(self->ring_fd);
+        self->ring_fd = -1;
+    }
+    if (self->buf_ring != NULL) {
+        munmap(self->buf_ring, URING_BUFFERS * sizeof(struct io_uring_buf));
+        self->buf_ring = NULL;
+    }
+    if (self->sqes != NULL) {
+        munmap(self->sqes, self->sqes_len);
+        self->sqes = NULL;
+    }
+    if ((self->cq_ring != NULL) && (self->cq_ring != self->sq_ring)) {
+        munmap(self->cq_ring, self->cq_ring_len);
+    }
+    self->cq_ring = NULL;
+    if (self->sq_ring != NULL) {
+        munmap(self->sq_ring, self->sq_ring_len);
+        self->sq_ring = NULL;
+    }
+    self->tx_queued = 0;
+    self->tx_inflight = 0;
+    Udp_Close(&self->udp);
+}
+
+StdRet_t Uring_SendSpdu(UringTransport* const self, const NodeId_t nodeId, const SpduLen_t spduLen, const uint8_t* const pSpduData)
+{
+    assert(self != NULL);
+    assert(pSpduData != NULL);
+
+    const struct sockaddr_in* const peer = Udp_PeerOf(&self->udp, nodeId);
+    if ((peer == NULL) || (spduLen > MAX_BUFF_SIZE)) {
+        self->udp.stats.tx_dropped++;
+        return NOT_OK;
+    }
+
+    if (self->tx_queued == UDP_BATCH) {
+        Uring_Flush(self);
+    }
+    uint8_t* const frame = self->udp.tx_frames[self->tx_queued];
+    memcpy(frame, pSpduData, spduLen);
+    prep_send(self, peer, frame, spduLen);
+
+    return OK;
+}
+
+StdRet_t Uring_SendSpduBatch(UringTransport* const self, const SafeComSpdu* const pSpdus, const uint32_t count)
+{
+    assert(self != NULL);
+    assert((pSpdus != NULL) || (count == 0U));
+
+    const uint64_t dropped = self->udp.stats.tx_dropped;
+
+    Uring_Flush(self);
+    for (uint32_t i = 0; i < count; i++) {
+        const struct sockaddr_in* const peer = Udp_PeerOf(&self->udp, pSpdus[i].nodeId);
+
+        if (peer == NULL) {
+            self->udp.stats.tx_dropped++;
+            continue;
+        }
+        prep_send(self, peer, pSpdus[i].pSpduData, pSpdus[i].spduLen);
+        if (self->tx_queued == UDP_BATCH) {
+            Uring_Flush(self);
+        }
+    }
+    Uring_Flush(self);
+
+    return (self->udp.stats.tx_dropped == dropped) ? OK : NOT_OK;
+}
+
+uint32_t Uring_Flush(UringTransport* const self)
+{
+    assert(self != NULL);
+
+    const uint64_t sent = self->udp.stats.tx_datagrams;
+
+    self->tx_inflight += self->tx_queued;
+    self->tx_queued = 0;
+
+    /* Usually a single io_uring_enter submits the sends and returns once they completed */
+    while ((self->tx_inflight > 0U) && (self->ring_fd >= 0)) {
+        if (enter(self, self->tx_inflight, URING_FLUSH_TIMEOUT_NS, &self->udp.stats.tx_syscalls) != OK) {
+            reap(self);
+            drop_sends(self);
+            break;
+        }
+        reap(self);
+    }
+
+    return (uint32_t)(self->udp.stats.tx_datagrams - sent);
+}
+
+uint32_t Uring_Receive(UringTransport* const self, const SafeComSpdu** const pSpdus)
+{
+    assert(self != NULL);
+    assert(pSpdus != NULL);
+
+    for (uint32_t i = 0; i < self->held_count; i++) {
+        return_buffer(self, self->held[i]);
+    }
+    if (self->held_count > 0U) {
+        publish_buffers(self);
+        self->held_count = 0;
+    }
+    if (!self->rx_armed) {
+        arm_receive(self);
+    }
+
+    /* Completions already in the ring are taken without a system call */
+    reap(self);
+    if ((self->stash_count == 0U) || (self->to_submit > 0U)) {
+        enter(self, 0, 0, &self->udp.stats.rx_syscalls);
+        reap(self);
+    }
+
+    SafeComSpdu* const spdus = self->udp.rx_spdus;
+    uint32_t count = 0;
+
+    while ((self->held_count < UDP_BATCH) && (self->stash_count > 0U)) {
+        const struct io_uring_cqe cqe = self->stash[self->stash_head];
+
+        self->stash_head = (self->stash_head + 1U) & (URING_STASH - 1U);
+        self->stash_count--;
+        if ((cqe.flags & IORING_CQE_F_MORE) == 0U) {
+            self->rx_armed = false;     /* Out of buffers or failed, armed again on the next call */
+        }
+        if ((cqe.flags & IORING_CQE_F_BUFFER) == 0U) {
+            continue;
+        }
+
+        const uint16_t bid = (uint16_t)(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+        self->held[self->held_count++] = bid;
+        if (cqe.res < 0) {
+            continue;
+        }
+
+        /* recvmsg header, source address and payload, all in the registered buffer */
+        const struct io_uring_recvmsg_out* const out = (const struct io_uring_recvmsg_out*)self->buffers[bid];
+        const struct sockaddr_in* const name = (const struct sockaddr_in*)(out + 1);
+        const uint8_t* const payload = (const uint8_t*)(out + 1) + self->rx_msg.msg_namelen + self->rx_msg.msg_controllen;
+        const NodeId_t nodeId = (out->namelen == sizeof(*name)) ? Udp_NodeOf(&self->udp, name) : UDP_NO_NODE;
+
+        if (((out->flags & MSG_TRUNC) != 0U) || (out->payloadlen > MAX_BUFF_SIZE)) {
+            self->udp.stats.rx_truncated++;
+        } else if (nodeId == UDP_NO_NODE) {
+            self->udp.stats.rx_unknown++;
+        } else {
+            spdus[count].nodeId = nodeId;
+            spdus[count].spduLen = out->payloadlen;
+            spdus[count].pSpduData = payload;
+            count++;
+        }
+    }
+    self->udp.stats.rx_datagrams += count;
+    *pSpdus = spdus;
+
+    return count;
+}
+
+uint32_t Uring_Poll(UringTransport* const self, const SafeCom* const instance)
+{
+    assert(self != NULL);
+    assert(instance != NULL);
+
+    const SafeComSpdu* spdus;
+    const uint32_t count = Uring_Receive(self, &spdus);
+
+    if (count > 0U) {
+        SafeCom_ReceiveSpduBatch(instance, spdus, count);
+    }
+    Uring_Flush(self);
+
+    return count;
+}